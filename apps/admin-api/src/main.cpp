@@ -4,6 +4,7 @@
 #include <spdlog/spdlog.h>
 #include "common/env.hpp"
 #include "common/log.hpp"
+#include "common/metrics.hpp"
 #include <hyperswitch/routing/route.grpc.pb.h>
 
 int main() {
@@ -14,7 +15,12 @@ int main() {
   auto channel = grpc::CreateChannel(route_addr, grpc::InsecureChannelCredentials());
   auto route_stub = hyperswitch::routing::RouteService::NewStub(channel);
 
+  auto& pick_latency = hs::metrics::registry().histogram("hs_admin_upstream_seconds", "Upstream gRPC call latency", {{"method", "Pick"}});
+
   httplib::Server svr;
+  svr.Get("/metrics", [](const httplib::Request&, httplib::Response& res) {
+    res.set_content(hs::metrics::registry().expose(), "text/plain; version=0.0.4");
+  });
   svr.Post("/internal/route/pick", [&](const httplib::Request& req, httplib::Response& res){
     try {
       auto j = nlohmann::json::parse(req.body);
@@ -30,7 +36,9 @@ int main() {
 
       grpc::ClientContext ctx;
       hyperswitch::routing::PickResponse presp;
+      auto t0 = std::chrono::steady_clock::now();
       auto st = route_stub->Pick(&ctx, preq, &presp);
+      pick_latency.record(std::chrono::steady_clock::now() - t0);
       if (!st.ok()) {
         res.status = 502;
         res.set_content(nlohmann::json({{"error", st.error_message()}}).dump(), "application/json");
@@ -39,6 +47,11 @@ int main() {
       nlohmann::json out;
       out["route_plan"] = presp.route_plan();
       out["policy_version"] = presp.policy_version();
+      out["e164_to"] = presp.e164_to();
+      if (!presp.dest_region().empty()) {
+        out["dest_region"] = presp.dest_region();
+        out["number_type"] = presp.number_type();
+      }
       out["candidates"] = nlohmann::json::array();
       for (const auto& c : presp.candidates()) {
         out["candidates"].push_back({
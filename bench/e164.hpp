@@ -0,0 +1,100 @@
+#pragma once
+// 基准与压测共用的合成 E.164 号码：按国际批发话务的大致分布选国家，再按号段选前几位（靠前的号段更热），
+// 其余位随机。prefixes() 生成覆盖同一分布的前缀表，号码与前缀表用同一种子时可复现
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace hs::bench {
+
+struct Country {
+  const char* cc;
+  double weight;   // 话务占比（相对值）
+  int nsn_len;     // 国内有效号码长度
+  std::vector<const char*> leads;  // 常见号段，按热度降序
+};
+
+inline const std::vector<Country>& countries() {
+  static const std::vector<Country> c = {
+    {"1", 18, 10, {"212", "646", "917", "718", "305", "786", "213", "415", "312", "713", "469", "702", "818", "201"}},
+    {"91", 9, 10, {"9", "8", "7", "6"}},
+    {"86", 8, 11, {"13", "15", "18", "17"}},
+    {"44", 8, 10, {"7", "20", "121", "161", "131"}},
+    {"49", 7, 11, {"151", "152", "157", "160", "170", "171", "176", "30", "40", "89"}},
+    {"33", 5, 9, {"6", "7", "1"}},
+    {"52", 5, 10, {"55", "33", "81", "1"}},
+    {"55", 5, 11, {"11", "21", "31", "41"}},
+    {"39", 4, 10, {"3", "06", "02"}},
+    {"34", 4, 9, {"6", "7", "91", "93"}},
+    {"234", 4, 10, {"80", "81", "70", "90"}},
+    {"62", 4, 11, {"81", "82", "85", "21"}},
+    {"880", 3, 10, {"17", "18", "19", "15"}},
+    {"92", 3, 10, {"30", "31", "33", "34"}},
+    {"63", 3, 10, {"9", "2"}},
+    {"7", 3, 10, {"9", "495", "812"}},
+    {"20", 2, 10, {"10", "11", "12", "2"}},
+    {"971", 2, 9, {"50", "52", "55", "4"}},
+    {"966", 2, 9, {"5", "1"}},
+    {"61", 2, 9, {"4", "2", "3"}},
+  };
+  return c;
+}
+
+class E164Mix {
+public:
+  explicit E164Mix(uint64_t seed = 1) : rng_(seed) {
+    std::vector<double> w;
+    for (const auto& c : countries()) {
+      w.push_back(c.weight);
+      // 号段热度按 1/(i+1) 衰减
+      std::vector<double> lw;
+      for (size_t i = 0; i < c.leads.size(); ++i) lw.push_back(1.0 / static_cast<double>(i + 1));
+      lead_.emplace_back(lw.begin(), lw.end());
+    }
+    country_ = std::discrete_distribution<size_t>(w.begin(), w.end());
+  }
+
+  // 生成一个号码（国家码开头，不含 +），返回国家码加号段的长度
+  size_t next(std::string& out) {
+    size_t ci = country_(rng_);
+    const Country& c = countries()[ci];
+    out.assign(c.cc);
+    out += c.leads[lead_[ci](rng_)];
+    size_t head = out.size();
+    size_t len = std::char_traits<char>::length(c.cc) + static_cast<size_t>(c.nsn_len);
+    while (out.size() < len) out += static_cast<char>('0' + rng_() % 10);
+    return head;
+  }
+  std::string next() {
+    std::string s;
+    next(s);
+    return s;
+  }
+
+  // n 条前缀：全部国家码与号段，其余为按同一分布抽取的号段细分（再延长 1~5 位），去重后排序
+  std::vector<std::string> prefixes(size_t n) {
+    std::unordered_set<std::string> seen;
+    for (const auto& c : countries()) {
+      seen.insert(c.cc);
+      for (const char* l : c.leads) seen.insert(std::string(c.cc) + l);
+    }
+    std::string num;
+    while (seen.size() < n) {
+      size_t head = next(num);
+      seen.insert(num.substr(0, std::min(num.size() - 1, head + 1 + rng_() % 5)));
+    }
+    std::vector<std::string> out(seen.begin(), seen.end());
+    std::sort(out.begin(), out.end());
+    return out;
+  }
+
+private:
+  std::mt19937_64 rng_;
+  std::discrete_distribution<size_t> country_;
+  std::vector<std::discrete_distribution<size_t>> lead_;
+};
+
+}
@@ -0,0 +1,219 @@
+#include "fake_backend.hpp"
+#include <hyperswitch/billing/billing.grpc.pb.h>
+#include <hyperswitch/cdr/cdr.grpc.pb.h>
+#include <hyperswitch/observe/observe.grpc.pb.h>
+#include <hyperswitch/routing/route.grpc.pb.h>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <filesystem>
+#include <vector>
+#include "batch_pipeline.hpp"
+#include "cdr_ingest_impl.hpp"
+#include "common/call_registry.hpp"
+#include "common/number.hpp"
+#include "common/prefix_trie.hpp"
+#include "common/rpc_server.hpp"
+#include "e164.hpp"
+#include "observe_ingest_impl.hpp"
+#include "penalty_cache.hpp"
+#include "rate_engine.hpp"
+
+namespace hs::bench {
+
+using hyperswitch::billing::BillingService;
+using hyperswitch::cdr::CdrIngest;
+using hyperswitch::observe::ObserveIngest;
+using hyperswitch::routing::RouteService;
+
+namespace {
+
+constexpr size_t kVendors = 20;
+constexpr size_t kCandidates = 3;
+
+// 合成的路由计划：每个前缀 kCandidates 个供应商，按前缀散列分配
+class FakeRoutes {
+public:
+  explicit FakeRoutes(const std::vector<std::string>& deck) : penalties_(nullptr, {}) {
+    for (size_t i = 0; i < deck.size(); ++i) {
+      *trie_.insert(deck[i]) = static_cast<uint32_t>(i);
+      size_t h = std::hash<std::string>{}(deck[i]);
+      for (size_t k = 0; k < kCandidates; ++k) vendors_.push_back(static_cast<uint32_t>((h + k * 7) % kVendors));
+    }
+    hs::StringMap<double> p;
+    for (size_t v = 0; v < kVendors; v += 4) p.emplace("vend-" + std::to_string(v), 0.5);
+    penalties_.apply(std::move(p));
+  }
+
+  ::grpc::Status pick(const hyperswitch::routing::PickRequest& req, hyperswitch::routing::PickResponse* resp) const {
+    hs::number::E164 to;
+    if (hs::number::normalize(req.e164_to().empty() ? req.to_uri() : req.e164_to(), to) != hs::number::Status::Ok)
+      return ::grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT, "invalid destination number");
+    resp->set_e164_to(std::string(to.view()));
+    uint32_t v = trie_.longest(to.view());
+    if (v == hs::PrefixTrie::kNone) return ::grpc::Status(::grpc::StatusCode::NOT_FOUND, "no route candidates");
+    for (size_t k = 0; k < kCandidates; ++k) {
+      uint32_t vendor = vendors_[v * kCandidates + k];
+      auto trunk = "vend-" + std::to_string(vendor);
+      auto* c = resp->add_candidates();
+      c->set_vendor("vendor-" + std::to_string(vendor));
+      c->set_ip("10.20.30." + std::to_string(vendor + 1));
+      c->set_port(5060);
+      c->set_priority(static_cast<uint32_t>(k + 1));
+      c->set_weight(std::max(1, static_cast<int>(100 * penalties_.penalty(trunk))));
+      c->set_entry_id(static_cast<int64_t>(v * kCandidates + k));
+      c->set_egress_trunk(std::move(trunk));
+    }
+    resp->set_route_plan("fake");
+    resp->set_policy_version("v1");
+    return ::grpc::Status::OK;
+  }
+
+private:
+  hs::PrefixTrie trie_;
+  std::vector<uint32_t> vendors_;
+  hs::routing::PenaltyCache penalties_;
+};
+
+// 合成的费率表：所有账户共用一张
+class FakeRates {
+public:
+  explicit FakeRates(const std::vector<std::string>& deck) {
+    static constexpr uint32_t kSteps[][2] = {{1, 1}, {60, 60}, {30, 6}, {60, 1}};
+    for (const auto& p : deck) {
+      size_t h = std::hash<std::string>{}(p);
+      hs::billing::RateItem it;
+      it.price_per_min = hs::Money::from_micros(static_cast<int64_t>(1000 + h % 250000));
+      it.min_time_sec = kSteps[h % 4][0];
+      it.step_sec = kSteps[h % 4][1];
+      it.rounding = hs::Rounding::HalfUp;
+      it.prefix = p;
+      *deck_.trie.insert(p) = static_cast<uint32_t>(deck_.items.size());
+      deck_.items.push_back(std::move(it));
+    }
+  }
+
+  const hs::billing::RateItem* match(std::string_view e164) const { return engine_.match(deck_, e164); }
+
+private:
+  hs::billing::RateDeck deck_;
+  hs::billing::RateEngine engine_;
+};
+
+const hs::Money kMinReserve = hs::Money::from_micros(100000);
+
+}
+
+struct FakeBackend::Impl {
+  explicit Impl(const Options& opt)
+    : deck(E164Mix(42).prefixes(opt.prefixes)),
+      routes(deck),
+      rates(deck),
+      spool(hs::cdr::Spool::Options{opt.spool_dir, size_t{64} << 20, opt.fsync}),
+      pipeline(&spool, {}, [](const std::string&, const std::string&) {}),
+      calls(hs::CallRegistry::Options{}),
+      cdr(&pipeline, &calls),
+      agg(nullptr, {}),
+      observe(&agg),
+      server(make_options(opt)) {}
+
+  static hs::rpc::Options make_options(const Options& opt) {
+    hs::rpc::Options o;
+    o.bind = opt.bind;
+    o.workers = 16;
+    return hs::rpc::options_from_env(o);
+  }
+
+  void authorize(const hyperswitch::billing::AuthorizeRequest& req, hyperswitch::billing::AuthorizeResponse* resp) {
+    hs::Money amount = kMinReserve;
+    if (!req.e164_to().empty()) {
+      const auto* item = rates.match(req.e164_to());
+      if (!item) {
+        resp->set_allowed(false);
+        resp->set_reason("no rate for destination");
+        return;
+      }
+      amount = std::max(amount, hs::billing::RateEngine::charge(*item, req.expected_secs()));
+    }
+    resp->set_allowed(true);
+    resp->set_auth_token("fake:" + req.call_id());
+    resp->set_authorized_amount(amount.to_double());
+    resp->set_authorized_amount_exact(amount.str());
+  }
+
+  ::grpc::Status settle(const hyperswitch::billing::SettleRequest& req, hyperswitch::billing::SettleResponse* resp) {
+    const auto* item = rates.match(req.e164_to());
+    if (!item) return ::grpc::Status(::grpc::StatusCode::NOT_FOUND, "no rate for destination");
+    auto amount = hs::billing::RateEngine::charge(*item, req.billsec());
+    resp->set_success(true);
+    resp->set_final_amount(amount.to_double());
+    resp->set_final_amount_exact(amount.str());
+    return ::grpc::Status::OK;
+  }
+
+  std::vector<std::string> deck;
+  FakeRoutes routes;
+  FakeRates rates;
+  hs::cdr::Spool spool;
+  hs::cdr::BatchPipeline pipeline;
+  hs::CallRegistry calls;
+  hs::cdr::CdrIngestImpl cdr;
+  hs::observe::QualityAggregator agg;
+  hs::observe::ObserveIngestImpl observe;
+  RouteService::AsyncService route_svc;
+  BillingService::AsyncService billing_svc;
+  CdrIngest::AsyncService cdr_svc;
+  ObserveIngest::AsyncService observe_svc;
+  hs::rpc::Server server;
+};
+
+FakeBackend::FakeBackend(Options opt) {
+  std::filesystem::remove_all(opt.spool_dir);
+  impl_ = std::make_unique<Impl>(opt);
+  auto* d = impl_.get();
+  d->pipeline.start();
+
+  auto& s = d->server;
+  s.unary("Pick", &d->route_svc, &RouteService::AsyncService::RequestPick,
+          [d](auto*, auto* req, auto* resp) { return d->routes.pick(*req, resp); });
+  s.unary("PickBatch", &d->route_svc, &RouteService::AsyncService::RequestPickBatch, [d](auto*, auto* req, auto* resp) {
+    for (const auto& item : req->items()) {
+      auto* r = resp->add_results();
+      r->set_seq(item.seq());
+      auto st = d->routes.pick(item.request(), r->mutable_response());
+      if (!st.ok()) {
+        r->clear_response();
+        r->set_code(st.error_code());
+        r->set_error(st.error_message());
+      }
+    }
+    return ::grpc::Status::OK;
+  });
+  s.unary("Authorize", &d->billing_svc, &BillingService::AsyncService::RequestAuthorize, [d](auto*, auto* req, auto* resp) {
+    d->authorize(*req, resp);
+    return ::grpc::Status::OK;
+  });
+  s.unary("Settle", &d->billing_svc, &BillingService::AsyncService::RequestSettle,
+          [d](auto*, auto* req, auto* resp) { return d->settle(*req, resp); });
+  // 与 cdr-svc 相同：落盘等待组提交，交给工作线程池
+  s.unary("Push", &d->cdr_svc, &CdrIngest::AsyncService::RequestPush,
+          [d](auto* ctx, auto* req, auto* resp) { return d->cdr.Push(ctx, req, resp); }, hs::rpc::Exec::Pool);
+  s.unary("PushBatch", &d->cdr_svc, &CdrIngest::AsyncService::RequestPushBatch,
+          [d](auto* ctx, auto* req, auto* resp) { return d->cdr.PushBatch(ctx, req, resp); }, hs::rpc::Exec::Pool);
+  s.bidi_stream("PushStream", &d->cdr_svc, &CdrIngest::AsyncService::RequestPushStream,
+                [d](auto* ctx, const auto& req, auto& resp) { return d->cdr.PushStream(ctx, req, resp); }, hs::rpc::Exec::Pool);
+  s.unary("PushRtcp", &d->observe_svc, &ObserveIngest::AsyncService::RequestPushRtcp,
+          [d](auto* ctx, auto* req, auto* resp) { return d->observe.PushRtcp(ctx, req, resp); });
+  s.unary("PushRtcpBatch", &d->observe_svc, &ObserveIngest::AsyncService::RequestPushRtcpBatch,
+          [d](auto* ctx, auto* req, auto* resp) { return d->observe.PushRtcpBatch(ctx, req, resp); });
+  s.client_stream("PushRtcpStream", &d->observe_svc, &ObserveIngest::AsyncService::RequestPushRtcpStream,
+                  [d](auto* ctx, const auto& req, auto& resp) { return d->observe.PushRtcpStream(ctx, req, resp); });
+  s.start();
+  spdlog::info("Fake backend on {} ({} prefixes, spool {})", opt.bind, d->deck.size(), opt.spool_dir);
+}
+
+FakeBackend::~FakeBackend() {
+  impl_->server.shutdown();
+  impl_->pipeline.stop();
+}
+
+}
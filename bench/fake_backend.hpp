@@ -0,0 +1,32 @@
+#pragma once
+// loadgen --fake 使用的进程内替身：在一个端口上同时提供 RouteService、BillingService、CdrIngest、ObserveIngest，
+// 不依赖 PostgreSQL / Redis / ClickHouse，可在裸机上验证框架与压测本身。
+// - CDR：真实的接入逻辑、spool 与写入管道，ClickHouse 换成丢弃数据的发送函数
+// - RTCP：真实的接入与聚合，只是不启动向 Redis 发布的线程
+// - 路由 / 计费：按 e164.hpp 合成的前缀表在内存中选路与计价；Authorize / Settle 立即返回，不模拟账本提交延迟
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace hs::bench {
+
+class FakeBackend {
+public:
+  struct Options {
+    std::string bind = "127.0.0.1:7100";
+    std::string spool_dir = "/tmp/hs_bench_spool/loadgen";  // 启动时清空
+    bool fsync = false;
+    size_t prefixes = 60000;
+  };
+
+  explicit FakeBackend(Options opt);
+  ~FakeBackend();
+  FakeBackend(const FakeBackend&) = delete;
+  FakeBackend& operator=(const FakeBackend&) = delete;
+
+private:
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+}
@@ -0,0 +1,91 @@
+// SipAuth 源地址匹配基准：IPv4 /24 与主机地址、IPv6 /48、/64 与 /128 混合的中继 ACL 上做最长前缀匹配。
+// 建表后先核对边界前缀（/64、/128 与 IPv4-mapped 地址不得误中 IPv6 条目），不一致时不计时
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "ip_acl.hpp"
+
+namespace {
+
+constexpr size_t kLookups = 1 << 14;
+
+struct Fixture {
+  hs::auth::IpAcl acl;
+  std::vector<hs::auth::IpAddr> probes;
+  std::string error;
+};
+
+void add(hs::auth::IpAcl& acl, const std::string& cidr, int64_t trunk) {
+  uint32_t e = acl.add_entry({trunk, "acc", "t" + std::to_string(trunk)});
+  acl.insert(*hs::auth::parse_cidr(cidr), e);
+}
+
+// 期望命中的中继，0 表示不命中
+bool expect(const Fixture& f, const char* ip, int64_t trunk, std::string& error) {
+  const auto* e = f.acl.match(*hs::auth::parse_ip(ip));
+  int64_t got = e ? e->trunk_id : 0;
+  if (got == trunk) return true;
+  error = std::string(ip) + " matched trunk " + std::to_string(got) + ", want " + std::to_string(trunk);
+  return false;
+}
+
+std::unique_ptr<Fixture> build(size_t trunks) {
+  auto f = std::make_unique<Fixture>();
+  std::mt19937_64 rng(11);
+  char buf[64];
+  int64_t id = 1;
+  // 边界前缀：/64 与 /128 的掩码恰好落在 64 位字的边界
+  add(f->acl, "2001:db8:1:2::/64", id++);
+  add(f->acl, "2001:db8:1:2::10/128", id++);
+  add(f->acl, "2001:db8:1:3::/64", id++);
+  for (size_t i = 0; i < trunks; ++i) {
+    uint64_t r = rng();
+    switch (i % 4) {
+      case 0: std::snprintf(buf, sizeof(buf), "%u.%u.%u.0/24", unsigned(r >> 56) | 1, unsigned(r >> 48) & 255, unsigned(r >> 40) & 255); break;
+      case 1: std::snprintf(buf, sizeof(buf), "%u.%u.%u.%u", unsigned(r >> 56) | 1, unsigned(r >> 48) & 255, unsigned(r >> 40) & 255, unsigned(r >> 32) & 255); break;
+      case 2: std::snprintf(buf, sizeof(buf), "2a00:%x:%x::/48", unsigned(r >> 48), unsigned(r >> 32) & 0xffff); break;
+      case 3: std::snprintf(buf, sizeof(buf), "2a01:%x:%x:%x::/64", unsigned(r >> 48), unsigned(r >> 32) & 0xffff, unsigned(r >> 16) & 0xffff); break;
+    }
+    add(f->acl, buf, id++);
+    // 一半探测地址落在条目内，一半随机
+    uint64_t h = rng();
+    switch (i % 4) {
+      case 0: std::snprintf(buf + std::string_view(buf).rfind('.') + 1, 16, "%u", unsigned(h & 255)); break;
+      case 1: break;
+      default: std::snprintf(buf + std::string_view(buf).find("::") + 2, 24, "%x", unsigned(h & 0xffff)); break;
+    }
+    f->probes.push_back(*hs::auth::parse_ip(buf));
+    f->probes.push_back({rng(), rng()});
+  }
+  for (size_t i = 0, n = f->probes.size(); f->probes.size() < kLookups; ++i) f->probes.push_back(f->probes[i % n]);
+  expect(*f, "2001:db8:1:2::10", 2, f->error) && expect(*f, "2001:db8:1:2::11", 1, f->error) &&
+    expect(*f, "2001:db8:1:2:ffff::1", 1, f->error) && expect(*f, "2001:db8:1:3::1", 3, f->error) &&
+    expect(*f, "2001:db8:1:4::1", 0, f->error) && expect(*f, "::1", 0, f->error) &&
+    expect(*f, "203.0.113.9", 0, f->error) && expect(*f, "10.1.2.3", 0, f->error);
+  return f;
+}
+
+// Arg: 中继条目数
+void BM_Match(benchmark::State& state) {
+  auto f = build(static_cast<size_t>(state.range(0)));
+  if (!f->error.empty()) {
+    state.SkipWithError(f->error.c_str());
+    return;
+  }
+  size_t i = 0, hits = 0;
+  for (auto _ : state) {
+    const auto* e = f->acl.match(f->probes[i]);
+    hits += e != nullptr;
+    benchmark::DoNotOptimize(e);
+    i = (i + 1) & (kLookups - 1);
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["hit_ratio"] = static_cast<double>(hits) / static_cast<double>(state.iterations());
+  state.counters["nodes"] = static_cast<double>(f->acl.nodes());
+}
+BENCHMARK(BM_Match)->ArgName("trunks")->Arg(100)->Arg(10000);
+
+}
@@ -0,0 +1,71 @@
+// RiskEval 限流判定基准（本地模式）：同一计数器上的多线程争用与互不相关计数器的扩展性
+// 同一中继：CPS 令牌桶按线程分片，速率高于 kStripeMinCps * 8 时分为 8 片；并发计数为单个原子量
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "limiter.hpp"
+
+namespace {
+
+std::unique_ptr<hs::auth::Limiter> g_limiter;
+
+void setup(uint32_t max_cps, uint32_t max_concurrent, int trunks) {
+  hs::auth::Limiter::Limits l;
+  l.accounts["acc"] = {0, 0};
+  for (int i = 0; i < trunks; ++i) l.trunks["t" + std::to_string(i)] = {max_cps, max_concurrent};
+  l.account_ingress["acc"] = "t0";
+  l.entries[1] = {max_cps, max_concurrent};
+  g_limiter = std::make_unique<hs::auth::Limiter>(nullptr, hs::auth::Limiter::Options{});
+  g_limiter->apply(l);
+}
+
+void report(benchmark::State& state) {
+  if (state.thread_index() != 0) return;
+  const auto& s = g_limiter->stats();
+  state.counters["allowed"] = static_cast<double>(s.allowed.load());
+  state.counters["rejected"] = static_cast<double>(s.rejected_cps.load() + s.rejected_concurrent.load());
+}
+
+// 所有线程打同一入中继与路由条目，只检查不占用并发；Arg: max_cps
+void BM_SameTrunkCheck(benchmark::State& state) {
+  if (state.thread_index() == 0) setup(static_cast<uint32_t>(state.range(0)), 0, 1);
+  hs::auth::Limiter::Request r;
+  r.account_code = "acc";
+  r.ingress_trunk = "t0";
+  r.plan_entry_id = 1;
+  for (auto _ : state) benchmark::DoNotOptimize(g_limiter->acquire(r));
+  report(state);
+}
+BENCHMARK(BM_SameTrunkCheck)->Arg(1'000'000'000)->Arg(100)->ThreadRange(1, 64)->UseRealTime();
+
+// 每个线程一个入中继
+void BM_DistinctTrunksCheck(benchmark::State& state) {
+  if (state.thread_index() == 0) setup(1'000'000'000, 0, 64);
+  std::string trunk = "t" + std::to_string(state.thread_index());
+  hs::auth::Limiter::Request r;
+  r.ingress_trunk = trunk;
+  for (auto _ : state) benchmark::DoNotOptimize(g_limiter->acquire(r));
+  report(state);
+}
+BENCHMARK(BM_DistinctTrunksCheck)->ThreadRange(1, 64)->UseRealTime();
+
+// 占用并发名额后立即归还：call_id 分片锁 + 并发原子计数的往返开销
+void BM_SameTrunkCallRelease(benchmark::State& state) {
+  if (state.thread_index() == 0) setup(1'000'000'000, 1'000'000, 1);
+  std::vector<std::string> ids;
+  for (int i = 0; i < 1024; ++i) ids.push_back("call-" + std::to_string(state.thread_index()) + "-" + std::to_string(i));
+  hs::auth::Limiter::Request r;
+  r.account_code = "acc";
+  r.plan_entry_id = 1;
+  size_t n = 0;
+  for (auto _ : state) {
+    r.call_id = ids[n++ & 1023];
+    benchmark::DoNotOptimize(g_limiter->acquire(r));
+    g_limiter->release(r.call_id);
+  }
+  report(state);
+}
+BENCHMARK(BM_SameTrunkCallRelease)->ThreadRange(1, 64)->UseRealTime();
+
+}
@@ -0,0 +1,586 @@
+// gRPC 压测：对运行中的服务发压，输出吞吐与延迟分位
+// 用法：loadgen <mode> [--target host:port] [--concurrency 16] [--duration 10] [--batch 500] [--window 8] [--server-pid PID]
+//                      [--rate N] [--trunks a,b] [--accounts a,b] [--seed N] [--fake]
+// 指定 --server-pid（同机运行的服务进程）时按其 CPU 时间折算每核吞吐；
+// --rate 为开环定速（每秒调用数，批量与流式模式为批次数），不指定时每个并发单元收到应答后立即发下一个；
+// --fake 在进程内启动不依赖数据库的服务替身（见 fake_backend.hpp）并对其发压
+#include <grpcpp/grpcpp.h>
+#include <hyperswitch/billing/billing.grpc.pb.h>
+#include <hyperswitch/cdr/cdr.grpc.pb.h>
+#include <hyperswitch/observe/observe.grpc.pb.h>
+#include <hyperswitch/routing/route.grpc.pb.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "common/env.hpp"
+#include "e164.hpp"
+#include "fake_backend.hpp"
+
+namespace {
+
+using clock_t_ = std::chrono::steady_clock;
+
+struct Options {
+  std::string mode;
+  std::string target;    // 为空时取模式默认端口
+  int concurrency = 16;  // 并发请求线程数（流式为并发流数）
+  int duration = 10;     // 秒
+  int batch = 500;       // 每批事件数
+  int window = 8;        // 流式每条流的在途批次数
+  int server_pid = 0;
+  double rate = 0;       // 每秒调用数，0 为闭环
+  bool fake = false;
+  std::vector<std::string> trunks{"cust-0"};   // Pick 的入中继，轮转使用
+  std::vector<std::string> accounts{"acc-0"};  // Authorize / Settle 的账户，轮转使用
+  uint64_t seed = 1;
+};
+
+const char* code_name(grpc::StatusCode c) {
+  switch (c) {
+    case grpc::StatusCode::CANCELLED: return "CANCELLED";
+    case grpc::StatusCode::INVALID_ARGUMENT: return "INVALID_ARGUMENT";
+    case grpc::StatusCode::DEADLINE_EXCEEDED: return "DEADLINE_EXCEEDED";
+    case grpc::StatusCode::NOT_FOUND: return "NOT_FOUND";
+    case grpc::StatusCode::PERMISSION_DENIED: return "PERMISSION_DENIED";
+    case grpc::StatusCode::RESOURCE_EXHAUSTED: return "RESOURCE_EXHAUSTED";
+    case grpc::StatusCode::FAILED_PRECONDITION: return "FAILED_PRECONDITION";
+    case grpc::StatusCode::INTERNAL: return "INTERNAL";
+    case grpc::StatusCode::UNAVAILABLE: return "UNAVAILABLE";
+    default: return "OTHER";
+  }
+}
+
+// 每个工作线程独立记录，结束后合并
+struct Recorder {
+  uint64_t items = 0;
+  uint64_t errors = 0;
+  std::map<std::string, uint64_t> failures;        // 按状态码或业务拒绝原因计
+  std::array<std::vector<double>, 2> latency_us;  // 下标对应 Mode::series
+  void record(clock_t_::time_point t0, uint64_t n, size_t series = 0) {
+    latency_us[series].push_back(std::chrono::duration<double, std::micro>(clock_t_::now() - t0).count());
+    items += n;
+  }
+  void fail(const std::string& why) {
+    ++errors;
+    ++failures[why];
+  }
+  void fail(const grpc::Status& st) { fail(code_name(st.error_code())); }
+};
+
+// 开环定速：每个线程按 concurrency / rate 的间隔排定发送时刻，延迟自排定时刻起算。
+// 服务端变慢时积压的等待计入延迟，避免闭环压测因少发请求而掩盖排队（coordinated omission）；
+// 未指定 --rate 时为闭环，返回当前时刻
+class Pacer {
+public:
+  explicit Pacer(const Options& o) {
+    if (o.rate <= 0) return;
+    interval_ = std::chrono::duration_cast<clock_t_::duration>(std::chrono::duration<double>(o.concurrency / o.rate));
+    // 各线程随机错开首个发送时刻，避免同时起跳
+    std::mt19937_64 rng(std::random_device{}());
+    next_ = clock_t_::now() + clock_t_::duration(static_cast<clock_t_::rep>(rng() % std::max<clock_t_::rep>(1, interval_.count())));
+  }
+
+  clock_t_::time_point wait() {
+    if (interval_.count() == 0) return clock_t_::now();
+    auto t = next_;
+    next_ += interval_;
+    std::this_thread::sleep_until(t);
+    return t;
+  }
+
+private:
+  clock_t_::duration interval_{0};
+  clock_t_::time_point next_;
+};
+
+// /proc/<pid>/stat 中的 utime + stime，单位秒
+double process_cpu_seconds(int pid) {
+  std::ifstream in("/proc/" + std::to_string(pid) + "/stat");
+  std::string line;
+  if (!std::getline(in, line)) return -1;
+  auto p = line.rfind(')');
+  if (p == std::string::npos) return -1;
+  std::istringstream fields(line.substr(p + 2));
+  std::string f;
+  unsigned long long utime = 0, stime = 0;
+  for (int i = 3; fields >> f; ++i) {
+    if (i == 14) utime = std::stoull(f);
+    if (i == 15) { stime = std::stoull(f); break; }
+  }
+  return static_cast<double>(utime + stime) / static_cast<double>(::sysconf(_SC_CLK_TCK));
+}
+
+void report(const Options& o, const std::vector<const char*>& series, std::vector<Recorder>& recs, double secs,
+            const char* unit, double server_cpu) {
+  Recorder all;
+  for (auto& r : recs) {
+    all.items += r.items;
+    all.errors += r.errors;
+    for (const auto& [why, n] : r.failures) all.failures[why] += n;
+    for (size_t i = 0; i < all.latency_us.size(); ++i)
+      all.latency_us[i].insert(all.latency_us[i].end(), r.latency_us[i].begin(), r.latency_us[i].end());
+  }
+  std::printf("%s: %.0f %s/s over %.1fs (%llu %s, %llu errors, %zu calls)\n", o.mode.c_str(), all.items / secs, unit, secs,
+              static_cast<unsigned long long>(all.items), unit, static_cast<unsigned long long>(all.errors),
+              all.latency_us[0].size());
+  if (o.rate > 0) std::printf("  open loop at %.0f calls/s, latency measured from scheduled send time\n", o.rate);
+  for (size_t i = 0; i < series.size(); ++i) {
+    auto& lat = all.latency_us[i];
+    if (lat.empty()) continue;
+    auto pct = [&](double p) {
+      size_t k = std::min(lat.size() - 1, static_cast<size_t>(p * lat.size()));
+      std::nth_element(lat.begin(), lat.begin() + k, lat.end());
+      return lat[k];
+    };
+    std::printf("  %s latency us: p50=%.0f p90=%.0f p99=%.0f p999=%.0f\n", series[i], pct(0.5), pct(0.9), pct(0.99), pct(0.999));
+  }
+  for (const auto& [why, n] : all.failures) std::printf("  error %s: %llu\n", why.c_str(), static_cast<unsigned long long>(n));
+  if (server_cpu > 0)
+    std::printf("  server cpu: %.2f cores busy, %.0f %s/s per core\n", server_cpu / secs, all.items / server_cpu, unit);
+}
+
+void fill_cdr(hyperswitch::cdr::CdrEvent& e, uint64_t n) {
+  auto id = std::to_string(n);
+  e.set_call_id("loadgen-" + id);
+  e.set_attempt(1);
+  e.set_phase("end");
+  e.set_start_ts("2024-03-01T12:00:00.120Z");
+  e.set_answer_ts("2024-03-01T12:00:04.870Z");
+  e.set_end_ts("2024-03-01T12:03:11.010Z");
+  e.set_from_uri("sip:493012345@carrier-a.example.net");
+  e.set_to_uri("sip:447911" + id + "@10.20.30.40");
+  e.set_e164_from("493012345");
+  e.set_e164_to("447911" + id);
+  e.set_ingress_trunk("cust-" + std::to_string(n % 50));
+  e.set_egress_trunk("vend-" + std::to_string(n % 20));
+  e.set_sip_final_code(200);
+  e.set_sip_final_reason("OK");
+  e.set_route_plan("default");
+  e.set_vendor("vendor-" + std::to_string(n % 20));
+  e.set_codec_in("PCMA");
+  e.set_codec_out("PCMA");
+  e.set_pdd_ms(1200);
+  e.set_acd_seconds(186.14);
+  e.set_bytes_tx(1493200);
+  e.set_bytes_rx(1490100);
+  e.set_node("loadgen");
+}
+
+std::atomic<uint64_t> g_seq{0};
+
+void fill_batch(hyperswitch::cdr::CdrBatch& b, int n) {
+  b.Clear();
+  b.set_seq(g_seq.fetch_add(1));
+  for (int i = 0; i < n; ++i) fill_cdr(*b.add_events(), g_seq.fetch_add(1));
+}
+
+// 每个线程一个同步 unary 调用循环
+void run_cdr_unary(const Options& o, std::shared_ptr<grpc::Channel> ch, Recorder& rec, clock_t_::time_point deadline) {
+  auto stub = hyperswitch::cdr::CdrIngest::NewStub(ch);
+  Pacer pace(o);
+  hyperswitch::cdr::CdrEvent ev;
+  hyperswitch::cdr::Ack ack;
+  while (clock_t_::now() < deadline) {
+    fill_cdr(ev, g_seq.fetch_add(1));
+    grpc::ClientContext ctx;
+    auto t0 = pace.wait();
+    auto st = stub->Push(&ctx, ev, &ack);
+    if (st.ok()) rec.record(t0, 1);
+    else rec.fail(st);
+  }
+}
+
+void run_cdr_batch(const Options& o, std::shared_ptr<grpc::Channel> ch, Recorder& rec, clock_t_::time_point deadline) {
+  auto stub = hyperswitch::cdr::CdrIngest::NewStub(ch);
+  Pacer pace(o);
+  hyperswitch::cdr::CdrBatch b;
+  hyperswitch::cdr::CdrBatchAck ack;
+  while (clock_t_::now() < deadline) {
+    fill_batch(b, o.batch);
+    grpc::ClientContext ctx;
+    auto t0 = pace.wait();
+    auto st = stub->PushBatch(&ctx, b, &ack);
+    if (st.ok()) rec.record(t0, ack.accepted());
+    else rec.fail(st);
+  }
+}
+
+// 一条流：写线程在窗口内连续发送，当前线程读取应答；延迟为单批发送到应答
+void run_cdr_stream(const Options& o, std::shared_ptr<grpc::Channel> ch, Recorder& rec, clock_t_::time_point deadline) {
+  auto stub = hyperswitch::cdr::CdrIngest::NewStub(ch);
+  grpc::ClientContext ctx;
+  auto stream = stub->PushStream(&ctx);
+  std::mutex mu;
+  std::condition_variable cv;
+  std::map<uint64_t, clock_t_::time_point> inflight;
+
+  std::thread writer([&] {
+    Pacer pace(o);
+    hyperswitch::cdr::CdrBatch b;
+    while (clock_t_::now() < deadline) {
+      fill_batch(b, o.batch);
+      {
+        std::unique_lock<std::mutex> lk(mu);
+        cv.wait(lk, [&] { return static_cast<int>(inflight.size()) < o.window; });
+      }
+      auto t0 = pace.wait();
+      {
+        std::lock_guard<std::mutex> lk(mu);
+        inflight.emplace(b.seq(), t0);
+      }
+      if (!stream->Write(b)) break;
+    }
+    stream->WritesDone();
+  });
+
+  hyperswitch::cdr::CdrBatchAck ack;
+  while (stream->Read(&ack)) {
+    std::lock_guard<std::mutex> lk(mu);
+    auto it = inflight.find(ack.seq());
+    if (it == inflight.end()) continue;
+    if (ack.ok()) rec.record(it->second, ack.accepted());
+    else rec.fail("batch rejected");
+    inflight.erase(it);
+    cv.notify_one();
+  }
+  {
+    // 流异常结束时放行写线程
+    std::lock_guard<std::mutex> lk(mu);
+    rec.errors += inflight.size();
+    if (!inflight.empty()) rec.failures["stream aborted"] += inflight.size();
+    inflight.clear();
+  }
+  cv.notify_one();
+  writer.join();
+  auto st = stream->Finish();
+  if (!st.ok()) std::cerr << "stream finished: " << st.error_message() << "\n";
+}
+
+void fill_rtcp(hyperswitch::observe::RtcpReport& r, uint64_t n, int64_t now_ms) {
+  // 10000 路并发通话循环上报，每条通话腿首份报告携带中继
+  uint64_t call = n % 20000;
+  r.set_call_id("loadgen-" + std::to_string(call / 2));
+  r.set_leg(static_cast<uint32_t>(call & 1));
+  r.set_loss(static_cast<float>(n % 100) / 5000.0f);
+  r.set_jitter_ms(static_cast<float>(n % 30));
+  r.set_rtt_ms(static_cast<float>(40 + n % 200));
+  r.set_ts_ms(now_ms);
+  if (n < 20000) r.set_trunk((call & 1 ? "vend-" : "cust-") + std::to_string(call % 40));
+  else r.clear_trunk();
+}
+
+int64_t epoch_ms() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void fill_rtcp_batch(hyperswitch::observe::RtcpBatch& b, int n) {
+  // 复用已有元素，避免压测端自身的分配开销
+  int64_t now = epoch_ms();
+  while (b.reports_size() > n) b.mutable_reports()->RemoveLast();
+  for (int i = 0; i < n; ++i) {
+    auto* r = i < b.reports_size() ? b.mutable_reports(i) : b.add_reports();
+    fill_rtcp(*r, g_seq.fetch_add(1), now);
+  }
+}
+
+void run_rtcp_unary(const Options& o, std::shared_ptr<grpc::Channel> ch, Recorder& rec, clock_t_::time_point deadline) {
+  auto stub = hyperswitch::observe::ObserveIngest::NewStub(ch);
+  Pacer pace(o);
+  hyperswitch::observe::RtcpStat st;
+  hyperswitch::observe::Ack ack;
+  while (clock_t_::now() < deadline) {
+    uint64_t n = g_seq.fetch_add(1), call = n % 20000;
+    st.set_call_id("loadgen-" + std::to_string(call / 2));
+    st.set_leg(call & 1 ? "b" : "a");
+    st.set_loss(static_cast<double>(n % 100) / 5000.0);
+    st.set_jitter_ms(static_cast<double>(n % 30));
+    st.set_rtt_ms(static_cast<double>(40 + n % 200));
+    if (n < 20000) st.set_trunk((call & 1 ? "vend-" : "cust-") + std::to_string(call % 40));
+    else st.clear_trunk();
+    grpc::ClientContext ctx;
+    auto t0 = pace.wait();
+    auto s = stub->PushRtcp(&ctx, st, &ack);
+    if (s.ok()) rec.record(t0, 1);
+    else rec.fail(s);
+  }
+}
+
+void run_rtcp_batch(const Options& o, std::shared_ptr<grpc::Channel> ch, Recorder& rec, clock_t_::time_point deadline) {
+  auto stub = hyperswitch::observe::ObserveIngest::NewStub(ch);
+  Pacer pace(o);
+  hyperswitch::observe::RtcpBatch b;
+  hyperswitch::observe::RtcpBatchAck ack;
+  while (clock_t_::now() < deadline) {
+    fill_rtcp_batch(b, o.batch);
+    grpc::ClientContext ctx;
+    auto t0 = pace.wait();
+    auto s = stub->PushRtcpBatch(&ctx, b, &ack);
+    if (s.ok()) rec.record(t0, ack.accepted());
+    else rec.fail(s);
+  }
+}
+
+// 客户端流只在结束时应答，不记录单批延迟
+void run_rtcp_stream(const Options& o, std::shared_ptr<grpc::Channel> ch, Recorder& rec, clock_t_::time_point deadline) {
+  auto stub = hyperswitch::observe::ObserveIngest::NewStub(ch);
+  grpc::ClientContext ctx;
+  hyperswitch::observe::RtcpBatchAck ack;
+  auto writer = stub->PushRtcpStream(&ctx, &ack);
+  Pacer pace(o);
+  hyperswitch::observe::RtcpBatch b;
+  while (clock_t_::now() < deadline) {
+    fill_rtcp_batch(b, o.batch);
+    pace.wait();
+    if (!writer->Write(b)) break;
+  }
+  writer->WritesDone();
+  auto s = writer->Finish();
+  if (s.ok()) rec.items += ack.accepted();
+  else {
+    rec.fail(s);
+    std::cerr << "stream finished: " << s.error_message() << "\n";
+  }
+}
+
+// 各线程号码生成器的种子为 --seed 加线程序号，同一参数下生成的号码集合可复现
+std::atomic<uint64_t> g_workers{0};
+
+void fill_pick(hyperswitch::routing::PickRequest& req, uint64_t n, const std::string& to, const Options& o) {
+  req.Clear();
+  req.set_call_id("loadgen-" + std::to_string(n));
+  req.set_from_uri("sip:493012345@carrier-a.example.net");
+  req.set_to_uri("sip:" + to + "@10.20.30.40");
+  req.set_e164_from("493012345");
+  req.set_e164_to(to);
+  req.set_src_ip("192.0.2.10");
+  req.set_ingress_trunk(o.trunks[n % o.trunks.size()]);
+}
+
+// 目的号码按 e164.hpp 的话务分布抽取，入中继在 --trunks 中轮转
+void run_route_pick(const Options& o, std::shared_ptr<grpc::Channel> ch, Recorder& rec, clock_t_::time_point deadline) {
+  auto stub = hyperswitch::routing::RouteService::NewStub(ch);
+  Pacer pace(o);
+  hs::bench::E164Mix mix(o.seed + g_workers.fetch_add(1));
+  hyperswitch::routing::PickRequest req;
+  hyperswitch::routing::PickResponse resp;
+  std::string to;
+  while (clock_t_::now() < deadline) {
+    uint64_t n = g_seq.fetch_add(1);
+    mix.next(to);
+    fill_pick(req, n, to, o);
+    resp.Clear();
+    grpc::ClientContext ctx;
+    auto t0 = pace.wait();
+    auto st = stub->Pick(&ctx, req, &resp);
+    if (st.ok()) rec.record(t0, 1);
+    else rec.fail(st);
+  }
+}
+
+// 每次调用 --batch 个号码；items 为选路成功的号码数，单项失败按其状态码计入错误
+void run_route_batch(const Options& o, std::shared_ptr<grpc::Channel> ch, Recorder& rec, clock_t_::time_point deadline) {
+  auto stub = hyperswitch::routing::RouteService::NewStub(ch);
+  Pacer pace(o);
+  hs::bench::E164Mix mix(o.seed + g_workers.fetch_add(1));
+  hyperswitch::routing::PickBatchRequest req;
+  hyperswitch::routing::PickBatchResponse resp;
+  std::string to;
+  while (clock_t_::now() < deadline) {
+    req.Clear();
+    for (int i = 0; i < o.batch; ++i) {
+      uint64_t n = g_seq.fetch_add(1);
+      mix.next(to);
+      auto* item = req.add_items();
+      item->set_seq(static_cast<uint64_t>(i));
+      fill_pick(*item->mutable_request(), n, to, o);
+    }
+    resp.Clear();
+    grpc::ClientContext ctx;
+    auto t0 = pace.wait();
+    auto st = stub->PickBatch(&ctx, req, &resp);
+    if (!st.ok()) {
+      rec.fail(st);
+      continue;
+    }
+    uint64_t ok = 0;
+    for (const auto& r : resp.results()) {
+      if (r.code() == 0) ++ok;
+      else rec.fail(code_name(static_cast<grpc::StatusCode>(r.code())));
+    }
+    rec.record(t0, ok);
+  }
+}
+
+// 一次通话：Authorize 后按近似指数分布的时长（均值 3 分钟）Settle；未获授权的通话不结算。
+// 账户在 --accounts 中轮转，items 为完成结算的通话数
+void run_billing(const Options& o, std::shared_ptr<grpc::Channel> ch, Recorder& rec, clock_t_::time_point deadline) {
+  auto stub = hyperswitch::billing::BillingService::NewStub(ch);
+  Pacer pace(o);
+  uint64_t seed = o.seed + g_workers.fetch_add(1);
+  hs::bench::E164Mix mix(seed);
+  std::mt19937_64 rng(seed);
+  std::exponential_distribution<double> duration(1.0 / 180.0);
+  hyperswitch::billing::AuthorizeRequest areq;
+  hyperswitch::billing::AuthorizeResponse aresp;
+  hyperswitch::billing::SettleRequest sreq;
+  hyperswitch::billing::SettleResponse sresp;
+  std::string to;
+  while (clock_t_::now() < deadline) {
+    uint64_t n = g_seq.fetch_add(1);
+    auto call_id = "loadgen-" + std::to_string(n);
+    const auto& account = o.accounts[n % o.accounts.size()];
+    mix.next(to);
+    areq.set_call_id(call_id);
+    areq.set_account_code(account);
+    areq.set_expected_secs(300);
+    areq.set_e164_to(to);
+    aresp.Clear();
+    grpc::ClientContext actx;
+    auto t0 = pace.wait();
+    auto st = stub->Authorize(&actx, areq, &aresp);
+    if (!st.ok()) {
+      rec.fail(st);
+      continue;
+    }
+    rec.record(t0, 0, 0);
+    if (!aresp.allowed()) {
+      rec.fail("denied: " + aresp.reason());
+      continue;
+    }
+
+    sreq.set_call_id(call_id);
+    sreq.set_auth_token(aresp.auth_token());
+    sreq.set_billsec(static_cast<uint32_t>(duration(rng)));
+    sreq.set_account_code(account);
+    sreq.set_e164_to(to);
+    sresp.Clear();
+    grpc::ClientContext sctx;
+    auto t1 = clock_t_::now();
+    st = stub->Settle(&sctx, sreq, &sresp);
+    if (!st.ok()) rec.fail(st);
+    else if (!sresp.success()) rec.fail("settle rejected");
+    else rec.record(t1, 1, 1);
+  }
+}
+
+struct Mode {
+  const char* name;
+  const char* unit;
+  const char* target;
+  std::function<void(const Options&, std::shared_ptr<grpc::Channel>, Recorder&, clock_t_::time_point)> run;
+  std::vector<const char*> series = {"call"};  // 分列统计的调用延迟
+};
+
+const std::vector<Mode>& modes() {
+  static const std::vector<Mode> m = {
+    {"cdr-unary", "events", "127.0.0.1:7002", run_cdr_unary},
+    {"cdr-batch", "events", "127.0.0.1:7002", run_cdr_batch},
+    {"cdr-stream", "events", "127.0.0.1:7002", run_cdr_stream},
+    {"rtcp-unary", "reports", "127.0.0.1:7005", run_rtcp_unary},
+    {"rtcp-batch", "reports", "127.0.0.1:7005", run_rtcp_batch},
+    {"rtcp-stream", "reports", "127.0.0.1:7005", run_rtcp_stream},
+    {"route-pick", "picks", "127.0.0.1:7001", run_route_pick},
+    {"route-batch", "picks", "127.0.0.1:7001", run_route_batch},
+    {"billing", "calls", "127.0.0.1:7003", run_billing, {"authorize", "settle"}},
+  };
+  return m;
+}
+
+std::vector<std::string> split(const std::string& list) {
+  std::vector<std::string> out;
+  std::stringstream in(list);
+  for (std::string item; std::getline(in, item, ',');)
+    if (!item.empty()) out.push_back(item);
+  if (out.empty()) throw std::runtime_error("empty list: " + list);
+  return out;
+}
+
+Options parse_args(int argc, char** argv) {
+  Options o;
+  if (argc < 2) throw std::runtime_error("mode required");
+  o.mode = argv[1];
+  for (int i = 2; i < argc; ++i) {
+    std::string a = argv[i];
+    auto next = [&]() -> std::string {
+      if (i + 1 >= argc) throw std::runtime_error("missing value for " + a);
+      return argv[++i];
+    };
+    if (a == "--target") o.target = next();
+    else if (a == "--concurrency") o.concurrency = std::max(1, std::stoi(next()));
+    else if (a == "--duration") o.duration = std::max(1, std::stoi(next()));
+    else if (a == "--batch") o.batch = std::max(1, std::stoi(next()));
+    else if (a == "--window") o.window = std::max(1, std::stoi(next()));
+    else if (a == "--server-pid") o.server_pid = std::stoi(next());
+    else if (a == "--rate") o.rate = std::stod(next());
+    else if (a == "--trunks") o.trunks = split(next());
+    else if (a == "--accounts") o.accounts = split(next());
+    else if (a == "--seed") o.seed = std::stoull(next());
+    else if (a == "--fake") o.fake = true;
+    else throw std::runtime_error("unknown option " + a);
+  }
+  return o;
+}
+
+}
+
+int main(int argc, char** argv) {
+  Options o;
+  const Mode* mode = nullptr;
+  try {
+    o = parse_args(argc, argv);
+    for (const auto& m : modes())
+      if (o.mode == m.name) mode = &m;
+    if (!mode) throw std::runtime_error("unknown mode " + o.mode);
+    if (o.target.empty()) o.target = o.fake ? hs::bench::FakeBackend::Options{}.bind : mode->target;
+  } catch (const std::exception& ex) {
+    std::cerr << ex.what() << "\n"
+              << "Usage: loadgen <mode> [--target host:port] [--concurrency 16] [--duration 10] [--batch 500] [--window 8]\n"
+              << "               [--server-pid PID] [--rate N] [--trunks a,b] [--accounts a,b] [--seed N] [--fake]\n"
+              << "Modes:";
+    for (const auto& m : modes()) std::cerr << " " << m.name;
+    std::cerr << "\n";
+    return 2;
+  }
+
+  // 替身与压测共享本机 CPU，结果只用于比较框架与压测本身的改动
+  std::unique_ptr<hs::bench::FakeBackend> fake;
+  if (o.fake) {
+    hs::bench::FakeBackend::Options fo;
+    fo.bind = o.target;
+    fo.spool_dir = hs::get_env("HS_BENCH_DIR", "/tmp/hs_bench_spool") + "/loadgen";
+    fake = std::make_unique<hs::bench::FakeBackend>(fo);
+  }
+
+  // 每个并发单元独立 channel，避免所有请求挤在同一条 HTTP/2 连接上
+  std::vector<Recorder> recs(o.concurrency);
+  std::vector<std::thread> threads;
+  double cpu0 = o.server_pid ? process_cpu_seconds(o.server_pid) : -1;
+  auto start = clock_t_::now();
+  auto deadline = start + std::chrono::seconds(o.duration);
+  for (int i = 0; i < o.concurrency; ++i) {
+    grpc::ChannelArguments args;
+    args.SetInt("hs.loadgen.channel", i);
+    auto ch = grpc::CreateCustomChannel(o.target, grpc::InsecureChannelCredentials(), args);
+    threads.emplace_back([&, i, ch] { mode->run(o, ch, recs[i], deadline); });
+  }
+  for (auto& t : threads) t.join();
+  double secs = std::chrono::duration<double>(clock_t_::now() - start).count();
+  double cpu = cpu0 >= 0 ? process_cpu_seconds(o.server_pid) - cpu0 : -1;
+  report(o, mode->series, recs, secs, mode->unit, cpu);
+  return 0;
+}
@@ -0,0 +1,62 @@
+// 号码规范化基准：route / billing / auth / cdr 每次请求都要走的 URI → E.164 转换。
+// 号码按 e164.hpp 的话务分布抽取，按输入形态分别计时
+#include <benchmark/benchmark.h>
+#include <string>
+#include <vector>
+#include "common/number.hpp"
+#include "e164.hpp"
+
+namespace {
+
+constexpr size_t kNumbers = 1 << 14;
+
+enum Form { kBare, kPlus, kSipUri, kTelUri, kNational, kSpaced };
+
+std::vector<std::string> inputs(Form form) {
+  hs::bench::E164Mix mix(7);
+  std::vector<std::string> out;
+  out.reserve(kNumbers);
+  for (size_t i = 0; i < kNumbers; ++i) {
+    std::string n = mix.next();
+    switch (form) {
+      case kBare: out.push_back(n); break;
+      case kPlus: out.push_back("+" + n); break;
+      case kSipUri: out.push_back("<sip:+" + n + "@10.20.30.40:5060;user=phone>;tag=a73kszlfl"); break;
+      case kTelUri: out.push_back("tel:+" + n.substr(0, 2) + "-" + n.substr(2, 3) + "-" + n.substr(5) + ";phone-context=example.com"); break;
+      // 技术前缀 + 国内冠字，经改写与国家码替换
+      case kNational: out.push_back("sip:1234#0" + n.substr(2) + "@carrier-a.example.net"); break;
+      // 人工录入的带空格与括号的号码，ok_ratio 应为 1
+      case kSpaced: out.push_back("+" + n.substr(0, 2) + " (" + n.substr(2, 3) + ") " + n.substr(5, 3) + " " + n.substr(8)); break;
+    }
+  }
+  return out;
+}
+
+hs::number::DialPlan trunk_plan() {
+  hs::number::DialPlan p;
+  p.national_prefix = "0";
+  p.country_code = "44";
+  p.rewrites = {{"1234#", 5, ""}, {"9999#", 5, "00"}, {"*", 1, ""}};
+  p.finalize();
+  return p;
+}
+
+// Arg: 输入形态
+void BM_Normalize(benchmark::State& state) {
+  auto form = static_cast<Form>(state.range(0));
+  static const hs::number::DialPlan plan = trunk_plan();
+  auto in = inputs(form);
+  const hs::number::DialPlan* p = form == kNational ? &plan : nullptr;
+  size_t i = 0, ok = 0;
+  for (auto _ : state) {
+    hs::number::E164 out;
+    ok += hs::number::normalize(in[i], out, p) == hs::number::Status::Ok;
+    benchmark::DoNotOptimize(out);
+    i = (i + 1) & (kNumbers - 1);
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["ok_ratio"] = static_cast<double>(ok) / static_cast<double>(state.iterations());
+}
+BENCHMARK(BM_Normalize)->ArgName("form")->Arg(kBare)->Arg(kPlus)->Arg(kSipUri)->Arg(kTelUri)->Arg(kNational)->Arg(kSpaced);
+
+}
@@ -0,0 +1,45 @@
+// 惩罚系数查找基准：Pick 对每个候选读取一次惩罚系数（快照读 + 时钟 + 哈希查找），
+// 以及路由决策缓存每次命中时比较的版本号。快照由 apply 直接装入，不需要 Redis
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "penalty_cache.hpp"
+
+namespace {
+
+std::unique_ptr<hs::routing::PenaltyCache> g_cache;
+std::vector<std::string> g_trunks;
+
+// 一半中继有惩罚记录，另一半查找落空（按 1.0 处理）
+void setup(size_t trunks) {
+  g_trunks.clear();
+  hs::StringMap<double> p;
+  for (size_t i = 0; i < trunks; ++i) {
+    g_trunks.push_back("vend-" + std::to_string(i));
+    if (i % 2 == 0) p.emplace(g_trunks.back(), 0.25 + static_cast<double>(i % 7) / 10.0);
+  }
+  g_cache = std::make_unique<hs::routing::PenaltyCache>(nullptr, hs::routing::PenaltyCache::Options{});
+  g_cache->apply(std::move(p));
+}
+
+// Arg: 中继数
+void BM_PenaltyLookup(benchmark::State& state) {
+  if (state.thread_index() == 0) setup(static_cast<size_t>(state.range(0)));
+  size_t i = static_cast<size_t>(state.thread_index()) * 31;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(g_cache->penalty(g_trunks[i % g_trunks.size()]));
+    ++i;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PenaltyLookup)->Arg(64)->Arg(4096)->ThreadRange(1, 64)->UseRealTime();
+
+void BM_PenaltyVersion(benchmark::State& state) {
+  if (state.thread_index() == 0) setup(64);
+  for (auto _ : state) benchmark::DoNotOptimize(g_cache->version());
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PenaltyVersion)->ThreadRange(1, 64)->UseRealTime();
+
+}
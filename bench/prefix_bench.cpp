@@ -0,0 +1,89 @@
+// 前缀匹配基准：合成 E.164 前缀表上的最长匹配与逐层遍历（路由候选、黑名单走的路径），以及建树耗时。
+// 号码按 e164.hpp 的话务分布抽取，与前缀表同源，命中率接近生产
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "common/prefix_trie.hpp"
+#include "e164.hpp"
+
+namespace {
+
+constexpr size_t kNumbers = 1 << 16;
+
+struct Fixture {
+  hs::PrefixTrie trie;
+  std::vector<std::string> numbers;
+};
+
+// 每种前缀表规模只构建一次
+const Fixture& fixture(size_t prefixes) {
+  static std::mutex mu;
+  std::lock_guard<std::mutex> lk(mu);
+  static std::vector<std::pair<size_t, std::unique_ptr<Fixture>>> cache;
+  for (const auto& [n, f] : cache)
+    if (n == prefixes) return *f;
+  auto f = std::make_unique<Fixture>();
+  hs::bench::E164Mix mix(42);
+  auto deck = mix.prefixes(prefixes);
+  for (size_t i = 0; i < deck.size(); ++i) *f->trie.insert(deck[i]) = static_cast<uint32_t>(i);
+  f->numbers.reserve(kNumbers);
+  for (size_t i = 0; i < kNumbers; ++i) f->numbers.push_back(mix.next());
+  return *cache.emplace_back(prefixes, std::move(f)).second;
+}
+
+// Arg: 前缀条数
+void BM_TrieLongest(benchmark::State& state) {
+  const auto& f = fixture(static_cast<size_t>(state.range(0)));
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(f.trie.longest(f.numbers[i]));
+    i = (i + 1) & (kNumbers - 1);
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["nodes"] = static_cast<double>(f.trie.node_count());
+  state.counters["bytes"] = static_cast<double>(f.trie.node_count() * sizeof(hs::PrefixTrie::Node));
+}
+BENCHMARK(BM_TrieLongest)->Arg(1000)->Arg(60000)->Arg(500000);
+
+// 收集路径上全部命中（RouteTable::candidates 由长到短输出候选）
+void BM_TrieWalk(benchmark::State& state) {
+  const auto& f = fixture(static_cast<size_t>(state.range(0)));
+  size_t i = 0;
+  for (auto _ : state) {
+    uint32_t depth = 0;
+    f.trie.walk(f.numbers[i], [&](uint32_t, size_t) { ++depth; });
+    benchmark::DoNotOptimize(depth);
+    i = (i + 1) & (kNumbers - 1);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TrieWalk)->Arg(1000)->Arg(60000)->Arg(500000);
+
+// 多线程只读：快照在各完成队列线程间共享
+void BM_TrieLongestShared(benchmark::State& state) {
+  const auto& f = fixture(60000);
+  size_t i = static_cast<size_t>(state.thread_index()) * 4099;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(f.trie.longest(f.numbers[i & (kNumbers - 1)]));
+    ++i;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TrieLongestShared)->ThreadRange(1, 64)->UseRealTime();
+
+// 重建一张路由计划或费率表的前缀索引
+void BM_TrieBuild(benchmark::State& state) {
+  hs::bench::E164Mix mix(42);
+  auto deck = mix.prefixes(static_cast<size_t>(state.range(0)));
+  for (auto _ : state) {
+    hs::PrefixTrie trie;
+    for (size_t i = 0; i < deck.size(); ++i) *trie.insert(deck[i]) = static_cast<uint32_t>(i);
+    benchmark::DoNotOptimize(trie.node_count());
+  }
+  state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(deck.size()));
+}
+BENCHMARK(BM_TrieBuild)->Arg(60000)->Arg(500000)->Unit(benchmark::kMillisecond);
+
+}
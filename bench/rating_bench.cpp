@@ -0,0 +1,101 @@
+// 计费基准：费率表最长前缀匹配与定点计费（min_time、步长取整、连接费）。
+// 费率表按 e164.hpp 合成，价格与步长按前缀散列取值，覆盖 1/1、60/60、30/6 等常见计费方式
+#include <benchmark/benchmark.h>
+#include <functional>
+#include <string>
+#include <vector>
+#include "e164.hpp"
+#include "rate_engine.hpp"
+
+namespace {
+
+using hs::billing::RateDeck;
+using hs::billing::RateEngine;
+using hs::billing::RateItem;
+
+constexpr size_t kNumbers = 1 << 16;
+
+RateItem make_item(const std::string& prefix, hs::Rounding rounding) {
+  static constexpr uint32_t kSteps[][2] = {{1, 1}, {60, 60}, {30, 6}, {60, 1}};
+  size_t h = std::hash<std::string>{}(prefix);
+  RateItem it;
+  it.price_per_min = hs::Money::from_micros(static_cast<int64_t>(1000 + h % 250000));
+  it.min_time_sec = kSteps[h % 4][0];
+  it.step_sec = kSteps[h % 4][1];
+  it.connection_fee = h % 8 ? hs::Money{} : hs::Money::from_micros(5000);
+  it.rounding = rounding;
+  it.prefix = prefix;
+  return it;
+}
+
+struct Fixture {
+  RateDeck deck;
+  std::vector<std::string> numbers;
+  std::vector<uint32_t> billsec;
+};
+
+Fixture make_fixture(size_t prefixes, hs::Rounding rounding = hs::Rounding::HalfUp) {
+  Fixture f;
+  hs::bench::E164Mix mix(7);
+  for (const auto& p : mix.prefixes(prefixes)) {
+    *f.deck.trie.insert(p) = static_cast<uint32_t>(f.deck.items.size());
+    f.deck.items.push_back(make_item(p, rounding));
+  }
+  // 通话时长近似指数分布，均值约 3 分钟，约三成未接通（0 秒）
+  std::mt19937_64 rng(7);
+  std::exponential_distribution<double> dur(1.0 / 180.0);
+  for (size_t i = 0; i < kNumbers; ++i) {
+    f.numbers.push_back(mix.next());
+    f.billsec.push_back(rng() % 10 < 3 ? 0 : static_cast<uint32_t>(dur(rng)));
+  }
+  return f;
+}
+
+// Arg: 前缀条数
+void BM_RateMatch(benchmark::State& state) {
+  auto f = make_fixture(static_cast<size_t>(state.range(0)));
+  RateEngine engine;
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(engine.match(f.deck, f.numbers[i]));
+    i = (i + 1) & (kNumbers - 1);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RateMatch)->Arg(1000)->Arg(60000)->Arg(500000);
+
+// 定点计费本身（128 位中间量的乘除与取整）；Arg: Rounding
+void BM_Charge(benchmark::State& state) {
+  auto rounding = static_cast<hs::Rounding>(state.range(0));
+  auto f = make_fixture(1000, rounding);
+  std::vector<const RateItem*> items;
+  RateEngine engine;
+  for (const auto& n : f.numbers) items.push_back(engine.match(f.deck, n));
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(RateEngine::charge(*items[i], f.billsec[i]));
+    i = (i + 1) & (kNumbers - 1);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Charge)
+  ->Arg(static_cast<int>(hs::Rounding::Ceil))
+  ->Arg(static_cast<int>(hs::Rounding::Floor))
+  ->Arg(static_cast<int>(hs::Rounding::HalfUp))
+  ->Arg(static_cast<int>(hs::Rounding::HalfEven));
+
+// Settle 的内存部分：匹配 + 计费 + 金额转十进制文本
+void BM_MatchChargeFormat(benchmark::State& state) {
+  auto f = make_fixture(60000);
+  RateEngine engine;
+  size_t i = 0;
+  for (auto _ : state) {
+    const RateItem* it = engine.match(f.deck, f.numbers[i]);
+    if (it) benchmark::DoNotOptimize(RateEngine::charge(*it, f.billsec[i]).str());
+    i = (i + 1) & (kNumbers - 1);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MatchChargeFormat);
+
+}
@@ -0,0 +1,86 @@
+// CDR spool 基准：落盘吞吐（组提交）与重放读取速率，用于估算 ClickHouse 长时间故障所需磁盘
+// 数据目录取 HS_BENCH_DIR（默认 /tmp/hs_bench_spool），应指向与生产相同类型的磁盘
+#include <benchmark/benchmark.h>
+#include <common/env.hpp>
+#include <filesystem>
+#include <memory>
+#include "spool.hpp"
+
+namespace {
+
+std::string bench_dir(const char* name) {
+  auto dir = hs::get_env("HS_BENCH_DIR", "/tmp/hs_bench_spool") + "/" + name;
+  std::filesystem::remove_all(dir);
+  return dir;
+}
+
+// 与 JSONEachRow 单行 CDR 相当的大小
+std::string make_row(size_t n) {
+  std::string row = R"({"call_id":"bench",)";
+  row.resize(n, 'x');
+  return row;
+}
+
+std::unique_ptr<hs::cdr::Spool> g_spool;
+
+// 每次迭代相当于一次 Push：追加并等待落盘；多线程时体现组提交的合并效果
+// Args: 行字节数, 是否 fdatasync
+void BM_SpoolAppendSync(benchmark::State& state) {
+  if (state.thread_index() == 0) {
+    g_spool = std::make_unique<hs::cdr::Spool>(hs::cdr::Spool::Options{bench_dir("append"), size_t{64} << 20, state.range(1) != 0});
+    g_spool->open();
+  }
+  auto row = make_row(static_cast<size_t>(state.range(0)));
+  for (auto _ : state) {
+    g_spool->sync(g_spool->append(row));
+    // 模拟 flusher 切批并立即确认，使旧段被回收
+    if (g_spool->pending().rows >= 5000) {
+      if (auto r = g_spool->cut()) {
+        g_spool->sync(r->lsn);
+        g_spool->ack(*r);
+      }
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+  if (state.thread_index() == 0) g_spool.reset();
+}
+BENCHMARK(BM_SpoolAppendSync)
+  ->ArgsProduct({{256, 600}, {1}})
+  ->Args({600, 0})
+  ->ThreadRange(1, 64)
+  ->UseRealTime();
+
+// 重启后重放：校验 CRC 并解出批次内容
+// Args: 总行数
+void BM_SpoolReplay(benchmark::State& state) {
+  auto dir = bench_dir("replay");
+  auto row = make_row(600);
+  {
+    hs::cdr::Spool sp({dir, size_t{64} << 20, false});
+    sp.open();
+    uint64_t lsn = 0;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+      sp.append(row);
+      if (sp.pending().rows >= 5000) lsn = sp.cut()->lsn;
+    }
+    if (auto r = sp.cut()) lsn = r->lsn;
+    sp.sync(lsn);
+  }
+  hs::cdr::Spool sp({dir, size_t{64} << 20, false});
+  auto ranges = sp.open();
+  int64_t rows = 0, bytes = 0;
+  for (auto _ : state) {
+    for (const auto& r : ranges) {
+      auto body = sp.read(r);
+      rows += static_cast<int64_t>(r.rows);
+      bytes += static_cast<int64_t>(body.size());
+      benchmark::DoNotOptimize(body.data());
+    }
+  }
+  state.SetItemsProcessed(rows);
+  state.SetBytesProcessed(bytes);
+}
+BENCHMARK(BM_SpoolReplay)->Arg(200000)->Unit(benchmark::kMillisecond);
+
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "common/hash.hpp"
+#include "common/redis.hpp"
+
+namespace hs {
+
+// 在途通话登记表：按 call_id 的 64 位哈希分片开放寻址（线性探测、删除后移），槽位只存哈希、参与方编号与到期时刻，
+// 每通 32 字节；参与方（账户、中继、供应商）的在途数为原子计数，读取不加锁。
+// 未正常结束的通话按到期时刻回收。start() 后后台线程定期回收并把各参与方在途数写入 Redis 哈希 calls:live:<source>，
+// 供 route-svc / auth-svc 经 hs::LiveCalls 读取。
+class CallRegistry {
+public:
+  struct Options {
+    std::string source;  // "<服务>:<节点>"，同一服务的多个节点在读取端求和
+    std::chrono::milliseconds publish_interval{1000};
+    std::chrono::seconds setup_ttl{300};   // 未接通的通话
+    std::chrono::seconds ttl{14400};       // 已接通或计费中的通话
+  };
+
+  struct Stats {
+    std::atomic<uint64_t> opened{0};
+    std::atomic<uint64_t> updated{0};
+    std::atomic<uint64_t> closed{0};
+    std::atomic<uint64_t> unknown_close{0};
+    std::atomic<uint64_t> expired{0};
+    std::atomic<uint64_t> publishes{0};
+    std::atomic<uint64_t> publish_errors{0};
+  };
+
+  // 空字段不登记；计数键为 "account:<code>"、"trunk:<name>"（出入中继共用）、"vendor:<name>"
+  struct Parties {
+    std::string_view account;
+    std::string_view ingress_trunk;
+    std::string_view egress_trunk;
+    std::string_view vendor;
+  };
+
+  struct CallView {
+    std::string account, ingress_trunk, egress_trunk, vendor;
+    int64_t expire_ms = 0;
+  };
+
+  explicit CallRegistry(Options opt);
+  ~CallRegistry();
+
+  void start(hs::RedisClient* redis);
+  void stop();
+
+  // 登记通话；已存在时补齐或替换参与方（如改选路由）并刷新到期时刻
+  void open(std::string_view call_id, const Parties& p, std::chrono::seconds ttl);
+  bool close(std::string_view call_id);
+  size_t expire(int64_t now_ms);
+
+  std::optional<CallView> find(std::string_view call_id) const;
+  int32_t live(std::string_view key) const;
+  // 全部参与方的在途数（含 0）
+  std::vector<std::pair<std::string, int32_t>> counts() const;
+  size_t size() const;
+
+  const Options& options() const { return opt_; }
+  const Stats& stats() const { return stats_; }
+
+private:
+  static constexpr size_t kRoles = 4;
+  static constexpr size_t kShards = 64;
+
+  struct Slot {
+    uint64_t hash = 0;  // 0 表示空槽
+    std::array<uint32_t, kRoles> parties{};  // 参与方编号，0 表示无
+    int64_t expire_ms = 0;
+  };
+  struct Shard {
+    mutable std::mutex mu;
+    std::vector<Slot> slots;
+    size_t used = 0;
+  };
+  // 参与方按块分配，块指针写入后不再变化，计数更新无需持有 ent_mu_
+  static constexpr size_t kChunk = 1024;
+  static constexpr size_t kMaxChunks = 1024;
+  struct Entity {
+    std::string key;  // 写入后只读
+    std::atomic<int32_t> live{0};
+  };
+
+  static uint64_t hash(std::string_view call_id);
+  Shard& shard(uint64_t h) { return shards_[h >> 58]; }
+  const Shard& shard(uint64_t h) const { return shards_[h >> 58]; }
+  static size_t probe(const Shard& s, uint64_t h);  // 命中或第一个空槽
+  static void grow(Shard& s);
+  static void erase(Shard& s, size_t i);
+  uint32_t intern(std::string_view prefix, std::string_view name);  // 超出容量返回 0
+  Entity& entity(uint32_t id) const { --id; return chunks_[id / kChunk][id % kChunk]; }
+  void adjust(const Slot& s, int32_t delta);
+  void publish();
+  void run(std::stop_token st);
+
+  Options opt_;
+  std::array<Shard, kShards> shards_;
+  mutable std::shared_mutex ent_mu_;
+  std::array<std::unique_ptr<Entity[]>, kMaxChunks> chunks_;
+  hs::StringMap<uint32_t> entity_ids_;  // 键 → 编号（从 1 开始），只增不删
+
+  hs::RedisClient* redis_ = nullptr;
+  Stats stats_;
+  metrics::Histogram* publish_rtt_;
+  std::mutex run_mu_;
+  std::condition_variable_any run_cv_;
+  std::jthread thread_;
+};
+
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#endif
+
+namespace hs {
+
+// CRC-32C（Castagnoli），用于磁盘记录校验；编译目标支持 SSE4.2 时使用硬件指令
+inline uint32_t crc32c(const void* data, size_t n, uint32_t crc = 0) {
+  auto p = static_cast<const unsigned char*>(data);
+  crc = ~crc;
+#if defined(__SSE4_2__)
+  for (; n >= 8; n -= 8, p += 8) {
+    uint64_t v;
+    std::memcpy(&v, p, 8);
+    crc = static_cast<uint32_t>(_mm_crc32_u64(crc, v));
+  }
+  for (; n > 0; --n, ++p) crc = _mm_crc32_u8(crc, *p);
+#else
+  static const auto table = [] {
+    std::array<uint32_t, 256> t{};
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; ++k) c = (c & 1) ? (c >> 1) ^ 0x82F63B78u : c >> 1;
+      t[i] = c;
+    }
+    return t;
+  }();
+  for (; n > 0; --n, ++p) crc = table[(crc ^ *p) & 0xff] ^ (crc >> 8);
+#endif
+  return ~crc;
+}
+
+}
@@ -9,4 +9,12 @@ inline std::string get_env(const char* key, const std::string& def = {}) {
   return v ? std::string(v) : def;
 }
 
-}
\ No newline at end of file
+inline long long get_env_int(const char* key, long long def) {
+  const char* v = std::getenv(key);
+  if (!v || !*v) return def;
+  char* end = nullptr;
+  long long n = std::strtoll(v, &end, 10);
+  return (end && *end == '\0') ? n : def;
+}
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include "common/hash.hpp"
+#include "common/redis.hpp"
+#include "common/snapshot.hpp"
+
+namespace hs {
+
+// 在途通话数的进程内只读视图：后台线程定期读取各 CallRegistry 发布的 calls:live:<source>，整体替换快照。
+// 同一服务的多个节点求和，不同服务（billing 与 cdr 各自看到同一通话）取最大值；
+// 超过 max_stale 未更新的来源忽略，整体快照过期时所有计数按 0 处理（不据此拒绝呼叫）。
+class LiveCalls {
+public:
+  struct Options {
+    std::chrono::milliseconds refresh_interval{1000};
+    std::chrono::milliseconds max_stale{10000};
+  };
+
+  struct Stats {
+    std::atomic<uint64_t> refreshes{0};
+    std::atomic<uint64_t> refresh_errors{0};
+    std::atomic<uint64_t> sources{0};
+    std::atomic<uint64_t> stale_sources{0};
+    std::atomic<uint64_t> keys{0};
+  };
+
+  LiveCalls(hs::RedisClient* redis, Options opt);
+  ~LiveCalls();
+
+  // 同步刷新一次后启动后台线程
+  void start();
+  void stop();
+
+  // key 形如 "account:<code>"、"trunk:<name>"、"vendor:<name>"
+  int32_t live(std::string_view key) const;
+  int32_t live(std::string_view prefix, std::string_view name) const;
+
+  const Stats& stats() const { return stats_; }
+
+private:
+  struct Table {
+    hs::StringMap<int32_t> live;
+    int64_t loaded_ms = 0;
+  };
+
+  void refresh();
+  void run(std::stop_token st);
+
+  hs::RedisClient* redis_;
+  Options opt_;
+  hs::Snapshot<Table> table_;
+  Stats stats_;
+  metrics::Histogram* refresh_rtt_;
+  std::mutex run_mu_;
+  std::condition_variable_any run_cv_;
+  std::jthread thread_;
+};
+
+}
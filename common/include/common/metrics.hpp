@@ -0,0 +1,211 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace httplib { class Server; }
+
+namespace hs::metrics {
+
+// 进程内指标，按 Prometheus 文本格式导出。计数器与直方图按线程累加：每个线程拥有一块私有计数单元，
+// 只有该线程写入，记录只是一次 relaxed 读加写（无锁前缀、无共享缓存行），可常驻热路径；导出时汇总各线程的块。
+// 线程退出后其块交给后来的线程继续累加，计数不丢失。指标对象由 Registry 持有，地址在进程内不变，
+// 组件在构造时取得引用后直接使用。
+
+using Labels = std::vector<std::pair<std::string, std::string>>;
+
+namespace detail {
+
+inline constexpr size_t kChunkCells = 4096;
+inline constexpr size_t kMaxChunks = 256;
+
+// 一个线程的计数单元：按块懒分配，块指针发布后不再变化
+struct Block {
+  std::array<std::atomic<std::atomic<uint64_t>*>, kMaxChunks> chunks{};
+  std::atomic<uint64_t>* grow(size_t chunk);
+};
+
+Block* acquire_block();
+void release_block(Block* b);
+
+struct BlockHolder {
+  Block* block = acquire_block();
+  ~BlockHolder() { release_block(block); }
+};
+
+inline std::atomic<uint64_t>& cell(size_t idx) {
+  thread_local BlockHolder holder;
+  size_t chunk = idx / kChunkCells;
+  auto* c = holder.block->chunks[chunk].load(std::memory_order_acquire);
+  if (!c) c = holder.block->grow(chunk);
+  return c[idx % kChunkCells];
+}
+
+// 只有所属线程写入，无需原子读改写
+inline void add(size_t idx, uint64_t n) {
+  auto& c = cell(idx);
+  c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+// 分配 n 个连续的单元编号
+size_t allocate(size_t n);
+// 各线程 [base, base + n) 之和累加到 out
+void sum(size_t base, size_t n, uint64_t* out);
+
+}
+
+class Counter {
+public:
+  Counter() : base_(detail::allocate(1)) {}
+  void inc(uint64_t n = 1) { detail::add(base_, n); }
+  uint64_t value() const;
+
+private:
+  size_t base_;
+};
+
+class Gauge {
+public:
+  void set(int64_t v) { v_.store(v, std::memory_order_relaxed); }
+  void add(int64_t d) { v_.fetch_add(d, std::memory_order_relaxed); }
+  int64_t value() const { return v_.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<int64_t> v_{0};
+};
+
+// 延迟直方图（纳秒）：HDR 式对数-线性分桶，每个 2 的幂区间 4 个子桶（相对误差不超过 25%），
+// 覆盖 256ns 至 2^36ns（约 68.7s），更大的值计入溢出桶。桶为左开右闭，与 Prometheus 的 le 语义一致。
+class Histogram {
+public:
+  static constexpr int kSubBits = 2;
+  static constexpr int kMinExp = 8;
+  static constexpr int kMaxExp = 36;
+  static constexpr size_t kFinite = 1 + (static_cast<size_t>(kMaxExp - kMinExp) << kSubBits);
+  static constexpr size_t kBuckets = kFinite + 1;
+
+  static size_t bucket(uint64_t ns) {
+    uint64_t v = ns ? ns - 1 : 0;
+    if (v < (uint64_t{1} << kMinExp)) return 0;
+    int e = 63 - std::countl_zero(v);
+    if (e >= kMaxExp) return kFinite;
+    size_t sub = static_cast<size_t>(v >> (e - kSubBits)) & ((size_t{1} << kSubBits) - 1);
+    return 1 + (static_cast<size_t>(e - kMinExp) << kSubBits) + sub;
+  }
+  // 桶 i（i < kFinite）的上界
+  static uint64_t upper_ns(size_t i) {
+    if (i == 0) return uint64_t{1} << kMinExp;
+    size_t j = i - 1;
+    int e = kMinExp + static_cast<int>(j >> kSubBits);
+    uint64_t sub = j & ((size_t{1} << kSubBits) - 1);
+    return ((uint64_t{1} << kSubBits) + sub + 1) << (e - kSubBits);
+  }
+
+  Histogram() : base_(detail::allocate(kBuckets + 1)) {}
+
+  void record_ns(uint64_t ns) {
+    detail::add(base_ + bucket(ns), 1);
+    detail::add(base_ + kBuckets, ns);
+  }
+  void record(std::chrono::nanoseconds d) { record_ns(d.count() > 0 ? static_cast<uint64_t>(d.count()) : 0); }
+
+  struct Snapshot {
+    std::array<uint64_t, kBuckets> counts{};
+    uint64_t count = 0;
+    uint64_t sum_ns = 0;
+    // 分位数取所在桶的上界，无样本时为 0
+    uint64_t quantile_ns(double q) const;
+  };
+  Snapshot snapshot() const;
+
+private:
+  size_t base_;  // kBuckets 个桶之后是累计纳秒
+};
+
+// 作用域计时，析构时记入直方图
+class Timer {
+public:
+  explicit Timer(Histogram& h) : h_(&h), t0_(std::chrono::steady_clock::now()) {}
+  Timer(const Timer&) = delete;
+  Timer& operator=(const Timer&) = delete;
+  ~Timer() { h_->record(std::chrono::steady_clock::now() - t0_); }
+
+private:
+  Histogram* h_;
+  std::chrono::steady_clock::time_point t0_;
+};
+
+// 导出时读取已有的统计原子量
+template <class T>
+std::function<double()> load(const std::atomic<T>& a) {
+  return [&a] { return static_cast<double>(a.load(std::memory_order_relaxed)); };
+}
+
+class Registry {
+public:
+  // 同名同标签返回同一对象；同名不同类型抛出 std::logic_error
+  Counter& counter(std::string_view name, std::string_view help, const Labels& labels = {});
+  Gauge& gauge(std::string_view name, std::string_view help, const Labels& labels = {});
+  Histogram& histogram(std::string_view name, std::string_view help, const Labels& labels = {});
+
+  // 导出时调用 fn 取值，用于已有的统计结构与按需计算的量。owner 析构前须调用 remove(owner)；
+  // 同名同标签再次注册时替换
+  void counter_fn(const void* owner, std::string_view name, std::string_view help, std::function<double()> fn,
+                  const Labels& labels = {});
+  void gauge_fn(const void* owner, std::string_view name, std::string_view help, std::function<double()> fn,
+                const Labels& labels = {});
+  void remove(const void* owner);
+
+  // Prometheus 文本格式（0.0.4）
+  std::string expose() const;
+
+private:
+  enum class Type { Counter, Gauge, Histogram };
+  struct Series {
+    std::string labels;  // 已格式化的 k="v",...
+    std::unique_ptr<Counter> counter;
+    std::unique_ptr<Gauge> gauge;
+    std::unique_ptr<Histogram> histogram;
+    std::function<double()> fn;
+    const void* owner = nullptr;
+  };
+  struct Family {
+    Type type;
+    std::string help;
+    std::vector<std::unique_ptr<Series>> series;
+  };
+
+  Series& series(std::string_view name, std::string_view help, Type type, const Labels& labels);
+
+  mutable std::mutex mu_;  // 导出期间持有，remove 返回后回调不会再被调用
+  std::map<std::string, Family, std::less<>> families_;
+};
+
+// 进程全局注册表
+Registry& registry();
+
+// /metrics HTTP 端点，后台线程服务；bind 为 host:port，为空或 "off" 时不启动
+class Exporter {
+public:
+  explicit Exporter(const std::string& bind, Registry& reg = registry());
+  ~Exporter();
+  Exporter(const Exporter&) = delete;
+  Exporter& operator=(const Exporter&) = delete;
+
+private:
+  std::unique_ptr<httplib::Server> svr_;
+  std::thread thread_;
+};
+
+}
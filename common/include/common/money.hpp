@@ -0,0 +1,113 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace hs {
+
+enum class Rounding : uint8_t { Ceil, Floor, HalfUp, HalfEven };
+
+// 与 billing.rate_items.rounding_mode 取值对应：ceil/floor/round/bankers
+inline std::optional<Rounding> parse_rounding(std::string_view s) {
+  if (s == "ceil") return Rounding::Ceil;
+  if (s == "floor") return Rounding::Floor;
+  if (s == "round") return Rounding::HalfUp;
+  if (s == "bankers") return Rounding::HalfEven;
+  return std::nullopt;
+}
+
+inline const char* rounding_name(Rounding r) {
+  switch (r) {
+    case Rounding::Ceil: return "ceil";
+    case Rounding::Floor: return "floor";
+    case Rounding::HalfUp: return "round";
+    case Rounding::HalfEven: return "bankers";
+  }
+  return "ceil";
+}
+
+// num/den 按指定方式取整（den > 0）
+inline int64_t div_round(__int128 num, int64_t den, Rounding mode) {
+  __int128 q = num / den, r = num % den;
+  if (r == 0) return static_cast<int64_t>(q);
+  bool neg = (num < 0);
+  if (neg) { r = -r; }
+  switch (mode) {
+    case Rounding::Ceil: if (!neg) ++q; break;
+    case Rounding::Floor: if (neg) --q; break;
+    case Rounding::HalfUp:
+      if (2 * r >= den) q += neg ? -1 : 1;
+      break;
+    case Rounding::HalfEven:
+      if (2 * r > den || (2 * r == den && (q % 2 != 0))) q += neg ? -1 : 1;
+      break;
+  }
+  return static_cast<int64_t>(q);
+}
+
+// 定点金额，精度与 NUMERIC(18,6) 一致：以 1e-6 为单位的 int64
+class Money {
+public:
+  static constexpr int kScale = 6;
+  static constexpr int64_t kUnit = 1000000;
+
+  constexpr Money() = default;
+  static constexpr Money from_micros(int64_t m) { Money x; x.micros_ = m; return x; }
+
+  // 精确解析十进制字符串（如 PostgreSQL NUMERIC 文本），超过 6 位小数时按 mode 取整
+  static std::optional<Money> parse(std::string_view s, Rounding mode = Rounding::HalfEven) {
+    size_t i = 0;
+    bool neg = false;
+    if (i < s.size() && (s[i] == '-' || s[i] == '+')) neg = s[i++] == '-';
+    __int128 v = 0;
+    int frac = -1, digits = 0;
+    for (; i < s.size(); ++i) {
+      char c = s[i];
+      if (c == '.' && frac < 0) { frac = 0; continue; }
+      if (c < '0' || c > '9') return std::nullopt;
+      if (++digits > 30) return std::nullopt;
+      v = v * 10 + (c - '0');
+      if (frac >= 0) ++frac;
+    }
+    if (digits == 0) return std::nullopt;
+    if (frac < 0) frac = 0;
+    if (neg) v = -v;
+    int64_t m;
+    if (frac <= kScale) {
+      for (int k = frac; k < kScale; ++k) v *= 10;
+      m = static_cast<int64_t>(v);
+    } else {
+      int64_t den = 1;
+      for (int k = kScale; k < frac; ++k) den *= 10;
+      m = div_round(v, den, mode);
+    }
+    return from_micros(m);
+  }
+
+  constexpr int64_t micros() const { return micros_; }
+  double to_double() const { return static_cast<double>(micros_) / kUnit; }
+
+  std::string str() const {
+    uint64_t a = micros_ < 0 ? 0 - static_cast<uint64_t>(micros_) : static_cast<uint64_t>(micros_);
+    std::string frac = std::to_string(a % kUnit);
+    return (micros_ < 0 ? "-" : "") + std::to_string(a / kUnit) + "." + std::string(kScale - frac.size(), '0') + frac;
+  }
+
+  // this × num / den，结果按 mode 取整到 1e-6
+  Money mul_div(int64_t num, int64_t den, Rounding mode) const {
+    return from_micros(div_round(static_cast<__int128>(micros_) * num, den, mode));
+  }
+
+  constexpr Money operator+(Money o) const { return from_micros(micros_ + o.micros_); }
+  constexpr Money operator-(Money o) const { return from_micros(micros_ - o.micros_); }
+  constexpr Money& operator+=(Money o) { micros_ += o.micros_; return *this; }
+  constexpr Money& operator-=(Money o) { micros_ -= o.micros_; return *this; }
+  constexpr Money operator-() const { return from_micros(-micros_); }
+  constexpr auto operator<=>(const Money&) const = default;
+
+private:
+  int64_t micros_ = 0;
+};
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+namespace hs {
+
+// 有界多生产者单消费者环：每个槽位带序号（Vyukov 有界队列），生产者只竞争一次 CAS，
+// 消费者不与生产者共享写入的缓存行。满时 try_push 立即返回 false，由调用方丢弃并计数，从不阻塞
+template <class T>
+class MpscRing {
+  static_assert(std::is_trivially_copyable_v<T>);
+
+public:
+  // capacity 向上取整为 2 的幂
+  explicit MpscRing(size_t capacity)
+    : mask_(std::bit_ceil(capacity < 2 ? size_t{2} : capacity) - 1), slots_(new Slot[mask_ + 1]) {
+    for (size_t i = 0; i <= mask_; ++i) slots_[i].seq.store(i, std::memory_order_relaxed);
+  }
+
+  bool try_push(const T& v) {
+    uint64_t pos = head_.load(std::memory_order_relaxed);
+    for (;;) {
+      Slot& s = slots_[pos & mask_];
+      uint64_t seq = s.seq.load(std::memory_order_acquire);
+      auto dif = static_cast<int64_t>(seq - pos);
+      if (dif == 0) {
+        if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          s.value = v;
+          s.seq.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (dif < 0) {
+        return false;  // 消费者尚未取走一整圈之前的记录
+      } else {
+        pos = head_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // 只能由一个线程调用
+  bool try_pop(T& out) {
+    uint64_t pos = tail_.load(std::memory_order_relaxed);
+    Slot& s = slots_[pos & mask_];
+    if (s.seq.load(std::memory_order_acquire) != pos + 1) return false;
+    out = s.value;
+    s.seq.store(pos + mask_ + 1, std::memory_order_release);
+    tail_.store(pos + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  size_t capacity() const { return mask_ + 1; }
+  // 近似长度，仅供统计
+  size_t size_approx() const {
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    return head > tail ? static_cast<size_t>(head - tail) : 0;
+  }
+
+private:
+  struct alignas(64) Slot {
+    std::atomic<uint64_t> seq;
+    T value;
+  };
+
+  size_t mask_;
+  std::unique_ptr<Slot[]> slots_;
+  alignas(64) std::atomic<uint64_t> head_{0};
+  alignas(64) std::atomic<uint64_t> tail_{0};  // 只有消费者写入
+};
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace hs::number {
+
+// 规范化后的 E.164 数字上限，与号码计划索引一致
+constexpr size_t kMaxDigits = 17;
+
+// 规范化结果：不含 '+' 的 E.164 数字，存放在调用方提供的定长缓冲中（通常在栈上），不分配内存。
+// 缓冲大于 kMaxDigits，供改写规则在截断校验前展开
+struct E164 {
+  static constexpr size_t kCapacity = 32;
+  alignas(16) char digits[kCapacity] = {};  // 整块做 SIMD 校验，先清零
+  uint8_t size = 0;
+  std::string_view view() const { return {digits, size}; }
+};
+
+enum class Status : uint8_t {
+  Ok,
+  Empty,     // 用户部分为空
+  BadChar,   // 剥离前缀与改写后仍含非数字字符
+  TooLong,   // 超过 kMaxDigits 位
+  Invalid,   // SIP URI 没有用户部分，只有主机
+};
+
+const char* status_name(Status s);
+
+// 入中继的改写规则：以 match 开头的号码剥离前 strip 位后补 prepend，如技术前缀 "1234#"
+struct Rewrite {
+  std::string match;
+  uint32_t strip = 0;
+  std::string prepend;
+};
+
+// 入中继的拨号计划；缺省只识别 '+' 与国际冠字 "00"
+struct DialPlan {
+  std::string intl_prefix = "00";  // 国际冠字，剥离后即为 E.164
+  std::string national_prefix;     // 国内冠字（如 "0"），剥离后补 country_code；为空时不识别
+  std::string country_code;        // 中继所在国家码
+  std::vector<Rewrite> rewrites;   // 取 match 最长的一条，在冠字识别之前执行
+
+  // 按 match 长度降序排列，装载完成后调用一次
+  void finalize();
+};
+
+// 把 SIP URI、tel URI 或裸号码转换为规范 E.164：
+//   去掉 name-addr 的尖括号、sip:/sips:/tel: 前缀、'@' 之后的主机部分与 ';' '?' 之后的参数，
+//   去掉视觉分隔符（- . ( ) 空格与制表符），执行中继改写规则，
+//   再剥离 '+'（或 %2B）、国际冠字，或以国家码替换国内冠字，最后校验全部为数字。
+// sip:/sips: URI 在 '@' 之前没有用户部分时返回 Invalid。
+// plan 为空时使用缺省拨号计划；已是规范 E.164 的号码原样返回。失败时 out.size 为 0
+Status normalize(std::string_view in, E164& out, const DialPlan* plan = nullptr);
+
+// URI 的原始用户部分（不做规范化），供无法规范化时保留原值；裸号码原样返回，没有用户部分的 SIP URI 返回空
+std::string_view user_part(std::string_view uri);
+
+}
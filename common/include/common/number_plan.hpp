@@ -0,0 +1,113 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace hs {
+
+// 号码类型，与 libphonenumber 元数据中的号码描述一一对应
+enum class NumberType : uint8_t {
+  FixedLine, Mobile, Pager, TollFree, PremiumRate, SharedCost, PersonalNumber, Voip, Uan, Voicemail, kCount
+};
+
+const char* number_type_name(NumberType t);
+// 类型位图的名称；固话与手机同时命中（如北美）为 "fixed_line_or_mobile"，空位图为 ""
+const char* number_types_name(uint16_t types);
+
+// 号码计划索引：由 libphonenumber 元数据展开得到的 (E.164 前缀, 允许的总长度, 地区, 类型) 条目，
+// 组织为按层存放的十叉树，写入单个文件后只读映射加载，不做反序列化。
+// 一个条目表示"以该前缀开头、总长度在位图内的号码均属于该地区的该类型"；号码的分类为沿路径所有长度匹配的条目之并。
+// 文件为小端序，格式：Header | Node[node_count] | Entry[entry_count] | Region[region_count]，各段 4 字节对齐
+class NumberPlan {
+public:
+  static constexpr char kMagic[4] = {'H', 'S', 'N', 'P'};
+  static constexpr uint32_t kVersion = 1;
+  static constexpr size_t kMaxDigits = 17;
+
+  struct Header {
+    char magic[4];
+    uint32_t version;
+    int64_t built_at;      // epoch 秒
+    uint64_t source_hash;  // 源元数据的 FNV-1a 指纹
+    uint32_t node_count;
+    uint32_t entry_count;
+    uint32_t region_count;
+    uint32_t crc;          // Header 之后全部数据的 CRC32C
+  };
+  // 子节点在 first_child 起连续存放，按 child_mask 中置位的数字升序；条目在 first_entry 起连续存放
+  struct Node {
+    uint16_t child_mask;
+    uint16_t entry_count;
+    uint32_t first_child;
+    uint32_t first_entry;
+  };
+  struct Entry {
+    uint32_t lengths;  // bit n 表示允许总长度 n（含国家码）
+    uint16_t region;
+    uint8_t type;      // NumberType
+    uint8_t reserved;
+  };
+  struct Region {
+    char id[4];            // CLDR 地区码，"001" 为非地理号码；不足补 0
+    char calling_code[4];  // 国家码数字，不足补 0
+  };
+
+  struct Match {
+    const Region* region = nullptr;  // 最长的长度匹配条目所属地区；无匹配时为路径上最长条目的地区（可能为空）
+    uint16_t types = 0;              // 命中的类型位图（1 << NumberType），为 0 表示号码无效
+    uint8_t prefix_len = 0;          // region 对应条目的前缀长度
+    bool valid() const { return types != 0; }
+  };
+
+  // 映射并校验索引文件，魔数、版本、大小或校验和不符时抛出 std::runtime_error
+  static std::shared_ptr<const NumberPlan> open(const std::string& path);
+  ~NumberPlan();
+  NumberPlan(const NumberPlan&) = delete;
+  NumberPlan& operator=(const NumberPlan&) = delete;
+
+  // digits 为 E.164 数字（不含 '+'），含非数字字符时视为无效
+  Match classify(std::string_view digits) const;
+
+  const Header& header() const { return *header_; }
+  size_t node_count() const { return header_->node_count; }
+  size_t entry_count() const { return header_->entry_count; }
+  size_t region_count() const { return header_->region_count; }
+  static std::string_view region_id(const Region& r);
+  static std::string_view calling_code(const Region& r);
+
+private:
+  NumberPlan() = default;
+
+  const void* map_ = nullptr;
+  size_t size_ = 0;
+  const Header* header_ = nullptr;
+  const Node* nodes_ = nullptr;
+  const Entry* entries_ = nullptr;
+  const Region* regions_ = nullptr;
+};
+
+// 构建索引：逐条加入 (前缀, 长度位图, 地区, 类型)，相同前缀、地区与类型的条目合并长度
+class NumberPlanBuilder {
+public:
+  NumberPlanBuilder();
+  // 返回地区编号；同一 id 与国家码重复调用返回同一编号
+  uint16_t region(std::string_view id, std::string_view calling_code);
+  // digits 以国家码开头，只含数字且不超过 kMaxDigits 位
+  void add(std::string_view digits, uint32_t lengths, uint16_t region, NumberType type);
+
+  size_t node_count() const { return children_.size(); }
+  size_t entry_count() const;
+  // 序列化为索引文件内容；写文件时先写临时文件再改名，读端不会看到半个文件
+  std::string serialize(uint64_t source_hash, int64_t built_at) const;
+  void write(const std::string& path, uint64_t source_hash, int64_t built_at) const;
+
+private:
+  std::vector<std::array<uint32_t, 10>> children_;
+  std::vector<std::vector<NumberPlan::Entry>> entries_;
+  std::vector<NumberPlan::Region> regions_;
+};
+
+}
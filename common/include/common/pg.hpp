@@ -1,16 +1,85 @@
 #pragma once
 #include <pqxx/pqxx>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "common/metrics.hpp"
 
 namespace hs {
 
+// 有界 PostgreSQL 连接池：借出/归还、断线重连，注册过的预编译语句在每个连接上只 PREPARE 一次
 class Pg {
+  struct Slot {
+    std::unique_ptr<pqxx::connection> conn;
+    size_t prepared = 0; // 已在该连接上 PREPARE 的语句数
+  };
+
 public:
-  explicit Pg(const std::string& conninfo);
-  pqxx::connection& conn();
+  struct Stats {
+    std::atomic<uint64_t> checkouts{0};
+    std::atomic<uint64_t> waits{0};        // 借出时需要排队的次数
+    std::atomic<uint64_t> wait_ns{0};      // 累计排队时长
+    std::atomic<uint64_t> timeouts{0};
+    std::atomic<uint64_t> reconnects{0};
+    std::atomic<int64_t> in_use{0};
+  };
+
+  class Lease {
+  public:
+    Lease(Lease&& o) noexcept : pool_(std::exchange(o.pool_, nullptr)), slot_(o.slot_), invalid_(o.invalid_) {}
+    Lease(const Lease&) = delete;
+    Lease& operator=(const Lease&) = delete;
+    ~Lease() { if (pool_) pool_->release(slot_, invalid_); }
+
+    pqxx::connection& operator*() const { return *slot_->conn; }
+    pqxx::connection* operator->() const { return slot_->conn.get(); }
+    // 连接状态不可信时调用，归还后丢弃并在下次借出时重连
+    void invalidate() { invalid_ = true; }
+
+  private:
+    friend class Pg;
+    Lease(Pg* pool, Slot* slot) : pool_(pool), slot_(slot) {}
+    Pg* pool_;
+    Slot* slot_;
+    bool invalid_ = false;
+  };
+
+  explicit Pg(const std::string& conninfo, size_t pool_size = 1,
+              std::chrono::milliseconds acquire_timeout = std::chrono::milliseconds(2000));
+  ~Pg();
+
+  // 注册预编译语句，可在任意时刻调用；连接在下次借出时补齐
+  void prepare(const std::string& name, const std::string& sql);
+  // 池满时最多等待 acquire_timeout，超时抛出 std::runtime_error
+  Lease acquire();
+
+  const Stats& stats() const { return stats_; }
+  size_t capacity() const { return capacity_; }
+
+  // 语句耗时直方图 hs_pg_query_seconds{statement}，调用方取得后自行缓存
+  static metrics::Histogram& query_latency(std::string_view statement);
+
 private:
-  std::unique_ptr<pqxx::connection> connection_;
+  void release(Slot* slot, bool invalid);
+  void ensure_ready(Slot& slot, const std::vector<std::pair<std::string, std::string>>& pending);
+
+  std::string conninfo_;
+  size_t capacity_;
+  std::chrono::milliseconds timeout_;
+  std::mutex mu_;
+  std::condition_variable cv_;
+  std::vector<std::unique_ptr<Slot>> slots_;
+  std::vector<Slot*> idle_;
+  std::vector<std::pair<std::string, std::string>> statements_;
+  Stats stats_;
+  metrics::Histogram* wait_latency_;
 };
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <pqxx/pqxx>
+
+namespace hs {
+
+// 在独立连接上 LISTEN 若干通道，按通道合并去抖后在后台线程回调。
+// 通知负载约定为 "<schema.table>:<key>"，key 为 '*' 表示需要全量重建（见 migrations/postgres/004_change_notify.sql）。
+class PgListener {
+public:
+  using Handler = std::function<void(const std::vector<std::string>& payloads)>;
+
+  explicit PgListener(std::string conninfo, std::chrono::milliseconds debounce = std::chrono::milliseconds(200));
+  ~PgListener();
+
+  // 须在 start() 之前注册
+  void subscribe(const std::string& channel, Handler on_change);
+  // 断线重连后调用：断线期间的通知已丢失，订阅方应全量重建
+  void on_resync(std::function<void()> fn);
+
+  // 同步建立连接并 LISTEN，然后启动后台线程；调用方应在 start() 之后再做首次全量加载，避免遗漏变更
+  void start();
+  void stop();
+
+private:
+  class Receiver;
+  void connect();
+  void run(std::stop_token st);
+  void dispatch();
+
+  std::string conninfo_;
+  std::chrono::milliseconds debounce_;
+  std::map<std::string, Handler> handlers_;
+  std::vector<std::function<void()>> resync_;
+  std::unique_ptr<pqxx::connection> conn_;
+  std::vector<std::unique_ptr<Receiver>> receivers_;
+  std::map<std::string, std::set<std::string>> pending_;
+  std::jthread thread_;
+};
+
+}
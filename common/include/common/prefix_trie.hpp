@@ -0,0 +1,82 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace hs {
+
+// 十叉数字前缀树：节点连续存放在一个数组里，value 为调用方自定义的槽位下标。
+class PrefixTrie {
+public:
+  static constexpr uint32_t kNone = 0xffffffffu;
+
+  struct Node {
+    std::array<uint32_t, 10> child;
+    uint32_t value;
+  };
+
+  PrefixTrie() { nodes_.push_back(empty_node()); }
+
+  // 插入前缀并返回其节点 value 的引用；前缀含非数字字符时返回 nullptr
+  uint32_t* insert(std::string_view prefix) {
+    uint32_t n = 0;
+    for (char ch : prefix) {
+      unsigned d = static_cast<unsigned char>(ch) - '0';
+      if (d > 9) return nullptr;
+      if (nodes_[n].child[d] == kNone) {
+        nodes_[n].child[d] = static_cast<uint32_t>(nodes_.size());
+        nodes_.push_back(empty_node());
+      }
+      n = nodes_[n].child[d];
+    }
+    return &nodes_[n].value;
+  }
+
+  // 沿 key 逐位下行，对路径上每个有值的节点调用 fn(value, depth)，由短到长；遇到非数字即停止
+  template <class Fn>
+  void walk(std::string_view key, Fn&& fn) const {
+    uint32_t n = 0;
+    if (nodes_[0].value != kNone) fn(nodes_[0].value, size_t{0});
+    for (size_t i = 0; i < key.size(); ++i) {
+      unsigned d = static_cast<unsigned char>(key[i]) - '0';
+      if (d > 9) return;
+      n = nodes_[n].child[d];
+      if (n == kNone) return;
+      if (nodes_[n].value != kNone) fn(nodes_[n].value, i + 1);
+    }
+  }
+
+  // 最长匹配前缀的 value，无匹配返回 kNone
+  uint32_t longest(std::string_view key) const {
+    uint32_t best = kNone;
+    walk(key, [&](uint32_t v, size_t) { best = v; });
+    return best;
+  }
+
+  size_t node_count() const { return nodes_.size(); }
+  const std::vector<Node>& nodes() const { return nodes_; }
+
+  // 以 nodes() 导出的节点数组重建（快照文件加载）；为空或子节点下标越界时返回 false 且不修改
+  bool assign(std::span<const Node> nodes) {
+    if (nodes.empty()) return false;
+    for (const Node& n : nodes)
+      for (uint32_t c : n.child)
+        if (c != kNone && c >= nodes.size()) return false;
+    nodes_.assign(nodes.begin(), nodes.end());
+    return true;
+  }
+
+private:
+  static Node empty_node() {
+    Node n;
+    n.child.fill(kNone);
+    n.value = kNone;
+    return n;
+  }
+
+  std::vector<Node> nodes_;
+};
+
+}
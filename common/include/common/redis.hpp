@@ -2,6 +2,8 @@
 #include <sw/redis++/redis++.h>
 #include <memory>
 #include <string>
+#include <string_view>
+#include "common/metrics.hpp"
 
 namespace hs {
 
@@ -9,6 +11,9 @@ class RedisClient {
 public:
   explicit RedisClient(const std::string& uri);
   sw::redis::Redis& get();
+
+  // 往返耗时直方图 hs_redis_rtt_seconds{op}，调用方取得后自行缓存；流水线按一次往返计
+  static metrics::Histogram& rtt(std::string_view op);
 private:
   std::unique_ptr<sw::redis::Redis> redis_;
 };
@@ -0,0 +1,510 @@
+#pragma once
+#include <grpcpp/alarm.h>
+#include <grpcpp/grpcpp.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <spdlog/spdlog.h>
+#include "common/metrics.hpp"
+
+namespace hs::rpc {
+
+// 异步 gRPC 服务框架：N 个完成队列各由一个绑核线程轮询，处理器直接在轮询线程上运行（内存判定类），
+// 或交给有界工作线程池（磁盘等阻塞 I/O），或以回调方式挂起等待数据库提交而不占用线程。
+// 过载时快速失败而不是无界排队：每个队列在途调用超过 max_inflight、工作线程池排队超过 max_queued 时
+// 直接返回 RESOURCE_EXHAUSTED；到达时已过截止时间的调用返回 DEADLINE_EXCEEDED 且不执行处理器。
+
+// 同步处理器的执行位置
+enum class Exec { Inline, Pool };
+
+struct Options {
+  std::string bind;
+  size_t queues = 0;           // 完成队列（轮询线程）数，0 为可用核数
+  bool pin_cores = true;       // 轮询线程依次绑定到进程可用的核
+  size_t max_inflight = 4096;  // 每个队列的在途调用上限（含挂起等待的异步调用与打开的流）
+  size_t max_streams = 1024;   // 每个连接的并发流上限，限制 gRPC 内部尚未分派的积压
+  size_t workers = 0;          // Exec::Pool 线程数，0 时 Pool 处理器在轮询线程上运行
+  size_t max_queued = 1024;    // 工作线程池排队上限
+  std::chrono::milliseconds default_deadline{5000};  // 客户端未设截止时间的异步一元调用
+};
+
+// 以 base 为默认值，读取 RPC_QUEUES、RPC_PIN_CORES、RPC_MAX_INFLIGHT、RPC_MAX_STREAMS、
+// RPC_WORKERS、RPC_MAX_QUEUED、RPC_DEFAULT_DEADLINE_MS
+Options options_from_env(Options base);
+
+struct Stats {
+  std::atomic<uint64_t> calls{0};
+  std::atomic<uint64_t> shed{0};       // 在途或排队超限被拒绝
+  std::atomic<uint64_t> expired{0};    // 执行前已过截止时间
+  std::atomic<uint64_t> timed_out{0};  // 异步处理器未在截止时间内完成
+  std::atomic<uint64_t> errors{0};     // 处理器抛出异常
+};
+
+namespace detail {
+
+struct Tag {
+  virtual void proceed(bool ok) = 0;
+  virtual ~Tag() = default;
+};
+
+struct Queue {
+  std::unique_ptr<grpc::ServerCompletionQueue> cq;
+  std::atomic<size_t> inflight{0};
+  std::thread thread;
+};
+
+// 每个方法的处理耗时直方图（hs_rpc_server_handling_seconds）与非 OK 状态计数
+struct MethodMetrics {
+  explicit MethodMetrics(std::string_view method);
+  void record(std::chrono::steady_clock::time_point t0, const grpc::Status& st) const {
+    latency->record(std::chrono::steady_clock::now() - t0);
+    if (!st.ok()) failures->inc();
+  }
+  metrics::Histogram* latency;
+  metrics::Counter* failures;
+};
+
+struct Method {
+  explicit Method(std::string_view name) : metrics(name) {}
+  virtual void spawn(Queue& q) = 0;
+  virtual ~Method() = default;
+  MethodMetrics metrics;
+};
+
+class AsyncUnaryBase;
+
+}
+
+// 异步一元处理器的完成回调：可在任意线程调用，且必须恰好调用一次；调用前处理器持有的请求与响应对象保持有效
+class Done {
+public:
+  void operator()(const grpc::Status& status) const;
+private:
+  friend class detail::AsyncUnaryBase;
+  explicit Done(detail::AsyncUnaryBase* call) : call_(call) {}
+  detail::AsyncUnaryBase* call_;
+};
+
+class Server {
+public:
+  explicit Server(Options opt);
+  ~Server();
+
+  // name 为方法名，作为指标的 method 标签；处理耗时自调用出队（异步一元为处理器开始）至处理器完成，流按每条消息计
+  // handler: grpc::Status(grpc::ServerContext*, const Req*, Resp*)
+  template <class Svc, class Base, class Req, class Resp, class H>
+  void unary(std::string_view name, Svc* svc,
+             void (Base::*request)(grpc::ServerContext*, Req*, grpc::ServerAsyncResponseWriter<Resp>*,
+                                   grpc::CompletionQueue*, grpc::ServerCompletionQueue*, void*),
+             H handler, Exec exec = Exec::Inline);
+
+  // handler: void(grpc::ServerContext*, const Req*, Resp*, hs::rpc::Done)。
+  // 截止时间取客户端截止时间与 now + timeout（0 时为 default_deadline）中较早者，到期仍未完成返回 DEADLINE_EXCEEDED
+  template <class Svc, class Base, class Req, class Resp, class H>
+  void unary_async(std::string_view name, Svc* svc,
+                   void (Base::*request)(grpc::ServerContext*, Req*, grpc::ServerAsyncResponseWriter<Resp>*,
+                                         grpc::CompletionQueue*, grpc::ServerCompletionQueue*, void*),
+                   H handler, std::chrono::milliseconds timeout = {});
+
+  // 客户端流：每条消息调用 handler: grpc::Status(grpc::ServerContext*, const Req&, Resp&)，
+  // 客户端结束发送后返回累积的 Resp；非 OK 状态立即结束该流
+  template <class Svc, class Base, class Req, class Resp, class H>
+  void client_stream(std::string_view name, Svc* svc,
+                     void (Base::*request)(grpc::ServerContext*, grpc::ServerAsyncReader<Resp, Req>*,
+                                           grpc::CompletionQueue*, grpc::ServerCompletionQueue*, void*),
+                     H handler, Exec exec = Exec::Inline);
+
+  // 双向流，一问一答：每条请求消息调用 handler（签名同上，Resp 已清空）并写回一条响应
+  template <class Svc, class Base, class Req, class Resp, class H>
+  void bidi_stream(std::string_view name, Svc* svc,
+                   void (Base::*request)(grpc::ServerContext*, grpc::ServerAsyncReaderWriter<Resp, Req>*,
+                                         grpc::CompletionQueue*, grpc::ServerCompletionQueue*, void*),
+                   H handler, Exec exec = Exec::Inline);
+
+  // 注册全部方法后调用：监听端口、在每个队列上挂起各方法的首个请求并启动线程
+  void start();
+  // 阻塞至 shutdown()，期间每分钟打印一次统计
+  void wait();
+  void shutdown();
+
+  const Options& options() const { return opt_; }
+  const Stats& stats() const { return stats_; }
+
+  // 以下供调用对象使用
+  enum class Admit { Ok, Shed, Expired };
+  Admit admit(detail::Queue& q, const grpc::ServerContext& ctx);
+  void release(detail::Queue& q) { q.inflight.fetch_sub(1, std::memory_order_relaxed); }
+  // 投递到工作线程池；排队超限返回 false，未配置工作线程时在当前线程执行
+  bool submit(std::function<void()> fn);
+  Stats& mutable_stats() { return stats_; }
+
+private:
+  void add_service(grpc::Service* svc);
+  void export_metrics();
+  void poll(detail::Queue& q);
+  void work(std::stop_token st);
+
+  Options opt_;
+  Stats stats_;
+  std::vector<grpc::Service*> services_;
+  std::vector<std::unique_ptr<detail::Method>> methods_;
+  std::unique_ptr<grpc::Server> server_;
+  std::vector<std::unique_ptr<detail::Queue>> queues_;
+
+  std::mutex jobs_mu_;
+  std::condition_variable_any jobs_cv_;
+  std::deque<std::function<void()>> jobs_;
+  std::vector<std::jthread> workers_;
+
+  std::mutex state_mu_;
+  std::condition_variable state_cv_;
+  bool stopping_ = false;
+};
+
+namespace detail {
+
+inline grpc::Status status_of(Server::Admit a) {
+  if (a == Server::Admit::Shed) return {grpc::StatusCode::RESOURCE_EXHAUSTED, "server overloaded"};
+  return {grpc::StatusCode::DEADLINE_EXCEEDED, "deadline exceeded before dispatch"};
+}
+
+inline bool expired(const grpc::ServerContext& ctx) {
+  return ctx.deadline() <= std::chrono::system_clock::now();
+}
+
+template <class H, class... Args>
+grpc::Status invoke(Server& srv, const H& handler, Args&&... args) {
+  try {
+    return handler(std::forward<Args>(args)...);
+  } catch (const std::exception& ex) {
+    srv.mutable_stats().errors.fetch_add(1, std::memory_order_relaxed);
+    spdlog::error("RPC handler error: {}", ex.what());
+    return {grpc::StatusCode::INTERNAL, ex.what()};
+  }
+}
+
+// ---- 一元 ----
+
+template <class Svc, class Req, class Resp, class H>
+struct UnaryMethod final : Method {
+  using Request = void (Svc::*)(grpc::ServerContext*, Req*, grpc::ServerAsyncResponseWriter<Resp>*,
+                                grpc::CompletionQueue*, grpc::ServerCompletionQueue*, void*);
+  UnaryMethod(std::string_view name, Server* s, Svc* v, Request r, H h, Exec e)
+    : Method(name), srv(s), svc(v), request(r), handler(std::move(h)), exec(e) {}
+  void spawn(Queue& q) override;
+
+  Server* srv;
+  Svc* svc;
+  Request request;
+  H handler;
+  Exec exec;
+};
+
+template <class M, class Req, class Resp>
+class UnaryCall final : public Tag {
+public:
+  UnaryCall(M* m, Queue* q) : m_(m), q_(q), writer_(&ctx_) {
+    (m_->svc->*m_->request)(&ctx_, &req_, &writer_, q_->cq.get(), q_->cq.get(), this);
+  }
+  ~UnaryCall() override {
+    if (admitted_) m_->srv->release(*q_);
+  }
+
+  void proceed(bool ok) override {
+    if (started_ || !ok) { delete this; return; }  // Finish 完成，或服务关闭
+    started_ = true;
+    t0_ = std::chrono::steady_clock::now();
+    m_->spawn(*q_);
+    auto a = m_->srv->admit(*q_, ctx_);
+    if (a != Server::Admit::Ok) { writer_.FinishWithError(status_of(a), this); return; }
+    admitted_ = true;
+    if (m_->exec == Exec::Inline || !m_->srv->submit([this] { run(); })) {
+      if (m_->exec == Exec::Pool) {
+        // submit 失败：工作线程池排队超限
+        m_->srv->mutable_stats().shed.fetch_add(1, std::memory_order_relaxed);
+        writer_.FinishWithError(status_of(Server::Admit::Shed), this);
+        return;
+      }
+      run();
+    }
+  }
+
+private:
+  void run() {
+    // 排队期间可能已经超时
+    if (expired(ctx_)) {
+      m_->srv->mutable_stats().expired.fetch_add(1, std::memory_order_relaxed);
+      writer_.FinishWithError(status_of(Server::Admit::Expired), this);
+      return;
+    }
+    auto st = invoke(*m_->srv, m_->handler, &ctx_, static_cast<const Req*>(&req_), &resp_);
+    m_->metrics.record(t0_, st);
+    if (st.ok()) writer_.Finish(resp_, st, this);
+    else writer_.FinishWithError(st, this);
+  }
+
+  M* m_;
+  Queue* q_;
+  grpc::ServerContext ctx_;
+  Req req_;
+  Resp resp_;
+  grpc::ServerAsyncResponseWriter<Resp> writer_;
+  std::chrono::steady_clock::time_point t0_;
+  bool started_ = false;
+  bool admitted_ = false;
+};
+
+template <class Svc, class Req, class Resp, class H>
+void UnaryMethod<Svc, Req, Resp, H>::spawn(Queue& q) {
+  new UnaryCall<UnaryMethod, Req, Resp>(this, &q);
+}
+
+// ---- 异步一元 ----
+
+// 调用对象由以下引用共同持有，全部释放后删除：处理阶段、处理器回调（Done）、截止时间闹钟、Finish 完成事件
+class AsyncUnaryBase : public Tag {
+public:
+  void proceed(bool ok) override;
+  void complete(const grpc::Status& st);
+
+protected:
+  AsyncUnaryBase(Server* srv, Queue* q, const MethodMetrics* metrics) : srv_(srv), q_(q), metrics_(metrics) {}
+  ~AsyncUnaryBase() override {
+    if (admitted_) srv_->release(*q_);
+  }
+
+  // 收到请求后调用：重新挂起同一方法的下一个请求
+  virtual void respawn() = 0;
+  virtual void dispatch(Done done) = 0;
+  virtual void finish(const grpc::Status& st) = 0;  // 一元写回，OK 时附带响应
+
+  void ref() { refs_.fetch_add(1, std::memory_order_relaxed); }
+  void unref() {
+    if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+  }
+
+  grpc::ServerContext ctx_;
+  std::chrono::milliseconds timeout_{};
+
+private:
+  struct AlarmTag final : Tag {
+    AsyncUnaryBase* owner = nullptr;
+    void proceed(bool ok) override;
+  };
+
+  void start();
+  void try_finish(const grpc::Status& st);
+
+  Server* srv_;
+  Queue* q_;
+  const MethodMetrics* metrics_;
+  std::chrono::steady_clock::time_point t0_;
+  bool started_ = false;
+  bool admitted_ = false;
+  std::atomic<int> refs_{1};
+  std::atomic<bool> finished_{false};
+  std::atomic<bool> completed_{false};
+  grpc::Alarm alarm_;
+  AlarmTag alarm_tag_;
+};
+
+template <class Svc, class Req, class Resp, class H>
+struct AsyncUnaryMethod final : Method {
+  using Request = void (Svc::*)(grpc::ServerContext*, Req*, grpc::ServerAsyncResponseWriter<Resp>*,
+                                grpc::CompletionQueue*, grpc::ServerCompletionQueue*, void*);
+  AsyncUnaryMethod(std::string_view name, Server* s, Svc* v, Request r, H h, std::chrono::milliseconds t)
+    : Method(name), srv(s), svc(v), request(r), handler(std::move(h)), timeout(t) {}
+  void spawn(Queue& q) override;
+
+  Server* srv;
+  Svc* svc;
+  Request request;
+  H handler;
+  std::chrono::milliseconds timeout;
+};
+
+template <class M, class Req, class Resp>
+class AsyncUnaryCall final : public AsyncUnaryBase {
+public:
+  AsyncUnaryCall(M* m, Queue* q) : AsyncUnaryBase(m->srv, q, &m->metrics), m_(m), q_(q), writer_(&ctx_) {
+    timeout_ = m->timeout;
+    (m_->svc->*m_->request)(&ctx_, &req_, &writer_, q_->cq.get(), q_->cq.get(), static_cast<Tag*>(this));
+  }
+
+private:
+  void respawn() override { m_->spawn(*q_); }
+  void dispatch(Done done) override {
+    try {
+      m_->handler(&ctx_, static_cast<const Req*>(&req_), &resp_, done);
+    } catch (const std::exception& ex) {
+      m_->srv->mutable_stats().errors.fetch_add(1, std::memory_order_relaxed);
+      spdlog::error("RPC handler error: {}", ex.what());
+      done({grpc::StatusCode::INTERNAL, ex.what()});
+    }
+  }
+  void finish(const grpc::Status& st) override {
+    if (st.ok()) writer_.Finish(resp_, st, static_cast<Tag*>(this));
+    else writer_.FinishWithError(st, static_cast<Tag*>(this));
+  }
+
+  M* m_;
+  Queue* q_;
+  Req req_;
+  Resp resp_;
+  grpc::ServerAsyncResponseWriter<Resp> writer_;
+};
+
+template <class Svc, class Req, class Resp, class H>
+void AsyncUnaryMethod<Svc, Req, Resp, H>::spawn(Queue& q) {
+  new AsyncUnaryCall<AsyncUnaryMethod, Req, Resp>(this, &q);
+}
+
+// ---- 流 ----
+
+// 同一时刻每个流只有一个未完成操作（读、写或结束），无需引用计数
+template <class M, class Stream, class Req, class Resp, bool kBidi>
+class StreamCall final : public Tag {
+public:
+  StreamCall(M* m, Queue* q) : m_(m), q_(q), stream_(&ctx_) {
+    (m_->svc->*m_->request)(&ctx_, &stream_, q_->cq.get(), q_->cq.get(), this);
+  }
+  ~StreamCall() override {
+    if (admitted_) m_->srv->release(*q_);
+  }
+
+  void proceed(bool ok) override {
+    switch (state_) {
+      case State::Request: {
+        if (!ok) { delete this; return; }
+        m_->spawn(*q_);
+        auto a = m_->srv->admit(*q_, ctx_);
+        if (a != Server::Admit::Ok) { finish(status_of(a)); return; }
+        admitted_ = true;
+        read();
+        return;
+      }
+      case State::Read:
+        // 客户端结束发送
+        if (!ok) { finish(grpc::Status::OK); return; }
+        if (m_->exec == Exec::Inline || !m_->srv->submit([this] { handle(); })) {
+          if (m_->exec == Exec::Pool) {
+            m_->srv->mutable_stats().shed.fetch_add(1, std::memory_order_relaxed);
+            finish(status_of(Server::Admit::Shed));
+            return;
+          }
+          handle();
+        }
+        return;
+      case State::Write:
+        if (!ok) { finish({grpc::StatusCode::CANCELLED, "stream write failed"}); return; }
+        read();
+        return;
+      case State::Finish:
+        delete this;
+        return;
+    }
+  }
+
+private:
+  enum class State { Request, Read, Write, Finish };
+
+  void read() {
+    state_ = State::Read;
+    stream_.Read(&req_, this);
+  }
+
+  void handle() {
+    if constexpr (kBidi) resp_.Clear();
+    auto t0 = std::chrono::steady_clock::now();
+    auto st = invoke(*m_->srv, m_->handler, &ctx_, static_cast<const Req&>(req_), resp_);
+    m_->metrics.record(t0, st);
+    if (!st.ok()) { finish(st); return; }
+    if constexpr (kBidi) {
+      state_ = State::Write;
+      stream_.Write(resp_, this);
+    } else {
+      read();
+    }
+  }
+
+  void finish(const grpc::Status& st) {
+    state_ = State::Finish;
+    if constexpr (kBidi) stream_.Finish(st, this);
+    else if (st.ok()) stream_.Finish(resp_, st, this);
+    else stream_.FinishWithError(st, this);
+  }
+
+  M* m_;
+  Queue* q_;
+  grpc::ServerContext ctx_;
+  Req req_;
+  Resp resp_;
+  Stream stream_;
+  State state_ = State::Request;
+  bool admitted_ = false;
+};
+
+template <class Svc, class Stream, class Req, class Resp, class H, bool kBidi>
+struct StreamMethod final : Method {
+  using Request = void (Svc::*)(grpc::ServerContext*, Stream*, grpc::CompletionQueue*, grpc::ServerCompletionQueue*, void*);
+  StreamMethod(std::string_view name, Server* s, Svc* v, Request r, H h, Exec e)
+    : Method(name), srv(s), svc(v), request(r), handler(std::move(h)), exec(e) {}
+  void spawn(Queue& q) override { new StreamCall<StreamMethod, Stream, Req, Resp, kBidi>(this, &q); }
+
+  Server* srv;
+  Svc* svc;
+  Request request;
+  H handler;
+  Exec exec;
+};
+
+}
+
+template <class Svc, class Base, class Req, class Resp, class H>
+void Server::unary(std::string_view name, Svc* svc,
+                   void (Base::*request)(grpc::ServerContext*, Req*, grpc::ServerAsyncResponseWriter<Resp>*,
+                                         grpc::CompletionQueue*, grpc::ServerCompletionQueue*, void*),
+                   H handler, Exec exec) {
+  add_service(svc);
+  methods_.push_back(std::make_unique<detail::UnaryMethod<Svc, Req, Resp, H>>(name, this, svc, request, std::move(handler), exec));
+}
+
+template <class Svc, class Base, class Req, class Resp, class H>
+void Server::unary_async(std::string_view name, Svc* svc,
+                         void (Base::*request)(grpc::ServerContext*, Req*, grpc::ServerAsyncResponseWriter<Resp>*,
+                                               grpc::CompletionQueue*, grpc::ServerCompletionQueue*, void*),
+                         H handler, std::chrono::milliseconds timeout) {
+  add_service(svc);
+  methods_.push_back(std::make_unique<detail::AsyncUnaryMethod<Svc, Req, Resp, H>>(name, this, svc, request, std::move(handler), timeout));
+}
+
+template <class Svc, class Base, class Req, class Resp, class H>
+void Server::client_stream(std::string_view name, Svc* svc,
+                           void (Base::*request)(grpc::ServerContext*, grpc::ServerAsyncReader<Resp, Req>*,
+                                                 grpc::CompletionQueue*, grpc::ServerCompletionQueue*, void*),
+                           H handler, Exec exec) {
+  add_service(svc);
+  using M = detail::StreamMethod<Svc, grpc::ServerAsyncReader<Resp, Req>, Req, Resp, H, false>;
+  methods_.push_back(std::make_unique<M>(name, this, svc, request, std::move(handler), exec));
+}
+
+template <class Svc, class Base, class Req, class Resp, class H>
+void Server::bidi_stream(std::string_view name, Svc* svc,
+                         void (Base::*request)(grpc::ServerContext*, grpc::ServerAsyncReaderWriter<Resp, Req>*,
+                                               grpc::CompletionQueue*, grpc::ServerCompletionQueue*, void*),
+                         H handler, Exec exec) {
+  add_service(svc);
+  using M = detail::StreamMethod<Svc, grpc::ServerAsyncReaderWriter<Resp, Req>, Req, Resp, H, true>;
+  methods_.push_back(std::make_unique<M>(name, this, svc, request, std::move(handler), exec));
+}
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace hs {
+
+// 不可变数据的发布点：写端构建完整对象后整体替换，读端永远看到完整的某一版本。
+// read() 在线程本地缓存当前版本的 shared_ptr，版本未变时只做一次原子读，不加锁也不改引用计数；
+// 返回的指针在本线程下一次对同类型快照调用 read() 之前有效。
+template <class T>
+class Snapshot {
+public:
+  Snapshot() = default;
+  explicit Snapshot(std::shared_ptr<const T> p) { store(std::move(p)); }
+
+  void store(std::shared_ptr<const T> p) {
+    ptr_.store(std::move(p), std::memory_order_release);
+    version_.fetch_add(1, std::memory_order_acq_rel);
+  }
+
+  std::shared_ptr<const T> load() const { return ptr_.load(std::memory_order_acquire); }
+
+  const T* read() const {
+    struct Cache {
+      const Snapshot* owner = nullptr;
+      uint64_t version = 0;
+      std::shared_ptr<const T> ptr;
+    };
+    thread_local Cache cache;
+    uint64_t v = version_.load(std::memory_order_acquire);
+    if (cache.owner != this || cache.version != v) {
+      cache.ptr = ptr_.load(std::memory_order_acquire);
+      cache.owner = this;
+      cache.version = v;
+    }
+    return cache.ptr.get();
+  }
+
+  uint64_t version() const { return version_.load(std::memory_order_acquire); }
+
+private:
+  std::atomic<std::shared_ptr<const T>> ptr_;
+  std::atomic<uint64_t> version_{0};
+};
+
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace hs {
+
+// 快照文件：服务内存结构（路由计划、费率表等）的扁平副本，冷启动时映射加载，随后再从 PostgreSQL 追平。
+// 文件由若干段组成，每段是一个定长记录数组，记录之间以段内下标互相引用，字符串存放在公共字符串段；
+// 不含指针，可直接 mmap。文件为小端序，格式：Header | Section[section_count] | 各段数据（8 字节对齐）
+class SnapshotFile {
+public:
+  static constexpr char kMagic[4] = {'H', 'S', 'S', 'F'};
+  static constexpr uint32_t kStrings = 0;  // 字符串段的段号
+
+  struct Header {
+    char magic[4];
+    char kind[4];          // 内容类型，如 "ROUT"、"RATE"
+    uint32_t version;      // 内容格式版本，由各服务定义
+    uint32_t section_count;
+    int64_t created_at;    // epoch 秒
+    uint64_t size;         // 文件总长度
+    uint32_t crc;          // Header 之后全部数据的 CRC32C
+    uint32_t reserved;
+  };
+  struct Section {
+    uint32_t id;
+    uint32_t record_size;
+    uint64_t offset;       // 自文件头起
+    uint64_t count;
+  };
+  // 字符串段中的 [offset, offset + size)
+  struct Str {
+    uint32_t offset;
+    uint32_t size;
+  };
+
+  // 映射并校验文件；魔数、类型、版本、长度或校验和不符，或 max_age_s > 0 且文件早于该秒数时抛出 std::runtime_error
+  static std::shared_ptr<const SnapshotFile> open(const std::string& path, std::string_view kind, uint32_t version,
+                                                  int64_t max_age_s = 0);
+  ~SnapshotFile();
+  SnapshotFile(const SnapshotFile&) = delete;
+  SnapshotFile& operator=(const SnapshotFile&) = delete;
+
+  // 段号为 id 的记录数组；段不存在时为空，记录长度不符时抛出 std::runtime_error
+  template <class T>
+  std::span<const T> section(uint32_t id) const {
+    static_assert(std::is_trivially_copyable_v<T>);
+    auto [data, count] = raw(id, sizeof(T), alignof(T));
+    return {static_cast<const T*>(data), count};
+  }
+  std::string_view str(Str s) const;
+
+  // 记录中的下标区间 [first, first + count)，越界时抛出 std::runtime_error
+  template <class T>
+  static std::span<const T> slice(std::span<const T> s, uint64_t first, uint64_t count) {
+    if (first > s.size() || count > s.size() - first) throw std::runtime_error("snapshot: index out of range");
+    return s.subspan(first, count);
+  }
+
+  const Header& header() const { return *header_; }
+  const std::string& path() const { return path_; }
+
+private:
+  SnapshotFile() = default;
+  std::pair<const void*, size_t> raw(uint32_t id, size_t record_size, size_t align) const;
+
+  std::string path_;
+  const void* map_ = nullptr;
+  size_t size_ = 0;
+  const Header* header_ = nullptr;
+  const Section* sections_ = nullptr;
+};
+
+// 构建快照文件：逐段加入记录数组，字符串经 str() 写入字符串段
+class SnapshotWriter {
+public:
+  SnapshotWriter(std::string_view kind, uint32_t version);
+
+  SnapshotFile::Str str(std::string_view s);
+
+  template <class T>
+  void section(uint32_t id, std::span<const T> records) {
+    static_assert(std::is_trivially_copyable_v<T> && alignof(T) <= 8);
+    add(id, sizeof(T), records.data(), records.size());
+  }
+  template <class T>
+  void section(uint32_t id, const std::vector<T>& records) { section(id, std::span<const T>(records)); }
+
+  std::string serialize(int64_t created_at) const;
+  // 先写临时文件并 fsync，再改名替换，读端不会看到半个文件
+  void write(const std::string& path, int64_t created_at) const;
+
+private:
+  void add(uint32_t id, uint32_t record_size, const void* data, size_t count);
+
+  char kind_[4];
+  uint32_t version_;
+  std::string strings_;
+  std::vector<std::pair<SnapshotFile::Section, std::string>> sections_;
+};
+
+// 快照维护线程：reload 非空时先反复调用直到成功（从快照启动后的追平，失败按 1s 起、至多 30s 退避），
+// 然后调用一次 save，之后每隔 interval 调用一次（为 0 时不再调用）；save 应自行跳过未变化的数据
+std::jthread snapshot_thread(std::string what, std::function<void()> reload, std::function<void()> save,
+                             std::chrono::seconds interval);
+
+}
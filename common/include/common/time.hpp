@@ -0,0 +1,76 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace hs {
+
+inline int64_t now_epoch_ms() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// 公历日期 → 1970-01-01 起的天数（H. Hinnant days_from_civil）
+constexpr int64_t days_from_civil(int64_t y, unsigned m, unsigned d) {
+  y -= m <= 2;
+  const int64_t era = (y >= 0 ? y : y - 399) / 400;
+  const unsigned yoe = static_cast<unsigned>(y - era * 400);
+  const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + static_cast<int64_t>(doe) - 719468;
+}
+
+// 解析 ISO8601 / RFC3339 时间为 epoch 毫秒：YYYY-MM-DD[(T| )HH:MM[:SS[.fff]]][Z|±HH[:MM]]，无时区按 UTC
+inline std::optional<int64_t> parse_iso8601_ms(std::string_view s) {
+  size_t i = 0;
+  auto num = [&](size_t n, int& out) {
+    if (i + n > s.size()) return false;
+    int v = 0;
+    for (size_t k = 0; k < n; ++k) {
+      char c = s[i + k];
+      if (c < '0' || c > '9') return false;
+      v = v * 10 + (c - '0');
+    }
+    out = v;
+    i += n;
+    return true;
+  };
+  auto lit = [&](char c) {
+    if (i < s.size() && s[i] == c) { ++i; return true; }
+    return false;
+  };
+  int y, mo, d, h = 0, mi = 0, sec = 0, ms = 0;
+  if (!num(4, y) || !lit('-') || !num(2, mo) || !lit('-') || !num(2, d)) return std::nullopt;
+  if (mo < 1 || mo > 12 || d < 1 || d > 31) return std::nullopt;
+  if (i < s.size() && (s[i] == 'T' || s[i] == 't' || s[i] == ' ')) {
+    ++i;
+    if (!num(2, h) || !lit(':') || !num(2, mi)) return std::nullopt;
+    if (lit(':') && !num(2, sec)) return std::nullopt;
+    if (lit('.') || lit(',')) {
+      int scale = 100, digits = 0;
+      while (i < s.size() && s[i] >= '0' && s[i] <= '9') {
+        if (digits++ < 3) { ms += (s[i] - '0') * scale; scale /= 10; }
+        ++i;
+      }
+      if (digits == 0) return std::nullopt;
+    }
+  }
+  int64_t offset_min = 0;
+  if (i < s.size()) {
+    if (s[i] == 'Z' || s[i] == 'z') {
+      ++i;
+    } else if (s[i] == '+' || s[i] == '-') {
+      int sign = s[i++] == '-' ? -1 : 1, oh, om = 0;
+      if (!num(2, oh)) return std::nullopt;
+      if (lit(':')) { if (!num(2, om)) return std::nullopt; }
+      else if (i < s.size() && !num(2, om)) return std::nullopt;
+      offset_min = sign * (oh * 60 + om);
+    }
+  }
+  if (i != s.size() || h > 23 || mi > 59 || sec > 60) return std::nullopt;
+  int64_t days = days_from_civil(y, static_cast<unsigned>(mo), static_cast<unsigned>(d));
+  int64_t secs = days * 86400 + h * 3600 + mi * 60 + sec - offset_min * 60;
+  return secs * 1000 + ms;
+}
+
+}
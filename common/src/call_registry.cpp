@@ -0,0 +1,259 @@
+#include "common/call_registry.hpp"
+#include <algorithm>
+#include <spdlog/spdlog.h>
+#include "common/time.hpp"
+
+namespace hs {
+
+namespace {
+
+constexpr size_t kInitialSlots = 256;
+
+// 参与方顺序与 Slot::parties 一致
+constexpr std::string_view kPrefix[] = {"account:", "trunk:", "trunk:", "vendor:"};
+
+}
+
+CallRegistry::CallRegistry(Options opt) : opt_(std::move(opt)) {
+  for (auto& s : shards_) s.slots.resize(kInitialSlots);
+  auto& reg = metrics::registry();
+  publish_rtt_ = &RedisClient::rtt("calls_publish");
+  reg.gauge_fn(this, "hs_calls_live", "Calls currently registered on this node", [this] { return static_cast<double>(size()); });
+  reg.counter_fn(this, "hs_calls_opened_total", "Calls registered", metrics::load(stats_.opened));
+  reg.counter_fn(this, "hs_calls_closed_total", "Calls closed normally", metrics::load(stats_.closed));
+  reg.counter_fn(this, "hs_calls_expired_total", "Calls reclaimed by TTL", metrics::load(stats_.expired));
+  reg.counter_fn(this, "hs_calls_unknown_close_total", "Close requests for unknown calls", metrics::load(stats_.unknown_close));
+  reg.counter_fn(this, "hs_calls_publish_errors_total", "Failed publishes of live call counts", metrics::load(stats_.publish_errors));
+}
+
+CallRegistry::~CallRegistry() {
+  metrics::registry().remove(this);
+  stop();
+}
+
+void CallRegistry::start(hs::RedisClient* redis) {
+  redis_ = redis;
+  thread_ = std::jthread([this](std::stop_token st) { run(st); });
+}
+
+void CallRegistry::stop() {
+  if (thread_.joinable()) {
+    thread_.request_stop();
+    run_cv_.notify_all();
+    thread_.join();
+  }
+}
+
+uint64_t CallRegistry::hash(std::string_view call_id) {
+  // splitmix64 终混：高 6 位选分片，低位选槽位，两者都需均匀
+  uint64_t h = std::hash<std::string_view>{}(call_id);
+  h ^= h >> 30;
+  h *= 0xbf58476d1ce4e5b9ULL;
+  h ^= h >> 27;
+  h *= 0x94d049bb133111ebULL;
+  h ^= h >> 31;
+  return h ? h : 1;
+}
+
+size_t CallRegistry::probe(const Shard& s, uint64_t h) {
+  size_t mask = s.slots.size() - 1;
+  size_t i = h & mask;
+  while (s.slots[i].hash != 0 && s.slots[i].hash != h) i = (i + 1) & mask;
+  return i;
+}
+
+void CallRegistry::grow(Shard& s) {
+  std::vector<Slot> old(s.slots.size() * 2);
+  old.swap(s.slots);
+  for (const auto& slot : old)
+    if (slot.hash) s.slots[probe(s, slot.hash)] = slot;
+}
+
+void CallRegistry::erase(Shard& s, size_t i) {
+  // 删除后把同一探测链上的后续元素前移，不留墓碑
+  size_t mask = s.slots.size() - 1;
+  size_t j = i;
+  for (;;) {
+    j = (j + 1) & mask;
+    if (s.slots[j].hash == 0) break;
+    size_t home = s.slots[j].hash & mask;
+    bool movable = i <= j ? (home <= i || home > j) : (home <= i && home > j);
+    if (movable) {
+      s.slots[i] = s.slots[j];
+      i = j;
+    }
+  }
+  s.slots[i] = Slot{};
+  --s.used;
+}
+
+uint32_t CallRegistry::intern(std::string_view prefix, std::string_view name) {
+  thread_local std::string key;
+  key.assign(prefix).append(name);
+  {
+    std::shared_lock<std::shared_mutex> lk(ent_mu_);
+    auto it = entity_ids_.find(key);
+    if (it != entity_ids_.end()) return it->second;
+  }
+  std::unique_lock<std::shared_mutex> lk(ent_mu_);
+  auto it = entity_ids_.find(key);
+  if (it != entity_ids_.end()) return it->second;
+  size_t n = entity_ids_.size();
+  if (n >= kChunk * kMaxChunks) {
+    if (n == kChunk * kMaxChunks) spdlog::warn("Call registry: too many parties, '{}' not tracked", key);
+    return 0;
+  }
+  if (n % kChunk == 0) chunks_[n / kChunk] = std::make_unique<Entity[]>(kChunk);
+  chunks_[n / kChunk][n % kChunk].key = key;
+  auto id = static_cast<uint32_t>(n + 1);
+  entity_ids_.emplace(key, id);
+  return id;
+}
+
+void CallRegistry::adjust(const Slot& s, int32_t delta) {
+  for (uint32_t id : s.parties)
+    if (id) entity(id).live.fetch_add(delta, std::memory_order_relaxed);
+}
+
+void CallRegistry::open(std::string_view call_id, const Parties& p, std::chrono::seconds ttl) {
+  const std::string_view names[kRoles] = {p.account, p.ingress_trunk, p.egress_trunk, p.vendor};
+  std::array<uint32_t, kRoles> ids{};
+  for (size_t r = 0; r < kRoles; ++r)
+    if (!names[r].empty()) ids[r] = intern(kPrefix[r], names[r]);
+  int64_t expire_ms = hs::now_epoch_ms() + std::chrono::duration_cast<std::chrono::milliseconds>(ttl).count();
+
+  uint64_t h = hash(call_id);
+  auto& s = shard(h);
+  std::lock_guard<std::mutex> lk(s.mu);
+  if ((s.used + 1) * 4 > s.slots.size() * 3) grow(s);
+  Slot& slot = s.slots[probe(s, h)];
+  if (slot.hash == 0) {
+    slot.hash = h;
+    ++s.used;
+    stats_.opened.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    stats_.updated.fetch_add(1, std::memory_order_relaxed);
+  }
+  for (size_t r = 0; r < kRoles; ++r) {
+    if (!ids[r] || ids[r] == slot.parties[r]) continue;
+    if (slot.parties[r]) entity(slot.parties[r]).live.fetch_sub(1, std::memory_order_relaxed);
+    entity(ids[r]).live.fetch_add(1, std::memory_order_relaxed);
+    slot.parties[r] = ids[r];
+  }
+  // 事件可能乱序（如 answer 先于 start 到达），到期时刻只延后不提前
+  slot.expire_ms = std::max(slot.expire_ms, expire_ms);
+}
+
+bool CallRegistry::close(std::string_view call_id) {
+  uint64_t h = hash(call_id);
+  auto& s = shard(h);
+  std::lock_guard<std::mutex> lk(s.mu);
+  size_t i = probe(s, h);
+  if (s.slots[i].hash == 0) {
+    stats_.unknown_close.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  adjust(s.slots[i], -1);
+  erase(s, i);
+  stats_.closed.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+size_t CallRegistry::expire(int64_t now_ms) {
+  size_t n = 0;
+  for (auto& s : shards_) {
+    std::lock_guard<std::mutex> lk(s.mu);
+    // 删除会把后续元素前移到当前位置，因此删除后不前进
+    for (size_t i = 0; i < s.slots.size();) {
+      const Slot& slot = s.slots[i];
+      if (slot.hash == 0 || slot.expire_ms > now_ms) { ++i; continue; }
+      adjust(slot, -1);
+      erase(s, i);
+      ++n;
+    }
+  }
+  stats_.expired.fetch_add(n, std::memory_order_relaxed);
+  return n;
+}
+
+std::optional<CallRegistry::CallView> CallRegistry::find(std::string_view call_id) const {
+  uint64_t h = hash(call_id);
+  const auto& s = shard(h);
+  std::lock_guard<std::mutex> lk(s.mu);
+  const Slot& slot = s.slots[probe(s, h)];
+  if (slot.hash == 0) return std::nullopt;
+  CallView v;
+  std::string* out[kRoles] = {&v.account, &v.ingress_trunk, &v.egress_trunk, &v.vendor};
+  for (size_t r = 0; r < kRoles; ++r)
+    if (slot.parties[r]) *out[r] = entity(slot.parties[r]).key.substr(kPrefix[r].size());
+  v.expire_ms = slot.expire_ms;
+  return v;
+}
+
+int32_t CallRegistry::live(std::string_view key) const {
+  std::shared_lock<std::shared_mutex> lk(ent_mu_);
+  auto it = entity_ids_.find(key);
+  return it == entity_ids_.end() ? 0 : entity(it->second).live.load(std::memory_order_relaxed);
+}
+
+std::vector<std::pair<std::string, int32_t>> CallRegistry::counts() const {
+  std::shared_lock<std::shared_mutex> lk(ent_mu_);
+  std::vector<std::pair<std::string, int32_t>> out;
+  out.reserve(entity_ids_.size());
+  for (const auto& [key, id] : entity_ids_) out.emplace_back(key, entity(id).live.load(std::memory_order_relaxed));
+  return out;
+}
+
+size_t CallRegistry::size() const {
+  size_t n = 0;
+  for (const auto& s : shards_) {
+    std::lock_guard<std::mutex> lk(s.mu);
+    n += s.used;
+  }
+  return n;
+}
+
+void CallRegistry::publish() {
+  auto now_ms = hs::now_epoch_ms();
+  std::vector<std::pair<std::string, std::string>> fields;
+  for (auto& [key, n] : counts()) fields.emplace_back(std::move(key), std::to_string(n));
+  fields.emplace_back("_ts", std::to_string(now_ms));
+  // 节点停止发布后哈希自动过期，读取端同时按 _ts 判断新鲜度
+  auto ttl = std::max(std::chrono::milliseconds(10000), opt_.publish_interval * 5);
+  auto key = "calls:live:" + opt_.source;
+  auto pipe = redis_->get().pipeline(false);
+  pipe.hset(key, fields.begin(), fields.end());
+  pipe.pexpire(key, ttl);
+  pipe.sadd("calls:live:sources", opt_.source);
+  metrics::Timer t(*publish_rtt_);
+  pipe.exec();
+}
+
+void CallRegistry::run(std::stop_token st) {
+  auto next_report = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+  while (!st.stop_requested()) {
+    {
+      std::unique_lock<std::mutex> lk(run_mu_);
+      run_cv_.wait_for(lk, st, opt_.publish_interval, [] { return false; });
+    }
+    if (st.stop_requested()) break;
+    expire(hs::now_epoch_ms());
+    if (redis_) {
+      try {
+        publish();
+        stats_.publishes.fetch_add(1, std::memory_order_relaxed);
+      } catch (const std::exception& ex) {
+        if (stats_.publish_errors.fetch_add(1, std::memory_order_relaxed) % 60 == 0)
+          spdlog::warn("Call registry publish failed: {}", ex.what());
+      }
+    }
+    if (std::chrono::steady_clock::now() >= next_report) {
+      next_report = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+      spdlog::info("Call registry {}: live={} opened={} updated={} closed={} unknown_close={} expired={} publish_errors={}",
+                   opt_.source, size(), stats_.opened.load(), stats_.updated.load(), stats_.closed.load(),
+                   stats_.unknown_close.load(), stats_.expired.load(), stats_.publish_errors.load());
+    }
+  }
+}
+
+}
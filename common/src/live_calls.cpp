@@ -0,0 +1,117 @@
+#include "common/live_calls.hpp"
+#include <algorithm>
+#include <charconv>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <spdlog/spdlog.h>
+#include "common/time.hpp"
+
+namespace hs {
+
+LiveCalls::LiveCalls(hs::RedisClient* redis, Options opt) : redis_(redis), opt_(opt) {
+  auto& reg = metrics::registry();
+  refresh_rtt_ = &RedisClient::rtt("live_calls_refresh");
+  reg.counter_fn(this, "hs_live_calls_refresh_errors_total", "Failed refreshes of cluster live call counts",
+                 metrics::load(stats_.refresh_errors));
+  reg.gauge_fn(this, "hs_live_calls_sources", "Live call sources read in the last refresh", metrics::load(stats_.sources));
+  reg.gauge_fn(this, "hs_live_calls_stale_sources", "Sources ignored as stale in the last refresh", metrics::load(stats_.stale_sources));
+  reg.gauge_fn(this, "hs_live_calls_keys", "Accounts, trunks and vendors with live calls", metrics::load(stats_.keys));
+}
+
+LiveCalls::~LiveCalls() {
+  metrics::registry().remove(this);
+  stop();
+}
+
+void LiveCalls::start() {
+  refresh();
+  thread_ = std::jthread([this](std::stop_token st) { run(st); });
+}
+
+void LiveCalls::stop() {
+  if (thread_.joinable()) {
+    thread_.request_stop();
+    run_cv_.notify_all();
+    thread_.join();
+  }
+}
+
+int32_t LiveCalls::live(std::string_view key) const {
+  const Table* t = table_.read();
+  if (!t || hs::now_epoch_ms() - t->loaded_ms > opt_.max_stale.count()) return 0;
+  auto it = t->live.find(key);
+  return it == t->live.end() ? 0 : it->second;
+}
+
+int32_t LiveCalls::live(std::string_view prefix, std::string_view name) const {
+  thread_local std::string key;
+  key.assign(prefix).append(name);
+  return live(key);
+}
+
+void LiveCalls::refresh() {
+  try {
+    auto& r = redis_->get();
+    std::vector<std::string> sources;
+    r.smembers("calls:live:sources", std::back_inserter(sources));
+    auto next = std::make_shared<Table>();
+    int64_t now_ms = hs::now_epoch_ms();
+    uint64_t stale = 0;
+    if (!sources.empty()) {
+      auto pipe = r.pipeline(false);
+      for (const auto& s : sources) pipe.hgetall("calls:live:" + s);
+      auto t0 = std::chrono::steady_clock::now();
+      auto replies = pipe.exec();
+      refresh_rtt_->record(std::chrono::steady_clock::now() - t0);
+      // 服务 → 键 → 各节点之和
+      std::unordered_map<std::string, hs::StringMap<int32_t>> by_service;
+      std::vector<std::string> gone;
+      for (size_t i = 0; i < sources.size(); ++i) {
+        std::unordered_map<std::string, std::string> fields;
+        replies.get(i, std::inserter(fields, fields.end()));
+        if (fields.empty()) { gone.push_back(sources[i]); continue; }
+        int64_t ts = 0;
+        if (auto it = fields.find("_ts"); it != fields.end())
+          std::from_chars(it->second.data(), it->second.data() + it->second.size(), ts);
+        if (now_ms - ts > opt_.max_stale.count()) { ++stale; continue; }
+        auto& acc = by_service[sources[i].substr(0, sources[i].find(':'))];
+        for (const auto& [k, v] : fields) {
+          int32_t n = 0;
+          if (k == "_ts" || std::from_chars(v.data(), v.data() + v.size(), n).ec != std::errc()) continue;
+          acc[k] += n;
+        }
+      }
+      for (const auto& [svc, acc] : by_service)
+        for (const auto& [k, n] : acc) {
+          auto& cur = next->live[k];
+          cur = std::max(cur, n);
+        }
+      // 哈希已过期的来源从集合中移除
+      if (!gone.empty()) r.srem("calls:live:sources", gone.begin(), gone.end());
+    }
+    next->loaded_ms = now_ms;
+    stats_.sources.store(sources.size(), std::memory_order_relaxed);
+    stats_.stale_sources.store(stale, std::memory_order_relaxed);
+    stats_.keys.store(next->live.size(), std::memory_order_relaxed);
+    table_.store(std::move(next));
+    stats_.refreshes.fetch_add(1, std::memory_order_relaxed);
+  } catch (const std::exception& ex) {
+    if (stats_.refresh_errors.fetch_add(1, std::memory_order_relaxed) % 60 == 0)
+      spdlog::warn("Live call refresh failed: {}", ex.what());
+  }
+}
+
+void LiveCalls::run(std::stop_token st) {
+  while (!st.stop_requested()) {
+    {
+      std::unique_lock<std::mutex> lk(run_mu_);
+      run_cv_.wait_for(lk, st, opt_.refresh_interval, [] { return false; });
+    }
+    if (st.stop_requested()) break;
+    refresh();
+  }
+}
+
+}
@@ -0,0 +1,252 @@
+#include "common/metrics.hpp"
+#include <httplib.h>
+#include <algorithm>
+#include <stdexcept>
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+namespace hs::metrics {
+
+// ---- 线程计数单元 ----
+
+namespace detail {
+
+namespace {
+
+struct Blocks {
+  std::mutex mu;
+  std::vector<std::unique_ptr<Block>> all;  // 只增，导出时遍历
+  std::vector<Block*> free;                 // 已退出线程留下的块
+  std::atomic<size_t> next{0};
+};
+
+Blocks& blocks() {
+  static Blocks* b = new Blocks();  // 不析构：线程可能晚于静态对象析构退出
+  return *b;
+}
+
+}
+
+std::atomic<uint64_t>* Block::grow(size_t chunk) {
+  if (chunk >= kMaxChunks) throw std::length_error("metrics cell space exhausted");
+  auto* c = new std::atomic<uint64_t>[kChunkCells]();
+  chunks[chunk].store(c, std::memory_order_release);
+  return c;
+}
+
+Block* acquire_block() {
+  auto& b = blocks();
+  std::lock_guard<std::mutex> lk(b.mu);
+  if (!b.free.empty()) {
+    Block* blk = b.free.back();
+    b.free.pop_back();
+    return blk;
+  }
+  return b.all.emplace_back(std::make_unique<Block>()).get();
+}
+
+void release_block(Block* blk) {
+  auto& b = blocks();
+  std::lock_guard<std::mutex> lk(b.mu);
+  b.free.push_back(blk);
+}
+
+size_t allocate(size_t n) {
+  size_t base = blocks().next.fetch_add(n, std::memory_order_relaxed);
+  if (base + n > kMaxChunks * kChunkCells) throw std::length_error("metrics cell space exhausted");
+  return base;
+}
+
+void sum(size_t base, size_t n, uint64_t* out) {
+  auto& b = blocks();
+  std::lock_guard<std::mutex> lk(b.mu);
+  for (const auto& blk : b.all)
+    for (size_t i = 0; i < n; ++i) {
+      size_t idx = base + i;
+      const auto* c = blk->chunks[idx / kChunkCells].load(std::memory_order_acquire);
+      if (c) out[i] += c[idx % kChunkCells].load(std::memory_order_relaxed);
+    }
+}
+
+}
+
+uint64_t Counter::value() const {
+  uint64_t n = 0;
+  detail::sum(base_, 1, &n);
+  return n;
+}
+
+Histogram::Snapshot Histogram::snapshot() const {
+  Snapshot out;
+  std::array<uint64_t, kBuckets + 1> cells{};
+  detail::sum(base_, cells.size(), cells.data());
+  std::copy_n(cells.begin(), kBuckets, out.counts.begin());
+  out.sum_ns = cells[kBuckets];
+  for (auto c : out.counts) out.count += c;
+  return out;
+}
+
+uint64_t Histogram::Snapshot::quantile_ns(double q) const {
+  if (count == 0) return 0;
+  auto rank = static_cast<uint64_t>(q * static_cast<double>(count - 1)) + 1;
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kFinite; ++i) {
+    seen += counts[i];
+    if (seen >= rank) return upper_ns(i);
+  }
+  return uint64_t{1} << kMaxExp;
+}
+
+// ---- Registry ----
+
+static void escape(std::string& out, std::string_view v) {
+  for (char c : v) {
+    if (c == '\\' || c == '"') { out += '\\'; out += c; }
+    else if (c == '\n') out += "\\n";
+    else out += c;
+  }
+}
+
+static std::string format_labels(const Labels& labels) {
+  std::string out;
+  for (const auto& [k, v] : labels) {
+    if (!out.empty()) out += ',';
+    out += k;
+    out += "=\"";
+    escape(out, v);
+    out += '"';
+  }
+  return out;
+}
+
+Registry::Series& Registry::series(std::string_view name, std::string_view help, Type type, const Labels& labels) {
+  auto it = families_.find(name);
+  if (it == families_.end()) it = families_.emplace(std::string(name), Family{type, std::string(help), {}}).first;
+  if (it->second.type != type) throw std::logic_error("metric " + std::string(name) + " registered with another type");
+  std::string key = format_labels(labels);
+  for (auto& s : it->second.series)
+    if (s->labels == key) return *s;
+  auto& s = it->second.series.emplace_back(std::make_unique<Series>());
+  s->labels = std::move(key);
+  return *s;
+}
+
+Counter& Registry::counter(std::string_view name, std::string_view help, const Labels& labels) {
+  std::lock_guard<std::mutex> lk(mu_);
+  auto& s = series(name, help, Type::Counter, labels);
+  if (!s.counter) s.counter = std::make_unique<Counter>();
+  return *s.counter;
+}
+
+Gauge& Registry::gauge(std::string_view name, std::string_view help, const Labels& labels) {
+  std::lock_guard<std::mutex> lk(mu_);
+  auto& s = series(name, help, Type::Gauge, labels);
+  if (!s.gauge) s.gauge = std::make_unique<Gauge>();
+  return *s.gauge;
+}
+
+Histogram& Registry::histogram(std::string_view name, std::string_view help, const Labels& labels) {
+  std::lock_guard<std::mutex> lk(mu_);
+  auto& s = series(name, help, Type::Histogram, labels);
+  if (!s.histogram) s.histogram = std::make_unique<Histogram>();
+  return *s.histogram;
+}
+
+void Registry::counter_fn(const void* owner, std::string_view name, std::string_view help, std::function<double()> fn,
+                          const Labels& labels) {
+  std::lock_guard<std::mutex> lk(mu_);
+  auto& s = series(name, help, Type::Counter, labels);
+  s.fn = std::move(fn);
+  s.owner = owner;
+}
+
+void Registry::gauge_fn(const void* owner, std::string_view name, std::string_view help, std::function<double()> fn,
+                        const Labels& labels) {
+  std::lock_guard<std::mutex> lk(mu_);
+  auto& s = series(name, help, Type::Gauge, labels);
+  s.fn = std::move(fn);
+  s.owner = owner;
+}
+
+void Registry::remove(const void* owner) {
+  std::lock_guard<std::mutex> lk(mu_);
+  for (auto& [name, f] : families_)
+    std::erase_if(f.series, [owner](const auto& s) { return s->fn && s->owner == owner; });
+}
+
+static void sample(std::string& out, std::string_view name, std::string_view suffix, std::string_view labels,
+                   std::string_view extra, double v) {
+  out += name;
+  out += suffix;
+  if (!labels.empty() || !extra.empty()) {
+    out += '{';
+    out += labels;
+    if (!labels.empty() && !extra.empty()) out += ',';
+    out += extra;
+    out += '}';
+  }
+  fmt::format_to(std::back_inserter(out), " {}\n", v);
+}
+
+std::string Registry::expose() const {
+  std::string out;
+  out.reserve(64 * 1024);
+  std::lock_guard<std::mutex> lk(mu_);
+  for (const auto& [name, f] : families_) {
+    if (f.series.empty()) continue;
+    static constexpr const char* kTypes[] = {"counter", "gauge", "histogram"};
+    fmt::format_to(std::back_inserter(out), "# HELP {} {}\n# TYPE {} {}\n", name, f.help, name, kTypes[static_cast<int>(f.type)]);
+    for (const auto& s : f.series) {
+      if (s->fn) sample(out, name, "", s->labels, "", s->fn());
+      else if (s->counter) sample(out, name, "", s->labels, "", static_cast<double>(s->counter->value()));
+      else if (s->gauge) sample(out, name, "", s->labels, "", static_cast<double>(s->gauge->value()));
+      else if (s->histogram) {
+        // 导出时每个 2 的幂区间合并为两个桶，控制序列数
+        auto snap = s->histogram->snapshot();
+        uint64_t cum = 0;
+        for (size_t i = 0; i < Histogram::kFinite; ++i) {
+          cum += snap.counts[i];
+          if (i != 0 && ((i - 1) & 1) == 0) continue;
+          sample(out, name, "_bucket", s->labels, fmt::format("le=\"{}\"", static_cast<double>(Histogram::upper_ns(i)) / 1e9),
+                 static_cast<double>(cum));
+        }
+        sample(out, name, "_bucket", s->labels, "le=\"+Inf\"", static_cast<double>(snap.count));
+        sample(out, name, "_sum", s->labels, "", static_cast<double>(snap.sum_ns) / 1e9);
+        sample(out, name, "_count", s->labels, "", static_cast<double>(snap.count));
+      }
+    }
+  }
+  return out;
+}
+
+Registry& registry() {
+  static Registry* r = new Registry();  // 不析构：静态对象析构期间仍可能有线程在记录
+  return *r;
+}
+
+// ---- Exporter ----
+
+Exporter::Exporter(const std::string& bind, Registry& reg) {
+  if (bind.empty() || bind == "off") return;
+  auto pos = bind.rfind(':');
+  if (pos == std::string::npos) throw std::invalid_argument("METRICS_BIND must be host:port: " + bind);
+  std::string host = bind.substr(0, pos);
+  int port = std::stoi(bind.substr(pos + 1));
+
+  svr_ = std::make_unique<httplib::Server>();
+  svr_->Get("/metrics", [&reg](const httplib::Request&, httplib::Response& res) {
+    res.set_content(reg.expose(), "text/plain; version=0.0.4");
+  });
+  // 端口占用在启动时暴露
+  if (!svr_->bind_to_port(host, port)) throw std::runtime_error("failed to bind metrics endpoint " + bind);
+  thread_ = std::thread([this] { svr_->listen_after_bind(); });
+  spdlog::info("Metrics endpoint on {}/metrics", bind);
+}
+
+Exporter::~Exporter() {
+  if (!svr_) return;
+  svr_->stop();
+  if (thread_.joinable()) thread_.join();
+}
+
+}
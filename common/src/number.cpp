@@ -0,0 +1,158 @@
+#include "common/number.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace hs::number {
+
+static_assert(E164::kCapacity % 16 == 0 && E164::kCapacity <= 32 && kMaxDigits < E164::kCapacity);
+
+namespace {
+
+const DialPlan kDefaultPlan;
+
+// p 为小写
+bool iprefix(std::string_view s, std::string_view p) {
+  if (s.size() < p.size()) return false;
+  for (size_t i = 0; i < p.size(); ++i)
+    if (static_cast<char>(s[i] | 0x20) != p[i]) return false;
+  return true;
+}
+
+// 用户部分中的字符分类
+enum : uint8_t { kCopy, kSkip, kEnd };
+constexpr auto kClass = [] {
+  std::array<uint8_t, 256> t{};
+  for (unsigned char c : std::string_view("-.() \t")) t[c] = kSkip;  // 视觉分隔符
+  for (unsigned char c : std::string_view("@;?>")) t[c] = kEnd;      // 主机、参数、头域或 name-addr 结束
+  return t;
+}();
+
+// URI 去掉 name-addr 的尖括号外部分与 scheme；裸号码原样返回。sip 标记 sip:/sips:
+std::string_view strip_scheme(std::string_view s, bool& sip) {
+  if (auto lt = s.find('<'); lt != std::string_view::npos) s.remove_prefix(lt + 1);
+  while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+  sip = iprefix(s, "sip:") || iprefix(s, "sips:");
+  if (iprefix(s, "sip:") || iprefix(s, "tel:")) s.remove_prefix(4);
+  else if (iprefix(s, "sips:")) s.remove_prefix(5);
+  return s;
+}
+
+// SIP URI 的用户部分必须以 '@' 结束，用户参数（如 ;npdi）之后也是；i 为用户部分结束的位置
+bool has_user(std::string_view user, size_t i) {
+  size_t at = user.find('@', i);
+  return at != std::string_view::npos && at < user.find('>', i);
+}
+
+// 前 size 个字节全部为 '0'..'9'；缓冲按 16 字节对齐、整块比较
+bool all_digits(const E164& e) {
+#if defined(__SSE2__)
+  // 无符号比较 c - '0' <= 9：翻转符号位后用有符号比较
+  const __m128i zero = _mm_set1_epi8('0');
+  const __m128i flip = _mm_set1_epi8(static_cast<char>(0x80));
+  const __m128i limit = _mm_set1_epi8(static_cast<char>(0x80 + 10));
+  uint32_t mask = 0;
+  for (size_t i = 0; i < E164::kCapacity; i += 16) {
+    __m128i v = _mm_load_si128(reinterpret_cast<const __m128i*>(e.digits + i));
+    __m128i t = _mm_xor_si128(_mm_sub_epi8(v, zero), flip);
+    mask |= static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmplt_epi8(t, limit))) << i;
+  }
+  uint32_t want = (uint32_t{1} << e.size) - 1;
+  return (mask & want) == want;
+#else
+  for (size_t i = 0; i < e.size; ++i)
+    if (static_cast<unsigned char>(e.digits[i] - '0') > 9) return false;
+  return true;
+#endif
+}
+
+}
+
+const char* status_name(Status s) {
+  switch (s) {
+    case Status::Ok: return "ok";
+    case Status::Empty: return "empty";
+    case Status::BadChar: return "bad_char";
+    case Status::TooLong: return "too_long";
+    case Status::Invalid: return "invalid";
+  }
+  return "";
+}
+
+void DialPlan::finalize() {
+  std::stable_sort(rewrites.begin(), rewrites.end(),
+                   [](const Rewrite& a, const Rewrite& b) { return a.match.size() > b.match.size(); });
+}
+
+std::string_view user_part(std::string_view uri) {
+  bool sip;
+  std::string_view user = strip_scheme(uri, sip);
+  size_t end = user.find_first_of("@;?>");
+  if (sip && !has_user(user, end == std::string_view::npos ? user.size() : end)) return {};
+  return user.substr(0, end);
+}
+
+Status normalize(std::string_view in, E164& out, const DialPlan* plan) {
+  if (!plan) plan = &kDefaultPlan;
+  out.size = 0;
+  bool sip;
+  std::string_view user = strip_scheme(in, sip);
+
+  // 单趟复制用户部分，跳过分隔符，遇到主机或参数结束
+  char* d = out.digits;
+  size_t n = 0, i = 0;
+  if (iprefix(user, "%2b")) {
+    d[n++] = '+';
+    i = 3;
+  }
+  for (; i < user.size(); ++i) {
+    uint8_t c = kClass[static_cast<unsigned char>(user[i])];
+    if (c == kEnd) break;
+    if (c == kSkip) continue;
+    if (n == E164::kCapacity) return Status::TooLong;
+    d[n++] = user[i];
+  }
+  // 没有 '@' 的 SIP URI 只有主机（如 sip:10.0.0.1），不是号码
+  if (sip && !has_user(user, i)) return Status::Invalid;
+
+  // 中继改写：规则已按 match 长度降序，第一条命中即最长
+  for (const auto& r : plan->rewrites) {
+    if (!std::string_view(d, n).starts_with(r.match)) continue;
+    size_t strip = std::min<size_t>(r.strip, n);
+    if (n - strip + r.prepend.size() > E164::kCapacity) return Status::TooLong;
+    std::memmove(d + r.prepend.size(), d + strip, n - strip);
+    std::memcpy(d, r.prepend.data(), r.prepend.size());
+    n = n - strip + r.prepend.size();
+    break;
+  }
+
+  // 冠字：'+' 与国际冠字直接剥离，国内冠字替换为国家码
+  std::string_view s(d, n), cc;
+  size_t skip = 0;
+  if (s.starts_with('+')) {
+    skip = 1;
+  } else if (!plan->intl_prefix.empty() && s.starts_with(plan->intl_prefix)) {
+    skip = plan->intl_prefix.size();
+  } else if (!plan->national_prefix.empty() && !plan->country_code.empty() && s.starts_with(plan->national_prefix)) {
+    skip = plan->national_prefix.size();
+    cc = plan->country_code;
+  }
+  if (n - skip + cc.size() > E164::kCapacity) return Status::TooLong;
+  if (skip != cc.size()) std::memmove(d + cc.size(), d + skip, n - skip);
+  if (!cc.empty()) std::memcpy(d, cc.data(), cc.size());
+  n = n - skip + cc.size();
+
+  if (n == 0) return Status::Empty;
+  if (n > kMaxDigits) return Status::TooLong;
+  out.size = static_cast<uint8_t>(n);
+  if (!all_digits(out)) {
+    out.size = 0;
+    return Status::BadChar;
+  }
+  return Status::Ok;
+}
+
+}
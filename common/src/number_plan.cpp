@@ -0,0 +1,258 @@
+#include "common/number_plan.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <spdlog/spdlog.h>
+#include "common/crc32c.hpp"
+
+namespace hs {
+
+static_assert(sizeof(NumberPlan::Header) == 40);
+static_assert(sizeof(NumberPlan::Node) == 12);
+static_assert(sizeof(NumberPlan::Entry) == 8);
+static_assert(sizeof(NumberPlan::Region) == 8);
+
+namespace {
+
+constexpr const char* kTypeNames[] = {"fixed_line", "mobile", "pager", "toll_free", "premium_rate", "shared_cost",
+                                      "personal_number", "voip", "uan", "voicemail"};
+static_assert(std::size(kTypeNames) == static_cast<size_t>(NumberType::kCount));
+
+constexpr uint32_t kNone = 0xffffffffu;
+
+std::string_view fixed_str(const char (&s)[4]) {
+  return {s, static_cast<size_t>(std::find(s, s + 4, '\0') - s)};
+}
+
+}
+
+const char* number_type_name(NumberType t) {
+  auto i = static_cast<size_t>(t);
+  return i < std::size(kTypeNames) ? kTypeNames[i] : "";
+}
+
+const char* number_types_name(uint16_t types) {
+  constexpr uint16_t fixed_mobile = (1u << static_cast<int>(NumberType::FixedLine)) | (1u << static_cast<int>(NumberType::Mobile));
+  if ((types & fixed_mobile) == fixed_mobile) return "fixed_line_or_mobile";
+  if (types == 0) return "";
+  return number_type_name(static_cast<NumberType>(std::countr_zero(types)));
+}
+
+// ---- NumberPlan ----
+
+std::shared_ptr<const NumberPlan> NumberPlan::open(const std::string& path) {
+  auto t0 = std::chrono::steady_clock::now();
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) throw std::runtime_error("cannot open number plan " + path + ": " + std::strerror(errno));
+  struct stat st {};
+  if (::fstat(fd, &st) != 0) {
+    int err = errno;
+    ::close(fd);
+    throw std::runtime_error("cannot stat number plan " + path + ": " + std::strerror(err));
+  }
+  std::shared_ptr<NumberPlan> p(new NumberPlan());
+  p->size_ = static_cast<size_t>(st.st_size);
+  if (p->size_ < sizeof(Header)) {
+    ::close(fd);
+    throw std::runtime_error("number plan " + path + " is truncated");
+  }
+  // 预读全部页面，查找路径上不再缺页
+  void* m = ::mmap(nullptr, p->size_, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+  int err = errno;
+  ::close(fd);
+  if (m == MAP_FAILED) throw std::runtime_error("cannot map number plan " + path + ": " + std::strerror(err));
+  p->map_ = m;
+
+  auto base = static_cast<const char*>(m);
+  p->header_ = reinterpret_cast<const Header*>(base);
+  const Header& h = *p->header_;
+  if (std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0) throw std::runtime_error("number plan " + path + ": bad magic");
+  if (h.version != kVersion)
+    throw std::runtime_error("number plan " + path + ": version " + std::to_string(h.version) + ", expected " +
+                             std::to_string(kVersion));
+  size_t expect = sizeof(Header) + size_t{h.node_count} * sizeof(Node) + size_t{h.entry_count} * sizeof(Entry) +
+                  size_t{h.region_count} * sizeof(Region);
+  if (h.node_count == 0 || expect != p->size_) throw std::runtime_error("number plan " + path + ": size mismatch");
+  if (crc32c(base + sizeof(Header), p->size_ - sizeof(Header)) != h.crc)
+    throw std::runtime_error("number plan " + path + ": checksum mismatch");
+  p->nodes_ = reinterpret_cast<const Node*>(base + sizeof(Header));
+  p->entries_ = reinterpret_cast<const Entry*>(p->nodes_ + h.node_count);
+  p->regions_ = reinterpret_cast<const Region*>(p->entries_ + h.entry_count);
+
+  // 下标在加载时校验一次，查找时不再检查
+  for (uint32_t i = 0; i < h.node_count; ++i) {
+    const Node& n = p->nodes_[i];
+    if ((n.child_mask >> 10) != 0 || (n.child_mask && size_t{n.first_child} + std::popcount(n.child_mask) > h.node_count) ||
+        size_t{n.first_entry} + n.entry_count > h.entry_count)
+      throw std::runtime_error("number plan " + path + ": corrupt node " + std::to_string(i));
+  }
+  for (uint32_t i = 0; i < h.entry_count; ++i)
+    if (p->entries_[i].region >= h.region_count || p->entries_[i].type >= static_cast<uint8_t>(NumberType::kCount))
+      throw std::runtime_error("number plan " + path + ": corrupt entry " + std::to_string(i));
+
+  spdlog::info("Number plan {} loaded in {:.1f}ms: {} regions, {} prefixes, {} nodes, built at {}", path,
+               std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count(), h.region_count,
+               h.entry_count, h.node_count, h.built_at);
+  return p;
+}
+
+NumberPlan::~NumberPlan() {
+  if (map_) ::munmap(const_cast<void*>(map_), size_);
+}
+
+std::string_view NumberPlan::region_id(const Region& r) { return fixed_str(r.id); }
+std::string_view NumberPlan::calling_code(const Region& r) { return fixed_str(r.calling_code); }
+
+NumberPlan::Match NumberPlan::classify(std::string_view digits) const {
+  Match m;
+  if (digits.empty() || digits.size() > kMaxDigits) return m;
+  for (char c : digits)
+    if (c < '0' || c > '9') return m;
+  const uint32_t bit = uint32_t{1} << digits.size();
+  const Region* fallback = nullptr;
+  uint8_t fallback_len = 0;
+
+  const Node* n = &nodes_[0];
+  for (size_t depth = 0;; ++depth) {
+    const Entry* e = entries_ + n->first_entry;
+    for (uint16_t i = 0; i < n->entry_count; ++i, ++e) {
+      const Region* r = &regions_[e->region];
+      if (!fallback || depth > fallback_len) {
+        fallback = r;
+        fallback_len = static_cast<uint8_t>(depth);
+      }
+      if (!(e->lengths & bit)) continue;
+      // 更深的条目属于另一地区时以更深者为准，同一地区的类型合并
+      if (m.region != r && m.types && depth == m.prefix_len) continue;
+      if (m.region != r) m.types = 0;
+      m.region = r;
+      m.prefix_len = static_cast<uint8_t>(depth);
+      m.types |= static_cast<uint16_t>(1u << e->type);
+    }
+    if (depth == digits.size()) break;
+    unsigned d = static_cast<unsigned>(digits[depth] - '0');
+    if (!(n->child_mask >> d & 1)) break;
+    n = &nodes_[n->first_child + std::popcount(static_cast<uint16_t>(n->child_mask & ((1u << d) - 1)))];
+  }
+  if (!m.types) {
+    m.region = fallback;
+    m.prefix_len = fallback_len;
+  }
+  return m;
+}
+
+// ---- NumberPlanBuilder ----
+
+NumberPlanBuilder::NumberPlanBuilder() {
+  children_.emplace_back().fill(kNone);
+  entries_.emplace_back();
+}
+
+uint16_t NumberPlanBuilder::region(std::string_view id, std::string_view calling_code) {
+  if (id.size() > 4 || calling_code.size() > 4) throw std::invalid_argument("region id or calling code too long");
+  NumberPlan::Region r{};
+  std::copy(id.begin(), id.end(), r.id);
+  std::copy(calling_code.begin(), calling_code.end(), r.calling_code);
+  for (size_t i = 0; i < regions_.size(); ++i)
+    if (std::memcmp(&regions_[i], &r, sizeof(r)) == 0) return static_cast<uint16_t>(i);
+  if (regions_.size() >= 0xffff) throw std::length_error("too many regions");
+  regions_.push_back(r);
+  return static_cast<uint16_t>(regions_.size() - 1);
+}
+
+void NumberPlanBuilder::add(std::string_view digits, uint32_t lengths, uint16_t region, NumberType type) {
+  if (digits.size() > NumberPlan::kMaxDigits) throw std::invalid_argument("prefix too long: " + std::string(digits));
+  uint32_t n = 0;
+  for (char c : digits) {
+    unsigned d = static_cast<unsigned char>(c) - '0';
+    if (d > 9) throw std::invalid_argument("prefix is not numeric: " + std::string(digits));
+    if (children_[n][d] == kNone) {
+      children_[n][d] = static_cast<uint32_t>(children_.size());
+      children_.emplace_back().fill(kNone);
+      entries_.emplace_back();
+    }
+    n = children_[n][d];
+  }
+  for (auto& e : entries_[n])
+    if (e.region == region && e.type == static_cast<uint8_t>(type)) {
+      e.lengths |= lengths;
+      return;
+    }
+  if (entries_[n].size() >= 0xffff) throw std::length_error("too many entries on one prefix");
+  entries_[n].push_back({lengths, region, static_cast<uint8_t>(type), 0});
+}
+
+size_t NumberPlanBuilder::entry_count() const {
+  size_t n = 0;
+  for (const auto& e : entries_) n += e.size();
+  return n;
+}
+
+std::string NumberPlanBuilder::serialize(uint64_t source_hash, int64_t built_at) const {
+  // 按层排列：同一父节点的子节点在 BFS 序中相邻
+  std::vector<uint32_t> order{0};
+  order.reserve(children_.size());
+  for (size_t i = 0; i < order.size(); ++i)
+    for (uint32_t c : children_[order[i]])
+      if (c != kNone) order.push_back(c);
+  std::vector<uint32_t> index(children_.size());
+  for (size_t i = 0; i < order.size(); ++i) index[order[i]] = static_cast<uint32_t>(i);
+
+  std::vector<NumberPlan::Node> nodes(order.size());
+  std::vector<NumberPlan::Entry> entries;
+  entries.reserve(entry_count());
+  for (size_t i = 0; i < order.size(); ++i) {
+    const auto& ch = children_[order[i]];
+    NumberPlan::Node& n = nodes[i];
+    n.child_mask = 0;
+    n.first_child = 0;
+    for (unsigned d = 0; d < 10; ++d) {
+      if (ch[d] == kNone) continue;
+      if (!n.child_mask) n.first_child = index[ch[d]];
+      n.child_mask = static_cast<uint16_t>(n.child_mask | (1u << d));
+    }
+    n.first_entry = static_cast<uint32_t>(entries.size());
+    n.entry_count = static_cast<uint16_t>(entries_[order[i]].size());
+    entries.insert(entries.end(), entries_[order[i]].begin(), entries_[order[i]].end());
+  }
+
+  NumberPlan::Header h{};
+  std::memcpy(h.magic, NumberPlan::kMagic, sizeof(h.magic));
+  h.version = NumberPlan::kVersion;
+  h.built_at = built_at;
+  h.source_hash = source_hash;
+  h.node_count = static_cast<uint32_t>(nodes.size());
+  h.entry_count = static_cast<uint32_t>(entries.size());
+  h.region_count = static_cast<uint32_t>(regions_.size());
+
+  std::string out(sizeof(h), '\0');
+  out.append(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(NumberPlan::Node));
+  out.append(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(NumberPlan::Entry));
+  out.append(reinterpret_cast<const char*>(regions_.data()), regions_.size() * sizeof(NumberPlan::Region));
+  h.crc = crc32c(out.data() + sizeof(h), out.size() - sizeof(h));
+  std::memcpy(out.data(), &h, sizeof(h));
+  return out;
+}
+
+void NumberPlanBuilder::write(const std::string& path, uint64_t source_hash, int64_t built_at) const {
+  std::string data = serialize(source_hash, built_at);
+  std::string tmp = path + ".tmp";
+  {
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    if (!out) throw std::runtime_error("cannot open " + tmp);
+    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+    if (!out.flush()) throw std::runtime_error("cannot write " + tmp);
+  }
+  std::filesystem::rename(tmp, path);
+}
+
+}
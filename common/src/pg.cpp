@@ -3,14 +3,100 @@
 
 namespace hs {
 
-Pg::Pg(const std::string& conninfo) {
-  connection_ = std::make_unique<pqxx::connection>(conninfo);
-  if (!connection_->is_open()) {
+Pg::Pg(const std::string& conninfo, size_t pool_size, std::chrono::milliseconds acquire_timeout)
+  : conninfo_(conninfo), capacity_(pool_size == 0 ? 1 : pool_size), timeout_(acquire_timeout) {
+  // 首个连接立即建立，配置错误在启动时暴露
+  auto slot = std::make_unique<Slot>();
+  slot->conn = std::make_unique<pqxx::connection>(conninfo_);
+  if (!slot->conn->is_open()) {
     throw std::runtime_error("Failed to open PostgreSQL connection");
   }
-  spdlog::info("Connected to PostgreSQL: {}", connection_->dbname());
+  spdlog::info("Connected to PostgreSQL: {} (pool size {})", slot->conn->dbname(), capacity_);
+  idle_.push_back(slot.get());
+  slots_.push_back(std::move(slot));
+
+  auto& reg = metrics::registry();
+  wait_latency_ = &reg.histogram("hs_pg_pool_wait_seconds", "Time spent waiting for a pooled PostgreSQL connection");
+  reg.counter_fn(this, "hs_pg_pool_checkouts_total", "PostgreSQL connection checkouts", metrics::load(stats_.checkouts));
+  reg.counter_fn(this, "hs_pg_pool_waits_total", "Checkouts that had to wait for a free connection", metrics::load(stats_.waits));
+  reg.counter_fn(this, "hs_pg_pool_timeouts_total", "Checkouts that gave up waiting", metrics::load(stats_.timeouts));
+  reg.counter_fn(this, "hs_pg_pool_reconnects_total", "PostgreSQL reconnects", metrics::load(stats_.reconnects));
+  reg.gauge_fn(this, "hs_pg_pool_in_use", "Connections currently checked out", metrics::load(stats_.in_use));
+  reg.gauge_fn(this, "hs_pg_pool_size", "Connection pool capacity", [this] { return static_cast<double>(capacity_); });
+}
+
+Pg::~Pg() { metrics::registry().remove(this); }
+
+metrics::Histogram& Pg::query_latency(std::string_view statement) {
+  return metrics::registry().histogram("hs_pg_query_seconds", "PostgreSQL statement latency", {{"statement", std::string(statement)}});
+}
+
+void Pg::prepare(const std::string& name, const std::string& sql) {
+  std::lock_guard<std::mutex> lk(mu_);
+  statements_.emplace_back(name, sql);
 }
 
-pqxx::connection& Pg::conn() { return *connection_; }
+Pg::Lease Pg::acquire() {
+  auto t0 = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lk(mu_);
+  if (idle_.empty() && slots_.size() < capacity_) {
+    slots_.push_back(std::make_unique<Slot>());
+    idle_.push_back(slots_.back().get());
+  }
+  if (idle_.empty()) {
+    stats_.waits.fetch_add(1, std::memory_order_relaxed);
+    if (!cv_.wait_for(lk, timeout_, [&] { return !idle_.empty(); })) {
+      stats_.timeouts.fetch_add(1, std::memory_order_relaxed);
+      throw std::runtime_error("PostgreSQL pool exhausted");
+    }
+    auto waited = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0);
+    stats_.wait_ns.fetch_add(static_cast<uint64_t>(waited.count()), std::memory_order_relaxed);
+    wait_latency_->record(waited);
+  }
+  Slot* slot = idle_.back();
+  idle_.pop_back();
+  std::vector<std::pair<std::string, std::string>> pending;
+  bool fresh = !slot->conn || !slot->conn->is_open();
+  size_t from = fresh ? 0 : slot->prepared;
+  if (from < statements_.size()) pending.assign(statements_.begin() + static_cast<std::ptrdiff_t>(from), statements_.end());
+  lk.unlock();
 
-}
\ No newline at end of file
+  stats_.checkouts.fetch_add(1, std::memory_order_relaxed);
+  stats_.in_use.fetch_add(1, std::memory_order_relaxed);
+  try {
+    ensure_ready(*slot, pending);
+  } catch (...) {
+    release(slot, true);
+    throw;
+  }
+  return Lease(this, slot);
+}
+
+void Pg::ensure_ready(Slot& slot, const std::vector<std::pair<std::string, std::string>>& pending) {
+  if (!slot.conn || !slot.conn->is_open()) {
+    if (slot.conn) {
+      stats_.reconnects.fetch_add(1, std::memory_order_relaxed);
+      spdlog::warn("PostgreSQL connection lost, reconnecting");
+    }
+    slot.conn.reset();
+    slot.prepared = 0;
+    slot.conn = std::make_unique<pqxx::connection>(conninfo_);
+  }
+  for (const auto& [name, sql] : pending) slot.conn->prepare(name, sql);
+  slot.prepared += pending.size();
+}
+
+void Pg::release(Slot* slot, bool invalid) {
+  if (invalid || (slot->conn && !slot->conn->is_open())) {
+    slot->conn.reset();
+    slot->prepared = 0;
+  }
+  stats_.in_use.fetch_sub(1, std::memory_order_relaxed);
+  {
+    std::lock_guard<std::mutex> lk(mu_);
+    idle_.push_back(slot);
+  }
+  cv_.notify_one();
+}
+
+}
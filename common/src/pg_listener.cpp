@@ -0,0 +1,101 @@
+#include "common/pg_listener.hpp"
+#include <spdlog/spdlog.h>
+
+namespace hs {
+
+class PgListener::Receiver final : public pqxx::notification_receiver {
+public:
+  Receiver(pqxx::connection& conn, const std::string& channel, PgListener* owner)
+    : pqxx::notification_receiver(conn, channel), channel_(channel), owner_(owner) {}
+  void operator()(const std::string& payload, int) override {
+    owner_->pending_[channel_].insert(payload.empty() ? std::string("*") : payload);
+  }
+private:
+  std::string channel_;
+  PgListener* owner_;
+};
+
+PgListener::PgListener(std::string conninfo, std::chrono::milliseconds debounce)
+  : conninfo_(std::move(conninfo)), debounce_(debounce) {}
+
+PgListener::~PgListener() { stop(); }
+
+void PgListener::subscribe(const std::string& channel, Handler on_change) {
+  handlers_[channel] = std::move(on_change);
+}
+
+void PgListener::on_resync(std::function<void()> fn) { resync_.push_back(std::move(fn)); }
+
+void PgListener::connect() {
+  receivers_.clear();
+  conn_ = std::make_unique<pqxx::connection>(conninfo_);
+  for (const auto& [ch, h] : handlers_) receivers_.push_back(std::make_unique<Receiver>(*conn_, ch, this));
+  spdlog::info("PgListener listening on {} channel(s)", handlers_.size());
+}
+
+void PgListener::start() {
+  connect();
+  thread_ = std::jthread([this](std::stop_token st) { run(st); });
+}
+
+void PgListener::stop() {
+  if (thread_.joinable()) {
+    thread_.request_stop();
+    thread_.join();
+  }
+}
+
+void PgListener::dispatch() {
+  auto batch = std::move(pending_);
+  pending_.clear();
+  for (auto& [ch, payloads] : batch) {
+    auto it = handlers_.find(ch);
+    if (it == handlers_.end()) continue;
+    try {
+      it->second(std::vector<std::string>(payloads.begin(), payloads.end()));
+    } catch (const std::exception& ex) {
+      spdlog::error("PgListener handler for {} failed: {}", ch, ex.what());
+    }
+  }
+}
+
+void PgListener::run(std::stop_token st) {
+  using clock = std::chrono::steady_clock;
+  auto backoff = std::chrono::milliseconds(500);
+  while (!st.stop_requested()) {
+    try {
+      if (!conn_) {
+        connect();
+        backoff = std::chrono::milliseconds(500);
+        for (auto& fn : resync_) fn();
+      }
+      auto last = clock::now();
+      auto first = clock::time_point{};
+      while (!st.stop_requested()) {
+        if (conn_->await_notification(0, 100000) > 0) {
+          last = clock::now();
+          if (first == clock::time_point{}) first = last;
+          // 持续有通知时也不无限推迟，最长等待 5 个去抖周期
+          if (last - first < debounce_ * 5) continue;
+        }
+        auto now = clock::now();
+        if (!pending_.empty() && (now - last >= debounce_ || now - first >= debounce_ * 5)) {
+          dispatch();
+          first = clock::time_point{};
+        }
+      }
+    } catch (const std::exception& ex) {
+      spdlog::error("PgListener connection lost: {}", ex.what());
+      receivers_.clear();
+      conn_.reset();
+      for (auto waited = std::chrono::milliseconds(0); waited < backoff && !st.stop_requested();
+           waited += std::chrono::milliseconds(100))
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      backoff = std::min(backoff * 2, std::chrono::milliseconds(10000));
+    }
+  }
+  receivers_.clear();
+  conn_.reset();
+}
+
+}
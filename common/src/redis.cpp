@@ -12,4 +12,8 @@ RedisClient::RedisClient(const std::string& uri) {
 
 sw::redis::Redis& RedisClient::get() { return *redis_; }
 
+metrics::Histogram& RedisClient::rtt(std::string_view op) {
+  return metrics::registry().histogram("hs_redis_rtt_seconds", "Redis round-trip latency", {{"op", std::string(op)}});
+}
+
 }
\ No newline at end of file
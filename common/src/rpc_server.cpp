@@ -0,0 +1,252 @@
+#include "common/rpc_server.hpp"
+#include <pthread.h>
+#include <sched.h>
+#include <algorithm>
+#include <stdexcept>
+#include "common/env.hpp"
+
+namespace hs::rpc {
+
+Options options_from_env(Options base) {
+  auto num = [](const char* key, size_t def) {
+    return static_cast<size_t>(std::max<long long>(0, hs::get_env_int(key, static_cast<long long>(def))));
+  };
+  base.queues = num("RPC_QUEUES", base.queues);
+  base.pin_cores = hs::get_env_int("RPC_PIN_CORES", base.pin_cores ? 1 : 0) != 0;
+  base.max_inflight = num("RPC_MAX_INFLIGHT", base.max_inflight);
+  base.max_streams = num("RPC_MAX_STREAMS", base.max_streams);
+  base.workers = num("RPC_WORKERS", base.workers);
+  base.max_queued = num("RPC_MAX_QUEUED", base.max_queued);
+  base.default_deadline = std::chrono::milliseconds(hs::get_env_int("RPC_DEFAULT_DEADLINE_MS", base.default_deadline.count()));
+  return base;
+}
+
+// ---- Done / 异步一元 ----
+
+void Done::operator()(const grpc::Status& status) const { call_->complete(status); }
+
+namespace detail {
+
+MethodMetrics::MethodMetrics(std::string_view method) {
+  auto& reg = metrics::registry();
+  metrics::Labels labels{{"method", std::string(method)}};
+  latency = &reg.histogram("hs_rpc_server_handling_seconds", "RPC handler latency", labels);
+  failures = &reg.counter("hs_rpc_server_failures_total", "RPCs (or stream messages) whose handler returned a non-OK status", labels);
+}
+
+void AsyncUnaryBase::proceed(bool ok) {
+  if (started_) { unref(); return; }  // Finish 完成
+  started_ = true;
+  if (!ok) { delete this; return; }   // 服务关闭
+  respawn();
+  start();
+}
+
+void AsyncUnaryBase::start() {
+  auto a = srv_->admit(*q_, ctx_);
+  if (a != Server::Admit::Ok) {
+    try_finish(status_of(a));
+    unref();
+    return;
+  }
+  admitted_ = true;
+  t0_ = std::chrono::steady_clock::now();
+  auto now = std::chrono::system_clock::now();
+  auto deadline = std::min(ctx_.deadline(), now + (timeout_.count() ? timeout_ : srv_->options().default_deadline));
+  ref();
+  alarm_tag_.owner = this;
+  alarm_.Set(q_->cq.get(), deadline, static_cast<Tag*>(&alarm_tag_));
+  ref();
+  dispatch(Done(this));
+  unref();
+}
+
+void AsyncUnaryBase::complete(const grpc::Status& st) {
+  if (completed_.exchange(true, std::memory_order_acq_rel)) {
+    spdlog::error("RPC async handler completed twice");
+    return;
+  }
+  metrics_->record(t0_, st);
+  try_finish(st);
+  alarm_.Cancel();
+  unref();
+}
+
+void AsyncUnaryBase::try_finish(const grpc::Status& st) {
+  // 处理器完成与截止时间到期只有先到者写回；超时后处理器仍可写响应对象，但不会再被发送
+  if (finished_.exchange(true, std::memory_order_acq_rel)) return;
+  ref();
+  finish(st);
+}
+
+void AsyncUnaryBase::AlarmTag::proceed(bool ok) {
+  // ok=false 表示处理器先完成、闹钟被取消
+  if (ok && !owner->completed_.load(std::memory_order_acquire)) {
+    owner->srv_->mutable_stats().timed_out.fetch_add(1, std::memory_order_relaxed);
+    owner->try_finish({grpc::StatusCode::DEADLINE_EXCEEDED, "deadline exceeded"});
+  }
+  owner->unref();
+}
+
+}
+
+// ---- Server ----
+
+Server::Server(Options opt) : opt_(std::move(opt)) {}
+
+Server::~Server() {
+  metrics::registry().remove(this);
+  shutdown();
+}
+
+void Server::add_service(grpc::Service* svc) {
+  if (std::find(services_.begin(), services_.end(), svc) == services_.end()) services_.push_back(svc);
+}
+
+Server::Admit Server::admit(detail::Queue& q, const grpc::ServerContext& ctx) {
+  stats_.calls.fetch_add(1, std::memory_order_relaxed);
+  if (detail::expired(ctx)) {
+    stats_.expired.fetch_add(1, std::memory_order_relaxed);
+    return Admit::Expired;
+  }
+  if (q.inflight.fetch_add(1, std::memory_order_relaxed) >= opt_.max_inflight) {
+    q.inflight.fetch_sub(1, std::memory_order_relaxed);
+    stats_.shed.fetch_add(1, std::memory_order_relaxed);
+    return Admit::Shed;
+  }
+  return Admit::Ok;
+}
+
+bool Server::submit(std::function<void()> fn) {
+  if (workers_.empty()) {
+    fn();
+    return true;
+  }
+  {
+    std::lock_guard<std::mutex> lk(jobs_mu_);
+    if (jobs_.size() >= opt_.max_queued) return false;
+    jobs_.push_back(std::move(fn));
+  }
+  jobs_cv_.notify_one();
+  return true;
+}
+
+void Server::work(std::stop_token st) {
+  for (;;) {
+    std::function<void()> fn;
+    {
+      std::unique_lock<std::mutex> lk(jobs_mu_);
+      // 停止时先处理完已排队的任务，它们各自持有未结束的调用
+      if (!jobs_cv_.wait(lk, st, [this] { return !jobs_.empty(); })) return;
+      fn = std::move(jobs_.front());
+      jobs_.pop_front();
+    }
+    fn();
+  }
+}
+
+void Server::poll(detail::Queue& q) {
+  void* tag = nullptr;
+  bool ok = false;
+  while (q.cq->Next(&tag, &ok)) static_cast<detail::Tag*>(tag)->proceed(ok);
+}
+
+static std::vector<int> allowed_cpus() {
+  std::vector<int> cpus;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0)
+    for (int i = 0; i < CPU_SETSIZE; ++i)
+      if (CPU_ISSET(i, &set)) cpus.push_back(i);
+  if (cpus.empty())
+    for (unsigned i = 0; i < std::max(1u, std::thread::hardware_concurrency()); ++i) cpus.push_back(static_cast<int>(i));
+  return cpus;
+}
+
+void Server::start() {
+  grpc::ServerBuilder builder;
+  builder.AddListeningPort(opt_.bind, grpc::InsecureServerCredentials());
+  for (auto* svc : services_) builder.RegisterService(svc);
+  if (opt_.max_streams) builder.AddChannelArgument(GRPC_ARG_MAX_CONCURRENT_STREAMS, static_cast<int>(opt_.max_streams));
+
+  auto cpus = allowed_cpus();
+  size_t n = opt_.queues ? opt_.queues : cpus.size();
+  for (size_t i = 0; i < n; ++i) {
+    auto q = std::make_unique<detail::Queue>();
+    q->cq = builder.AddCompletionQueue();
+    queues_.push_back(std::move(q));
+  }
+  server_ = builder.BuildAndStart();
+  if (!server_) throw std::runtime_error("failed to listen on " + opt_.bind);
+
+  for (size_t i = 0; i < opt_.workers; ++i) workers_.emplace_back([this](std::stop_token st) { work(st); });
+  for (size_t i = 0; i < queues_.size(); ++i) {
+    auto& q = *queues_[i];
+    for (auto& m : methods_) m->spawn(q);
+    q.thread = std::thread([this, &q] { poll(q); });
+    if (opt_.pin_cores) {
+      cpu_set_t one;
+      CPU_ZERO(&one);
+      CPU_SET(cpus[i % cpus.size()], &one);
+      if (int rc = pthread_setaffinity_np(q.thread.native_handle(), sizeof(one), &one); rc != 0)
+        spdlog::warn("RPC queue {}: failed to pin to cpu {} ({})", i, cpus[i % cpus.size()], rc);
+    }
+  }
+  export_metrics();
+  spdlog::info("RPC server on {}: queues={} pinned={} workers={} max_inflight={} default_deadline={}ms",
+               opt_.bind, queues_.size(), opt_.pin_cores, opt_.workers, opt_.max_inflight, opt_.default_deadline.count());
+}
+
+void Server::export_metrics() {
+  auto& reg = metrics::registry();
+  reg.counter_fn(this, "hs_rpc_server_calls_total", "RPCs received", metrics::load(stats_.calls));
+  reg.counter_fn(this, "hs_rpc_server_shed_total", "RPCs rejected with RESOURCE_EXHAUSTED by in-flight or queue limits",
+                 metrics::load(stats_.shed));
+  reg.counter_fn(this, "hs_rpc_server_expired_total", "RPCs past their deadline before the handler ran", metrics::load(stats_.expired));
+  reg.counter_fn(this, "hs_rpc_server_timed_out_total", "Async RPCs whose handler missed the deadline", metrics::load(stats_.timed_out));
+  reg.counter_fn(this, "hs_rpc_server_errors_total", "RPC handlers that threw", metrics::load(stats_.errors));
+  reg.gauge_fn(this, "hs_rpc_server_inflight", "Admitted RPCs and open streams", [this] {
+    size_t n = 0;
+    for (const auto& q : queues_) n += q->inflight.load(std::memory_order_relaxed);
+    return static_cast<double>(n);
+  });
+  reg.gauge_fn(this, "hs_rpc_server_queued", "Jobs waiting for a worker thread", [this] {
+    std::lock_guard<std::mutex> lk(jobs_mu_);
+    return static_cast<double>(jobs_.size());
+  });
+}
+
+void Server::wait() {
+  std::unique_lock<std::mutex> lk(state_mu_);
+  for (;;) {
+    if (state_cv_.wait_for(lk, std::chrono::seconds(60), [this] { return stopping_; })) return;
+    size_t inflight = 0, queued = 0;
+    for (const auto& q : queues_) inflight += q->inflight.load(std::memory_order_relaxed);
+    {
+      std::lock_guard<std::mutex> jl(jobs_mu_);
+      queued = jobs_.size();
+    }
+    spdlog::info("RPC stats: calls={} shed={} expired={} timed_out={} errors={} inflight={} queued={}",
+                 stats_.calls.load(), stats_.shed.load(), stats_.expired.load(), stats_.timed_out.load(),
+                 stats_.errors.load(), inflight, queued);
+  }
+}
+
+void Server::shutdown() {
+  {
+    std::lock_guard<std::mutex> lk(state_mu_);
+    if (stopping_ || !server_) return;
+    stopping_ = true;
+  }
+  state_cv_.notify_all();
+  // 给在途调用 1 秒完成，之后取消；工作线程排空后再关闭完成队列，保证写回时队列仍然有效
+  server_->Shutdown(std::chrono::system_clock::now() + std::chrono::seconds(1));
+  for (auto& w : workers_) w.request_stop();
+  jobs_cv_.notify_all();
+  workers_.clear();
+  for (auto& q : queues_) q->cq->Shutdown();
+  for (auto& q : queues_)
+    if (q->thread.joinable()) q->thread.join();
+}
+
+}
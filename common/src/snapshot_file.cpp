@@ -0,0 +1,210 @@
+#include "common/snapshot_file.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <spdlog/spdlog.h>
+#include "common/crc32c.hpp"
+
+namespace hs {
+
+static_assert(sizeof(SnapshotFile::Header) == 40);
+static_assert(sizeof(SnapshotFile::Section) == 24);
+
+namespace {
+
+size_t align8(size_t n) { return (n + 7) & ~size_t{7}; }
+
+[[noreturn]] void fail(const std::string& path, const std::string& why) {
+  throw std::runtime_error("snapshot " + path + ": " + why);
+}
+
+}
+
+// ---- SnapshotFile ----
+
+std::shared_ptr<const SnapshotFile> SnapshotFile::open(const std::string& path, std::string_view kind, uint32_t version,
+                                                      int64_t max_age_s) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) fail(path, std::strerror(errno));
+  struct stat st {};
+  if (::fstat(fd, &st) != 0) {
+    int err = errno;
+    ::close(fd);
+    fail(path, std::strerror(err));
+  }
+  std::shared_ptr<SnapshotFile> f(new SnapshotFile());
+  f->path_ = path;
+  f->size_ = static_cast<size_t>(st.st_size);
+  if (f->size_ < sizeof(Header)) {
+    ::close(fd);
+    fail(path, "truncated");
+  }
+  void* m = ::mmap(nullptr, f->size_, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+  int err = errno;
+  ::close(fd);
+  if (m == MAP_FAILED) fail(path, std::strerror(err));
+  f->map_ = m;
+
+  auto base = static_cast<const char*>(m);
+  f->header_ = reinterpret_cast<const Header*>(base);
+  const Header& h = *f->header_;
+  if (std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0) fail(path, "bad magic");
+  if (kind.size() != sizeof(h.kind) || std::memcmp(h.kind, kind.data(), sizeof(h.kind)) != 0)
+    fail(path, "kind " + std::string(h.kind, sizeof(h.kind)) + ", expected " + std::string(kind));
+  if (h.version != version) fail(path, "version " + std::to_string(h.version) + ", expected " + std::to_string(version));
+  if (h.size != f->size_) fail(path, "size mismatch");
+  if (max_age_s > 0) {
+    auto now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    if (now - h.created_at > max_age_s) fail(path, std::to_string(now - h.created_at) + "s old");
+  }
+  if (sizeof(Header) + size_t{h.section_count} * sizeof(Section) > f->size_) fail(path, "truncated section table");
+  if (crc32c(base + sizeof(Header), f->size_ - sizeof(Header)) != h.crc) fail(path, "checksum mismatch");
+  f->sections_ = reinterpret_cast<const Section*>(base + sizeof(Header));
+  for (uint32_t i = 0; i < h.section_count; ++i) {
+    const Section& s = f->sections_[i];
+    if (s.record_size == 0 || s.offset % 8 != 0 || s.offset > f->size_ || s.count > (f->size_ - s.offset) / s.record_size)
+      fail(path, "corrupt section " + std::to_string(s.id));
+  }
+  return f;
+}
+
+SnapshotFile::~SnapshotFile() {
+  if (map_) ::munmap(const_cast<void*>(map_), size_);
+}
+
+std::pair<const void*, size_t> SnapshotFile::raw(uint32_t id, size_t record_size, size_t align) const {
+  for (uint32_t i = 0; i < header_->section_count; ++i) {
+    const Section& s = sections_[i];
+    if (s.id != id) continue;
+    if (s.record_size != record_size || s.offset % align != 0)
+      fail(path_, "section " + std::to_string(id) + " record size " + std::to_string(s.record_size) + ", expected " +
+                      std::to_string(record_size));
+    return {static_cast<const char*>(map_) + s.offset, static_cast<size_t>(s.count)};
+  }
+  return {nullptr, 0};
+}
+
+std::string_view SnapshotFile::str(Str s) const {
+  auto chars = section<char>(kStrings);
+  auto v = slice(chars, s.offset, s.size);
+  return {v.data(), v.size()};
+}
+
+// ---- SnapshotWriter ----
+
+SnapshotWriter::SnapshotWriter(std::string_view kind, uint32_t version) : version_(version) {
+  if (kind.size() != sizeof(kind_)) throw std::invalid_argument("snapshot kind must be 4 characters");
+  std::memcpy(kind_, kind.data(), sizeof(kind_));
+}
+
+SnapshotFile::Str SnapshotWriter::str(std::string_view s) {
+  if (strings_.size() + s.size() > UINT32_MAX) throw std::length_error("snapshot string section too large");
+  SnapshotFile::Str r{static_cast<uint32_t>(strings_.size()), static_cast<uint32_t>(s.size())};
+  strings_.append(s);
+  return r;
+}
+
+void SnapshotWriter::add(uint32_t id, uint32_t record_size, const void* data, size_t count) {
+  if (id == SnapshotFile::kStrings) throw std::invalid_argument("snapshot section 0 is reserved for strings");
+  for (const auto& [s, bytes] : sections_)
+    if (s.id == id) throw std::invalid_argument("duplicate snapshot section " + std::to_string(id));
+  sections_.push_back({{id, record_size, 0, count}, std::string(static_cast<const char*>(data), record_size * count)});
+}
+
+std::string SnapshotWriter::serialize(int64_t created_at) const {
+  std::vector<std::pair<SnapshotFile::Section, const std::string*>> all;
+  all.push_back({{SnapshotFile::kStrings, 1, 0, strings_.size()}, &strings_});
+  for (const auto& [s, bytes] : sections_) all.push_back({s, &bytes});
+
+  size_t offset = align8(sizeof(SnapshotFile::Header) + all.size() * sizeof(SnapshotFile::Section));
+  std::vector<SnapshotFile::Section> table;
+  for (auto& [s, bytes] : all) {
+    s.offset = offset;
+    table.push_back(s);
+    offset = align8(offset + bytes->size());
+  }
+
+  std::string out(offset, '\0');
+  std::memcpy(out.data() + sizeof(SnapshotFile::Header), table.data(), table.size() * sizeof(SnapshotFile::Section));
+  for (const auto& [s, bytes] : all) std::memcpy(out.data() + s.offset, bytes->data(), bytes->size());
+
+  SnapshotFile::Header h{};
+  std::memcpy(h.magic, SnapshotFile::kMagic, sizeof(h.magic));
+  std::memcpy(h.kind, kind_, sizeof(h.kind));
+  h.version = version_;
+  h.section_count = static_cast<uint32_t>(all.size());
+  h.created_at = created_at;
+  h.size = out.size();
+  h.crc = crc32c(out.data() + sizeof(h), out.size() - sizeof(h));
+  std::memcpy(out.data(), &h, sizeof(h));
+  return out;
+}
+
+void SnapshotWriter::write(const std::string& path, int64_t created_at) const {
+  std::string data = serialize(created_at);
+  std::string tmp = path + ".tmp." + std::to_string(::getpid());
+  int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) fail(tmp, std::strerror(errno));
+  for (size_t off = 0; off < data.size();) {
+    ssize_t n = ::write(fd, data.data() + off, data.size() - off);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) {
+      int err = errno;
+      ::close(fd);
+      fail(tmp, std::strerror(err));
+    }
+    off += static_cast<size_t>(n);
+  }
+  if (::fsync(fd) != 0) {
+    int err = errno;
+    ::close(fd);
+    fail(tmp, std::strerror(err));
+  }
+  ::close(fd);
+  if (::rename(tmp.c_str(), path.c_str()) != 0) fail(path, std::strerror(errno));
+}
+
+std::jthread snapshot_thread(std::string what, std::function<void()> reload, std::function<void()> save,
+                             std::chrono::seconds interval) {
+  return std::jthread([=, what = std::move(what), reload = std::move(reload), save = std::move(save)](std::stop_token st) {
+    // 只用于等待，停止请求经 stop_token 直接唤醒
+    std::mutex mu;
+    std::condition_variable_any cv;
+    auto sleep = [&](std::chrono::milliseconds d) {
+      std::unique_lock<std::mutex> lk(mu);
+      cv.wait_for(lk, st, d, [] { return false; });
+    };
+    auto backoff = std::chrono::milliseconds(1000);
+    while (reload && !st.stop_requested()) {
+      auto t0 = std::chrono::steady_clock::now();
+      try {
+        reload();
+        spdlog::info("{} caught up from PostgreSQL in {:.0f}ms", what,
+                     std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+        break;
+      } catch (const std::exception& ex) {
+        spdlog::warn("{} catch-up from PostgreSQL failed, still serving snapshot: {}", what, ex.what());
+      }
+      sleep(backoff);
+      backoff = std::min(backoff * 2, std::chrono::milliseconds(30000));
+    }
+    while (!st.stop_requested()) {
+      try {
+        save();
+      } catch (const std::exception& ex) {
+        spdlog::warn("{} snapshot write failed: {}", what, ex.what());
+      }
+      if (interval.count() <= 0) return;
+      sleep(interval);
+    }
+  });
+}
+
+}
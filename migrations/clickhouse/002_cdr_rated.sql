@@ -0,0 +1,20 @@
+-- 离线重算结果（tools/rerate 写入）；同一通话重复重算时以最新 rated_at 为准
+CREATE TABLE IF NOT EXISTS cdr_rated (
+  call_id String,
+  attempt UInt8,
+  start_ts DateTime,
+
+  account_code String,
+  rate_table String,
+  prefix String,
+  billsec UInt32,
+  currency String,
+  amount Decimal(18, 6),
+  status LowCardinality(String), -- ok / no_account / no_rate_table / no_rate
+
+  rated_at DateTime DEFAULT now()
+)
+ENGINE = ReplacingMergeTree(rated_at)
+PARTITION BY toYYYYMM(start_ts)
+ORDER BY (call_id, attempt)
+SETTINGS index_granularity = 8192;
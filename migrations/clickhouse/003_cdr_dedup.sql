@@ -0,0 +1,3 @@
+-- cdr-svc 以批次 insert_deduplication_token 重放 spool，非复制表需开启去重窗口
+-- 窗口需覆盖 ClickHouse 故障期间积压并重放的批次数
+ALTER TABLE cdr MODIFY SETTING non_replicated_deduplication_window = 100000;
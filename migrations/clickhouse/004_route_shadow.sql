@@ -0,0 +1,21 @@
+-- 影子路由分歧（route-svc 写入）：抽样的 Pick 上影子计划与生效计划的首选供应商或候选供应商集合不同
+-- divergence: first / set / live_no_route / shadow_no_route；供应商数组按候选顺序去重
+CREATE TABLE IF NOT EXISTS route_shadow (
+  ts DateTime,
+  node LowCardinality(String),
+  account_id Int64,
+  e164_to String,
+
+  live_plan Int64,
+  shadow_plan Int64,
+  divergence LowCardinality(String),
+
+  live_first String,
+  shadow_first String,
+  live_vendors Array(String),
+  shadow_vendors Array(String)
+)
+ENGINE = MergeTree
+PARTITION BY toYYYYMMDD(ts)
+ORDER BY (shadow_plan, ts)
+TTL ts + INTERVAL 30 DAY;
@@ -0,0 +1,68 @@
+BEGIN;
+
+-- 配置变更通知：服务通过 LISTEN 增量重建内存快照（common/pg_listener）
+-- 负载格式 "<schema.table>:<key>"；TG_ARGV[0] 为通道，TG_ARGV[1] 为分区键列名，缺省或为空时 key 为 '*'（全量）
+CREATE OR REPLACE FUNCTION ops.notify_change() RETURNS TRIGGER AS $$
+DECLARE
+  tbl TEXT := TG_TABLE_SCHEMA || '.' || TG_TABLE_NAME;
+  new_key TEXT := '*';
+  old_key TEXT := '*';
+BEGIN
+  IF TG_NARGS > 1 THEN
+    IF TG_OP <> 'DELETE' THEN new_key := COALESCE(to_jsonb(NEW)->>TG_ARGV[1], '*'); END IF;
+    IF TG_OP <> 'INSERT' THEN old_key := COALESCE(to_jsonb(OLD)->>TG_ARGV[1], '*'); END IF;
+  END IF;
+  IF TG_OP <> 'DELETE' THEN
+    PERFORM pg_notify(TG_ARGV[0], tbl || ':' || new_key);
+  END IF;
+  -- 删除或分区键变化时旧键同样失效；同一事务内重复的通知由 PostgreSQL 合并
+  IF TG_OP = 'DELETE' OR (TG_OP = 'UPDATE' AND old_key IS DISTINCT FROM new_key) THEN
+    PERFORM pg_notify(TG_ARGV[0], tbl || ':' || old_key);
+  END IF;
+  RETURN NULL;
+END; $$ LANGUAGE plpgsql;
+
+-- 路由（route-svc）
+DROP TRIGGER IF EXISTS trg_notify_route_plans ON routing.route_plans;
+CREATE TRIGGER trg_notify_route_plans AFTER INSERT OR UPDATE OR DELETE ON routing.route_plans
+FOR EACH ROW EXECUTE FUNCTION ops.notify_change('hs_routing', 'plan_id');
+
+DROP TRIGGER IF EXISTS trg_notify_plan_entries ON routing.plan_entries;
+CREATE TRIGGER trg_notify_plan_entries AFTER INSERT OR UPDATE OR DELETE ON routing.plan_entries
+FOR EACH ROW EXECUTE FUNCTION ops.notify_change('hs_routing', 'plan_id');
+
+DROP TRIGGER IF EXISTS trg_notify_vendors ON routing.vendors;
+CREATE TRIGGER trg_notify_vendors AFTER INSERT OR UPDATE OR DELETE ON routing.vendors
+FOR EACH ROW EXECUTE FUNCTION ops.notify_change('hs_routing');
+
+DROP TRIGGER IF EXISTS trg_notify_prefixes_routing ON routing.prefixes;
+CREATE TRIGGER trg_notify_prefixes_routing AFTER INSERT OR UPDATE OR DELETE ON routing.prefixes
+FOR EACH ROW EXECUTE FUNCTION ops.notify_change('hs_routing');
+
+DROP TRIGGER IF EXISTS trg_notify_blacklist ON security.blacklist_destinations;
+CREATE TRIGGER trg_notify_blacklist AFTER INSERT OR UPDATE OR DELETE ON security.blacklist_destinations
+FOR EACH ROW EXECUTE FUNCTION ops.notify_change('hs_routing', 'account_id');
+
+DROP TRIGGER IF EXISTS trg_notify_trunks_routing ON core.trunks;
+CREATE TRIGGER trg_notify_trunks_routing AFTER INSERT OR UPDATE OR DELETE ON core.trunks
+FOR EACH ROW EXECUTE FUNCTION ops.notify_change('hs_routing');
+
+-- 鉴权（auth-svc）
+DROP TRIGGER IF EXISTS trg_notify_trunks_auth ON core.trunks;
+CREATE TRIGGER trg_notify_trunks_auth AFTER INSERT OR UPDATE OR DELETE ON core.trunks
+FOR EACH ROW EXECUTE FUNCTION ops.notify_change('hs_auth', 'trunk_id');
+
+-- 费率（billing-svc）
+DROP TRIGGER IF EXISTS trg_notify_rate_tables ON billing.rate_tables;
+CREATE TRIGGER trg_notify_rate_tables AFTER INSERT OR UPDATE OR DELETE ON billing.rate_tables
+FOR EACH ROW EXECUTE FUNCTION ops.notify_change('hs_billing', 'account_id');
+
+DROP TRIGGER IF EXISTS trg_notify_rate_items ON billing.rate_items;
+CREATE TRIGGER trg_notify_rate_items AFTER INSERT OR UPDATE OR DELETE ON billing.rate_items
+FOR EACH ROW EXECUTE FUNCTION ops.notify_change('hs_billing', 'rate_table_id');
+
+DROP TRIGGER IF EXISTS trg_notify_prefixes_billing ON routing.prefixes;
+CREATE TRIGGER trg_notify_prefixes_billing AFTER INSERT OR UPDATE OR DELETE ON routing.prefixes
+FOR EACH ROW EXECUTE FUNCTION ops.notify_change('hs_billing');
+
+COMMIT;
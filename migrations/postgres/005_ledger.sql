@@ -0,0 +1,24 @@
+BEGIN;
+
+-- billing-svc 内存账本的追加日志：每个提交批次一个事务，txid 标识批次
+CREATE TABLE IF NOT EXISTS billing.ledger_journal (
+  entry_id     BIGSERIAL PRIMARY KEY,
+  txid         BIGINT NOT NULL DEFAULT txid_current(),
+  kind         TEXT NOT NULL CHECK (kind IN ('reserve','settle','void')),
+  account_id   BIGINT NOT NULL,
+  token        TEXT NOT NULL,
+  amount       NUMERIC(18,6) NOT NULL,
+  created_at   TIMESTAMPTZ NOT NULL DEFAULT now()
+);
+
+CREATE INDEX IF NOT EXISTS idx_ledger_journal_account ON billing.ledger_journal(account_id, entry_id);
+-- 恢复时只加载 open 状态的预授权
+CREATE INDEX IF NOT EXISTS idx_auth_open ON billing.authorizations(token) WHERE status = 'open';
+
+-- 账户变更（充值、授信、后付切换）通知账本刷新；账本自身的批量扣减以 hs.ledger_writer 标记跳过
+DROP TRIGGER IF EXISTS trg_notify_accounts_billing ON core.accounts;
+CREATE TRIGGER trg_notify_accounts_billing AFTER INSERT OR UPDATE OR DELETE ON core.accounts
+FOR EACH ROW WHEN (COALESCE(current_setting('hs.ledger_writer', true), '') <> 'on')
+EXECUTE FUNCTION ops.notify_change('hs_billing', 'account_id');
+
+COMMIT;
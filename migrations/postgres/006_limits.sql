@@ -0,0 +1,16 @@
+BEGIN;
+
+-- 账户级 CPS / 并发上限（0 表示不限），与 core.trunks、routing.plan_entries 的同名列一起由 auth-svc RiskEval 执行
+ALTER TABLE core.accounts ADD COLUMN IF NOT EXISTS max_cps INTEGER NOT NULL DEFAULT 0;
+ALTER TABLE core.accounts ADD COLUMN IF NOT EXISTS max_concurrent INTEGER NOT NULL DEFAULT 0;
+
+-- 限额变更通知 auth-svc；账户余额等频繁更新的列不触发
+DROP TRIGGER IF EXISTS trg_notify_accounts_auth ON core.accounts;
+CREATE TRIGGER trg_notify_accounts_auth AFTER INSERT OR DELETE OR UPDATE OF account_code, max_cps, max_concurrent ON core.accounts
+FOR EACH ROW EXECUTE FUNCTION ops.notify_change('hs_auth', 'account_id');
+
+DROP TRIGGER IF EXISTS trg_notify_plan_entries_auth ON routing.plan_entries;
+CREATE TRIGGER trg_notify_plan_entries_auth AFTER INSERT OR DELETE OR UPDATE OF max_cps, max_concurrent ON routing.plan_entries
+FOR EACH ROW EXECUTE FUNCTION ops.notify_change('hs_auth', 'entry_id');
+
+COMMIT;
@@ -0,0 +1,23 @@
+BEGIN;
+
+-- 入中继拨号计划：route-svc 按此把 to_uri / e164_to 规范化为 E.164（common/number.hpp）
+-- intl_prefix 剥离后即为 E.164；national_prefix 非空且 country_code 非空时替换为国家码
+ALTER TABLE core.trunks ADD COLUMN IF NOT EXISTS intl_prefix TEXT NOT NULL DEFAULT '00';
+ALTER TABLE core.trunks ADD COLUMN IF NOT EXISTS national_prefix TEXT NOT NULL DEFAULT '';
+ALTER TABLE core.trunks ADD COLUMN IF NOT EXISTS country_code TEXT NOT NULL DEFAULT '' CHECK (country_code ~ '^[0-9]{0,3}$');
+
+-- 改写规则：以 match_prefix 开头的号码剥离前 strip_digits 位后补 prepend，取最长匹配的一条，在冠字识别之前执行
+CREATE TABLE IF NOT EXISTS core.trunk_dial_rules (
+  rule_id          BIGSERIAL PRIMARY KEY,
+  trunk_id         BIGINT NOT NULL REFERENCES core.trunks(trunk_id) ON DELETE CASCADE,
+  match_prefix     TEXT NOT NULL,
+  strip_digits     INTEGER NOT NULL DEFAULT 0 CHECK (strip_digits >= 0),
+  prepend          TEXT NOT NULL DEFAULT '',
+  UNIQUE (trunk_id, match_prefix)
+);
+
+DROP TRIGGER IF EXISTS trg_notify_trunk_dial_rules ON core.trunk_dial_rules;
+CREATE TRIGGER trg_notify_trunk_dial_rules AFTER INSERT OR UPDATE OR DELETE ON core.trunk_dial_rules
+FOR EACH ROW EXECUTE FUNCTION ops.notify_change('hs_routing');
+
+COMMIT;
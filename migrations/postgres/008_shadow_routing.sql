@@ -0,0 +1,11 @@
+BEGIN;
+
+-- 影子路由：status='shadow' 的计划不参与选路，route-svc 在抽样的 Pick 上把它与同账户的生效计划比较，
+-- 分歧写入 ClickHouse route_shadow；tools/route-replay 用历史 CDR 离线比较两者的成本与质量。
+-- 中继绑定账户最新的 'live' 计划：灰度上线即把影子计划改为 'live'，回滚时改回 'shadow'，原计划随即重新生效
+ALTER TABLE routing.route_plans ADD COLUMN IF NOT EXISTS status TEXT NOT NULL DEFAULT 'live'
+  CHECK (status IN ('live', 'shadow'));
+
+CREATE INDEX IF NOT EXISTS route_plans_account_status_idx ON routing.route_plans (account_id, status, plan_id DESC);
+
+COMMIT;
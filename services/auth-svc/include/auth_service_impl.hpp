@@ -1,18 +1,26 @@
 #pragma once
+#include <mutex>
 #include <hyperswitch/auth/auth.grpc.pb.h>
 #include "common/pg.hpp"
-#include "common/redis.hpp"
+#include "common/snapshot.hpp"
+#include "ip_acl.hpp"
+#include "limiter.hpp"
 
 namespace hs::auth {
 
-class AuthServiceImpl final : public hyperswitch::auth::AuthService::Service {
+class AuthServiceImpl {
 public:
-  AuthServiceImpl(hs::Pg* pg, hs::RedisClient* redis);
-  ::grpc::Status SipAuth(::grpc::ServerContext*, const hyperswitch::auth::SipAuthRequest*, hyperswitch::auth::SipAuthResponse*) override;
-  ::grpc::Status RiskEval(::grpc::ServerContext*, const hyperswitch::auth::RiskEvalRequest*, hyperswitch::auth::RiskEvalResponse*) override;
+  AuthServiceImpl(hs::Pg* pg, Limiter* limiter);
+  // 全量重建 IP ACL 与限额（hs_auth 通知与断线重连时调用）
+  void reload();
+  ::grpc::Status SipAuth(::grpc::ServerContext*, const hyperswitch::auth::SipAuthRequest*, hyperswitch::auth::SipAuthResponse*);
+  ::grpc::Status RiskEval(::grpc::ServerContext*, const hyperswitch::auth::RiskEvalRequest*, hyperswitch::auth::RiskEvalResponse*);
+  ::grpc::Status ReleaseCall(::grpc::ServerContext*, const hyperswitch::auth::ReleaseCallRequest*, hyperswitch::auth::ReleaseCallResponse*);
 private:
   hs::Pg* pg_;
-  hs::RedisClient* redis_;
+  Limiter* limiter_;
+  hs::Snapshot<IpAcl> acl_;
+  std::mutex reload_mu_; // 仅串行化写端
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <pqxx/pqxx>
+
+namespace hs::auth {
+
+// 128 位地址；IPv4 映射到 ::ffff:0:0/96，与 IPv4-mapped IPv6 源地址统一匹配
+struct IpAddr {
+  uint64_t hi = 0, lo = 0;
+  bool bit(unsigned i) const { return i < 64 ? (hi >> (63 - i)) & 1 : (lo >> (127 - i)) & 1; }
+};
+
+struct Cidr {
+  IpAddr addr;  // 已按 len 清零主机位
+  uint8_t len = 0;
+};
+
+// "1.2.3.4"、"2001:db8::1"、"[2001:db8::1]"
+std::optional<IpAddr> parse_ip(std::string_view s);
+// 同上，可带 "/len"；缺省为主机路由
+std::optional<Cidr> parse_cidr(std::string_view s);
+
+// IP 鉴权中继的不可变索引：路径压缩的二进制基数树（Patricia），最长前缀匹配到账户与中继。
+// 数据来自 core.trunks（auth_mode='ip' 且启用），auth_data 支持 {"ip": "..."} 与 {"ips": [...]}，
+// 每项可为单个地址或 CIDR，字符串内也可用逗号分隔多项
+class IpAcl {
+public:
+  struct Entry {
+    int64_t trunk_id = 0;
+    std::string account_code;
+    std::string trunk_name;
+  };
+
+  static std::shared_ptr<const IpAcl> load(pqxx::connection& conn);
+
+  // 同一 CIDR 已绑定其他条目时保留原条目并返回 false
+  bool insert(const Cidr& c, uint32_t entry);
+  uint32_t add_entry(Entry e);
+
+  const Entry* match(const IpAddr& a) const;
+
+  size_t prefixes() const { return prefixes_; }
+  size_t nodes() const { return nodes_.size(); }
+  const std::vector<Entry>& entries() const { return entries_; }
+
+  IpAcl();
+
+private:
+  static constexpr uint32_t kNone = UINT32_MAX;
+  struct Node {
+    IpAddr key;
+    uint8_t len = 0;
+    uint32_t child[2] = {kNone, kNone};
+    uint32_t entry = kNone;
+  };
+
+  uint32_t new_node(const IpAddr& key, uint8_t len, uint32_t entry);
+
+  std::vector<Node> nodes_;  // 0 为根（::/0）
+  std::vector<Entry> entries_;
+  size_t prefixes_ = 0;
+};
+
+}
@@ -0,0 +1,187 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <pqxx/pqxx>
+#include "common/hash.hpp"
+#include "common/live_calls.hpp"
+#include "common/metrics.hpp"
+#include "common/redis.hpp"
+#include "common/snapshot.hpp"
+
+namespace hs::auth {
+
+// CPS / 并发限流：账户、入中继、路由条目（routing.plan_entries）与出中继各一个计数器，判定在进程内存完成。
+// 本地模式：CPS 为分片 GCRA 令牌桶，各分片分摊速率与突发，本分片不足时借用其余分片；并发为原子计数。
+// 集群模式：CPS 预算按自然秒向 Redis 批量租用（INCRBY 不超过上限）；并发由各节点周期上报本地占用并汇总其余节点，
+// 超额上限为一个同步周期内的到达量。
+// 请求线程从不访问 Redis：租约用完而本秒集群预算未耗尽时按本节点静态份额（⌈max_cps / nodes⌉）判定，
+// 这部分准入计入下一次租用（抵扣届时的预算），并唤醒同步线程立即补租。
+// 因此只有租约全部来自 Redis 时整个集群每秒准入才不超过 max_cps；补租未到期间每个节点每秒至多多准入
+// 一个份额（含 1 秒突发），最坏情况下单秒集群准入约为 2 × max_cps，多出的部分在后续秒内扣回。
+// Redis 同步失败超过 max_stale 时退化为本地模式，限额按 nodes 均分。
+class Limiter {
+public:
+  struct Options {
+    bool cluster = false;
+    std::string node_id;
+    uint32_t nodes = 1;
+    std::chrono::milliseconds sync_interval{50};
+    std::chrono::milliseconds max_stale{2000};
+    std::chrono::seconds call_ttl{10800};  // 未 release 的通话到期自动归还并发名额
+  };
+
+  struct Stats {
+    std::atomic<uint64_t> allowed{0};
+    std::atomic<uint64_t> rejected_cps{0};
+    std::atomic<uint64_t> rejected_concurrent{0};
+    std::atomic<uint64_t> released{0};
+    std::atomic<uint64_t> expired{0};
+    std::atomic<uint64_t> syncs{0};
+    std::atomic<uint64_t> sync_errors{0};
+    std::atomic<uint64_t> leases{0};
+    std::atomic<uint64_t> lease_misses{0};  // 租约用完时按本节点份额判定
+    std::atomic<uint64_t> degraded{0};      // 退化为本地判定的次数
+  };
+
+  // 限额配置，0 表示不限
+  struct Limit {
+    uint32_t max_cps = 0;
+    uint32_t max_concurrent = 0;
+  };
+  struct Limits {
+    hs::StringMap<Limit> accounts;
+    hs::StringMap<Limit> trunks;
+    std::unordered_map<int64_t, Limit> entries;
+    hs::StringMap<std::string> account_ingress;  // 账户 → 唯一的入中继
+  };
+
+  struct Request {
+    std::string_view account_code;
+    std::string_view ingress_trunk;  // 为空时取账户唯一的入中继
+    int64_t plan_entry_id = 0;
+    std::string_view egress_trunk;
+    std::string_view call_id;        // 非空时占用并发名额直到 release()
+  };
+
+  enum class Verdict { kAllowed, kCps, kConcurrent };
+  struct Decision {
+    Verdict verdict = Verdict::kAllowed;
+    std::string_view limit;  // 拒绝时为计数器键，如 "trunk:acme-in"；在 Limiter 生命周期内有效
+  };
+
+  Limiter(hs::RedisClient* redis, Options opt);
+  ~Limiter();
+
+  static Limits load(pqxx::connection& conn);
+  // 更新限额；计数器按键保留，进行中的通话与令牌桶状态不受影响
+  void apply(const Limits& limits);
+  bool loaded() const { return index_.read() != nullptr; }
+  // 在途通话视图（billing / cdr 登记）：账户与中继的并发同时不得超过其观测值，覆盖未经 RiskEval 或漏调 ReleaseCall 的通话
+  void set_observed(const hs::LiveCalls* live) { observed_ = live; }
+
+  void start();
+  void stop();
+
+  Decision acquire(const Request& r);
+  bool release(std::string_view call_id);
+
+  size_t active_calls() const;
+  const Stats& stats() const { return stats_; }
+
+private:
+  static constexpr size_t kStripes = 8;
+  static constexpr uint32_t kStripeMinCps = 64;  // 每个分片至少分到的速率
+  static constexpr size_t kSlots = 4;            // 账户、入中继、路由条目、出中继
+  static constexpr size_t kCallShards = 64;
+
+  struct alignas(64) Stripe {
+    std::atomic<int64_t> tat{0};  // GCRA 理论到达时刻（steady ns）
+  };
+
+  struct Counter {
+    explicit Counter(std::string k) : key(std::move(k)) {}
+    const std::string key;
+    std::atomic<uint32_t> max_cps{0};
+    std::atomic<uint32_t> max_concurrent{0};
+    std::array<Stripe, kStripes> stripes;
+    alignas(64) std::atomic<int32_t> concurrent{0};
+    // 集群模式：高 32 位为租约所属的秒，低 32 位为剩余令牌
+    alignas(64) std::atomic<uint64_t> lease{0};
+    std::atomic<int64_t> exhausted_sec{0};
+    std::atomic<uint32_t> demand{0};
+    std::atomic<int32_t> remote_concurrent{0};
+    std::atomic<uint32_t> borrowed{0};  // 租约用完后按本节点份额准入、尚未计入 Redis 的令牌
+    std::atomic<bool> reported{false};
+  };
+
+  struct Index {
+    hs::StringMap<Counter*> accounts;
+    hs::StringMap<Counter*> trunks;
+    std::unordered_map<int64_t, Counter*> entries;
+    hs::StringMap<Counter*> account_ingress;
+    std::vector<Counter*> limited;  // 配置了限额的计数器，供同步线程遍历
+  };
+
+  struct Held {
+    std::array<Counter*, kSlots> slots{};
+    int64_t expire_ms = 0;
+  };
+  struct CallShard {
+    mutable std::mutex mu;
+    hs::StringMap<Held> map;
+  };
+
+  // 成功取得的 CPS 令牌，失败时据此退还；stripe < 0 表示集群租约
+  struct Token {
+    Counter* c = nullptr;
+    int stripe = 0;
+    int64_t interval = 0;
+  };
+
+  Counter* counter(const std::string& key);
+  bool healthy(int64_t now_ms) const;
+  bool take_cps(Counter* c, int64_t now_ns, int64_t now_ms, Token& tok);
+  bool take_local(Counter* c, uint32_t rate, int64_t now_ns, Token& tok);
+  bool take_lease(Counter* c, int64_t now_ms);
+  void wake_sync();
+  void refund(const Token& tok);
+  bool take_concurrent(Counter* c, int64_t now_ms);
+  // n 含 owed：owed 为已按本节点份额准入的令牌，租到后先抵扣
+  struct Want {
+    Counter* c;
+    uint32_t n;
+    uint32_t owed;
+  };
+  void lease(const std::vector<Want>& want, int64_t sec);
+  void sync();
+  void sweep(int64_t now_ms);
+  void run(std::stop_token st);
+
+  hs::RedisClient* redis_;
+  Options opt_;
+  const hs::LiveCalls* observed_ = nullptr;
+  std::mutex reg_mu_;
+  hs::StringMap<std::unique_ptr<Counter>> counters_;  // 只增不删，指针在进程生命周期内有效
+  hs::Snapshot<Index> index_;
+  std::array<CallShard, kCallShards> calls_;
+  std::atomic<int64_t> last_sync_ms_{0};
+  mutable Stats stats_;
+  hs::metrics::Histogram* lease_rtt_;
+  hs::metrics::Histogram* sync_rtt_;
+  std::atomic<bool> sync_wanted_{false};
+  std::mutex run_mu_;
+  std::condition_variable_any run_cv_;
+  std::jthread thread_;
+};
+
+}
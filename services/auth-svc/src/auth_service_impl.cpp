@@ -1,23 +1,36 @@
 #include "auth_service_impl.hpp"
 #include <spdlog/spdlog.h>
+#include "common/number.hpp"
 
 using hyperswitch::auth::SipAuthRequest;
 using hyperswitch::auth::SipAuthResponse;
 using hyperswitch::auth::RiskEvalRequest;
 using hyperswitch::auth::RiskEvalResponse;
+using hyperswitch::auth::ReleaseCallRequest;
+using hyperswitch::auth::ReleaseCallResponse;
 
 namespace hs::auth {
 
-AuthServiceImpl::AuthServiceImpl(hs::Pg* pg, hs::RedisClient* redis) : pg_(pg), redis_(redis) {}
+AuthServiceImpl::AuthServiceImpl(hs::Pg* pg, Limiter* limiter) : pg_(pg), limiter_(limiter) {}
+
+void AuthServiceImpl::reload() {
+  std::lock_guard<std::mutex> lk(reload_mu_);
+  auto conn = pg_->acquire();
+  acl_.store(IpAcl::load(*conn));
+  limiter_->apply(Limiter::load(*conn));
+}
 
 ::grpc::Status AuthServiceImpl::SipAuth(::grpc::ServerContext*, const SipAuthRequest* req, SipAuthResponse* resp) {
   try {
-    pqxx::work tx(pg_->conn());
-    auto r = tx.exec_params("SELECT a.account_code, t.name FROM core.trunks t JOIN core.accounts a ON a.account_id=t.account_id WHERE t.auth_mode='ip' AND (t.auth_data->>'ip')=$1 AND t.enabled=true LIMIT 1", req->src_ip());
-    if (r.empty()) { resp->set_allowed(false); resp->set_reason("ip not allowed"); return ::grpc::Status::OK; }
+    const IpAcl* acl = acl_.read();
+    if (!acl) return {::grpc::StatusCode::UNAVAILABLE, "ip acl not loaded"};
+    auto ip = parse_ip(req->src_ip());
+    if (!ip) return {::grpc::StatusCode::INVALID_ARGUMENT, "invalid src_ip"};
+    const IpAcl::Entry* e = acl->match(*ip);
+    if (!e) { resp->set_allowed(false); resp->set_reason("ip not allowed"); return ::grpc::Status::OK; }
     resp->set_allowed(true);
-    resp->set_account_code(r[0][0].as<std::string>());
-    resp->set_trunk_name(r[0][1].as<std::string>());
+    resp->set_account_code(e->account_code);
+    resp->set_trunk_name(e->trunk_name);
     return ::grpc::Status::OK;
   } catch (const std::exception& ex) {
     spdlog::error("SipAuth error: {}", ex.what());
@@ -27,17 +40,25 @@ AuthServiceImpl::AuthServiceImpl(hs::Pg* pg, hs::RedisClient* redis) : pg_(pg),
 
 ::grpc::Status AuthServiceImpl::RiskEval(::grpc::ServerContext*, const RiskEvalRequest* req, RiskEvalResponse* resp) {
   try {
-    auto& r = redis_->get();
-    std::string key = "quota:cps:" + req->account_code();
-    auto now = std::chrono::system_clock::now();
-    auto sec = std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch()).count();
-    // 滑窗计数：当前秒+前一秒
-    r.incr(key + ":" + std::to_string(sec));
-    r.expire(key + ":" + std::to_string(sec), std::chrono::seconds(10));
-    // 简单阈值（后续改为读取 PG 限额或 Redis 配置）
-    int cps = req->cps();
-    if (cps > 1000) { resp->set_allowed(false); resp->set_reason("cps too high"); return ::grpc::Status::OK; }
-    resp->set_allowed(true);
+    if (!limiter_->loaded()) return {::grpc::StatusCode::UNAVAILABLE, "limits not loaded"};
+    // 目的号码无法规范化的呼叫直接拒绝，不占用限额
+    hs::number::E164 dest;
+    if (!req->e164_to().empty() && hs::number::normalize(req->e164_to(), dest) != hs::number::Status::Ok) {
+      resp->set_allowed(false);
+      resp->set_reason("invalid destination number");
+      return ::grpc::Status::OK;
+    }
+    Limiter::Request r;
+    r.account_code = req->account_code();
+    r.ingress_trunk = req->ingress_trunk();
+    r.plan_entry_id = req->plan_entry_id();
+    r.egress_trunk = req->egress_trunk();
+    r.call_id = req->call_id();
+    auto d = limiter_->acquire(r);
+    if (d.verdict == Limiter::Verdict::kAllowed) { resp->set_allowed(true); return ::grpc::Status::OK; }
+    resp->set_allowed(false);
+    resp->set_reason(d.verdict == Limiter::Verdict::kCps ? "cps limit" : "concurrent limit");
+    resp->set_limit(std::string(d.limit));
     return ::grpc::Status::OK;
   } catch (const std::exception& ex) {
     spdlog::error("RiskEval error: {}", ex.what());
@@ -45,4 +66,10 @@ AuthServiceImpl::AuthServiceImpl(hs::Pg* pg, hs::RedisClient* redis) : pg_(pg),
   }
 }
 
+::grpc::Status AuthServiceImpl::ReleaseCall(::grpc::ServerContext*, const ReleaseCallRequest* req, ReleaseCallResponse* resp) {
+  if (req->call_id().empty()) return {::grpc::StatusCode::INVALID_ARGUMENT, "call_id required"};
+  resp->set_released(limiter_->release(req->call_id()));
+  return ::grpc::Status::OK;
+}
+
 }
\ No newline at end of file
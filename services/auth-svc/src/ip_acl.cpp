@@ -0,0 +1,202 @@
+#include "ip_acl.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <bit>
+#include <charconv>
+#include <cstring>
+#include <spdlog/spdlog.h>
+
+namespace hs::auth {
+
+namespace {
+
+// 高 n 位为 1；n 为 0 或 64 时移位 64 位未定义，单独处理
+uint64_t high_bits(unsigned n) {
+  if (n == 0) return 0;
+  if (n >= 64) return ~uint64_t{0};
+  return ~(~uint64_t{0} >> n);
+}
+
+IpAddr mask(IpAddr a, unsigned len) {
+  if (len >= 128) return a;
+  if (len <= 64) {
+    a.hi &= high_bits(len);
+    a.lo = 0;
+  } else {
+    a.lo &= high_bits(len - 64);
+  }
+  return a;
+}
+
+unsigned common_bits(const IpAddr& a, const IpAddr& b) {
+  if (uint64_t x = a.hi ^ b.hi) return std::countl_zero(x);
+  if (uint64_t x = a.lo ^ b.lo) return 64 + std::countl_zero(x);
+  return 128;
+}
+
+uint64_t load_be64(const unsigned char* p) {
+  uint64_t v = 0;
+  for (int i = 0; i < 8; ++i) v = (v << 8) | p[i];
+  return v;
+}
+
+std::string_view trim(std::string_view s) {
+  while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+  while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+  return s;
+}
+
+// 返回地址与族内前缀长度上限（IPv4 32，IPv6 128）
+std::optional<std::pair<IpAddr, unsigned>> parse_addr(std::string_view s) {
+  s = trim(s);
+  if (s.size() >= 2 && s.front() == '[' && s.back() == ']') s = s.substr(1, s.size() - 2);
+  char buf[INET6_ADDRSTRLEN];
+  if (s.empty() || s.size() >= sizeof(buf)) return std::nullopt;
+  std::memcpy(buf, s.data(), s.size());
+  buf[s.size()] = '\0';
+  unsigned char b[16];
+  if (s.find(':') != std::string_view::npos) {
+    if (inet_pton(AF_INET6, buf, b) != 1) return std::nullopt;
+    return std::pair{IpAddr{load_be64(b), load_be64(b + 8)}, 128u};
+  }
+  if (inet_pton(AF_INET, buf, b) != 1) return std::nullopt;
+  uint64_t v4 = (uint64_t{b[0]} << 24) | (uint64_t{b[1]} << 16) | (uint64_t{b[2]} << 8) | b[3];
+  return std::pair{IpAddr{0, (uint64_t{0xffff} << 32) | v4}, 32u};
+}
+
+}
+
+std::optional<IpAddr> parse_ip(std::string_view s) {
+  auto a = parse_addr(s);
+  if (!a) return std::nullopt;
+  return a->first;
+}
+
+std::optional<Cidr> parse_cidr(std::string_view s) {
+  auto slash = s.find('/');
+  auto a = parse_addr(s.substr(0, slash));
+  if (!a) return std::nullopt;
+  auto [addr, max_len] = *a;
+  unsigned len = max_len;
+  if (slash != std::string_view::npos) {
+    auto t = trim(s.substr(slash + 1));
+    auto [p, ec] = std::from_chars(t.data(), t.data() + t.size(), len);
+    if (ec != std::errc() || p != t.data() + t.size() || t.empty() || len > max_len) return std::nullopt;
+  }
+  if (max_len == 32) len += 96;
+  return Cidr{mask(addr, len), static_cast<uint8_t>(len)};
+}
+
+IpAcl::IpAcl() { nodes_.push_back(Node{}); }
+
+uint32_t IpAcl::new_node(const IpAddr& key, uint8_t len, uint32_t entry) {
+  Node n;
+  n.key = key;
+  n.len = len;
+  n.entry = entry;
+  nodes_.push_back(n);
+  return static_cast<uint32_t>(nodes_.size() - 1);
+}
+
+uint32_t IpAcl::add_entry(Entry e) {
+  entries_.push_back(std::move(e));
+  return static_cast<uint32_t>(entries_.size() - 1);
+}
+
+bool IpAcl::insert(const Cidr& c, uint32_t entry) {
+  uint32_t cur = 0;
+  for (;;) {
+    // 不变式：c 的前 nodes_[cur].len 位与该节点一致
+    if (nodes_[cur].len == c.len) {
+      if (nodes_[cur].entry != kNone) return nodes_[cur].entry == entry;
+      nodes_[cur].entry = entry;
+      ++prefixes_;
+      return true;
+    }
+    int b = c.addr.bit(nodes_[cur].len);
+    uint32_t ch = nodes_[cur].child[b];
+    if (ch == kNone) {
+      uint32_t n = new_node(c.addr, c.len, entry);
+      nodes_[cur].child[b] = n;
+      ++prefixes_;
+      return true;
+    }
+    unsigned cpl = std::min({common_bits(c.addr, nodes_[ch].key), unsigned{c.len}, unsigned{nodes_[ch].len}});
+    if (cpl == nodes_[ch].len) { cur = ch; continue; }
+    // 在 cur 与 ch 之间插入分叉点：c 本身即分叉点，或新建一个无条目的中间节点
+    uint32_t mid;
+    if (cpl == c.len) {
+      mid = new_node(c.addr, c.len, entry);
+    } else {
+      mid = new_node(mask(c.addr, cpl), static_cast<uint8_t>(cpl), kNone);
+      uint32_t leaf = new_node(c.addr, c.len, entry);
+      nodes_[mid].child[c.addr.bit(cpl)] = leaf;
+    }
+    nodes_[mid].child[nodes_[ch].key.bit(cpl)] = ch;
+    nodes_[cur].child[b] = mid;
+    ++prefixes_;
+    return true;
+  }
+}
+
+const IpAcl::Entry* IpAcl::match(const IpAddr& a) const {
+  const Node* n = &nodes_[0];
+  uint32_t best = n->entry;
+  while (n->len < 128) {
+    uint32_t ch = n->child[a.bit(n->len)];
+    if (ch == kNone) break;
+    n = &nodes_[ch];
+    if (common_bits(a, n->key) < n->len) break;
+    if (n->entry != kNone) best = n->entry;
+  }
+  return best == kNone ? nullptr : &entries_[best];
+}
+
+std::shared_ptr<const IpAcl> IpAcl::load(pqxx::connection& conn) {
+  auto acl = std::make_shared<IpAcl>();
+  pqxx::read_transaction tx(conn);
+  // 同一 CIDR 出现在多个中继时按 trunk_id 保留最早的一条
+  auto rows = tx.exec(
+      "SELECT t.trunk_id, a.account_code, t.name, x.spec "
+      "FROM core.trunks t JOIN core.accounts a ON a.account_id=t.account_id "
+      "CROSS JOIN LATERAL ("
+      "  SELECT t.auth_data->>'ip' AS spec "
+      "  UNION ALL "
+      "  SELECT jsonb_array_elements_text(CASE WHEN jsonb_typeof(t.auth_data->'ips')='array' "
+      "                                   THEN t.auth_data->'ips' ELSE '[]'::jsonb END)"
+      ") x "
+      "WHERE t.auth_mode='ip' AND t.enabled=true AND x.spec IS NOT NULL "
+      "ORDER BY t.trunk_id");
+  size_t invalid = 0, duplicate = 0;
+  int64_t last_trunk = 0;
+  uint32_t entry = 0;
+  for (const auto& row : rows) {
+    int64_t trunk_id = row[0].as<int64_t>();
+    if (acl->entries_.empty() || trunk_id != last_trunk) {
+      entry = acl->add_entry({trunk_id, row[1].as<std::string>(), row[2].as<std::string>()});
+      last_trunk = trunk_id;
+    }
+    std::string_view spec = row[3].c_str();
+    while (!spec.empty()) {
+      auto comma = spec.find(',');
+      auto item = trim(spec.substr(0, comma));
+      spec = comma == std::string_view::npos ? std::string_view{} : spec.substr(comma + 1);
+      if (item.empty()) continue;
+      auto c = parse_cidr(item);
+      if (!c) {
+        ++invalid;
+        spdlog::warn("IP ACL: trunk {} has invalid address '{}'", trunk_id, item);
+        continue;
+      }
+      if (!acl->insert(*c, entry)) {
+        ++duplicate;
+        spdlog::warn("IP ACL: trunk {} address '{}' already bound to another trunk, ignored", trunk_id, item);
+      }
+    }
+  }
+  spdlog::info("IP ACL loaded: {} trunks, {} prefixes, {} nodes, {} invalid, {} duplicate",
+               acl->entries_.size(), acl->prefixes_, acl->nodes_.size(), invalid, duplicate);
+  return acl;
+}
+
+}
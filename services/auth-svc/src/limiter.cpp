@@ -0,0 +1,446 @@
+#include "limiter.hpp"
+#include <algorithm>
+#include <charconv>
+#include <iterator>
+#include <unordered_set>
+#include <spdlog/spdlog.h>
+#include "common/time.hpp"
+
+namespace hs::auth {
+
+namespace {
+
+int64_t steady_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 线程固定映射到一个分片，减少同一令牌桶上的 CAS 冲突
+size_t stripe_hint() {
+  static std::atomic<size_t> next{0};
+  thread_local size_t idx = next.fetch_add(1, std::memory_order_relaxed);
+  return idx;
+}
+
+uint32_t clamp_u32(int64_t v, uint32_t lo, uint32_t hi) {
+  return static_cast<uint32_t>(std::clamp<int64_t>(v, lo, hi));
+}
+
+}
+
+Limiter::Limiter(hs::RedisClient* redis, Options opt) : redis_(redis), opt_(std::move(opt)) {
+  if (opt_.nodes == 0) opt_.nodes = 1;
+  auto& reg = hs::metrics::registry();
+  lease_rtt_ = &hs::RedisClient::rtt("limit_lease");
+  sync_rtt_ = &hs::RedisClient::rtt("limit_sync");
+  const char* help = "RiskEval limit decisions";
+  reg.counter_fn(this, "hs_limiter_decisions_total", help, hs::metrics::load(stats_.allowed), {{"verdict", "allowed"}});
+  reg.counter_fn(this, "hs_limiter_decisions_total", help, hs::metrics::load(stats_.rejected_cps), {{"verdict", "cps"}});
+  reg.counter_fn(this, "hs_limiter_decisions_total", help, hs::metrics::load(stats_.rejected_concurrent), {{"verdict", "concurrent"}});
+  reg.counter_fn(this, "hs_limiter_released_total", "Concurrency slots released", hs::metrics::load(stats_.released));
+  reg.counter_fn(this, "hs_limiter_expired_total", "Concurrency slots reclaimed by TTL", hs::metrics::load(stats_.expired));
+  reg.counter_fn(this, "hs_limiter_sync_errors_total", "Failed cluster syncs", hs::metrics::load(stats_.sync_errors));
+  reg.counter_fn(this, "hs_limiter_lease_misses_total", "CPS decisions made from the node's local share after the lease ran out", hs::metrics::load(stats_.lease_misses));
+  reg.counter_fn(this, "hs_limiter_degraded_total", "Decisions made locally while Redis was stale", hs::metrics::load(stats_.degraded));
+  reg.gauge_fn(this, "hs_limiter_active_calls", "Calls holding a concurrency slot", [this] { return static_cast<double>(active_calls()); });
+}
+
+Limiter::~Limiter() {
+  hs::metrics::registry().remove(this);
+  stop();
+}
+
+Limiter::Limits Limiter::load(pqxx::connection& conn) {
+  Limits l;
+  pqxx::read_transaction tx(conn);
+  for (const auto& row : tx.exec("SELECT account_code, max_cps, max_concurrent FROM core.accounts "
+                                 "WHERE max_cps>0 OR max_concurrent>0")) {
+    l.accounts[row[0].as<std::string>()] = {static_cast<uint32_t>(row[1].as<int>()), static_cast<uint32_t>(row[2].as<int>())};
+  }
+  hs::StringMap<int> ingress_count;
+  for (const auto& row : tx.exec("SELECT t.name, a.account_code, t.direction, GREATEST(t.max_cps,0), GREATEST(t.max_concurrent,0) "
+                                 "FROM core.trunks t JOIN core.accounts a ON a.account_id=t.account_id WHERE t.enabled=true")) {
+    auto name = row[0].as<std::string>();
+    Limit lim{static_cast<uint32_t>(row[3].as<int>()), static_cast<uint32_t>(row[4].as<int>())};
+    if (lim.max_cps || lim.max_concurrent) l.trunks[name] = lim;
+    if (std::string_view(row[2].c_str()) == "ingress") {
+      auto code = row[1].as<std::string>();
+      if (++ingress_count[code] == 1) l.account_ingress[code] = name;
+      else l.account_ingress.erase(code);
+    }
+  }
+  for (const auto& row : tx.exec("SELECT entry_id, max_cps, max_concurrent FROM routing.plan_entries "
+                                 "WHERE max_cps>0 OR max_concurrent>0")) {
+    l.entries[row[0].as<long long>()] = {static_cast<uint32_t>(row[1].as<int>()), static_cast<uint32_t>(row[2].as<int>())};
+  }
+  spdlog::info("Limits loaded: {} accounts, {} trunks, {} plan entries", l.accounts.size(), l.trunks.size(), l.entries.size());
+  return l;
+}
+
+Limiter::Counter* Limiter::counter(const std::string& key) {
+  auto& c = counters_[key];
+  if (!c) c = std::make_unique<Counter>(key);
+  return c.get();
+}
+
+void Limiter::apply(const Limits& limits) {
+  std::lock_guard<std::mutex> lk(reg_mu_);
+  auto ix = std::make_shared<Index>();
+  std::unordered_set<Counter*> touched;
+  auto set = [&](const std::string& key, const Limit& lim) {
+    Counter* c = counter(key);
+    c->max_cps.store(lim.max_cps, std::memory_order_relaxed);
+    c->max_concurrent.store(lim.max_concurrent, std::memory_order_relaxed);
+    touched.insert(c);
+    ix->limited.push_back(c);
+    return c;
+  };
+  for (const auto& [code, lim] : limits.accounts) ix->accounts.emplace(code, set("account:" + code, lim));
+  for (const auto& [name, lim] : limits.trunks) ix->trunks.emplace(name, set("trunk:" + name, lim));
+  for (const auto& [id, lim] : limits.entries) ix->entries.emplace(id, set("entry:" + std::to_string(id), lim));
+  for (const auto& [code, trunk] : limits.account_ingress) {
+    auto it = ix->trunks.find(trunk);
+    if (it != ix->trunks.end()) ix->account_ingress.emplace(code, it->second);
+  }
+  // 已删除或取消限额的计数器改为不限，进行中的通话仍按原指针归还
+  for (auto& [key, c] : counters_) {
+    if (touched.count(c.get())) continue;
+    c->max_cps.store(0, std::memory_order_relaxed);
+    c->max_concurrent.store(0, std::memory_order_relaxed);
+  }
+  index_.store(std::move(ix));
+}
+
+void Limiter::start() {
+  if (opt_.cluster) sync();
+  thread_ = std::jthread([this](std::stop_token st) { run(st); });
+}
+
+void Limiter::stop() {
+  if (thread_.joinable()) {
+    thread_.request_stop();
+    run_cv_.notify_all();
+    thread_.join();
+  }
+}
+
+bool Limiter::healthy(int64_t now_ms) const {
+  return now_ms - last_sync_ms_.load(std::memory_order_relaxed) <= opt_.max_stale.count();
+}
+
+bool Limiter::take_local(Counter* c, uint32_t rate, int64_t now_ns, Token& tok) {
+  uint32_t n = clamp_u32(rate / kStripeMinCps, 1, kStripes);
+  int64_t interval = int64_t{1'000'000'000} * n / rate;
+  // 每个分片的突发容量为其 1 秒的份额
+  int64_t tau = interval * std::max<int64_t>(1, rate / n);
+  size_t home = stripe_hint() % n;
+  for (size_t k = 0; k < n; ++k) {
+    size_t i = (home + k) % n;
+    auto& tat = c->stripes[i].tat;
+    int64_t t = tat.load(std::memory_order_relaxed);
+    for (;;) {
+      int64_t nt = std::max(t, now_ns) + interval;
+      if (nt - now_ns > tau) break;
+      if (tat.compare_exchange_weak(t, nt, std::memory_order_relaxed)) {
+        tok = {c, static_cast<int>(i), interval};
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool Limiter::take_lease(Counter* c, int64_t now_ms) {
+  auto s32 = static_cast<uint32_t>(now_ms / 1000);
+  uint64_t v = c->lease.load(std::memory_order_acquire);
+  while ((v >> 32) == s32 && (v & 0xffffffffu) != 0) {
+    if (c->lease.compare_exchange_weak(v, v - 1, std::memory_order_acq_rel)) return true;
+  }
+  return false;
+}
+
+// 只有第一个未命中的线程加锁通知，其余线程看到标志已置位直接返回
+void Limiter::wake_sync() {
+  if (sync_wanted_.exchange(true, std::memory_order_relaxed)) return;
+  std::lock_guard<std::mutex> lk(run_mu_);
+  run_cv_.notify_one();
+}
+
+void Limiter::lease(const std::vector<Want>& want, int64_t sec) {
+  auto pipe = redis_->get().pipeline(false);
+  for (const auto& [c, n, owed] : want) {
+    auto key = "limit:cps:" + c->key + ":" + std::to_string(sec);
+    pipe.incrby(key, n).expire(key, std::chrono::seconds(5));
+  }
+  auto t0 = std::chrono::steady_clock::now();
+  auto replies = pipe.exec();
+  lease_rtt_->record(std::chrono::steady_clock::now() - t0);
+  auto s32 = static_cast<uint32_t>(sec);
+  for (size_t i = 0; i < want.size(); ++i) {
+    auto [c, n, owed] = want[i];
+    long long total = replies.get<long long>(i * 2);
+    long long over = total - c->max_cps.load(std::memory_order_relaxed);
+    auto granted = static_cast<uint32_t>(n - std::clamp<long long>(over, 0, n));
+    if (granted < n) c->exhausted_sec.store(sec, std::memory_order_relaxed);
+    stats_.leases.fetch_add(1, std::memory_order_relaxed);
+    granted -= std::min(granted, owed);
+    if (granted == 0) continue;
+    uint64_t v = c->lease.load(std::memory_order_acquire), nv;
+    do {
+      nv = (v >> 32) == s32 ? v + granted : (uint64_t{s32} << 32) | granted;
+    } while (!c->lease.compare_exchange_weak(v, nv, std::memory_order_acq_rel));
+  }
+}
+
+bool Limiter::take_cps(Counter* c, int64_t now_ns, int64_t now_ms, Token& tok) {
+  uint32_t max = c->max_cps.load(std::memory_order_relaxed);
+  if (max == 0) return true;
+  c->demand.fetch_add(1, std::memory_order_relaxed);
+  if (!opt_.cluster) return take_local(c, max, now_ns, tok);
+  uint32_t share = (max + opt_.nodes - 1) / opt_.nodes;
+  if (healthy(now_ms)) {
+    if (take_lease(c, now_ms)) {
+      tok = {c, -1, 0};
+      return true;
+    }
+    // 本秒集群预算已用完
+    if (c->exhausted_sec.load(std::memory_order_relaxed) == now_ms / 1000) return false;
+    // 租约用完（如刚跨秒）：不在请求线程上等 Redis，按本节点份额判定并记账，由同步线程补租
+    stats_.lease_misses.fetch_add(1, std::memory_order_relaxed);
+    wake_sync();
+    if (!take_local(c, share, now_ns, tok)) return false;
+    c->borrowed.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+  stats_.degraded.fetch_add(1, std::memory_order_relaxed);
+  return take_local(c, share, now_ns, tok);
+}
+
+void Limiter::refund(const Token& tok) {
+  if (!tok.c) return;
+  if (tok.stripe < 0) tok.c->lease.fetch_add(1, std::memory_order_acq_rel);
+  else tok.c->stripes[tok.stripe].tat.fetch_sub(tok.interval, std::memory_order_relaxed);
+}
+
+bool Limiter::take_concurrent(Counter* c, int64_t now_ms) {
+  int64_t max = c->max_concurrent.load(std::memory_order_relaxed);
+  int32_t v = c->concurrent.fetch_add(1, std::memory_order_acq_rel) + 1;
+  if (max == 0) return true;
+  int64_t limit = max;
+  if (opt_.cluster) {
+    if (healthy(now_ms)) limit -= c->remote_concurrent.load(std::memory_order_relaxed);
+    else limit = (limit + opt_.nodes - 1) / opt_.nodes;
+  }
+  // 观测值为全集群在途数，与未经本节点计数的通话一起比较完整上限
+  if (v <= limit && (!observed_ || observed_->live(c->key) < max)) return true;
+  c->concurrent.fetch_sub(1, std::memory_order_acq_rel);
+  return false;
+}
+
+Limiter::Decision Limiter::acquire(const Request& r) {
+  const Index* ix = index_.read();
+  if (!ix) return {};
+
+  std::array<Counter*, kSlots> want{};
+  std::array<bool, kSlots> named{};
+  auto find = [](const auto& map, const auto& key) -> Counter* {
+    auto it = map.find(key);
+    return it == map.end() ? nullptr : it->second;
+  };
+  named[0] = !r.account_code.empty();
+  if (named[0]) want[0] = find(ix->accounts, r.account_code);
+  if (!r.ingress_trunk.empty()) {
+    named[1] = true;
+    want[1] = find(ix->trunks, r.ingress_trunk);
+  } else if (named[0]) {
+    want[1] = find(ix->account_ingress, r.account_code);
+    named[1] = want[1] != nullptr;
+  }
+  named[2] = r.plan_entry_id != 0;
+  if (named[2]) want[2] = find(ix->entries, r.plan_entry_id);
+  named[3] = !r.egress_trunk.empty();
+  if (named[3]) want[3] = find(ix->trunks, r.egress_trunk);
+
+  int64_t now_ns = steady_ns();
+  int64_t now_ms = hs::now_epoch_ms();
+  std::array<Token, kSlots> toks{};
+  auto reject = [&](Verdict v, Counter* c) {
+    for (const auto& t : toks) refund(t);
+    (v == Verdict::kCps ? stats_.rejected_cps : stats_.rejected_concurrent).fetch_add(1, std::memory_order_relaxed);
+    return Decision{v, c->key};
+  };
+
+  // 无 call_id：只检查，不占用并发名额
+  if (r.call_id.empty()) {
+    for (size_t i = 0; i < kSlots; ++i)
+      if (want[i] && !take_cps(want[i], now_ns, now_ms, toks[i])) return reject(Verdict::kCps, want[i]);
+    for (size_t i = 0; i < kSlots; ++i) {
+      if (!want[i]) continue;
+      if (!take_concurrent(want[i], now_ms)) return reject(Verdict::kConcurrent, want[i]);
+      want[i]->concurrent.fetch_sub(1, std::memory_order_acq_rel);
+    }
+    stats_.allowed.fetch_add(1, std::memory_order_relaxed);
+    return {};
+  }
+
+  // 同一通话重复评估（如改选路由）：已占用的计数器不再计费，改选的槽位归还原计数器
+  auto& sh = calls_[std::hash<std::string_view>{}(r.call_id) % kCallShards];
+  std::lock_guard<std::mutex> lk(sh.mu);
+  auto it = sh.map.find(r.call_id);
+  Held* held = it == sh.map.end() ? nullptr : &it->second;
+  std::array<bool, kSlots> need{};
+  for (size_t i = 0; i < kSlots; ++i) need[i] = want[i] && (!held || held->slots[i] != want[i]);
+
+  for (size_t i = 0; i < kSlots; ++i)
+    if (need[i] && !take_cps(want[i], now_ns, now_ms, toks[i])) return reject(Verdict::kCps, want[i]);
+  for (size_t i = 0; i < kSlots; ++i) {
+    if (!need[i] || take_concurrent(want[i], now_ms)) continue;
+    for (size_t j = 0; j < i; ++j)
+      if (need[j]) want[j]->concurrent.fetch_sub(1, std::memory_order_acq_rel);
+    return reject(Verdict::kConcurrent, want[i]);
+  }
+
+  Held next = held ? *held : Held{};
+  for (size_t i = 0; i < kSlots; ++i) {
+    if (!named[i] || next.slots[i] == want[i]) continue;
+    if (next.slots[i]) next.slots[i]->concurrent.fetch_sub(1, std::memory_order_acq_rel);
+    next.slots[i] = want[i];
+  }
+  next.expire_ms = now_ms + std::chrono::duration_cast<std::chrono::milliseconds>(opt_.call_ttl).count();
+  bool any = std::any_of(next.slots.begin(), next.slots.end(), [](Counter* c) { return c != nullptr; });
+  if (held) {
+    if (any) *held = next;
+    else sh.map.erase(it);
+  } else if (any) {
+    sh.map.emplace(std::string(r.call_id), next);
+  }
+  stats_.allowed.fetch_add(1, std::memory_order_relaxed);
+  return {};
+}
+
+bool Limiter::release(std::string_view call_id) {
+  auto& sh = calls_[std::hash<std::string_view>{}(call_id) % kCallShards];
+  std::lock_guard<std::mutex> lk(sh.mu);
+  auto it = sh.map.find(call_id);
+  if (it == sh.map.end()) return false;
+  for (Counter* c : it->second.slots)
+    if (c) c->concurrent.fetch_sub(1, std::memory_order_acq_rel);
+  sh.map.erase(it);
+  stats_.released.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+size_t Limiter::active_calls() const {
+  size_t n = 0;
+  for (auto& sh : calls_) {
+    std::lock_guard<std::mutex> lk(sh.mu);
+    n += sh.map.size();
+  }
+  return n;
+}
+
+void Limiter::sweep(int64_t now_ms) {
+  for (auto& sh : calls_) {
+    std::lock_guard<std::mutex> lk(sh.mu);
+    for (auto it = sh.map.begin(); it != sh.map.end();) {
+      if (it->second.expire_ms > now_ms) { ++it; continue; }
+      for (Counter* c : it->second.slots)
+        if (c) c->concurrent.fetch_sub(1, std::memory_order_acq_rel);
+      it = sh.map.erase(it);
+      stats_.expired.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+}
+
+void Limiter::sync() {
+  const Index* ix = index_.read();
+  int64_t now_ms = hs::now_epoch_ms();
+  int64_t sec = now_ms / 1000;
+  auto s32 = static_cast<uint32_t>(sec);
+  std::vector<Want> want;
+  std::vector<Counter*> conc;
+  if (ix) {
+    for (Counter* c : ix->limited) {
+      uint32_t d = c->demand.exchange(0, std::memory_order_relaxed);
+      uint32_t max = c->max_cps.load(std::memory_order_relaxed);
+      uint32_t owed = c->borrowed.exchange(0, std::memory_order_relaxed);
+      if (max && (d || owed) && c->exhausted_sec.load(std::memory_order_relaxed) != sec) {
+        uint64_t v = c->lease.load(std::memory_order_relaxed);
+        uint32_t left = (v >> 32) == s32 ? static_cast<uint32_t>(v) : 0;
+        // 按上一周期的需求预租约两个周期的量，空闲计数器不占用集群预算；按份额准入的令牌一并计入
+        if (left < d || owed) want.push_back({c, clamp_u32(int64_t{d} * 2, 1, max) + owed, owed});
+      }
+      if (c->max_concurrent.load(std::memory_order_relaxed) &&
+          (d || c->concurrent.load(std::memory_order_relaxed) || c->reported.load(std::memory_order_relaxed)))
+        conc.push_back(c);
+    }
+  }
+  try {
+    if (!want.empty()) lease(want, sec);
+    if (!conc.empty()) {
+      auto pipe = redis_->get().pipeline(false);
+      for (Counter* c : conc) {
+        auto key = "limit:conc:" + c->key;
+        pipe.hset(key, opt_.node_id, std::to_string(c->concurrent.load(std::memory_order_relaxed)) + ":" + std::to_string(now_ms))
+            .hgetall(key)
+            .expire(key, std::chrono::seconds(60));
+      }
+      auto t0 = std::chrono::steady_clock::now();
+      auto replies = pipe.exec();
+      sync_rtt_->record(std::chrono::steady_clock::now() - t0);
+      for (size_t i = 0; i < conc.size(); ++i) {
+        std::unordered_map<std::string, std::string> nodes;
+        replies.get(i * 3 + 1, std::inserter(nodes, nodes.end()));
+        int64_t others = 0;
+        for (const auto& [node, v] : nodes) {
+          if (node == opt_.node_id) continue;
+          // "<并发>:<上报时刻>"，超过 max_stale 未更新的节点视为已下线
+          auto colon = v.find(':');
+          int64_t count = 0, ts = 0;
+          if (colon == std::string::npos) continue;
+          std::from_chars(v.data(), v.data() + colon, count);
+          std::from_chars(v.data() + colon + 1, v.data() + v.size(), ts);
+          if (now_ms - ts <= opt_.max_stale.count()) others += count;
+        }
+        conc[i]->remote_concurrent.store(static_cast<int32_t>(others), std::memory_order_relaxed);
+        conc[i]->reported.store(conc[i]->concurrent.load(std::memory_order_relaxed) != 0, std::memory_order_relaxed);
+      }
+    }
+    if (want.empty() && conc.empty()) redis_->get().ping();
+    if (!healthy(now_ms)) spdlog::info("Limiter cluster sync recovered");
+    last_sync_ms_.store(now_ms, std::memory_order_relaxed);
+    stats_.syncs.fetch_add(1, std::memory_order_relaxed);
+  } catch (const std::exception& ex) {
+    if (stats_.sync_errors.fetch_add(1, std::memory_order_relaxed) % 100 == 0)
+      spdlog::warn("Limiter cluster sync failed (last ok {}ms ago): {}", now_ms - last_sync_ms_.load(), ex.what());
+  }
+}
+
+void Limiter::run(std::stop_token st) {
+  auto next_sweep = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+  auto next_report = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+  auto interval = opt_.cluster ? opt_.sync_interval : std::chrono::milliseconds(1000);
+  while (!st.stop_requested()) {
+    {
+      std::unique_lock<std::mutex> lk(run_mu_);
+      run_cv_.wait_for(lk, st, interval, [this] { return sync_wanted_.load(std::memory_order_relaxed); });
+    }
+    if (st.stop_requested()) break;
+    sync_wanted_.store(false, std::memory_order_relaxed);
+    if (opt_.cluster) sync();
+    auto now = std::chrono::steady_clock::now();
+    if (now >= next_sweep) {
+      next_sweep = now + std::chrono::seconds(1);
+      sweep(hs::now_epoch_ms());
+    }
+    if (now >= next_report) {
+      next_report = now + std::chrono::seconds(60);
+      spdlog::info("Limiter: allowed={} rejected_cps={} rejected_concurrent={} active_calls={} released={} expired={} "
+                   "syncs={} sync_errors={} leases={} lease_misses={} degraded={}",
+                   stats_.allowed.load(), stats_.rejected_cps.load(), stats_.rejected_concurrent.load(), active_calls(),
+                   stats_.released.load(), stats_.expired.load(), stats_.syncs.load(), stats_.sync_errors.load(),
+                   stats_.leases.load(), stats_.lease_misses.load(), stats_.degraded.load());
+    }
+  }
+}
+
+}
@@ -1,9 +1,13 @@
-#include <grpcpp/grpcpp.h>
+#include <unistd.h>
 #include <spdlog/spdlog.h>
 #include "common/env.hpp"
+#include "common/live_calls.hpp"
 #include "common/log.hpp"
+#include "common/metrics.hpp"
 #include "common/pg.hpp"
+#include "common/pg_listener.hpp"
 #include "common/redis.hpp"
+#include "common/rpc_server.hpp"
 #include "auth_service_impl.hpp"
 
 int main(int argc, char** argv) {
@@ -12,16 +16,48 @@ int main(int argc, char** argv) {
   std::string redis_uri = hs::get_env("REDIS_URI", "tcp://localhost:6379");
   std::string bind = hs::get_env("BIND", "0.0.0.0:7004");
 
-  hs::Pg pg(pg_uri);
+  hs::Pg pg(pg_uri, hs::get_env_int("PG_POOL_SIZE", 8), std::chrono::milliseconds(hs::get_env_int("PG_POOL_TIMEOUT_MS", 2000)));
   hs::RedisClient redis(redis_uri);
 
-  hs::auth::AuthServiceImpl svc(&pg, &redis);
+  hs::auth::Limiter::Options lopt;
+  lopt.cluster = hs::get_env("LIMIT_MODE", "local") == "cluster";
+  lopt.node_id = hs::get_env("LIMIT_NODE_ID", hs::get_env("HOSTNAME", "auth-svc") + ":" + std::to_string(::getpid()));
+  lopt.nodes = static_cast<uint32_t>(hs::get_env_int("LIMIT_CLUSTER_NODES", 1));
+  lopt.sync_interval = std::chrono::milliseconds(hs::get_env_int("LIMIT_SYNC_MS", 50));
+  lopt.max_stale = std::chrono::milliseconds(hs::get_env_int("LIMIT_MAX_STALE_MS", 2000));
+  lopt.call_ttl = std::chrono::seconds(hs::get_env_int("LIMIT_CALL_TTL_S", 10800));
+  hs::auth::Limiter limiter(&redis, lopt);
+  hs::LiveCalls::Options vopt;
+  vopt.refresh_interval = std::chrono::milliseconds(hs::get_env_int("LIVE_CALLS_REFRESH_MS", 1000));
+  vopt.max_stale = std::chrono::milliseconds(hs::get_env_int("LIVE_CALLS_MAX_STALE_MS", 10000));
+  hs::LiveCalls live(&redis, vopt);
+  live.start();
+  limiter.set_observed(&live);
+  hs::auth::AuthServiceImpl svc(&pg, &limiter);
 
-  grpc::ServerBuilder builder;
-  builder.AddListeningPort(bind, grpc::InsecureServerCredentials());
-  builder.RegisterService(&svc);
-  auto server = builder.BuildAndStart();
+  // 先 LISTEN 再全量加载；中继与限额条目数量有限，任何变更都整体重建
+  hs::PgListener listener(pg_uri);
+  listener.subscribe("hs_auth", [&](const std::vector<std::string>&) { svc.reload(); });
+  listener.on_resync([&] { svc.reload(); });
+  listener.start();
+  svc.reload();
+  limiter.start();
+
+  // 三个方法都只访问内存结构，直接在完成队列线程上执行
+  using hyperswitch::auth::AuthService;
+  AuthService::AsyncService rpc_svc;
+  hs::rpc::Options ropt;
+  ropt.bind = bind;
+  hs::rpc::Server server(hs::rpc::options_from_env(ropt));
+  server.unary("SipAuth", &rpc_svc, &AuthService::AsyncService::RequestSipAuth,
+               [&](auto* ctx, auto* req, auto* resp) { return svc.SipAuth(ctx, req, resp); });
+  server.unary("RiskEval", &rpc_svc, &AuthService::AsyncService::RequestRiskEval,
+               [&](auto* ctx, auto* req, auto* resp) { return svc.RiskEval(ctx, req, resp); });
+  server.unary("ReleaseCall", &rpc_svc, &AuthService::AsyncService::RequestReleaseCall,
+               [&](auto* ctx, auto* req, auto* resp) { return svc.ReleaseCall(ctx, req, resp); });
+  server.start();
+  hs::metrics::Exporter metrics(hs::get_env("METRICS_BIND", "0.0.0.0:9104"));
   spdlog::info("auth-svc listening on {}", bind);
-  server->Wait();
+  server.wait();
   return 0;
 }
\ No newline at end of file
@@ -1,17 +1,48 @@
 #pragma once
 #include <hyperswitch/billing/billing.grpc.pb.h>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "common/call_registry.hpp"
+#include "common/number_plan.hpp"
 #include "common/pg.hpp"
+#include "common/rpc_server.hpp"
+#include "common/snapshot.hpp"
+#include "ledger.hpp"
+#include "rate_engine.hpp"
 
 namespace hs::billing {
 
-class BillingServiceImpl final : public hyperswitch::billing::BillingService::Service {
+class BillingServiceImpl {
 public:
-  explicit BillingServiceImpl(hs::Pg* pg);
-  ::grpc::Status Authorize(::grpc::ServerContext*, const hyperswitch::billing::AuthorizeRequest*, hyperswitch::billing::AuthorizeResponse*) override;
-  ::grpc::Status Rate(::grpc::ServerContext*, const hyperswitch::billing::RateRequest*, hyperswitch::billing::RateResponse*) override;
-  ::grpc::Status Settle(::grpc::ServerContext*, const hyperswitch::billing::SettleRequest*, hyperswitch::billing::SettleResponse*) override;
+  // numbers 非空时 Rate 返回目的地分类；reject_invalid 时无效号码的 Rate 返回 INVALID_ARGUMENT、Authorize 拒绝
+  BillingServiceImpl(hs::Pg* pg, Ledger* ledger, hs::CallRegistry* calls, int rate_history_days, hs::Money min_reserve,
+                     const hs::NumberPlan* numbers = nullptr, bool reject_invalid = true);
+  // Authorize / Settle 在内存中判定后挂起，账本批次提交后由写线程经 done 写回
+  void Authorize(::grpc::ServerContext*, const hyperswitch::billing::AuthorizeRequest*, hyperswitch::billing::AuthorizeResponse*, hs::rpc::Done done);
+  ::grpc::Status Rate(::grpc::ServerContext*, const hyperswitch::billing::RateRequest*, hyperswitch::billing::RateResponse*);
+  // 双向流的一条消息
+  ::grpc::Status RateBatch(::grpc::ServerContext*, const hyperswitch::billing::RateBatchRequest&, hyperswitch::billing::RateBatchResponse&);
+  void Settle(::grpc::ServerContext*, const hyperswitch::billing::SettleRequest*, hyperswitch::billing::SettleResponse*, hs::rpc::Done done);
+  // 全量重建费率快照
+  void reload();
+  // 从快照文件加载费率并发布；文件缺失、损坏或过旧时记录告警并返回 false，由调用方走 PostgreSQL 全量加载
+  bool load_snapshot(const std::string& path, int64_t max_age_s);
+  // 当前费率快照写入文件，自上次写入后未变化时跳过；只由快照维护线程调用
+  void save_snapshot(const std::string& path);
+  // 处理 hs_billing 通道的变更通知：按账户增量重建
+  void apply_changes(const std::vector<std::string>& payloads);
 private:
   hs::Pg* pg_;
+  Ledger* ledger_;
+  hs::CallRegistry* calls_; // Authorize 登记、Settle 注销的在途通话
+  int history_days_;
+  hs::Money min_reserve_;
+  const hs::NumberPlan* numbers_;
+  bool reject_invalid_;
+  hs::Snapshot<RateEngine> rates_;
+  std::mutex reload_mu_;
+  uint64_t saved_version_ = 0;
 };
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,157 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <pqxx/pqxx>
+#include "common/hash.hpp"
+#include "common/metrics.hpp"
+#include "common/money.hpp"
+#include "common/pg.hpp"
+
+namespace hs::billing {
+
+// 账户内存账本：余额、授信与未结预授权在内存中判定，变更以日志形式交给单个写线程，
+// 按批在一个事务内提交（预授权、按账户聚合的余额扣减 / 后付账单、ledger_journal）。
+// 调用方的回调在所属批次提交后由写线程调用，等待期间不占用调用线程；提交失败时丢弃内存状态并从 PostgreSQL 重新恢复。
+class Ledger {
+public:
+  struct Options {
+    size_t batch_max = 2000;
+    std::chrono::seconds reserve_ttl{14400};  // 超时未结算的预授权作废
+    std::chrono::seconds settled_keep{3600};  // 已结算 token 在内存中保留时长（幂等重放）
+  };
+
+  struct Stats {
+    std::atomic<uint64_t> batches{0};
+    std::atomic<uint64_t> entries{0};
+    std::atomic<uint64_t> commit_ns{0};
+    std::atomic<uint64_t> failures{0};
+    std::atomic<uint64_t> max_batch{0};
+  };
+
+  enum class Result { Ok, NotFound, Insufficient, Unavailable };
+
+  struct Authorization {
+    std::string token;
+    std::string currency;
+  };
+
+  struct Settlement {
+    hs::Money amount;
+    bool replay = false; // 重复结算，返回首次结果
+  };
+
+  Ledger(hs::Pg* pg, Options opt);
+  ~Ledger();
+
+  // 从 PostgreSQL 恢复账户余额与 open 状态的预授权，然后启动写线程
+  void start();
+  void stop();
+
+  // 结果在内存中即可确定（账户不存在、余额不足、重复结算）时在调用线程回调，否则在批次提交后由写线程回调；
+  // 回调中不能再调用 Ledger。结算需要查库（token 不在内存中）时在调用线程同步查询
+  using ReserveDone = std::function<void(Result, const Authorization&)>;
+  using SettleDone = std::function<void(Result, const Settlement&)>;
+  void reserve(std::string_view account_code, std::string_view call_id, hs::Money amount, ReserveDone done);
+  void settle(std::string_view token, hs::Money amount, SettleDone done);
+  // 账户变更通知：先提交在途日志，再从库中刷新指定账户；ids 为空时全量恢复
+  void refresh(const std::unordered_set<int64_t>& account_ids);
+
+  const Stats& stats() const { return stats_; }
+
+private:
+  struct Account {
+    int64_t account_id = 0;
+    std::string code;
+    std::string currency;
+    bool prepaid = true;
+    hs::Money balance;
+    hs::Money credit;
+    hs::Money reserved;  // 未结预授权合计，仅存在于内存，由 open 预授权推导
+    std::mutex mu;
+  };
+  struct Reservation {
+    int64_t account_id = 0;
+    hs::Money amount;
+    int64_t created_ms = 0;
+    bool settled = false;
+    hs::Money final_amount;
+    int64_t settled_ms = 0;
+  };
+  struct Shard {
+    std::mutex mu;
+    hs::StringMap<Reservation> tokens;
+  };
+  enum class Kind : uint8_t { Reserve, Settle, Void };
+  struct Entry {
+    Kind kind;
+    bool prepaid;
+    int64_t account_id;
+    std::string token;
+    std::string call_id;
+    std::string currency;
+    hs::Money amount;
+    std::function<void(bool)> done;  // 提交结果，作废日志为空
+  };
+  static constexpr size_t kShards = 64;
+
+  Shard& shard(std::string_view token) { return shards_[hs::StringHash{}(token) % kShards]; }
+  Account* by_id(int64_t id) const;
+  // 调用方持有 mu_（共享）与相关账户锁，保证同一账户的日志按内存生效顺序入队
+  void enqueue(Entry e);
+  // 已入队返回 nullopt 并取走 done；token 不在内存中返回 NotFound
+  std::optional<Result> settle_hot(std::string_view token, hs::Money amount, Settlement& out, SettleDone& done);
+  void settle_cold(std::string_view token, hs::Money amount, SettleDone done);
+  static void notify(std::vector<Entry>& batch, bool ok);
+
+  void run(std::stop_token st);
+  // 一个事务提交一批日志并通知调用方，失败返回 false
+  bool write(std::vector<Entry>& batch);
+  // 持有 mu_（独占）时提交队列中全部日志
+  bool flush_locked();
+  void fail_pending();
+  // 持有 mu_（独占）；only 为空时全量恢复（含 open 预授权），否则只刷新指定账户的余额与属性
+  void recover_locked(const std::unordered_set<int64_t>* only);
+  void expire(int64_t now_ms);
+
+  hs::Pg* pg_;
+  Options opt_;
+  Stats stats_;
+  struct Latency {
+    hs::metrics::Histogram* auth_open;
+    hs::metrics::Histogram* auth_close;
+    hs::metrics::Histogram* balance_debit;
+    hs::metrics::Histogram* invoice_add;
+    hs::metrics::Histogram* journal_add;
+    hs::metrics::Histogram* auth_lookup;
+    hs::metrics::Histogram* commit;  // 整批：借出连接至提交完成
+  } latency_;
+
+  std::shared_mutex mu_; // 共享：内存记账；独占：恢复 / 刷新
+  bool healthy_ = false;
+  std::unordered_map<int64_t, std::unique_ptr<Account>> accounts_;
+  hs::StringMap<Account*> by_code_;
+  std::array<Shard, kShards> shards_;
+
+  std::mutex queue_mu_;
+  std::condition_variable queue_cv_;
+  std::vector<Entry> queue_;
+  std::unordered_set<int64_t> refresh_ids_;
+  bool refresh_all_ = false;
+  std::jthread thread_;
+};
+
+}
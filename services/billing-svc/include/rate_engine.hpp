@@ -0,0 +1,91 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <pqxx/pqxx>
+#include "common/hash.hpp"
+#include "common/money.hpp"
+#include "common/prefix_trie.hpp"
+
+namespace hs::billing {
+
+struct RateItem {
+  hs::Money price_per_min;
+  uint32_t step_sec;
+  uint32_t min_time_sec;
+  hs::Money connection_fee;
+  hs::Rounding rounding;
+  std::string prefix;
+};
+
+// 一张费率表（一个版本）：trie 节点 value 为 items 下标
+struct RateDeck {
+  int64_t rate_table_id = 0;
+  std::string name;
+  std::string currency;
+  int64_t effective_from = 0; // epoch 秒
+  int64_t effective_to = 0;   // 0 表示无截止
+  hs::PrefixTrie trie;
+  std::vector<RateItem> items;
+};
+
+struct AccountRates {
+  int64_t account_id = 0;
+  std::string account_code;
+  std::string currency;
+  bool prepaid = true;
+  std::vector<std::shared_ptr<const RateDeck>> decks; // effective_from 降序
+};
+
+enum class RateStatus { Ok, NoRateTable, NoRate };
+
+struct RateQuote {
+  const AccountRates* account = nullptr;
+  const RateDeck* deck = nullptr;
+  const RateItem* item = nullptr;
+  hs::Money amount;
+};
+
+// 费率快照：账户 → 按生效时间排序的费率表 → 前缀索引；计算全部为定点运算
+class RateEngine {
+public:
+  // history_days：已失效但仍需用于 as_of 重算的费率表保留天数
+  static std::shared_ptr<const RateEngine> load(pqxx::connection& conn, int history_days);
+  // 增量重建指定账户，其余账户与当前快照共享
+  std::shared_ptr<const RateEngine> reload(pqxx::connection& conn, const std::unordered_set<int64_t>& account_ids) const;
+  // 快照文件（common/snapshot_file.hpp）：冷启动时先从文件加载，再从 PostgreSQL 追平；
+  // 文件损坏、版本不符或早于 max_age_s 秒（> 0 时）时抛出
+  static std::shared_ptr<const RateEngine> load_file(const std::string& path, int history_days, int64_t max_age_s = 0);
+  void save(const std::string& path) const;
+
+  const AccountRates* account(std::string_view account_code) const;
+  // rate_table 非空时只匹配同名费率表；否则取 as_of 时刻生效且 effective_from 最新的一张
+  const RateDeck* deck(const AccountRates& acct, int64_t as_of_epoch, std::string_view rate_table) const;
+  // 最长前缀匹配
+  const RateItem* match(const RateDeck& deck, std::string_view e164) const;
+  // 账户 → 费率表 → 前缀 → 金额，一次完成
+  RateStatus quote(std::string_view account_code, std::string_view e164, uint32_t billsec, int64_t as_of_epoch,
+                   std::string_view rate_table, RateQuote& out) const;
+  // rate_table_id 所属账户，未知返回 0
+  int64_t account_of_table(int64_t rate_table_id) const;
+
+  // 计费：不足 min_time 按 min_time；时长向上取整到计费步长，金额按 rounding 取整到 1e-6
+  static hs::Money charge(const RateItem& item, uint32_t billsec);
+
+private:
+  using AccountMap = hs::StringMap<std::shared_ptr<const AccountRates>>;
+  static size_t load_accounts(pqxx::transaction_base& tx, int history_days, const std::unordered_set<int64_t>* only,
+                              AccountMap& out, std::unordered_map<int64_t, std::string>& codes,
+                              std::unordered_map<int64_t, int64_t>& tables);
+
+  int history_days_ = 0;
+  AccountMap accounts_;
+  std::unordered_map<int64_t, std::string> codes_;  // account_id → account_code
+  std::unordered_map<int64_t, int64_t> tables_;     // rate_table_id → account_id
+};
+
+}
@@ -1,7 +1,9 @@
 #include "billing_service_impl.hpp"
 #include <spdlog/spdlog.h>
-#include <pqxx/pqxx>
-#include <random>
+#include <algorithm>
+#include <unordered_set>
+#include "common/number.hpp"
+#include "common/time.hpp"
 
 using hyperswitch::billing::AuthorizeRequest;
 using hyperswitch::billing::AuthorizeResponse;
@@ -9,136 +11,235 @@ using hyperswitch::billing::RateRequest;
 using hyperswitch::billing::RateResponse;
 using hyperswitch::billing::SettleRequest;
 using hyperswitch::billing::SettleResponse;
+using hyperswitch::billing::RateBatchRequest;
+using hyperswitch::billing::RateBatchResponse;
 
 namespace hs::billing {
 
-static std::string gen_token(){
-  static const char* al = "0123456789abcdef";
-  std::random_device rd; std::mt19937_64 g(rd());
-  std::uniform_int_distribution<int> d(0,15);
-  std::string s(32,'0'); for (auto &c: s) c = al[d(g)]; return s;
-}
+BillingServiceImpl::BillingServiceImpl(hs::Pg* pg, Ledger* ledger, hs::CallRegistry* calls, int rate_history_days, hs::Money min_reserve,
+                                       const hs::NumberPlan* numbers, bool reject_invalid)
+  : pg_(pg), ledger_(ledger), calls_(calls), history_days_(rate_history_days), min_reserve_(min_reserve),
+    numbers_(numbers), reject_invalid_(reject_invalid) {}
 
-BillingServiceImpl::BillingServiceImpl(hs::Pg* pg) : pg_(pg) {}
+// 号码计划分类；未加载号码计划时返回空匹配
+static hs::NumberPlan::Match classify(const hs::NumberPlan* numbers, std::string_view e164) {
+  return numbers ? numbers->classify(e164) : hs::NumberPlan::Match{};
+}
 
-::grpc::Status BillingServiceImpl::Authorize(::grpc::ServerContext*, const AuthorizeRequest* req, AuthorizeResponse* resp){
+void BillingServiceImpl::Authorize(::grpc::ServerContext*, const AuthorizeRequest* req, AuthorizeResponse* resp, hs::rpc::Done done) {
   try {
-    pqxx::work tx(pg_->conn());
-    auto r = tx.exec_params("SELECT account_id, prepaid, balance, credit_limit, currency FROM core.accounts WHERE account_code=$1", req->account_code());
-    if (r.empty()) return {::grpc::StatusCode::NOT_FOUND, "account not found"};
-    auto acc_id = r[0][0].as<long long>();
-    bool prepaid = r[0][1].as<bool>();
-    double balance = r[0][2].as<double>();
-    double credit = r[0][3].as<double>();
-    std::string ccy = r[0][4].as<std::string>();
-
-    double budget = 0.01; // 最小预授权
-    bool allowed = prepaid ? (balance > budget) : (balance + credit > budget);
-    resp->set_allowed(allowed);
-    if (!allowed) { resp->set_reason("insufficient funds"); return ::grpc::Status::OK; }
+    // 预授权额：expected_secs 按目的地费率计价，不低于 min_reserve_
+    hs::Money amount = min_reserve_;
+    if (!req->e164_to().empty()) {
+      hs::number::E164 dest;
+      if (hs::number::normalize(req->e164_to(), dest) != hs::number::Status::Ok ||
+          (numbers_ && reject_invalid_ && !classify(numbers_, dest.view()).valid())) {
+        resp->set_allowed(false);
+        resp->set_reason("invalid destination number");
+        return done(::grpc::Status::OK);
+      }
+      const RateEngine* eng = rates_.read();
+      if (!eng) return done({::grpc::StatusCode::UNAVAILABLE, "rate engine not loaded"});
+      RateQuote q;
+      switch (eng->quote(req->account_code(), dest.view(), req->expected_secs(), hs::now_epoch_ms() / 1000, {}, q)) {
+        case RateStatus::NoRateTable:
+          if (!q.account) return done({::grpc::StatusCode::NOT_FOUND, "account not found"});
+          resp->set_allowed(false);
+          resp->set_reason("rate table not found");
+          return done(::grpc::Status::OK);
+        case RateStatus::NoRate:
+          resp->set_allowed(false);
+          resp->set_reason("no rate for destination");
+          return done(::grpc::Status::OK);
+        case RateStatus::Ok:
+          amount = std::max(amount, q.amount);
+          break;
+      }
+    }
 
-    std::string token = gen_token();
-    tx.exec_params("INSERT INTO billing.authorizations(call_id,account_id,token,amount,currency,status) VALUES($1,$2,$3,$4,$5,'open')",
-                   req->call_id(), acc_id, token, budget, ccy);
-    tx.commit();
-    resp->set_auth_token(token);
-    resp->set_authorized_amount(budget);
-    return ::grpc::Status::OK;
+    ledger_->reserve(req->account_code(), req->call_id(), amount,
+                     [this, req, resp, amount, done](Ledger::Result r, const Ledger::Authorization& auth) {
+      switch (r) {
+        case Ledger::Result::NotFound: return done({::grpc::StatusCode::NOT_FOUND, "account not found"});
+        case Ledger::Result::Unavailable: return done({::grpc::StatusCode::UNAVAILABLE, "ledger unavailable"});
+        case Ledger::Result::Insufficient:
+          resp->set_allowed(false);
+          resp->set_reason("insufficient funds");
+          return done(::grpc::Status::OK);
+        case Ledger::Result::Ok: break;
+      }
+      if (!req->call_id().empty())
+        calls_->open(req->call_id(), {.account = req->account_code()}, calls_->options().ttl);
+      resp->set_allowed(true);
+      resp->set_auth_token(auth.token);
+      resp->set_authorized_amount(amount.to_double());
+      resp->set_authorized_amount_exact(amount.str());
+      done(::grpc::Status::OK);
+    });
   } catch (const std::exception& ex) {
     spdlog::error("Authorize error: {}", ex.what());
-    return {::grpc::StatusCode::INTERNAL, ex.what()};
+    done({::grpc::StatusCode::INTERNAL, ex.what()});
+  }
+}
+
+static ::grpc::Status rate_one(const RateEngine& eng, const hs::NumberPlan* numbers, bool reject_invalid,
+                               const RateRequest& req, RateResponse* resp) {
+  hs::number::E164 dest;
+  if (hs::number::normalize(req.e164_to(), dest) != hs::number::Status::Ok)
+    return {::grpc::StatusCode::INVALID_ARGUMENT, "invalid destination number"};
+  auto m = classify(numbers, dest.view());
+  if (numbers && reject_invalid && !m.valid()) return {::grpc::StatusCode::INVALID_ARGUMENT, "invalid destination number"};
+  int64_t as_of = hs::now_epoch_ms() / 1000;
+  if (!req.as_of().empty()) {
+    auto ms = hs::parse_iso8601_ms(req.as_of());
+    if (!ms) return {::grpc::StatusCode::INVALID_ARGUMENT, "invalid as_of"};
+    as_of = *ms / 1000;
+  }
+  RateQuote q;
+  switch (eng.quote(req.account_code(), dest.view(), req.billsec(), as_of, req.rate_table(), q)) {
+    case RateStatus::NoRateTable: return {::grpc::StatusCode::NOT_FOUND, "rate table not found"};
+    case RateStatus::NoRate: return {::grpc::StatusCode::NOT_FOUND, "rate not found"};
+    case RateStatus::Ok: break;
   }
+  resp->set_unit_price(q.item->price_per_min.to_double());
+  resp->set_step_sec(q.item->step_sec);
+  resp->set_min_time_sec(q.item->min_time_sec);
+  resp->set_connection_fee(q.item->connection_fee.to_double());
+  resp->set_rounding_mode(hs::rounding_name(q.item->rounding));
+  resp->set_amount(q.amount.to_double());
+  resp->set_amount_exact(q.amount.str());
+  if (m.valid()) {
+    resp->set_dest_region(std::string(hs::NumberPlan::region_id(*m.region)));
+    resp->set_number_type(hs::number_types_name(m.types));
+  }
+  return ::grpc::Status::OK;
 }
 
 ::grpc::Status BillingServiceImpl::Rate(::grpc::ServerContext*, const RateRequest* req, RateResponse* resp){
   try {
-    pqxx::work tx(pg_->conn());
-    auto rt = tx.exec_params("SELECT rt.rate_table_id, rt.currency FROM billing.rate_tables rt \n"
-                             "JOIN core.accounts a ON a.account_id=rt.account_id \n"
-                             "WHERE a.account_code=$1 AND rt.effective_from<=now() AND (rt.effective_to IS NULL OR rt.effective_to>=now()) \n"
-                             "ORDER BY rt.effective_from DESC LIMIT 1", req->account_code());
-    if (rt.empty()) return {::grpc::StatusCode::NOT_FOUND, "rate table not found"};
-    auto rate_table_id = rt[0][0].as<long long>();
-
-    auto r = tx.exec_params("SELECT ri.price_per_min, ri.billing_step_sec, ri.min_time_sec, ri.connection_fee, ri.rounding_mode, p.prefix \n"
-                            "FROM billing.rate_items ri JOIN routing.prefixes p ON p.prefix_id=ri.prefix_id \n"
-                            "WHERE ri.rate_table_id=$1 AND $2 LIKE p.prefix || '%' \n"
-                            "ORDER BY length(p.prefix) DESC LIMIT 1", rate_table_id, req->e164_to());
-    if (r.empty()) return {::grpc::StatusCode::NOT_FOUND, "rate not found"};
-
-    double price = r[0][0].as<double>();
-    int step = r[0][1].as<int>();
-    int min_time = r[0][2].as<int>();
-    double conn_fee = r[0][3].as<double>();
-    std::string rounding = r[0][4].as<std::string>();
-
-    uint32_t billsec = req->billsec();
-    if (billsec < static_cast<uint32_t>(min_time)) billsec = min_time;
-    uint32_t units = (billsec + step - 1) / step; // ceil
-    double amount = units * (price / 60.0 * step) + conn_fee;
-
-    resp->set_unit_price(price);
-    resp->set_step_sec(step);
-    resp->set_min_time_sec(min_time);
-    resp->set_connection_fee(conn_fee);
-    resp->set_rounding_mode(rounding);
-    resp->set_amount(amount);
-    return ::grpc::Status::OK;
+    const RateEngine* eng = rates_.read();
+    if (!eng) return {::grpc::StatusCode::UNAVAILABLE, "rate engine not loaded"};
+    return rate_one(*eng, numbers_, reject_invalid_, *req, resp);
   } catch (const std::exception& ex) {
     spdlog::error("Rate error: {}", ex.what());
     return {::grpc::StatusCode::INTERNAL, ex.what()};
   }
 }
 
-::grpc::Status BillingServiceImpl::Settle(::grpc::ServerContext*, const SettleRequest* req, SettleResponse* resp){
+::grpc::Status BillingServiceImpl::RateBatch(::grpc::ServerContext*, const RateBatchRequest& in, RateBatchResponse& out) {
   try {
-    pqxx::work tx(pg_->conn());
-    // 重新计价
-    auto rt = tx.exec_params("SELECT rt.rate_table_id, a.account_id, a.prepaid FROM billing.rate_tables rt \n"
-                             "JOIN core.accounts a ON a.account_id=rt.account_id \n"
-                             "WHERE a.account_code=$1 AND rt.effective_from<=now() AND (rt.effective_to IS NULL OR rt.effective_to>=now()) \n"
-                             "ORDER BY rt.effective_from DESC LIMIT 1", req->account_code());
-    if (rt.empty()) return {::grpc::StatusCode::NOT_FOUND, "rate table not found"};
-    auto rate_table_id = rt[0][0].as<long long>();
-    auto account_id = rt[0][1].as<long long>();
-    bool prepaid = rt[0][2].as<bool>();
+    // 每条消息读取一次快照，同一批次内结果一致
+    const RateEngine* eng = rates_.read();
+    if (!eng) return {::grpc::StatusCode::UNAVAILABLE, "rate engine not loaded"};
+    for (const auto& item : in.items()) {
+      auto* r = out.add_results();
+      r->set_seq(item.seq());
+      auto st = rate_one(*eng, numbers_, reject_invalid_, item.request(), r->mutable_response());
+      if (!st.ok()) {
+        r->clear_response();
+        r->set_error(st.error_message());
+      }
+    }
+    return ::grpc::Status::OK;
+  } catch (const std::exception& ex) {
+    spdlog::error("RateBatch error: {}", ex.what());
+    return {::grpc::StatusCode::INTERNAL, ex.what()};
+  }
+}
 
-    auto r = tx.exec_params("SELECT ri.price_per_min, ri.billing_step_sec, ri.min_time_sec, ri.connection_fee \n"
-                            "FROM billing.rate_items ri JOIN routing.prefixes p ON p.prefix_id=ri.prefix_id \n"
-                            "WHERE ri.rate_table_id=$1 AND $2 LIKE p.prefix || '%' \n"
-                            "ORDER BY length(p.prefix) DESC LIMIT 1", rate_table_id, req->e164_to());
-    if (r.empty()) return {::grpc::StatusCode::NOT_FOUND, "rate not found"};
+void BillingServiceImpl::Settle(::grpc::ServerContext*, const SettleRequest* req, SettleResponse* resp, hs::rpc::Done done) {
+  try {
+    // 重新计价（与 Rate 同一引擎、同一定点算法），在内存账本中释放预授权并记账
+    const RateEngine* eng = rates_.read();
+    if (!eng) return done({::grpc::StatusCode::UNAVAILABLE, "rate engine not loaded"});
+    // 通话已发生，无法规范化的号码不拒绝，按原值匹配费率
+    hs::number::E164 dest;
+    std::string_view to = req->e164_to();
+    if (hs::number::normalize(to, dest) == hs::number::Status::Ok) to = dest.view();
+    RateQuote q;
+    switch (eng->quote(req->account_code(), to, req->billsec(), hs::now_epoch_ms() / 1000, {}, q)) {
+      case RateStatus::NoRateTable: return done({::grpc::StatusCode::NOT_FOUND, "rate table not found"});
+      case RateStatus::NoRate: return done({::grpc::StatusCode::NOT_FOUND, "rate not found"});
+      case RateStatus::Ok: break;
+    }
+    ledger_->settle(req->auth_token(), q.amount, [this, req, resp, done](Ledger::Result r, const Ledger::Settlement& st) {
+      if (r != Ledger::Result::Unavailable && !req->call_id().empty()) calls_->close(req->call_id());
+      switch (r) {
+        case Ledger::Result::NotFound: return done({::grpc::StatusCode::NOT_FOUND, "authorization not found"});
+        case Ledger::Result::Unavailable: return done({::grpc::StatusCode::UNAVAILABLE, "ledger unavailable"});
+        case Ledger::Result::Insufficient:
+        case Ledger::Result::Ok: break;
+      }
+      resp->set_success(true);
+      // 重复结算返回首次结算金额
+      resp->set_final_amount(st.amount.to_double());
+      resp->set_final_amount_exact(st.amount.str());
+      done(::grpc::Status::OK);
+    });
+  } catch (const std::exception& ex) {
+    spdlog::error("Settle error: {}", ex.what());
+    done({::grpc::StatusCode::INTERNAL, ex.what()});
+  }
+}
 
-    double price = r[0][0].as<double>();
-    int step = r[0][1].as<int>();
-    int min_time = r[0][2].as<int>();
-    double conn_fee = r[0][3].as<double>();
+void BillingServiceImpl::reload() {
+  std::lock_guard<std::mutex> lk(reload_mu_);
+  auto conn = pg_->acquire();
+  rates_.store(RateEngine::load(*conn, history_days_));
+}
 
-    uint32_t billsec = req->billsec();
-    if (billsec < static_cast<uint32_t>(min_time)) billsec = min_time;
-    uint32_t units = (billsec + step - 1) / step; // ceil
-    double amount = units * (price / 60.0 * step) + conn_fee;
+bool BillingServiceImpl::load_snapshot(const std::string& path, int64_t max_age_s) {
+  try {
+    auto e = RateEngine::load_file(path, history_days_, max_age_s);
+    std::lock_guard<std::mutex> lk(reload_mu_);
+    rates_.store(std::move(e));
+    return true;
+  } catch (const std::exception& ex) {
+    spdlog::warn("Rate snapshot not used: {}", ex.what());
+    return false;
+  }
+}
 
-    // 标记授权为 settled
-    tx.exec_params("UPDATE billing.authorizations SET amount=$1, status='settled', updated_at=now() WHERE token=$2",
-                   amount, req->auth_token());
+void BillingServiceImpl::save_snapshot(const std::string& path) {
+  uint64_t v = rates_.version();
+  if (v == saved_version_) return;
+  auto e = rates_.load();
+  if (!e) return;
+  e->save(path);
+  saved_version_ = v;
+}
 
-    if (prepaid) {
-      tx.exec_params("UPDATE core.accounts SET balance = balance - $1, updated_at=now() WHERE account_id=$2", amount, account_id);
+void BillingServiceImpl::apply_changes(const std::vector<std::string>& payloads) {
+  std::lock_guard<std::mutex> lk(reload_mu_);
+  auto cur = rates_.load();
+  std::unordered_set<int64_t> accounts, ledger_accounts;
+  bool full = !cur;
+  for (const auto& p : payloads) {
+    auto pos = p.find(':');
+    std::string_view table(p.data(), pos == std::string::npos ? p.size() : pos);
+    std::string key = pos == std::string::npos ? "*" : p.substr(pos + 1);
+    // 余额 / 授信 / 后付属性归账本，费率快照是否全量重建都要刷新；账户编码与币种同时影响费率快照
+    if (table == "core.accounts" && key != "*") {
+      ledger_accounts.insert(std::stoll(key));
+      accounts.insert(std::stoll(key));
+      continue;
+    }
+    if (full) continue;
+    if (key == "*") { full = true; continue; }
+    if (table == "billing.rate_tables") {
+      accounts.insert(std::stoll(key));
+    } else if (table == "billing.rate_items") {
+      int64_t acct = cur->account_of_table(std::stoll(key));
+      if (acct == 0) full = true;
+      else accounts.insert(acct);
     } else {
-      // 后付：写入发票或应收表（此处简化记入发票金额）
-      tx.exec_params("INSERT INTO billing.invoices(account_id, period_start, period_end, currency, amount_due, status) VALUES ($1, date_trunc('month', now()), date_trunc('month', now()) + interval '1 month' - interval '1 day', $2, $3, 'open') ON CONFLICT DO NOTHING",
-                     account_id, req->currency(), amount);
+      full = true;
     }
-
-    tx.commit();
-    resp->set_success(true);
-    resp->set_final_amount(amount);
-    return ::grpc::Status::OK;
-  } catch (const std::exception& ex) {
-    spdlog::error("Settle error: {}", ex.what());
-    return {::grpc::StatusCode::INTERNAL, ex.what()};
   }
+  if (!ledger_accounts.empty()) ledger_->refresh(ledger_accounts);
+  auto conn = pg_->acquire();
+  if (full) rates_.store(RateEngine::load(*conn, history_days_));
+  else if (!accounts.empty()) rates_.store(cur->reload(*conn, accounts));
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,487 @@
+#include "ledger.hpp"
+#include <spdlog/spdlog.h>
+#include <random>
+#include <stdexcept>
+#include "common/time.hpp"
+
+namespace hs::billing {
+
+static std::string gen_token() {
+  static const char* al = "0123456789abcdef";
+  thread_local std::mt19937_64 g{std::random_device{}()};
+  std::string s(32, '0');
+  uint64_t a = g(), b = g();
+  for (size_t i = 0; i < 16; ++i) {
+    s[i] = al[(a >> (i * 4)) & 0xf];
+    s[16 + i] = al[(b >> (i * 4)) & 0xf];
+  }
+  return s;
+}
+
+static hs::Money money(const pqxx::field& f) {
+  auto m = hs::Money::parse(f.c_str());
+  if (!m) throw std::runtime_error(std::string("invalid amount: ") + f.c_str());
+  return *m;
+}
+
+static const char* kind_name(int k) {
+  static const char* names[] = {"reserve", "settle", "void"};
+  return names[k];
+}
+
+Ledger::Ledger(hs::Pg* pg, Options opt) : pg_(pg), opt_(opt) {
+  pg_->prepare("ledger_auth_open",
+               "INSERT INTO billing.authorizations(call_id, account_id, token, amount, currency, status) "
+               "SELECT c, a, t, m::numeric, y, 'open' FROM unnest($1::text[], $2::bigint[], $3::text[], $4::text[], $5::text[]) AS u(c, a, t, m, y)");
+  pg_->prepare("ledger_auth_close",
+               "UPDATE billing.authorizations au SET amount = u.m::numeric, status = u.s, updated_at = now() "
+               "FROM unnest($1::text[], $2::text[], $3::text[]) AS u(t, m, s) WHERE au.token = u.t");
+  pg_->prepare("ledger_balance_debit",
+               "UPDATE core.accounts a SET balance = a.balance - u.m::numeric, updated_at = now() "
+               "FROM unnest($1::bigint[], $2::text[]) AS u(id, m) WHERE a.account_id = u.id");
+  // 后付：并入当月 open 账单，没有则新建
+  pg_->prepare("ledger_invoice_add",
+               "WITH d AS (SELECT * FROM unnest($1::bigint[], $2::text[], $3::text[]) AS u(id, ccy, m)), "
+               "upd AS (UPDATE billing.invoices i SET amount_due = i.amount_due + d.m::numeric FROM d "
+               "        WHERE i.account_id = d.id AND i.status = 'open' AND i.period_start = date_trunc('month', now())::date "
+               "        RETURNING i.account_id) "
+               "INSERT INTO billing.invoices(account_id, period_start, period_end, currency, amount_due, status) "
+               "SELECT d.id, date_trunc('month', now()), date_trunc('month', now()) + interval '1 month' - interval '1 day', d.ccy, d.m::numeric, 'open' "
+               "FROM d WHERE d.id NOT IN (SELECT account_id FROM upd)");
+  pg_->prepare("ledger_journal_add",
+               "INSERT INTO billing.ledger_journal(kind, account_id, token, amount) "
+               "SELECT k, a, t, m::numeric FROM unnest($1::text[], $2::bigint[], $3::text[], $4::text[]) AS u(k, a, t, m)");
+  pg_->prepare("ledger_auth_lookup", "SELECT account_id, amount::text, status FROM billing.authorizations WHERE token=$1");
+
+  latency_ = {&hs::Pg::query_latency("ledger_auth_open"), &hs::Pg::query_latency("ledger_auth_close"),
+              &hs::Pg::query_latency("ledger_balance_debit"), &hs::Pg::query_latency("ledger_invoice_add"),
+              &hs::Pg::query_latency("ledger_journal_add"), &hs::Pg::query_latency("ledger_auth_lookup"),
+              &hs::metrics::registry().histogram("hs_ledger_commit_seconds", "Ledger batch transaction latency")};
+  auto& reg = hs::metrics::registry();
+  reg.counter_fn(this, "hs_ledger_batches_total", "Ledger batches committed", hs::metrics::load(stats_.batches));
+  reg.counter_fn(this, "hs_ledger_entries_total", "Ledger entries committed", hs::metrics::load(stats_.entries));
+  reg.counter_fn(this, "hs_ledger_failures_total", "Ledger batch commits that failed", hs::metrics::load(stats_.failures));
+  reg.gauge_fn(this, "hs_ledger_queued", "Ledger entries waiting for the writer", [this] {
+    std::lock_guard<std::mutex> lk(queue_mu_);
+    return static_cast<double>(queue_.size());
+  });
+}
+
+Ledger::~Ledger() {
+  hs::metrics::registry().remove(this);
+  stop();
+}
+
+void Ledger::start() {
+  {
+    std::unique_lock g(mu_);
+    recover_locked(nullptr);
+    healthy_ = true;
+  }
+  thread_ = std::jthread([this](std::stop_token st) { run(st); });
+}
+
+void Ledger::stop() {
+  if (thread_.joinable()) {
+    thread_.request_stop();
+    queue_cv_.notify_all();
+    thread_.join();
+  }
+}
+
+Ledger::Account* Ledger::by_id(int64_t id) const {
+  auto it = accounts_.find(id);
+  return it == accounts_.end() ? nullptr : it->second.get();
+}
+
+void Ledger::enqueue(Entry e) {
+  {
+    std::lock_guard<std::mutex> lk(queue_mu_);
+    queue_.push_back(std::move(e));
+  }
+  queue_cv_.notify_one();
+}
+
+void Ledger::notify(std::vector<Entry>& batch, bool ok) {
+  for (auto& e : batch)
+    if (e.done) e.done(ok);
+}
+
+void Ledger::reserve(std::string_view account_code, std::string_view call_id, hs::Money amount, ReserveDone done) {
+  Result r;
+  {
+    std::shared_lock g(mu_);
+    auto it = healthy_ ? by_code_.find(account_code) : by_code_.end();
+    if (!healthy_) {
+      r = Result::Unavailable;
+    } else if (it == by_code_.end()) {
+      r = Result::NotFound;
+    } else {
+      Account& a = *it->second;
+      std::lock_guard<std::mutex> la(a.mu);
+      hs::Money available = a.balance - a.reserved + (a.prepaid ? hs::Money{} : a.credit);
+      if (available <= amount) {
+        r = Result::Insufficient;
+      } else {
+        Authorization auth{gen_token(), a.currency};
+        a.reserved += amount;
+        {
+          Shard& sh = shard(auth.token);
+          std::lock_guard<std::mutex> ls(sh.mu);
+          sh.tokens[auth.token] = Reservation{a.account_id, amount, hs::now_epoch_ms()};
+        }
+        // 写线程在提交失败时同样回调；此时内存状态随后以库为准恢复
+        enqueue({Kind::Reserve, a.prepaid, a.account_id, auth.token, std::string(call_id), a.currency, amount,
+                 [done = std::move(done), auth](bool ok) { done(ok ? Result::Ok : Result::Unavailable, auth); }});
+        return;
+      }
+    }
+  }
+  done(r, {});
+}
+
+void Ledger::settle(std::string_view token, hs::Money amount, SettleDone done) {
+  Settlement out;
+  auto r = settle_hot(token, amount, out, done);
+  if (!r) return;
+  // 内存中没有：已作废、已清理或重启前结算，查库处理
+  if (*r == Result::NotFound) return settle_cold(token, amount, std::move(done));
+  done(*r, out);
+}
+
+std::optional<Ledger::Result> Ledger::settle_hot(std::string_view token, hs::Money amount, Settlement& out, SettleDone& done) {
+  std::shared_lock g(mu_);
+  if (!healthy_) return Result::Unavailable;
+  Shard& sh = shard(token);
+  int64_t account_id = 0;
+  {
+    std::lock_guard<std::mutex> ls(sh.mu);
+    auto it = sh.tokens.find(token);
+    if (it != sh.tokens.end()) {
+      if (it->second.settled) { out = {it->second.final_amount, true}; return Result::Ok; }
+      account_id = it->second.account_id;
+    }
+  }
+  Account* a = account_id ? by_id(account_id) : nullptr;
+  if (!a) return Result::NotFound;
+  std::lock_guard<std::mutex> la(a->mu);
+  std::lock_guard<std::mutex> ls(sh.mu);
+  auto it = sh.tokens.find(token);
+  if (it == sh.tokens.end()) return Result::NotFound;
+  Reservation& r = it->second;
+  if (r.settled) { out = {r.final_amount, true}; return Result::Ok; }
+  r.settled = true;
+  r.final_amount = amount;
+  r.settled_ms = hs::now_epoch_ms();
+  a->reserved -= r.amount;
+  if (a->prepaid) a->balance -= amount;
+  out = {amount, false};
+  enqueue({Kind::Settle, a->prepaid, a->account_id, std::string(token), {}, a->currency, amount,
+           [done = std::move(done), out](bool ok) { done(ok ? Result::Ok : Result::Unavailable, out); }});
+  return std::nullopt;
+}
+
+void Ledger::settle_cold(std::string_view token, hs::Money amount, SettleDone done) {
+  int64_t account_id;
+  {
+    auto conn = pg_->acquire();
+    pqxx::nontransaction tx(*conn);
+    auto t0 = std::chrono::steady_clock::now();
+    auto r = tx.exec_prepared("ledger_auth_lookup", std::string(token));
+    latency_.auth_lookup->record(std::chrono::steady_clock::now() - t0);
+    if (r.empty()) return done(Result::NotFound, {});
+    if (r[0][2].as<std::string>() == "settled") return done(Result::Ok, {money(r[0][1]), true});
+    account_id = r[0][0].as<long long>();
+  }
+
+  Result res = Result::Ok;
+  Settlement out;
+  {
+    std::shared_lock g(mu_);
+    Account* a = healthy_ ? by_id(account_id) : nullptr;
+    if (!healthy_) {
+      res = Result::Unavailable;
+    } else if (!a) {
+      res = Result::NotFound;
+    } else {
+      std::lock_guard<std::mutex> la(a->mu);
+      Shard& sh = shard(token);
+      std::lock_guard<std::mutex> ls(sh.mu);
+      auto [it, inserted] = sh.tokens.try_emplace(std::string(token));
+      Reservation& r = it->second;
+      if (!inserted && r.settled) {
+        out = {r.final_amount, true};
+      } else {
+        if (!inserted) a->reserved -= r.amount;
+        r.account_id = account_id;
+        r.settled = true;
+        r.final_amount = amount;
+        r.settled_ms = hs::now_epoch_ms();
+        if (a->prepaid) a->balance -= amount;
+        out = {amount, false};
+        enqueue({Kind::Settle, a->prepaid, a->account_id, std::string(token), {}, a->currency, amount,
+                 [done = std::move(done), out](bool ok) { done(ok ? Result::Ok : Result::Unavailable, out); }});
+        return;
+      }
+    }
+  }
+  done(res, out);
+}
+
+void Ledger::refresh(const std::unordered_set<int64_t>& account_ids) {
+  {
+    std::lock_guard<std::mutex> lk(queue_mu_);
+    if (account_ids.empty()) refresh_all_ = true;
+    else refresh_ids_.insert(account_ids.begin(), account_ids.end());
+  }
+  queue_cv_.notify_one();
+}
+
+bool Ledger::write(std::vector<Entry>& batch) {
+  auto t0 = std::chrono::steady_clock::now();
+  try {
+    std::vector<std::string> o_call, o_token, o_amount, o_ccy;
+    std::vector<long long> o_acct;
+    std::vector<std::string> c_token, c_amount, c_status;
+    hs::StringMap<size_t> c_index;
+    std::unordered_map<int64_t, hs::Money> debit;
+    std::unordered_map<int64_t, std::pair<std::string, hs::Money>> invoice;
+    std::vector<std::string> j_kind, j_token, j_amount;
+    std::vector<long long> j_acct;
+
+    for (auto& e : batch) {
+      std::string amt = e.amount.str();
+      if (e.kind == Kind::Reserve) {
+        o_call.push_back(e.call_id);
+        o_acct.push_back(e.account_id);
+        o_token.push_back(e.token);
+        o_amount.push_back(amt);
+        o_ccy.push_back(e.currency);
+      } else {
+        // 同一 token 在批内先作废后结算时只保留最后状态，UPDATE ... FROM 不允许一行匹配多次
+        const char* status = e.kind == Kind::Settle ? "settled" : "void";
+        auto [it, inserted] = c_index.try_emplace(e.token, c_token.size());
+        if (inserted) {
+          c_token.push_back(e.token);
+          c_amount.push_back(amt);
+          c_status.push_back(status);
+        } else {
+          c_amount[it->second] = amt;
+          c_status[it->second] = status;
+        }
+        if (e.kind == Kind::Settle && e.prepaid) debit[e.account_id] += e.amount;
+        if (e.kind == Kind::Settle && !e.prepaid) {
+          auto& inv = invoice[e.account_id];
+          inv.first = e.currency;
+          inv.second += e.amount;
+        }
+      }
+      j_kind.push_back(kind_name(static_cast<int>(e.kind)));
+      j_acct.push_back(e.account_id);
+      j_token.push_back(e.token);
+      j_amount.push_back(std::move(amt));
+    }
+
+    hs::metrics::Timer commit(*latency_.commit);
+    auto conn = pg_->acquire();
+    pqxx::work tx(*conn);
+    tx.exec("SET LOCAL hs.ledger_writer = 'on'");
+    if (!o_token.empty()) {
+      hs::metrics::Timer t(*latency_.auth_open);
+      tx.exec_prepared("ledger_auth_open", o_call, o_acct, o_token, o_amount, o_ccy);
+    }
+    if (!c_token.empty()) {
+      hs::metrics::Timer t(*latency_.auth_close);
+      tx.exec_prepared("ledger_auth_close", c_token, c_amount, c_status);
+    }
+    if (!debit.empty()) {
+      std::vector<long long> ids;
+      std::vector<std::string> amounts;
+      for (const auto& [id, m] : debit) { ids.push_back(id); amounts.push_back(m.str()); }
+      hs::metrics::Timer t(*latency_.balance_debit);
+      tx.exec_prepared("ledger_balance_debit", ids, amounts);
+    }
+    if (!invoice.empty()) {
+      std::vector<long long> ids;
+      std::vector<std::string> ccys, amounts;
+      for (const auto& [id, inv] : invoice) { ids.push_back(id); ccys.push_back(inv.first); amounts.push_back(inv.second.str()); }
+      hs::metrics::Timer t(*latency_.invoice_add);
+      tx.exec_prepared("ledger_invoice_add", ids, ccys, amounts);
+    }
+    {
+      hs::metrics::Timer t(*latency_.journal_add);
+      tx.exec_prepared("ledger_journal_add", j_kind, j_acct, j_token, j_amount);
+    }
+    tx.commit();
+  } catch (const std::exception& ex) {
+    ++stats_.failures;
+    spdlog::error("Ledger commit of {} entries failed: {}", batch.size(), ex.what());
+    notify(batch, false);
+    return false;
+  }
+
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+  ++stats_.batches;
+  stats_.entries += batch.size();
+  stats_.commit_ns += static_cast<uint64_t>(ns);
+  if (batch.size() > stats_.max_batch.load()) stats_.max_batch = batch.size();
+  notify(batch, true);
+  return true;
+}
+
+void Ledger::fail_pending() {
+  std::vector<Entry> pending;
+  {
+    std::lock_guard<std::mutex> lk(queue_mu_);
+    pending.swap(queue_);
+  }
+  notify(pending, false);
+}
+
+bool Ledger::flush_locked() {
+  for (;;) {
+    std::vector<Entry> batch;
+    {
+      std::lock_guard<std::mutex> lk(queue_mu_);
+      if (queue_.empty()) return true;
+      batch.swap(queue_);
+    }
+    if (!write(batch)) return false;
+  }
+}
+
+void Ledger::recover_locked(const std::unordered_set<int64_t>* only) {
+  auto conn = pg_->acquire();
+  pqxx::read_transaction tx(*conn);
+  std::string sql = "SELECT account_id, account_code, currency, prepaid, balance::text, credit_limit::text FROM core.accounts";
+  pqxx::result rows = only ? tx.exec_params(sql + " WHERE account_id = ANY($1)", std::vector<long long>(only->begin(), only->end()))
+                           : tx.exec(sql);
+  if (!only) {
+    accounts_.clear();
+    by_code_.clear();
+    for (auto& sh : shards_) sh.tokens.clear();
+  }
+
+  std::unordered_set<int64_t> seen;
+  for (const auto& row : rows) {
+    int64_t id = row[0].as<long long>();
+    auto& a = accounts_[id];
+    if (!a) a = std::make_unique<Account>();
+    else by_code_.erase(a->code);
+    a->account_id = id;
+    a->code = row[1].as<std::string>();
+    a->currency = row[2].as<std::string>();
+    a->prepaid = row[3].as<bool>();
+    a->balance = money(row[4]);
+    a->credit = money(row[5]);
+    by_code_[a->code] = a.get();
+    seen.insert(id);
+  }
+  if (only) {
+    // 已删除的账户
+    for (int64_t id : *only) {
+      if (seen.count(id)) continue;
+      auto it = accounts_.find(id);
+      if (it == accounts_.end()) continue;
+      by_code_.erase(it->second->code);
+      accounts_.erase(it);
+    }
+    spdlog::info("Ledger refreshed {} account(s)", only->size());
+    return;
+  }
+
+  size_t open = 0;
+  for (const auto& row : tx.exec(
+         "SELECT token, account_id, amount::text, (EXTRACT(EPOCH FROM created_at) * 1000)::bigint "
+         "FROM billing.authorizations WHERE status = 'open'")) {
+    std::string token = row[0].as<std::string>();
+    Reservation r{row[1].as<long long>(), money(row[2]), row[3].as<long long>()};
+    if (Account* a = by_id(r.account_id)) a->reserved += r.amount;
+    shard(token).tokens.emplace(std::move(token), r);
+    ++open;
+  }
+  spdlog::info("Ledger recovered {} accounts, {} open authorizations", accounts_.size(), open);
+}
+
+void Ledger::expire(int64_t now_ms) {
+  int64_t void_before = now_ms - std::chrono::duration_cast<std::chrono::milliseconds>(opt_.reserve_ttl).count();
+  int64_t prune_before = now_ms - std::chrono::duration_cast<std::chrono::milliseconds>(opt_.settled_keep).count();
+  std::vector<std::pair<std::string, int64_t>> stale;
+  for (auto& sh : shards_) {
+    std::lock_guard<std::mutex> ls(sh.mu);
+    for (auto it = sh.tokens.begin(); it != sh.tokens.end();) {
+      const Reservation& r = it->second;
+      if (r.settled && r.settled_ms < prune_before) { it = sh.tokens.erase(it); continue; }
+      if (!r.settled && r.created_ms < void_before) stale.emplace_back(it->first, r.account_id);
+      ++it;
+    }
+  }
+
+  std::shared_lock g(mu_);
+  for (const auto& [token, account_id] : stale) {
+    Account* a = by_id(account_id);
+    Shard& sh = shard(token);
+    std::unique_lock<std::mutex> la;
+    if (a) la = std::unique_lock<std::mutex>(a->mu);
+    std::lock_guard<std::mutex> ls(sh.mu);
+    auto it = sh.tokens.find(token);
+    if (it == sh.tokens.end() || it->second.settled) continue;
+    if (a) a->reserved -= it->second.amount;
+    enqueue({Kind::Void, a ? a->prepaid : true, account_id, token, {}, a ? a->currency : std::string(), it->second.amount, {}});
+    sh.tokens.erase(it);
+  }
+  if (!stale.empty()) spdlog::info("Ledger voided {} expired authorization(s)", stale.size());
+}
+
+void Ledger::run(std::stop_token st) {
+  using clock = std::chrono::steady_clock;
+  auto next_expire = clock::now() + std::chrono::seconds(10);
+  std::vector<Entry> batch;
+  for (;;) {
+    bool refresh_all = false, stopping = false;
+    std::unordered_set<int64_t> ids;
+    {
+      std::unique_lock<std::mutex> lk(queue_mu_);
+      queue_cv_.wait_for(lk, std::chrono::seconds(1), [&] {
+        return !queue_.empty() || refresh_all_ || !refresh_ids_.empty() || st.stop_requested();
+      });
+      stopping = st.stop_requested();
+      // 上一批提交期间到达的日志一起提交
+      size_t n = std::min(queue_.size(), opt_.batch_max);
+      batch.assign(std::make_move_iterator(queue_.begin()), std::make_move_iterator(queue_.begin() + static_cast<std::ptrdiff_t>(n)));
+      queue_.erase(queue_.begin(), queue_.begin() + static_cast<std::ptrdiff_t>(n));
+      refresh_all = std::exchange(refresh_all_, false);
+      ids.swap(refresh_ids_);
+    }
+
+    bool failed = !batch.empty() && !write(batch);
+    batch.clear();
+    if (failed || refresh_all || !ids.empty() || !healthy_) {
+      // 独占期间没有新的内存记账：先提交在途日志，再以库为准恢复或刷新
+      std::unique_lock g(mu_);
+      if (failed || !flush_locked()) {
+        fail_pending();
+        failed = true;
+      }
+      try {
+        recover_locked(failed || refresh_all || !healthy_ ? nullptr : &ids);
+        healthy_ = true;
+      } catch (const std::exception& ex) {
+        healthy_ = false;
+        spdlog::error("Ledger recovery failed: {}", ex.what());
+      }
+    }
+
+    if (stopping) {
+      std::unique_lock g(mu_);
+      if (!flush_locked()) fail_pending();
+      break;
+    }
+    if (clock::now() >= next_expire) {
+      expire(hs::now_epoch_ms());
+      next_expire = clock::now() + std::chrono::seconds(10);
+    }
+  }
+}
+
+}
@@ -0,0 +1,299 @@
+#include "rate_engine.hpp"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <chrono>
+#include "common/snapshot_file.hpp"
+
+namespace hs::billing {
+
+namespace {
+
+// ---- 快照文件布局：账户 → 费率表区间 → 前缀节点 / 费率项区间 ----
+
+constexpr std::string_view kSnapshotKind = "RATE";
+constexpr uint32_t kSnapshotVersion = 1;
+enum : uint32_t { kAccounts = 1, kDecks, kItems, kNodes };
+
+using Str = hs::SnapshotFile::Str;
+
+struct FlatAccount {
+  int64_t account_id;
+  Str code, currency;
+  uint32_t first_deck, deck_count;
+  uint8_t prepaid, reserved[7];
+};
+struct FlatDeck {
+  int64_t rate_table_id, effective_from, effective_to;
+  Str name, currency;
+  uint32_t first_node, node_count, first_item, item_count;
+};
+struct FlatItem {
+  int64_t price_micros, fee_micros;
+  Str prefix;
+  uint32_t step_sec, min_time_sec;
+  uint8_t rounding, reserved[7];
+};
+// 记录不含隐式填充，文件内容由数据唯一决定
+static_assert(sizeof(FlatAccount) == 40 && sizeof(FlatDeck) == 56 && sizeof(FlatItem) == 40);
+
+int64_t epoch_now() {
+  return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+}
+
+static pqxx::result exec_filtered(pqxx::transaction_base& tx, const std::string& sql, const std::unordered_set<int64_t>* only,
+                                  int history_days) {
+  if (!only) return tx.exec_params(sql, history_days);
+  std::vector<long long> ids(only->begin(), only->end());
+  return tx.exec_params(sql, history_days, ids);
+}
+
+size_t RateEngine::load_accounts(pqxx::transaction_base& tx, int history_days, const std::unordered_set<int64_t>* only,
+                                 AccountMap& out, std::unordered_map<int64_t, std::string>& codes,
+                                 std::unordered_map<int64_t, int64_t>& tables) {
+  const std::string acct_filter = only ? " AND a.account_id = ANY($2)" : "";
+  const std::string deck_where =
+    "WHERE (rt.effective_to IS NULL OR rt.effective_to >= now() - make_interval(days => $1))" + acct_filter;
+
+  std::unordered_map<int64_t, std::shared_ptr<AccountRates>> accts;
+  for (const auto& row : exec_filtered(tx,
+         "SELECT DISTINCT a.account_id, a.account_code, a.currency, a.prepaid FROM core.accounts a \n"
+         "JOIN billing.rate_tables rt ON rt.account_id=a.account_id " + deck_where, only, history_days)) {
+    auto a = std::make_shared<AccountRates>();
+    a->account_id = row[0].as<long long>();
+    a->account_code = row[1].as<std::string>();
+    a->currency = row[2].as<std::string>();
+    a->prepaid = row[3].as<bool>();
+    accts.emplace(a->account_id, std::move(a));
+  }
+
+  std::unordered_map<int64_t, std::shared_ptr<RateDeck>> decks;
+  for (const auto& row : exec_filtered(tx,
+         "SELECT rt.rate_table_id, rt.account_id, rt.name, rt.currency, EXTRACT(EPOCH FROM rt.effective_from)::bigint, \n"
+         "       COALESCE(EXTRACT(EPOCH FROM rt.effective_to)::bigint, 0) \n"
+         "FROM billing.rate_tables rt JOIN core.accounts a ON a.account_id=rt.account_id " + deck_where, only, history_days)) {
+    auto d = std::make_shared<RateDeck>();
+    d->rate_table_id = row[0].as<long long>();
+    d->name = row[2].as<std::string>();
+    d->currency = row[3].as<std::string>();
+    d->effective_from = row[4].as<long long>();
+    d->effective_to = row[5].as<long long>();
+    tables[d->rate_table_id] = row[1].as<long long>();
+    decks.emplace(d->rate_table_id, d);
+  }
+
+  size_t skipped = 0;
+  for (const auto& row : exec_filtered(tx,
+         "SELECT ri.rate_table_id, p.prefix, ri.price_per_min::text, ri.billing_step_sec, ri.min_time_sec, \n"
+         "       ri.connection_fee::text, ri.rounding_mode \n"
+         "FROM billing.rate_items ri JOIN routing.prefixes p ON p.prefix_id=ri.prefix_id \n"
+         "JOIN billing.rate_tables rt ON rt.rate_table_id=ri.rate_table_id \n"
+         "JOIN core.accounts a ON a.account_id=rt.account_id " + deck_where, only, history_days)) {
+    auto dit = decks.find(row[0].as<long long>());
+    if (dit == decks.end()) { ++skipped; continue; }
+    RateDeck& d = *dit->second;
+    auto price = hs::Money::parse(row[2].view());
+    auto fee = hs::Money::parse(row[5].view());
+    auto rounding = hs::parse_rounding(row[6].view());
+    std::string prefix = row[1].as<std::string>();
+    uint32_t* slot = d.trie.insert(prefix);
+    if (!slot || !price || !fee || !rounding) { ++skipped; continue; }
+    RateItem item{*price, static_cast<uint32_t>(std::max(1, row[3].as<int>())),
+                  static_cast<uint32_t>(std::max(0, row[4].as<int>())), *fee, *rounding, std::move(prefix)};
+    if (*slot == hs::PrefixTrie::kNone) {
+      *slot = static_cast<uint32_t>(d.items.size());
+      d.items.push_back(std::move(item));
+    } else {
+      // 同一前缀文本对应多个 prefix_id 时保留先出现的一条
+      ++skipped;
+    }
+  }
+
+  for (auto& [id, d] : decks) {
+    auto ait = accts.find(tables[id]);
+    if (ait != accts.end()) ait->second->decks.push_back(std::move(d));
+  }
+  for (auto& [id, a] : accts) {
+    std::sort(a->decks.begin(), a->decks.end(), [](const auto& x, const auto& y) {
+      return x->effective_from > y->effective_from;
+    });
+    codes[id] = a->account_code;
+    out[a->account_code] = std::move(a);
+  }
+  return skipped;
+}
+
+std::shared_ptr<const RateEngine> RateEngine::load(pqxx::connection& conn, int history_days) {
+  auto e = std::make_shared<RateEngine>();
+  e->history_days_ = history_days;
+  pqxx::read_transaction tx(conn);
+  size_t skipped = load_accounts(tx, history_days, nullptr, e->accounts_, e->codes_, e->tables_);
+  size_t items = 0;
+  for (const auto& [code, a] : e->accounts_)
+    for (const auto& d : a->decks) items += d->items.size();
+  spdlog::info("Rate engine loaded: {} accounts, {} rate tables, {} items, {} rows skipped",
+               e->accounts_.size(), e->tables_.size(), items, skipped);
+  return e;
+}
+
+std::shared_ptr<const RateEngine> RateEngine::reload(pqxx::connection& conn, const std::unordered_set<int64_t>& account_ids) const {
+  auto e = std::make_shared<RateEngine>(*this);
+  for (auto id : account_ids) {
+    auto cit = e->codes_.find(id);
+    if (cit != e->codes_.end()) {
+      e->accounts_.erase(cit->second);
+      e->codes_.erase(cit);
+    }
+  }
+  std::erase_if(e->tables_, [&](const auto& kv) { return account_ids.count(kv.second) > 0; });
+  pqxx::read_transaction tx(conn);
+  size_t skipped = load_accounts(tx, history_days_, &account_ids, e->accounts_, e->codes_, e->tables_);
+  spdlog::info("Rate engine reloaded {} account(s), {} rows skipped", account_ids.size(), skipped);
+  return e;
+}
+
+void RateEngine::save(const std::string& path) const {
+  auto t0 = std::chrono::steady_clock::now();
+  hs::SnapshotWriter w(kSnapshotKind, kSnapshotVersion);
+  std::vector<FlatAccount> accounts;
+  std::vector<FlatDeck> decks;
+  std::vector<FlatItem> items;
+  std::vector<hs::PrefixTrie::Node> nodes;
+  for (const auto& [code, a] : accounts_) {
+    FlatAccount fa{};
+    fa.account_id = a->account_id;
+    fa.code = w.str(a->account_code);
+    fa.currency = w.str(a->currency);
+    fa.prepaid = a->prepaid;
+    fa.first_deck = static_cast<uint32_t>(decks.size());
+    fa.deck_count = static_cast<uint32_t>(a->decks.size());
+    for (const auto& d : a->decks) {
+      FlatDeck fd{};
+      fd.rate_table_id = d->rate_table_id;
+      fd.effective_from = d->effective_from;
+      fd.effective_to = d->effective_to;
+      fd.name = w.str(d->name);
+      fd.currency = w.str(d->currency);
+      fd.first_node = static_cast<uint32_t>(nodes.size());
+      fd.node_count = static_cast<uint32_t>(d->trie.node_count());
+      nodes.insert(nodes.end(), d->trie.nodes().begin(), d->trie.nodes().end());
+      fd.first_item = static_cast<uint32_t>(items.size());
+      fd.item_count = static_cast<uint32_t>(d->items.size());
+      for (const auto& it : d->items) {
+        FlatItem fi{};
+        fi.price_micros = it.price_per_min.micros();
+        fi.fee_micros = it.connection_fee.micros();
+        fi.prefix = w.str(it.prefix);
+        fi.step_sec = it.step_sec;
+        fi.min_time_sec = it.min_time_sec;
+        fi.rounding = static_cast<uint8_t>(it.rounding);
+        items.push_back(fi);
+      }
+      decks.push_back(fd);
+    }
+    accounts.push_back(fa);
+  }
+  w.section(kAccounts, accounts);
+  w.section(kDecks, decks);
+  w.section(kItems, items);
+  w.section(kNodes, nodes);
+  w.write(path, epoch_now());
+  spdlog::info("Rate snapshot written to {} in {:.1f}ms: {} accounts, {} rate tables, {} items", path,
+               std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count(), accounts.size(),
+               decks.size(), items.size());
+}
+
+std::shared_ptr<const RateEngine> RateEngine::load_file(const std::string& path, int history_days, int64_t max_age_s) {
+  auto t0 = std::chrono::steady_clock::now();
+  auto f = hs::SnapshotFile::open(path, kSnapshotKind, kSnapshotVersion, max_age_s);
+  auto e = std::make_shared<RateEngine>();
+  e->history_days_ = history_days;
+  auto corrupt = [&](const char* what) { return std::runtime_error("snapshot " + path + ": " + what); };
+  auto decks = f->section<FlatDeck>(kDecks);
+  auto items = f->section<FlatItem>(kItems);
+  auto nodes = f->section<hs::PrefixTrie::Node>(kNodes);
+  size_t item_count = 0;
+  for (const auto& fa : f->section<FlatAccount>(kAccounts)) {
+    auto a = std::make_shared<AccountRates>();
+    a->account_id = fa.account_id;
+    a->account_code = f->str(fa.code);
+    a->currency = f->str(fa.currency);
+    a->prepaid = fa.prepaid != 0;
+    for (const auto& fd : hs::SnapshotFile::slice(decks, fa.first_deck, fa.deck_count)) {
+      auto d = std::make_shared<RateDeck>();
+      d->rate_table_id = fd.rate_table_id;
+      d->name = f->str(fd.name);
+      d->currency = f->str(fd.currency);
+      d->effective_from = fd.effective_from;
+      d->effective_to = fd.effective_to;
+      if (!d->trie.assign(hs::SnapshotFile::slice(nodes, fd.first_node, fd.node_count))) throw corrupt("corrupt prefix index");
+      for (const auto& n : d->trie.nodes())
+        if (n.value != hs::PrefixTrie::kNone && n.value >= fd.item_count) throw corrupt("prefix slot out of range");
+      d->items.reserve(fd.item_count);
+      for (const auto& fi : hs::SnapshotFile::slice(items, fd.first_item, fd.item_count)) {
+        if (fi.rounding > static_cast<uint8_t>(hs::Rounding::HalfEven) || fi.step_sec == 0) throw corrupt("invalid rate item");
+        d->items.push_back({hs::Money::from_micros(fi.price_micros), fi.step_sec, fi.min_time_sec,
+                            hs::Money::from_micros(fi.fee_micros), static_cast<hs::Rounding>(fi.rounding),
+                            std::string(f->str(fi.prefix))});
+      }
+      item_count += d->items.size();
+      e->tables_[d->rate_table_id] = a->account_id;
+      a->decks.push_back(std::move(d));
+    }
+    std::sort(a->decks.begin(), a->decks.end(), [](const auto& x, const auto& y) {
+      return x->effective_from > y->effective_from;
+    });
+    e->codes_[a->account_id] = a->account_code;
+    e->accounts_[a->account_code] = std::move(a);
+  }
+  spdlog::info("Rate engine loaded from snapshot {} ({}s old) in {:.1f}ms: {} accounts, {} rate tables, {} items", path,
+               epoch_now() - f->header().created_at,
+               std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count(), e->accounts_.size(),
+               e->tables_.size(), item_count);
+  return e;
+}
+
+const AccountRates* RateEngine::account(std::string_view account_code) const {
+  auto it = accounts_.find(account_code);
+  return it == accounts_.end() ? nullptr : it->second.get();
+}
+
+const RateDeck* RateEngine::deck(const AccountRates& acct, int64_t as_of_epoch, std::string_view rate_table) const {
+  for (const auto& d : acct.decks) {
+    if (!rate_table.empty() && d->name != rate_table) continue;
+    if (d->effective_from <= as_of_epoch && (d->effective_to == 0 || d->effective_to >= as_of_epoch)) return d.get();
+  }
+  return nullptr;
+}
+
+const RateItem* RateEngine::match(const RateDeck& deck, std::string_view e164) const {
+  uint32_t v = deck.trie.longest(e164);
+  return v == hs::PrefixTrie::kNone ? nullptr : &deck.items[v];
+}
+
+RateStatus RateEngine::quote(std::string_view account_code, std::string_view e164, uint32_t billsec, int64_t as_of_epoch,
+                             std::string_view rate_table, RateQuote& out) const {
+  out.account = account(account_code);
+  out.deck = out.account ? deck(*out.account, as_of_epoch, rate_table) : nullptr;
+  if (!out.deck) return RateStatus::NoRateTable;
+  out.item = match(*out.deck, e164);
+  if (!out.item) return RateStatus::NoRate;
+  out.amount = charge(*out.item, billsec);
+  return RateStatus::Ok;
+}
+
+int64_t RateEngine::account_of_table(int64_t rate_table_id) const {
+  auto it = tables_.find(rate_table_id);
+  return it == tables_.end() ? 0 : it->second;
+}
+
+hs::Money RateEngine::charge(const RateItem& item, uint32_t billsec) {
+  uint64_t secs = std::max(billsec, item.min_time_sec);
+  // 开始的计费步长总是整段计费；rounding 只作用于金额
+  uint64_t step = item.step_sec;
+  auto charged_secs = static_cast<int64_t>((secs + step - 1) / step * step);
+  return item.price_per_min.mul_div(charged_secs, 60, item.rounding) + item.connection_fee;
+}
+
+}
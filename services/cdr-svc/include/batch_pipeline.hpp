@@ -0,0 +1,95 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "common/metrics.hpp"
+#include "spool.hpp"
+
+namespace hs::cdr {
+
+// 下游永久拒绝（如数据格式错误），批次隔离后不再重试
+struct RejectedBatch : std::runtime_error {
+  using std::runtime_error::runtime_error;
+};
+
+// 以 Spool 为唯一数据源的批量管道：push 写入 spool 并等待组提交落盘后返回；
+// 未成批的行数 / 字节 / 时长任一达到上限时 flusher 写入批次边界，批次包含此前全部未成批的行，不再拆分
+// （一次多行 push 可使批次超过 max_rows / max_bytes）；固定数量的发送线程并发发送（即在途批次上限），
+// 失败按指数退避无限重试，成功后 ack 推进 checkpoint。启动时先重放 checkpoint 之后的批次。
+class BatchPipeline {
+public:
+  struct Options {
+    size_t max_rows = 5000;
+    size_t max_bytes = size_t{4} << 20;
+    std::chrono::milliseconds max_age{1000};
+    size_t senders = 4;
+    uint64_t max_pending_bytes = uint64_t{8} << 30; // spool 中未确认的数据上限
+    std::chrono::milliseconds retry_base{200};
+    std::chrono::milliseconds retry_max{30000};
+  };
+
+  struct Stats {
+    std::atomic<uint64_t> rows_in{0};
+    std::atomic<uint64_t> rows_sent{0};
+    std::atomic<uint64_t> batches_sent{0};
+    std::atomic<uint64_t> retries{0};
+    std::atomic<uint64_t> batches_rejected{0};
+    std::atomic<uint64_t> rejected{0};
+  };
+
+  // body 为批次内各行原样拼接，token 为幂等键；抛出 RejectedBatch 表示永久失败，其余异常重试
+  using Sender = std::function<void(const std::string& body, const std::string& token)>;
+
+  BatchPipeline(Spool* spool, Options opt, Sender send);
+  ~BatchPipeline();
+
+  // 恢复 spool 并入队待重放批次，然后启动 flusher 与发送线程
+  void start();
+  // 剩余数据成为最后一批；发送线程在队列清空或下游失败时退出，未发送的批次下次启动重放
+  void stop();
+
+  // 落盘后返回 true；积压超过 max_pending_bytes 时直接返回 false
+  bool push(std::string_view row);
+  // 多行共用一次落盘等待，整批写入或整批拒绝
+  bool push(std::span<const std::string_view> rows);
+
+  const Stats& stats() const { return stats_; }
+
+private:
+  using clock = std::chrono::steady_clock;
+
+  void flush_loop(std::stop_token st);
+  void send_loop();
+  void cut();
+  void enqueue(const Spool::Range& r);
+
+  Spool* spool_;
+  Options opt_;
+  Sender send_;
+  Stats stats_;
+  hs::metrics::Histogram* send_latency_;
+
+  std::mutex flush_mu_;
+  std::condition_variable flush_cv_;
+
+  mutable std::mutex q_mu_;
+  std::condition_variable q_cv_;
+  std::condition_variable stop_cv_; // 重试退避期间等待停止
+  std::deque<Spool::Range> q_;
+  std::atomic<bool> closed_{false};
+
+  std::jthread flusher_;
+  std::vector<std::thread> senders_;
+};
+
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <hyperswitch/cdr/cdr.pb.h>
+
+namespace hs::cdr {
+
+// 与编码列顺序一致的写入语句，列名显式列出，表新增带默认值的列不影响写入
+extern const std::string_view kCdrInsertQuery;
+
+// 事件字段不合法（时间戳无法解析等），调用方应拒绝该事件
+struct InvalidCdr : std::invalid_argument {
+  using std::invalid_argument::invalid_argument;
+};
+
+// 按 SIP 最终应答归类，用于 ASR 统计：answered / busy / no_answer / failed / rejected；
+// 未结束的呼叫返回空串
+std::string_view asr_bucket(uint32_t sip_final_code, bool answered);
+
+// 把一条 CdrEvent 以 RowBinary 追加到 out：时间戳转为 DateTime（epoch 秒），
+// billsec 由 answer/end 计算，asr_bucket 由最终应答归类，e164_from/e164_to 规范化为 E.164（为空时取自 URI）。start_ts 缺失或任一时间戳非法时抛出 InvalidCdr
+void encode_row_binary(const hyperswitch::cdr::CdrEvent& ev, std::string& out);
+
+}
@@ -1,16 +1,27 @@
 #pragma once
 #include <hyperswitch/cdr/cdr.grpc.pb.h>
-#include <string>
+#include "batch_pipeline.hpp"
+#include "common/call_registry.hpp"
 
 namespace hs::cdr {
 
-class CdrIngestImpl final : public hyperswitch::cdr::CdrIngest::Service {
+class CdrIngestImpl {
 public:
-  explicit CdrIngestImpl(const std::string& ch_http_endpoint);
+  CdrIngestImpl(BatchPipeline* pipeline, hs::CallRegistry* calls);
   ::grpc::Status Push(::grpc::ServerContext* ctx, const hyperswitch::cdr::CdrEvent* req,
-                      hyperswitch::cdr::Ack* resp) override;
+                      hyperswitch::cdr::Ack* resp);
+  ::grpc::Status PushBatch(::grpc::ServerContext* ctx, const hyperswitch::cdr::CdrBatch* req,
+                           hyperswitch::cdr::CdrBatchAck* resp);
+  // 双向流的一条消息：逐批落盘后应答
+  ::grpc::Status PushStream(::grpc::ServerContext* ctx, const hyperswitch::cdr::CdrBatch& in, hyperswitch::cdr::CdrBatchAck& ack);
 private:
-  std::string ch_http_;
+  // 编码并落盘一批；积压满时 ack.ok=false。磁盘故障等抛出异常
+  void push_batch(const hyperswitch::cdr::CdrBatch& in, hyperswitch::cdr::CdrBatchAck& ack);
+  // 已落盘的事件按 phase 更新在途通话：start / answer 登记，end 注销
+  void track(const hyperswitch::cdr::CdrEvent& ev);
+
+  BatchPipeline* pipeline_;
+  hs::CallRegistry* calls_;
 };
 
-}
\ No newline at end of file
+}
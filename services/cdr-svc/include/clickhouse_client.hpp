@@ -0,0 +1,31 @@
+#pragma once
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace hs::cdr {
+
+struct ClickHouseError : std::runtime_error {
+  ClickHouseError(long status, const std::string& msg) : std::runtime_error(msg), status(status) {}
+  // 4xx（超时与限流除外）为请求本身的问题，重试无意义
+  bool retryable() const { return status == 0 || status >= 500 || status == 408 || status == 429; }
+  long status;
+};
+
+// ClickHouse HTTP 写入：语句放在 URL 的 query 参数中，数据作为请求体
+class ClickHouseClient {
+public:
+  // lz4=true 时请求体以 LZ4 frame 压缩并带 Content-Encoding: lz4
+  ClickHouseClient(std::string endpoint, std::chrono::milliseconds timeout, bool lz4 = false);
+  // query 形如 "INSERT INTO cdr (...) FORMAT RowBinary"；失败抛出 ClickHouseError。
+  // dedup_token 非空时作为 insert_deduplication_token，同一批次重复写入被服务端丢弃（含物化视图）
+  void insert(std::string_view query, const std::string& body, std::string_view dedup_token = {}) const;
+
+private:
+  std::string endpoint_;
+  std::chrono::milliseconds timeout_;
+  bool lz4_;
+};
+
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "common/metrics.hpp"
+
+namespace hs::cdr {
+
+// CDR 本地预写日志。记录格式 [u32 len][u32 crc32c][u8 type][payload]，crc 覆盖 type 与 payload；
+// DATA 为一行（已编码的自定界数据），CUT 标记批次结束。段文件按大小轮转，且只在 CUT 之后轮转，批次不会跨段。
+// 追加先写入内存缓冲，sync() 由一个线程代表所有等待者写入并 fdatasync（组提交）。
+// 批次以 (段号, 段内起始偏移) 标识；ack 推进连续前缀的 checkpoint，之前的段可删除。
+class Spool {
+public:
+  struct Options {
+    std::string dir;
+    size_t segment_bytes = size_t{64} << 20;
+    bool fsync = true;
+  };
+
+  // 段内 [begin, end)，以 CUT 记录结尾；lsn 为 CUT 记录之后的逻辑位置
+  struct Range {
+    uint64_t segment = 0;
+    uint64_t begin = 0;
+    uint64_t end = 0;
+    uint64_t lsn = 0;
+    size_t rows = 0;
+  };
+
+  // 自上次切分以来尚未成批的数据
+  struct Pending {
+    size_t rows = 0;
+    size_t bytes = 0;
+    std::chrono::steady_clock::time_point first;
+  };
+
+  explicit Spool(Options opt);
+  ~Spool();
+
+  // 恢复：读取 checkpoint，校验各段并截断尾部残缺记录，为未切分的尾部补 CUT；
+  // 返回 checkpoint 之后尚未确认的批次（按写入顺序）。必须在 append 之前调用一次
+  std::vector<Range> open();
+
+  // 追加一行，返回其逻辑位置；sync(lsn) 返回后该行已落盘。磁盘写入失败后抛出异常
+  uint64_t append(std::string_view row);
+  // 多行一次追加，返回最后一行的逻辑位置
+  uint64_t append(std::span<const std::string_view> rows);
+  void sync(uint64_t lsn);
+
+  Pending pending() const;
+  // 切分当前批次，无数据时返回 nullopt；调用方需 sync(range.lsn) 后再发送
+  std::optional<Range> cut();
+
+  // 读出批次内各行原样拼接的内容；校验失败抛出异常
+  std::string read(const Range& r) const;
+  // 下游写入幂等键，重放时与首次发送一致
+  std::string token(const Range& r) const;
+  // 批次已写入下游（或已隔离）
+  void ack(const Range& r);
+  // 下游永久拒绝的批次写入 dir/rejected 供人工处理
+  void quarantine(const Range& r, const std::string& body) const;
+
+  // 已追加但未确认的字节数，用于背压
+  uint64_t unacked_bytes() const { return unacked_bytes_.load(std::memory_order_relaxed); }
+
+private:
+  enum : uint8_t { kData = 1, kCut = 2 };
+  static constexpr size_t kHeader = 9;
+
+  struct Chunk {
+    uint64_t segment;
+    std::string data;
+  };
+  struct Outstanding {
+    Range range;
+    bool acked = false;
+  };
+
+  std::string segment_path(uint64_t seg) const;
+  void encode(std::string& out, uint8_t type, std::string_view payload) const;
+  void write_chunks(std::vector<Chunk>& chunks);
+  void save_checkpoint(uint64_t seg, uint64_t off);
+
+  Options opt_;
+  std::string id_; // spool 目录标识，参与幂等键
+
+  mutable std::mutex mu_;
+  std::condition_variable sync_cv_;
+  std::vector<Chunk> chunks_;  // 待写入，最后一个为当前段的活动缓冲
+  uint64_t next_lsn_ = 0;
+  uint64_t durable_lsn_ = 0;
+  bool syncing_ = false;
+  bool broken_ = false;
+  uint64_t seg_ = 0;
+  uint64_t seg_size_ = 0;  // 当前段逻辑大小（含未写入缓冲）
+  uint64_t cut_begin_ = 0;
+  Pending pending_;
+
+  hs::metrics::Histogram* sync_latency_;  // 组提交：写入 + fdatasync
+
+  // 仅由 sync 的领头线程访问
+  int fd_ = -1;
+  uint64_t fd_seg_ = 0;
+
+  std::mutex ack_mu_;
+  std::deque<Outstanding> outstanding_;
+  uint64_t checkpoint_seg_ = 0;
+  uint64_t checkpoint_off_ = 0;
+  uint64_t oldest_seg_ = 0;
+
+  std::atomic<uint64_t> unacked_bytes_{0};
+};
+
+}
@@ -0,0 +1,186 @@
+#include "batch_pipeline.hpp"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+
+namespace hs::cdr {
+
+BatchPipeline::BatchPipeline(Spool* spool, Options opt, Sender send)
+  : spool_(spool), opt_(opt), send_(std::move(send)) {
+  opt_.senders = std::max<size_t>(1, opt_.senders);
+  auto& reg = hs::metrics::registry();
+  send_latency_ = &reg.histogram("hs_cdr_flush_seconds", "CDR batch send latency per attempt");
+  reg.counter_fn(this, "hs_cdr_rows_in_total", "CDR rows accepted into the spool", hs::metrics::load(stats_.rows_in));
+  reg.counter_fn(this, "hs_cdr_rows_sent_total", "CDR rows written downstream", hs::metrics::load(stats_.rows_sent));
+  reg.counter_fn(this, "hs_cdr_batches_sent_total", "CDR batches written downstream", hs::metrics::load(stats_.batches_sent));
+  reg.counter_fn(this, "hs_cdr_retries_total", "CDR batch send retries", hs::metrics::load(stats_.retries));
+  reg.counter_fn(this, "hs_cdr_batches_quarantined_total", "CDR batches rejected downstream or unreadable",
+                 hs::metrics::load(stats_.batches_rejected));
+  reg.counter_fn(this, "hs_cdr_rows_rejected_total", "CDR rows refused because the spool backlog is full",
+                 hs::metrics::load(stats_.rejected));
+  reg.gauge_fn(this, "hs_cdr_batches_queued", "CDR batches cut and waiting for a sender", [this] {
+    std::lock_guard<std::mutex> lk(q_mu_);
+    return static_cast<double>(q_.size());
+  });
+  reg.gauge_fn(this, "hs_cdr_spool_pending_rows", "CDR rows spooled but not yet cut into a batch",
+               [this] { return static_cast<double>(spool_->pending().rows); });
+  reg.gauge_fn(this, "hs_cdr_spool_unacked_bytes", "Spooled CDR bytes not yet acknowledged downstream",
+               [this] { return static_cast<double>(spool_->unacked_bytes()); });
+}
+
+BatchPipeline::~BatchPipeline() {
+  hs::metrics::registry().remove(this);
+  stop();
+}
+
+void BatchPipeline::start() {
+  for (const auto& r : spool_->open()) enqueue(r);
+  for (size_t i = 0; i < opt_.senders; ++i) senders_.emplace_back([this] { send_loop(); });
+  flusher_ = std::jthread([this](std::stop_token st) { flush_loop(st); });
+}
+
+void BatchPipeline::stop() {
+  if (!flusher_.joinable()) return;
+  flusher_.request_stop();
+  flush_cv_.notify_all();
+  flusher_.join();
+  {
+    std::lock_guard<std::mutex> lk(q_mu_);
+    closed_ = true;
+  }
+  q_cv_.notify_all();
+  stop_cv_.notify_all();
+  for (auto& t : senders_) t.join();
+  senders_.clear();
+}
+
+bool BatchPipeline::push(std::string_view row) {
+  return push(std::span<const std::string_view>(&row, 1));
+}
+
+bool BatchPipeline::push(std::span<const std::string_view> rows) {
+  if (rows.empty()) return true;
+  if (spool_->unacked_bytes() > opt_.max_pending_bytes) {
+    stats_.rejected += rows.size();
+    return false;
+  }
+  uint64_t lsn = spool_->append(rows);
+  spool_->sync(lsn);
+  stats_.rows_in += rows.size();
+  auto p = spool_->pending();
+  if (p.rows >= opt_.max_rows || p.bytes >= opt_.max_bytes) flush_cv_.notify_one();
+  return true;
+}
+
+void BatchPipeline::enqueue(const Spool::Range& r) {
+  {
+    std::lock_guard<std::mutex> lk(q_mu_);
+    q_.push_back(r);
+  }
+  q_cv_.notify_one();
+}
+
+void BatchPipeline::cut() {
+  auto r = spool_->cut();
+  if (!r) return;
+  spool_->sync(r->lsn);
+  enqueue(*r);
+}
+
+void BatchPipeline::flush_loop(std::stop_token st) {
+  auto tick = std::clamp(opt_.max_age / 4, std::chrono::milliseconds(5), std::chrono::milliseconds(250));
+  auto next_report = clock::now() + std::chrono::seconds(60);
+  while (!st.stop_requested()) {
+    {
+      std::unique_lock<std::mutex> lk(flush_mu_);
+      flush_cv_.wait_for(lk, tick, [&] {
+        if (st.stop_requested()) return true;
+        auto p = spool_->pending();
+        return p.rows >= opt_.max_rows || p.bytes >= opt_.max_bytes;
+      });
+    }
+    auto p = spool_->pending();
+    if (p.rows >= opt_.max_rows || p.bytes >= opt_.max_bytes || (p.rows && clock::now() - p.first >= opt_.max_age)) {
+      try {
+        cut();
+      } catch (const std::exception& ex) {
+        spdlog::error("CDR batch cut failed: {}", ex.what());
+      }
+    }
+
+    if (clock::now() >= next_report) {
+      next_report = clock::now() + std::chrono::seconds(60);
+      size_t queued;
+      {
+        std::lock_guard<std::mutex> lk(q_mu_);
+        queued = q_.size();
+      }
+      spdlog::info("CDR pipeline: in={} sent={} batches={} queued={} retries={} quarantined={} rejected={} spool_unacked={}",
+                   stats_.rows_in.load(), stats_.rows_sent.load(), stats_.batches_sent.load(), queued, stats_.retries.load(),
+                   stats_.batches_rejected.load(), stats_.rejected.load(), spool_->unacked_bytes());
+    }
+  }
+  try {
+    cut();
+  } catch (const std::exception& ex) {
+    spdlog::error("CDR batch cut failed: {}", ex.what());
+  }
+}
+
+void BatchPipeline::send_loop() {
+  for (;;) {
+    Spool::Range r;
+    {
+      std::unique_lock<std::mutex> lk(q_mu_);
+      q_cv_.wait(lk, [&] { return !q_.empty() || closed_; });
+      if (q_.empty()) return;
+      r = q_.front();
+      q_.pop_front();
+    }
+    std::string token = spool_->token(r);
+    std::string body;
+    try {
+      body = spool_->read(r);
+    } catch (const std::exception& ex) {
+      // 已落盘的数据校验失败只可能来自介质损坏，跳过以免阻塞 checkpoint
+      spdlog::critical("CDR batch {} unreadable, skipped: {}", token, ex.what());
+      ++stats_.batches_rejected;
+      spool_->ack(r);
+      continue;
+    }
+
+    auto backoff = opt_.retry_base;
+    for (int attempt = 1;; ++attempt) {
+      try {
+        {
+          hs::metrics::Timer t(*send_latency_);
+          send_(body, token);
+        }
+        stats_.rows_sent += r.rows;
+        ++stats_.batches_sent;
+        spool_->ack(r);
+        break;
+      } catch (const RejectedBatch& ex) {
+        try {
+          spool_->quarantine(r, body);
+          spdlog::error("CDR batch {} ({} rows) rejected, quarantined: {}", token, r.rows, ex.what());
+          ++stats_.batches_rejected;
+          spool_->ack(r);
+          break;
+        } catch (const std::exception& qex) {
+          spdlog::error("CDR batch {} rejected and quarantine failed: {}", token, qex.what());
+        }
+      } catch (const std::exception& ex) {
+        spdlog::warn("CDR batch {} ({} rows) failed (attempt {}), retry in {}ms: {}", token, r.rows, attempt, backoff.count(), ex.what());
+      }
+      // 停止过程中不再重试，批次留在 spool 中下次启动重放
+      ++stats_.retries;
+      {
+        std::unique_lock<std::mutex> lk(q_mu_);
+        if (stop_cv_.wait_for(lk, backoff, [&] { return closed_.load(); })) return;
+      }
+      backoff = std::min(backoff * 2, opt_.retry_max);
+    }
+  }
+}
+
+}
@@ -0,0 +1,102 @@
+#include "cdr_encoder.hpp"
+#include <common/number.hpp>
+#include <common/time.hpp>
+#include <cstring>
+#include <optional>
+
+namespace hs::cdr {
+
+const std::string_view kCdrInsertQuery =
+  "INSERT INTO cdr (call_id, attempt, start_ts, answer_ts, end_ts, billsec, from_uri, to_uri, e164_from, e164_to, "
+  "ingress_trunk, egress_trunk, sip_final_code, sip_final_reason, route_plan, vendor, codec_in, codec_out, transcoded, "
+  "pdd_ms, asr_bucket, acd_seconds, bytes_tx, bytes_rx, node) FORMAT RowBinary";
+
+namespace {
+
+template <class T>
+void put(std::string& out, T v) {
+  char b[sizeof(T)];
+  std::memcpy(b, &v, sizeof(T));  // RowBinary 为小端，与 x86/ARM 主机序一致
+  out.append(b, sizeof(T));
+}
+
+void put_str(std::string& out, std::string_view s) {
+  uint64_t n = s.size();
+  while (n >= 0x80) {
+    out += static_cast<char>((n & 0x7f) | 0x80);
+    n >>= 7;
+  }
+  out += static_cast<char>(n);
+  out.append(s);
+}
+
+// 空串视为缺失；DateTime 为 UInt32 秒
+std::optional<int64_t> epoch_sec(std::string_view s, const char* field) {
+  if (s.empty()) return std::nullopt;
+  auto ms = hs::parse_iso8601_ms(s);
+  if (!ms || *ms < 0 || *ms / 1000 > UINT32_MAX) throw InvalidCdr(std::string("invalid ") + field + ": " + std::string(s));
+  return *ms / 1000;
+}
+
+// 与 route / billing 同一规范化：字段为空时取自 URI；无法解析时保留原值（字段为空时为 URI 的用户部分），话单不丢信息
+std::string_view e164(std::string_view number, std::string_view uri, hs::number::E164& buf) {
+  if (hs::number::normalize(number.empty() ? uri : number, buf) == hs::number::Status::Ok) return buf.view();
+  return number.empty() ? hs::number::user_part(uri) : number;
+}
+
+}
+
+std::string_view asr_bucket(uint32_t code, bool answered) {
+  if (answered || (code >= 200 && code < 300)) return "answered";
+  switch (code) {
+    case 0: return "";
+    case 486: case 600: return "busy";
+    case 408: case 480: case 487: return "no_answer";
+  }
+  if (code >= 500 && code < 600) return "failed";
+  return "rejected";
+}
+
+void encode_row_binary(const hyperswitch::cdr::CdrEvent& ev, std::string& out) {
+  auto start = epoch_sec(ev.start_ts(), "start_ts");
+  if (!start) throw InvalidCdr("start_ts is required");
+  auto answer = epoch_sec(ev.answer_ts(), "answer_ts");
+  auto end = epoch_sec(ev.end_ts(), "end_ts");
+  // 与 cdr_proj 投影口径一致：按秒截断后相减
+  uint32_t billsec = answer && end && *end > *answer ? static_cast<uint32_t>(*end - *answer) : 0;
+
+  put_str(out, ev.call_id());
+  put<uint8_t>(out, static_cast<uint8_t>(ev.attempt()));
+  put<uint32_t>(out, static_cast<uint32_t>(*start));
+  if (answer) {
+    put<uint8_t>(out, 0);
+    put<uint32_t>(out, static_cast<uint32_t>(*answer));
+  } else {
+    put<uint8_t>(out, 1);
+  }
+  // 未结束的呼叫以 start_ts 占位，end_ts 列不可为空
+  put<uint32_t>(out, static_cast<uint32_t>(end.value_or(*start)));
+  put<uint32_t>(out, billsec);
+  put_str(out, ev.from_uri());
+  put_str(out, ev.to_uri());
+  hs::number::E164 buf;
+  put_str(out, e164(ev.e164_from(), ev.from_uri(), buf));
+  put_str(out, e164(ev.e164_to(), ev.to_uri(), buf));
+  put_str(out, ev.ingress_trunk());
+  put_str(out, ev.egress_trunk());
+  put<uint16_t>(out, static_cast<uint16_t>(ev.sip_final_code()));
+  put_str(out, ev.sip_final_reason());
+  put_str(out, ev.route_plan());
+  put_str(out, ev.vendor());
+  put_str(out, ev.codec_in());
+  put_str(out, ev.codec_out());
+  put<uint8_t>(out, ev.transcoded() ? 1 : 0);
+  put<uint32_t>(out, ev.pdd_ms());
+  put_str(out, asr_bucket(ev.sip_final_code(), answer.has_value()));
+  put<float>(out, static_cast<float>(ev.acd_seconds()));
+  put<uint64_t>(out, ev.bytes_tx());
+  put<uint64_t>(out, ev.bytes_rx());
+  put_str(out, ev.node());
+}
+
+}
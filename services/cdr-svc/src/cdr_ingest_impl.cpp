@@ -1,81 +1,110 @@
 #include "cdr_ingest_impl.hpp"
-#include <cpr/cpr.h>
-#include <nlohmann/json.hpp>
+#include "cdr_encoder.hpp"
 #include <spdlog/spdlog.h>
-#include <mutex>
-#include <deque>
+#include <vector>
 
 using hyperswitch::cdr::CdrEvent;
 using hyperswitch::cdr::Ack;
+using hyperswitch::cdr::CdrBatch;
+using hyperswitch::cdr::CdrBatchAck;
 
 namespace hs::cdr {
 
-static std::mutex g_mu;
-static std::deque<std::string> g_queue; // JSONEachRow lines
-static const size_t FLUSH_THRESHOLD = 200;
+CdrIngestImpl::CdrIngestImpl(BatchPipeline* pipeline, hs::CallRegistry* calls) : pipeline_(pipeline), calls_(calls) {}
 
-CdrIngestImpl::CdrIngestImpl(const std::string& ch_http_endpoint) : ch_http_(ch_http_endpoint) {}
-
-static void flush_batch(const std::string& ch_http) {
-  if (g_queue.empty()) return;
-  std::string body;
-  body.reserve(g_queue.size() * 256);
-  while (!g_queue.empty()) { body += g_queue.front(); body += "\n"; g_queue.pop_front(); }
-  std::string sql = "INSERT INTO cdr FORMAT JSONEachRow\n" + body;
-  auto r = cpr::Post(cpr::Url{ch_http}, cpr::Body{sql}, cpr::Timeout{5000});
-  if (r.status_code < 200 || r.status_code >= 300) {
-    spdlog::error("ClickHouse batch error {}: {}", r.status_code, r.text);
+void CdrIngestImpl::track(const CdrEvent& ev) {
+  const auto& phase = ev.phase();
+  if (phase == "end") {
+    calls_->close(ev.call_id());
+  } else if (phase == "start" || phase == "answer") {
+    hs::CallRegistry::Parties p;
+    p.ingress_trunk = ev.ingress_trunk();
+    p.egress_trunk = ev.egress_trunk();
+    p.vendor = ev.vendor();
+    const auto& opt = calls_->options();
+    calls_->open(ev.call_id(), p, phase == "answer" ? opt.ttl : opt.setup_ttl);
   }
 }
 
 ::grpc::Status CdrIngestImpl::Push(::grpc::ServerContext* ctx, const CdrEvent* req, Ack* resp) {
   try {
-    nlohmann::json row = {
-      {"call_id", req->call_id()},
-      {"attempt", req->attempt()},
-      {"start_ts", req->start_ts()},
-      {"answer_ts", req->answer_ts()},
-      {"end_ts", req->end_ts()},
-      {"billsec", 0},
-      {"from_uri", req->from_uri()},
-      {"to_uri", req->to_uri()},
-      {"e164_from", req->e164_from()},
-      {"e164_to", req->e164_to()},
-      {"ingress_trunk", req->ingress_trunk()},
-      {"egress_trunk", req->egress_trunk()},
-      {"sip_final_code", req->sip_final_code()},
-      {"sip_final_reason", req->sip_final_reason()},
-      {"route_plan", req->route_plan()},
-      {"vendor", req->vendor()},
-      {"codec_in", req->codec_in()},
-      {"codec_out", req->codec_out()},
-      {"transcoded", req->transcoded()},
-      {"pdd_ms", req->pdd_ms()},
-      {"acd_seconds", req->acd_seconds()},
-      {"bytes_tx", req->bytes_tx()},
-      {"bytes_rx", req->bytes_rx()},
-      {"node", req->node()}
-    };
-    // billsec 计算（若有）
-    if (!req->answer_ts().empty() && !req->end_ts().empty()) {
-      row["billsec"] = 0; // 交给 CH 凭表达式计算或 ETL 后续处理（可保留 0）
-    }
+    thread_local std::string row;
+    row.clear();
+    encode_row_binary(*req, row);
 
-    std::string line = row.dump();
-    {
-      std::lock_guard<std::mutex> lk(g_mu);
-      g_queue.push_back(line);
-      if (g_queue.size() >= FLUSH_THRESHOLD) {
-        // flush synchronously for now
-        flush_batch(ch_http_);
-      }
+    // 落盘到本地 spool 后应答，写入 ClickHouse 由管道异步完成
+    if (!pipeline_->push(row)) {
+      return {::grpc::StatusCode::RESOURCE_EXHAUSTED, "cdr backlog full"};
     }
+    track(*req);
     resp->set_ok(true);
     return ::grpc::Status::OK;
+  } catch (const InvalidCdr& ex) {
+    return {::grpc::StatusCode::INVALID_ARGUMENT, ex.what()};
   } catch (const std::exception& ex) {
     spdlog::error("CDR ingest error: {}", ex.what());
     return ::grpc::Status(::grpc::StatusCode::INTERNAL, ex.what());
   }
 }
 
-}
\ No newline at end of file
+void CdrIngestImpl::push_batch(const CdrBatch& in, CdrBatchAck& ack) {
+  thread_local std::string buf;
+  thread_local std::vector<size_t> ends;
+  thread_local std::vector<std::string_view> rows;
+  thread_local std::vector<int> encoded;
+  buf.clear();
+  ends.clear();
+  rows.clear();
+  encoded.clear();
+  ack.Clear();
+  ack.set_seq(in.seq());
+  for (int i = 0; i < in.events_size(); ++i) {
+    size_t mark = buf.size();
+    try {
+      encode_row_binary(in.events(i), buf);
+      ends.push_back(buf.size());
+      encoded.push_back(i);
+    } catch (const InvalidCdr& ex) {
+      buf.resize(mark);
+      ack.add_invalid(static_cast<uint32_t>(i));
+      if (ack.error().empty()) ack.set_error(ex.what());
+    }
+  }
+  size_t begin = 0;
+  for (size_t end : ends) {
+    rows.emplace_back(buf.data() + begin, end - begin);
+    begin = end;
+  }
+  if (!pipeline_->push(std::span<const std::string_view>(rows))) {
+    ack.set_ok(false);
+    ack.set_error("cdr backlog full");
+    return;
+  }
+  for (int i : encoded) track(in.events(i));
+  ack.set_ok(true);
+  ack.set_accepted(static_cast<uint32_t>(rows.size()));
+}
+
+::grpc::Status CdrIngestImpl::PushBatch(::grpc::ServerContext*, const CdrBatch* req, CdrBatchAck* resp) {
+  try {
+    push_batch(*req, *resp);
+    if (!resp->ok()) return {::grpc::StatusCode::RESOURCE_EXHAUSTED, "cdr backlog full"};
+    return ::grpc::Status::OK;
+  } catch (const std::exception& ex) {
+    spdlog::error("CDR batch ingest error: {}", ex.what());
+    return ::grpc::Status(::grpc::StatusCode::INTERNAL, ex.what());
+  }
+}
+
+::grpc::Status CdrIngestImpl::PushStream(::grpc::ServerContext*, const CdrBatch& in, CdrBatchAck& ack) {
+  try {
+    // 积压满只在该批的应答中体现，流保持打开，调用方按 seq 重发
+    push_batch(in, ack);
+    return ::grpc::Status::OK;
+  } catch (const std::exception& ex) {
+    spdlog::error("CDR stream ingest error: {}", ex.what());
+    return ::grpc::Status(::grpc::StatusCode::INTERNAL, ex.what());
+  }
+}
+
+}
@@ -0,0 +1,45 @@
+#include "clickhouse_client.hpp"
+#include <cpr/cpr.h>
+#include <lz4frame.h>
+#include <cctype>
+
+namespace hs::cdr {
+
+static std::string url_encode(std::string_view s) {
+  static const char* hex = "0123456789ABCDEF";
+  std::string out;
+  for (unsigned char c : s) {
+    if (std::isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') out += static_cast<char>(c);
+    else { out += '%'; out += hex[c >> 4]; out += hex[c & 0xf]; }
+  }
+  return out;
+}
+
+static std::string lz4_frame(const std::string& in) {
+  LZ4F_preferences_t prefs{};
+  prefs.frameInfo.contentSize = in.size();
+  std::string out(LZ4F_compressFrameBound(in.size(), &prefs), '\0');
+  size_t n = LZ4F_compressFrame(out.data(), out.size(), in.data(), in.size(), &prefs);
+  if (LZ4F_isError(n)) throw std::runtime_error(std::string("lz4: ") + LZ4F_getErrorName(n));
+  out.resize(n);
+  return out;
+}
+
+ClickHouseClient::ClickHouseClient(std::string endpoint, std::chrono::milliseconds timeout, bool lz4)
+  : endpoint_(std::move(endpoint)), timeout_(timeout), lz4_(lz4) {}
+
+void ClickHouseClient::insert(std::string_view query, const std::string& body, std::string_view dedup_token) const {
+  std::string url = endpoint_ + (endpoint_.find('?') == std::string::npos ? "?" : "&") + "query=" + url_encode(query);
+  if (!dedup_token.empty()) {
+    url += "&insert_deduplication_token=" + url_encode(dedup_token);
+    url += "&deduplicate_blocks_in_dependent_materialized_views=1";
+  }
+  auto r = lz4_ ? cpr::Post(cpr::Url{url}, cpr::Body{lz4_frame(body)}, cpr::Header{{"Content-Encoding", "lz4"}}, cpr::Timeout{timeout_})
+               : cpr::Post(cpr::Url{url}, cpr::Body{body}, cpr::Timeout{timeout_});
+  if (r.status_code < 200 || r.status_code >= 300) {
+    throw ClickHouseError(r.status_code, "ClickHouse " + std::to_string(r.status_code) + ": " +
+                                         (r.status_code == 0 ? r.error.message : r.text.substr(0, 512)));
+  }
+}
+
+}
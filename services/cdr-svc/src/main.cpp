@@ -1,21 +1,73 @@
-#include <grpcpp/grpcpp.h>
+#include <unistd.h>
 #include <spdlog/spdlog.h>
+#include "common/call_registry.hpp"
 #include "common/env.hpp"
 #include "common/log.hpp"
+#include "common/metrics.hpp"
+#include "common/redis.hpp"
+#include "common/rpc_server.hpp"
+#include "cdr_encoder.hpp"
 #include "cdr_ingest_impl.hpp"
+#include "clickhouse_client.hpp"
 
 int main(int argc, char** argv) {
   hs::init_logging(hs::get_env("LOG_LEVEL", "info"));
   std::string ch_http = hs::get_env("CH_HTTP", "http://localhost:8123/?database=hyperswitch");
+  std::string redis_uri = hs::get_env("REDIS_URI", "tcp://localhost:6379");
   std::string bind = hs::get_env("BIND", "0.0.0.0:7002");
 
-  hs::cdr::CdrIngestImpl svc(ch_http);
+  hs::cdr::ClickHouseClient ch(ch_http, std::chrono::milliseconds(hs::get_env_int("CH_TIMEOUT_MS", 10000)),
+                               hs::get_env("CH_COMPRESS", "none") == "lz4");
+  hs::cdr::Spool::Options sopt;
+  sopt.dir = hs::get_env("CDR_SPOOL_DIR", "./spool/cdr");
+  sopt.segment_bytes = static_cast<size_t>(hs::get_env_int("CDR_SPOOL_SEGMENT_MB", 64)) << 20;
+  sopt.fsync = hs::get_env_int("CDR_SPOOL_FSYNC", 1) != 0;
+  hs::cdr::Spool spool(sopt);
 
-  grpc::ServerBuilder builder;
-  builder.AddListeningPort(bind, grpc::InsecureServerCredentials());
-  builder.RegisterService(&svc);
-  auto server = builder.BuildAndStart();
+  hs::cdr::BatchPipeline::Options popt;
+  popt.max_rows = static_cast<size_t>(hs::get_env_int("CDR_FLUSH_ROWS", 5000));
+  popt.max_bytes = static_cast<size_t>(hs::get_env_int("CDR_FLUSH_BYTES", 4 << 20));
+  popt.max_age = std::chrono::milliseconds(hs::get_env_int("CDR_FLUSH_MS", 1000));
+  popt.senders = static_cast<size_t>(hs::get_env_int("CDR_MAX_INFLIGHT", 4));
+  popt.max_pending_bytes = static_cast<uint64_t>(hs::get_env_int("CDR_SPOOL_MAX_MB", 8192)) << 20;
+  hs::cdr::BatchPipeline pipeline(&spool, popt, [&ch](const std::string& body, const std::string& token) {
+    try {
+      ch.insert(hs::cdr::kCdrInsertQuery, body, token);
+    } catch (const hs::cdr::ClickHouseError& ex) {
+      if (!ex.retryable()) throw hs::cdr::RejectedBatch(ex.what());
+      throw;
+    }
+  });
+  pipeline.start();
+
+  hs::RedisClient redis(redis_uri);
+  hs::CallRegistry::Options copt;
+  copt.source = "cdr:" + hs::get_env("NODE_ID", hs::get_env("HOSTNAME", "cdr-svc") + ":" + std::to_string(::getpid()));
+  copt.publish_interval = std::chrono::milliseconds(hs::get_env_int("CALLS_PUBLISH_MS", 1000));
+  copt.setup_ttl = std::chrono::seconds(hs::get_env_int("CALLS_SETUP_TTL_S", 300));
+  copt.ttl = std::chrono::seconds(hs::get_env_int("CALLS_TTL_S", 14400));
+  hs::CallRegistry calls(copt);
+  calls.start(&redis);
+
+  hs::cdr::CdrIngestImpl svc(&pipeline, &calls);
+
+  // 落盘要等待 spool 组提交（fsync），交给工作线程池，完成队列线程不被磁盘阻塞；
+  // 并发等待的请求越多，一次 fsync 覆盖的行越多
+  using hyperswitch::cdr::CdrIngest;
+  CdrIngest::AsyncService rpc_svc;
+  hs::rpc::Options ropt;
+  ropt.bind = bind;
+  ropt.workers = 16;
+  hs::rpc::Server server(hs::rpc::options_from_env(ropt));
+  server.unary("Push", &rpc_svc, &CdrIngest::AsyncService::RequestPush,
+               [&](auto* ctx, auto* req, auto* resp) { return svc.Push(ctx, req, resp); }, hs::rpc::Exec::Pool);
+  server.unary("PushBatch", &rpc_svc, &CdrIngest::AsyncService::RequestPushBatch,
+               [&](auto* ctx, auto* req, auto* resp) { return svc.PushBatch(ctx, req, resp); }, hs::rpc::Exec::Pool);
+  server.bidi_stream("PushStream", &rpc_svc, &CdrIngest::AsyncService::RequestPushStream,
+                     [&](auto* ctx, const auto& req, auto& resp) { return svc.PushStream(ctx, req, resp); }, hs::rpc::Exec::Pool);
+  server.start();
+  hs::metrics::Exporter metrics(hs::get_env("METRICS_BIND", "0.0.0.0:9103"));
   spdlog::info("cdr-svc listening on {}", bind);
-  server->Wait();
+  server.wait();
   return 0;
 }
\ No newline at end of file
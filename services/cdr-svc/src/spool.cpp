@@ -0,0 +1,349 @@
+#include "spool.hpp"
+#include <spdlog/spdlog.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <system_error>
+#include "common/crc32c.hpp"
+
+namespace fs = std::filesystem;
+
+namespace hs::cdr {
+
+static void write_all(int fd, const char* p, size_t n) {
+  while (n > 0) {
+    ssize_t w = ::write(fd, p, n);
+    if (w < 0) {
+      if (errno == EINTR) continue;
+      throw std::system_error(errno, std::generic_category(), "spool write");
+    }
+    p += w;
+    n -= static_cast<size_t>(w);
+  }
+}
+
+static void fsync_dir(const std::string& dir) {
+  int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) return;
+  ::fsync(fd);
+  ::close(fd);
+}
+
+// 解析一条记录头；不完整或校验失败返回 false
+static bool parse_record(const char* base, size_t size, size_t pos, uint32_t& len, uint8_t& type) {
+  if (pos + 9 > size) return false;
+  uint32_t crc;
+  std::memcpy(&len, base + pos, 4);
+  std::memcpy(&crc, base + pos + 4, 4);
+  type = static_cast<uint8_t>(base[pos + 8]);
+  if (len > size - pos - 9) return false;
+  return hs::crc32c(base + pos + 9, len, hs::crc32c(&type, 1)) == crc;
+}
+
+Spool::Spool(Options opt)
+  : opt_(std::move(opt)),
+    sync_latency_(&hs::metrics::registry().histogram("hs_cdr_spool_sync_seconds", "CDR spool group commit latency (write + fdatasync)")) {}
+
+Spool::~Spool() {
+  if (fd_ >= 0) ::close(fd_);
+}
+
+std::string Spool::segment_path(uint64_t seg) const {
+  char name[32];
+  std::snprintf(name, sizeof(name), "/%016llu.seg", static_cast<unsigned long long>(seg));
+  return opt_.dir + name;
+}
+
+void Spool::encode(std::string& out, uint8_t type, std::string_view payload) const {
+  // 小端布局，与读取端 memcpy 一致
+  uint32_t len = static_cast<uint32_t>(payload.size());
+  uint32_t crc = hs::crc32c(payload.data(), payload.size(), hs::crc32c(&type, 1));
+  char hdr[kHeader];
+  std::memcpy(hdr, &len, 4);
+  std::memcpy(hdr + 4, &crc, 4);
+  hdr[8] = static_cast<char>(type);
+  out.append(hdr, kHeader);
+  out.append(payload);
+}
+
+std::vector<Spool::Range> Spool::open() {
+  fs::create_directories(opt_.dir);
+  {
+    std::ifstream in(opt_.dir + "/spool_id");
+    if (!(in >> id_)) {
+      // 每个 spool 目录唯一，目录重建后幂等键不会与旧数据冲突
+      std::mt19937_64 g{std::random_device{}()};
+      char buf[17];
+      std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(g()));
+      id_ = buf;
+      std::ofstream(opt_.dir + "/spool_id") << id_ << "\n";
+    }
+  }
+  {
+    std::ifstream in(opt_.dir + "/checkpoint");
+    if (!(in >> checkpoint_seg_ >> checkpoint_off_)) checkpoint_seg_ = checkpoint_off_ = 0;
+  }
+
+  std::vector<uint64_t> segs;
+  for (const auto& e : fs::directory_iterator(opt_.dir)) {
+    if (e.path().extension() != ".seg") continue;
+    try { segs.push_back(std::stoull(e.path().stem().string())); } catch (...) {}
+  }
+  std::sort(segs.begin(), segs.end());
+
+  std::vector<Range> out;
+  size_t rows_total = 0;
+  for (uint64_t s : segs) {
+    std::string path = segment_path(s);
+    if (s < checkpoint_seg_) { fs::remove(path); continue; }
+    std::string data;
+    {
+      std::ifstream in(path, std::ios::binary);
+      data.assign(std::istreambuf_iterator<char>(in), {});
+    }
+    size_t pos = 0, begin = 0, rows = 0;
+    uint32_t len;
+    uint8_t type;
+    while (parse_record(data.data(), data.size(), pos, len, type)) {
+      pos += kHeader + len;
+      if (type == kData) { ++rows; continue; }
+      if (s > checkpoint_seg_ || begin >= checkpoint_off_) {
+        out.push_back({s, begin, pos, 0, rows});
+        rows_total += rows;
+      }
+      begin = pos;
+      rows = 0;
+    }
+    if (pos < data.size()) {
+      spdlog::warn("Spool segment {} has {} trailing bytes that fail validation, truncating", path, data.size() - pos);
+      if (::truncate(path.c_str(), static_cast<off_t>(pos)) != 0)
+        throw std::system_error(errno, std::generic_category(), "spool truncate");
+    }
+    if (rows > 0) {
+      // 已确认落盘但尚未切分的尾部：补 CUT 成批
+      std::string rec;
+      encode(rec, kCut, {});
+      int fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+      if (fd < 0) throw std::system_error(errno, std::generic_category(), "spool open");
+      write_all(fd, rec.data(), rec.size());
+      ::fdatasync(fd);
+      ::close(fd);
+      out.push_back({s, begin, pos + rec.size(), 0, rows});
+      rows_total += rows;
+    }
+  }
+
+  // 新数据总是写入新段
+  seg_ = std::max(segs.empty() ? 0 : segs.back(), checkpoint_seg_) + 1;
+  oldest_seg_ = segs.empty() ? seg_ : std::max(segs.front(), checkpoint_seg_);
+  chunks_.clear();
+  chunks_.push_back({seg_, {}});
+  {
+    std::lock_guard<std::mutex> lk(ack_mu_);
+    for (const auto& r : out) {
+      outstanding_.push_back({r});
+      unacked_bytes_ += r.end - r.begin;
+    }
+  }
+  spdlog::info("Spool {} opened at segment {}: {} batch(es) / {} rows pending replay from checkpoint {}:{}",
+               opt_.dir, seg_, out.size(), rows_total, checkpoint_seg_, checkpoint_off_);
+  return out;
+}
+
+uint64_t Spool::append(std::string_view row) {
+  return append(std::span<const std::string_view>(&row, 1));
+}
+
+uint64_t Spool::append(std::span<const std::string_view> rows) {
+  // 校验和在锁外计算
+  thread_local std::string recs;
+  recs.clear();
+  for (auto row : rows) encode(recs, kData, row);
+
+  std::lock_guard<std::mutex> lk(mu_);
+  if (broken_) throw std::runtime_error("spool unavailable after write failure");
+  chunks_.back().data.append(recs);
+  seg_size_ += recs.size();
+  next_lsn_ += recs.size();
+  if (pending_.rows == 0 && !rows.empty()) pending_.first = std::chrono::steady_clock::now();
+  pending_.rows += rows.size();
+  pending_.bytes += recs.size();
+  unacked_bytes_.fetch_add(recs.size(), std::memory_order_relaxed);
+  return next_lsn_;
+}
+
+void Spool::write_chunks(std::vector<Chunk>& chunks) {
+  for (auto& c : chunks) {
+    if (c.data.empty()) continue;
+    if (fd_ < 0 || c.segment != fd_seg_) {
+      if (fd_ >= 0) {
+        if (opt_.fsync) ::fdatasync(fd_);
+        ::close(fd_);
+        fd_ = -1;
+      }
+      fd_ = ::open(segment_path(c.segment).c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+      if (fd_ < 0) throw std::system_error(errno, std::generic_category(), "spool open");
+      fd_seg_ = c.segment;
+      if (opt_.fsync) fsync_dir(opt_.dir);
+    }
+    write_all(fd_, c.data.data(), c.data.size());
+  }
+  if (opt_.fsync && fd_ >= 0 && ::fdatasync(fd_) != 0)
+    throw std::system_error(errno, std::generic_category(), "spool fdatasync");
+}
+
+void Spool::sync(uint64_t lsn) {
+  std::unique_lock<std::mutex> lk(mu_);
+  while (durable_lsn_ < lsn) {
+    if (broken_) throw std::runtime_error("spool unavailable after write failure");
+    if (syncing_) { sync_cv_.wait(lk); continue; }
+    // 领头：带走当前全部缓冲，一次写入与 fdatasync 覆盖所有等待者
+    syncing_ = true;
+    uint64_t target = next_lsn_;
+    std::vector<Chunk> chunks;
+    chunks.swap(chunks_);
+    chunks_.push_back({seg_, {}});
+    chunks_.back().data.reserve(chunks.back().data.capacity());
+    lk.unlock();
+    std::string err;
+    try {
+      hs::metrics::Timer t(*sync_latency_);
+      write_chunks(chunks);
+    } catch (const std::exception& ex) {
+      err = ex.what();
+    }
+    lk.lock();
+    syncing_ = false;
+    if (err.empty()) {
+      durable_lsn_ = target;
+    } else {
+      // 部分写入后文件状态不可信，停止接收，重启时由 open() 校验截断
+      broken_ = true;
+      spdlog::critical("Spool write failed, refusing further appends: {}", err);
+    }
+    sync_cv_.notify_all();
+  }
+}
+
+Spool::Pending Spool::pending() const {
+  std::lock_guard<std::mutex> lk(mu_);
+  return pending_;
+}
+
+std::optional<Spool::Range> Spool::cut() {
+  std::lock_guard<std::mutex> lk(mu_);
+  if (pending_.rows == 0 || broken_) return std::nullopt;
+  std::string& buf = chunks_.back().data;
+  size_t before = buf.size();
+  encode(buf, kCut, {});
+  size_t n = buf.size() - before;
+  seg_size_ += n;
+  next_lsn_ += n;
+  unacked_bytes_.fetch_add(n, std::memory_order_relaxed);
+
+  Range r{seg_, cut_begin_, seg_size_, next_lsn_, pending_.rows};
+  cut_begin_ = seg_size_;
+  pending_ = {};
+  if (seg_size_ >= opt_.segment_bytes) {
+    ++seg_;
+    seg_size_ = 0;
+    cut_begin_ = 0;
+    chunks_.push_back({seg_, {}});
+  }
+  std::lock_guard<std::mutex> la(ack_mu_);
+  outstanding_.push_back({r});
+  return r;
+}
+
+std::string Spool::read(const Range& r) const {
+  std::string path = segment_path(r.segment);
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) throw std::system_error(errno, std::generic_category(), "spool open " + path);
+  std::string raw(r.end - r.begin, '\0');
+  size_t got = 0;
+  while (got < raw.size()) {
+    ssize_t n = ::pread(fd, raw.data() + got, raw.size() - got, static_cast<off_t>(r.begin + got));
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    got += static_cast<size_t>(n);
+  }
+  ::close(fd);
+  if (got != raw.size()) throw std::runtime_error("spool short read in " + path);
+
+  std::string out;
+  out.reserve(raw.size());
+  size_t pos = 0, rows = 0;
+  uint32_t len;
+  uint8_t type;
+  while (pos < raw.size()) {
+    if (!parse_record(raw.data(), raw.size(), pos, len, type))
+      throw std::runtime_error("spool record checksum mismatch in " + path + " at " + std::to_string(r.begin + pos));
+    if (type == kData) {
+      out.append(raw, pos + kHeader, len);
+      ++rows;
+    }
+    pos += kHeader + len;
+  }
+  if (rows != r.rows && r.rows != 0) throw std::runtime_error("spool batch row count mismatch in " + path);
+  return out;
+}
+
+std::string Spool::token(const Range& r) const {
+  return "cdr-" + id_ + "-" + std::to_string(r.segment) + "-" + std::to_string(r.begin);
+}
+
+void Spool::save_checkpoint(uint64_t seg, uint64_t off) {
+  std::string tmp = opt_.dir + "/checkpoint.tmp";
+  {
+    std::ofstream out(tmp, std::ios::trunc);
+    out << seg << " " << off << "\n";
+  }
+  if (opt_.fsync) {
+    int fd = ::open(tmp.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) { ::fdatasync(fd); ::close(fd); }
+  }
+  fs::rename(tmp, opt_.dir + "/checkpoint");
+}
+
+void Spool::ack(const Range& r) {
+  std::lock_guard<std::mutex> lk(ack_mu_);
+  // 批次按 (段, 偏移) 单调产生
+  auto it = std::lower_bound(outstanding_.begin(), outstanding_.end(), r, [](const Outstanding& o, const Range& x) {
+    return o.range.segment < x.segment || (o.range.segment == x.segment && o.range.begin < x.begin);
+  });
+  if (it == outstanding_.end() || it->range.segment != r.segment || it->range.begin != r.begin || it->acked) return;
+  it->acked = true;
+  unacked_bytes_.fetch_sub(r.end - r.begin, std::memory_order_relaxed);
+
+  bool advanced = false;
+  while (!outstanding_.empty() && outstanding_.front().acked) {
+    checkpoint_seg_ = outstanding_.front().range.segment;
+    checkpoint_off_ = outstanding_.front().range.end;
+    outstanding_.pop_front();
+    advanced = true;
+  }
+  if (!advanced) return;
+  try {
+    save_checkpoint(checkpoint_seg_, checkpoint_off_);
+    for (; oldest_seg_ < checkpoint_seg_; ++oldest_seg_) {
+      std::error_code ec;
+      fs::remove(segment_path(oldest_seg_), ec);
+    }
+  } catch (const std::exception& ex) {
+    // checkpoint 落后只会导致重放，由下游幂等键去重
+    spdlog::error("Spool checkpoint update failed: {}", ex.what());
+  }
+}
+
+void Spool::quarantine(const Range& r, const std::string& body) const {
+  std::string dir = opt_.dir + "/rejected";
+  fs::create_directories(dir);
+  std::ofstream(dir + "/" + token(r) + ".rows", std::ios::binary) << body;
+}
+
+}
@@ -1,15 +1,21 @@
 #pragma once
 #include <hyperswitch/observe/observe.grpc.pb.h>
-#include "common/redis.hpp"
+#include "quality_aggregator.hpp"
 
 namespace hs::observe {
 
-class ObserveIngestImpl final : public hyperswitch::observe::ObserveIngest::Service {
+class ObserveIngestImpl {
 public:
-  explicit ObserveIngestImpl(hs::RedisClient* redis);
-  ::grpc::Status PushRtcp(::grpc::ServerContext*, const hyperswitch::observe::RtcpStat*, hyperswitch::observe::Ack*) override;
+  explicit ObserveIngestImpl(QualityAggregator* agg);
+  ::grpc::Status PushRtcp(::grpc::ServerContext*, const hyperswitch::observe::RtcpStat*, hyperswitch::observe::Ack*);
+  ::grpc::Status PushRtcpBatch(::grpc::ServerContext*, const hyperswitch::observe::RtcpBatch*,
+                               hyperswitch::observe::RtcpBatchAck*);
+  // 客户端流的一条消息，accepted 在 ack 中累加
+  ::grpc::Status PushRtcpStream(::grpc::ServerContext*, const hyperswitch::observe::RtcpBatch&, hyperswitch::observe::RtcpBatchAck&);
 private:
-  hs::RedisClient* redis_;
+  size_t ingest(const hyperswitch::observe::RtcpBatch& batch);
+
+  QualityAggregator* agg_;
 };
 
-}
\ No newline at end of file
+}
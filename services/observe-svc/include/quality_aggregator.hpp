@@ -0,0 +1,158 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "common/hash.hpp"
+#include "common/metrics.hpp"
+#include "common/redis.hpp"
+#include "quantile_sketch.hpp"
+
+namespace hs::observe {
+
+// RTCP 质量内存聚合：按通话腿记录最近值，按中继 / 供应商在滑动窗口内累积丢包、抖动、RTT 的分位草图。
+// 时间窗口由固定长度的时间桶组成，写入只做原子累加；后台线程提前清空下一个时间桶，
+// 并定期把各中继的分位与惩罚系数一次性流水线写入 Redis（quality:trunk:<trunk> 的 penalty 供 route-svc 使用）。
+class QualityAggregator {
+public:
+  struct Options {
+    std::chrono::seconds window{60};
+    std::chrono::seconds bucket{10};
+    std::chrono::milliseconds publish_interval{5000};
+    std::chrono::seconds call_ttl{300};  // 超过该时长无报告的通话腿被丢弃
+    uint32_t min_samples = 20;           // 窗口内样本不足时惩罚系数为 1
+    double quantile = 0.9;               // 计算惩罚所用的分位
+    double min_penalty = 0.05;
+    bool publish_calls = true;           // 同时写出 quality:call:<call_id>:<leg> 最近值
+  };
+
+  struct Stats {
+    std::atomic<uint64_t> reports{0};
+    std::atomic<uint64_t> unresolved{0};  // 无法确定中继 / 供应商，仅更新通话腿
+    std::atomic<uint64_t> publishes{0};
+    std::atomic<uint64_t> publish_errors{0};
+    std::atomic<uint64_t> publish_ns{0};
+  };
+
+  // 一份 RTCP 报告；trunk / vendor 只需在通话腿的任意一份报告中出现，之后按 call_id 解析。
+  // 字段均为视图，add() 在通话已存在时不分配内存
+  struct Sample {
+    std::string_view call_id;
+    int leg = 0;  // 0 = a, 1 = b
+    std::string_view trunk;
+    std::string_view vendor;
+    double loss = 0;  // 0..1
+    double jitter_ms = 0;
+    double rtt_ms = 0;
+    int64_t ts_ms = 0;  // 报告时刻，0 取接收时刻；超出窗口的按窗口边界计
+  };
+
+  struct Quality {
+    uint64_t samples = 0;
+    double loss_pct = 0;  // 分位值
+    double jitter_ms = 0;
+    double rtt_ms = 0;
+    double mos = 0;
+    double penalty = 1.0;
+  };
+
+  QualityAggregator(hs::RedisClient* redis, Options opt);
+  ~QualityAggregator();
+
+  void start();
+  void stop();
+
+  void add(const Sample& s);
+
+  // 当前窗口内的中继质量；未知中继返回 samples=0
+  Quality trunk_quality(std::string_view trunk) const;
+
+  // 简化 E-model：由丢包百分比、抖动与 RTT 估算 MOS，并线性映射为 [min_penalty, 1] 的惩罚系数
+  static double mos(double loss_pct, double jitter_ms, double rtt_ms);
+  static double penalty(double mos, double min_penalty);
+
+  const Stats& stats() const { return stats_; }
+
+private:
+  static constexpr size_t kShards = 64;
+
+  struct Bucket {
+    std::atomic<uint32_t> count{0};
+    QuantileSketch loss, jitter, rtt;
+    void clear() {
+      count.store(0, std::memory_order_relaxed);
+      loss.clear();
+      jitter.clear();
+      rtt.clear();
+    }
+  };
+
+  // 一个中继或供应商；创建后不删除，指针在进程生命周期内有效
+  struct Entity {
+    explicit Entity(std::string n, size_t slots) : name(std::move(n)), buckets(new Bucket[slots]) {}
+    std::string name;
+    std::unique_ptr<Bucket[]> buckets;
+  };
+
+  class Registry {
+  public:
+    Entity* get(std::string_view name, size_t slots);
+    const Entity* find(std::string_view name) const;
+    std::vector<Entity*> all() const;
+  private:
+    struct Shard {
+      mutable std::shared_mutex mu;
+      hs::StringMap<std::unique_ptr<Entity>> map;
+    };
+    std::array<Shard, 16> shards_;
+  };
+
+  struct Leg {
+    Entity* trunk = nullptr;
+    Entity* vendor = nullptr;
+    double loss = 0, jitter_ms = 0, rtt_ms = 0;
+    bool dirty = false;
+  };
+  struct Call {
+    Leg legs[2];  // a / b
+    int64_t last_ms = 0;
+  };
+  struct CallShard {
+    std::mutex mu;
+    hs::StringMap<Call> map;
+  };
+
+  int64_t epoch(int64_t ms) const { return ms / bucket_ms_; }
+  size_t slot(int64_t ep) const { return static_cast<size_t>(ep % static_cast<int64_t>(slots_)); }
+  Quality window_quality(const Entity& e, int64_t now_ep) const;
+  void clear_ahead(int64_t now_ep);
+  void publish(int64_t now_ms);
+  void run(std::stop_token st);
+
+  hs::RedisClient* redis_;
+  Options opt_;
+  int64_t bucket_ms_;
+  size_t window_buckets_;
+  size_t slots_;  // window_buckets_ + 2：当前写入、提前清空、以及正在过期的一个
+
+  Registry trunks_;
+  Registry vendors_;
+  std::array<CallShard, kShards> calls_;
+  int64_t cleared_ep_ = 0;  // 仅后台线程访问
+
+  Stats stats_;
+  hs::metrics::Histogram* publish_rtt_;
+  std::mutex run_mu_;
+  std::condition_variable_any run_cv_;
+  std::jthread thread_;
+};
+
+}
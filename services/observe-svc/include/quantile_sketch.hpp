@@ -0,0 +1,58 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace hs::observe {
+
+// 对数分桶的分位数草图：桶边界按 kGamma 等比增长，相对误差约 ±9%；
+// 桶计数为原子量，多线程无锁写入，读取时合并到普通数组再求分位
+class QuantileSketch {
+public:
+  static constexpr size_t kBins = 96;
+  static constexpr double kMin = 0.01;   // 不大于该值计入 0 号桶
+  static constexpr double kGamma = 1.2;  // 上限约 kMin * kGamma^95 ≈ 3.4e5
+  using Counts = std::array<uint64_t, kBins>;
+
+  static size_t bin(double v) {
+    if (!(v > kMin)) return 0;
+    static const double inv_log_gamma = 1.0 / std::log(kGamma);
+    auto i = static_cast<size_t>(std::log(v / kMin) * inv_log_gamma) + 1;
+    return i < kBins ? i : kBins - 1;
+  }
+  // 桶的几何中点
+  static double value(size_t i) {
+    return i == 0 ? 0.0 : kMin * std::pow(kGamma, static_cast<double>(i) - 0.5);
+  }
+
+  void add(double v) { bins_[bin(v)].fetch_add(1, std::memory_order_relaxed); }
+
+  void merge_into(Counts& acc) const {
+    for (size_t i = 0; i < kBins; ++i) acc[i] += bins_[i].load(std::memory_order_relaxed);
+  }
+
+  void clear() {
+    for (auto& b : bins_) b.store(0, std::memory_order_relaxed);
+  }
+
+  static double quantile(const Counts& acc, double q) {
+    uint64_t total = 0;
+    for (auto c : acc) total += c;
+    if (total == 0) return 0.0;
+    auto rank = static_cast<uint64_t>(std::ceil(q * static_cast<double>(total)));
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBins; ++i) {
+      seen += acc[i];
+      if (seen >= rank) return value(i);
+    }
+    return value(kBins - 1);
+  }
+
+private:
+  std::array<std::atomic<uint32_t>, kBins> bins_{};
+};
+
+}
@@ -1,8 +1,9 @@
-#include <grpcpp/grpcpp.h>
 #include <spdlog/spdlog.h>
 #include "common/env.hpp"
 #include "common/log.hpp"
+#include "common/metrics.hpp"
 #include "common/redis.hpp"
+#include "common/rpc_server.hpp"
 #include "observe_ingest_impl.hpp"
 
 int main(int argc, char** argv) {
@@ -11,13 +12,33 @@ int main(int argc, char** argv) {
   std::string bind = hs::get_env("BIND", "0.0.0.0:7005");
 
   hs::RedisClient redis(redis_uri);
-  hs::observe::ObserveIngestImpl svc(&redis);
+  hs::observe::QualityAggregator::Options qopt;
+  qopt.window = std::chrono::seconds(hs::get_env_int("QUALITY_WINDOW_S", 60));
+  qopt.bucket = std::chrono::seconds(hs::get_env_int("QUALITY_BUCKET_S", 10));
+  qopt.publish_interval = std::chrono::milliseconds(hs::get_env_int("QUALITY_PUBLISH_MS", 5000));
+  qopt.call_ttl = std::chrono::seconds(hs::get_env_int("QUALITY_CALL_TTL_S", 300));
+  qopt.min_samples = static_cast<uint32_t>(hs::get_env_int("QUALITY_MIN_SAMPLES", 20));
+  qopt.quantile = hs::get_env_int("QUALITY_QUANTILE_PCT", 90) / 100.0;
+  qopt.publish_calls = hs::get_env_int("QUALITY_PUBLISH_CALLS", 1) != 0;
+  hs::observe::QualityAggregator agg(&redis, qopt);
+  agg.start();
+  hs::observe::ObserveIngestImpl svc(&agg);
 
-  grpc::ServerBuilder builder;
-  builder.AddListeningPort(bind, grpc::InsecureServerCredentials());
-  builder.RegisterService(&svc);
-  auto server = builder.BuildAndStart();
+  // 全部方法只做内存聚合，直接在完成队列线程上执行
+  using hyperswitch::observe::ObserveIngest;
+  ObserveIngest::AsyncService rpc_svc;
+  hs::rpc::Options ropt;
+  ropt.bind = bind;
+  hs::rpc::Server server(hs::rpc::options_from_env(ropt));
+  server.unary("PushRtcp", &rpc_svc, &ObserveIngest::AsyncService::RequestPushRtcp,
+               [&](auto* ctx, auto* req, auto* resp) { return svc.PushRtcp(ctx, req, resp); });
+  server.unary("PushRtcpBatch", &rpc_svc, &ObserveIngest::AsyncService::RequestPushRtcpBatch,
+               [&](auto* ctx, auto* req, auto* resp) { return svc.PushRtcpBatch(ctx, req, resp); });
+  server.client_stream("PushRtcpStream", &rpc_svc, &ObserveIngest::AsyncService::RequestPushRtcpStream,
+                       [&](auto* ctx, const auto& req, auto& resp) { return svc.PushRtcpStream(ctx, req, resp); });
+  server.start();
+  hs::metrics::Exporter metrics(hs::get_env("METRICS_BIND", "0.0.0.0:9105"));
   spdlog::info("observe-svc listening on {}", bind);
-  server->Wait();
+  server.wait();
   return 0;
 }
\ No newline at end of file
@@ -1,19 +1,17 @@
 #include "observe_ingest_impl.hpp"
 #include <spdlog/spdlog.h>
 
+using hyperswitch::observe::RtcpBatch;
+using hyperswitch::observe::RtcpBatchAck;
+
 namespace hs::observe {
 
-ObserveIngestImpl::ObserveIngestImpl(hs::RedisClient* redis) : redis_(redis) {}
+ObserveIngestImpl::ObserveIngestImpl(QualityAggregator* agg) : agg_(agg) {}
 
 ::grpc::Status ObserveIngestImpl::PushRtcp(::grpc::ServerContext*, const hyperswitch::observe::RtcpStat* stat, hyperswitch::observe::Ack* ack) {
   try {
-    auto& r = redis_->get();
-    // key: quality:call:<call_id>:<leg>, store latest; also aggregate per trunk/vendor requires external mapping (not in event). Here we store per-call only.
-    std::string key = "quality:call:" + stat->call_id() + ":" + stat->leg();
-    r.hset(key, "loss", std::to_string(stat->loss()));
-    r.hset(key, "jitter_ms", std::to_string(stat->jitter_ms()));
-    r.hset(key, "rtt_ms", std::to_string(stat->rtt_ms()));
-    r.expire(key, std::chrono::seconds(300));
+    // 只做内存聚合，Redis 由聚合器定期批量写出
+    agg_->add({stat->call_id(), stat->leg() == "b" ? 1 : 0, stat->trunk(), stat->vendor(), stat->loss(), stat->jitter_ms(), stat->rtt_ms()});
     ack->set_ok(true);
     return ::grpc::Status::OK;
   } catch (const std::exception& ex) {
@@ -22,4 +20,33 @@ ObserveIngestImpl::ObserveIngestImpl(hs::RedisClient* redis) : redis_(redis) {}
   }
 }
 
-}
\ No newline at end of file
+size_t ObserveIngestImpl::ingest(const RtcpBatch& batch) {
+  for (const auto& r : batch.reports()) {
+    agg_->add({r.call_id(), r.leg() ? 1 : 0, r.trunk(), r.vendor(), r.loss(), r.jitter_ms(), r.rtt_ms(), r.ts_ms()});
+  }
+  return static_cast<size_t>(batch.reports_size());
+}
+
+::grpc::Status ObserveIngestImpl::PushRtcpBatch(::grpc::ServerContext*, const RtcpBatch* req, RtcpBatchAck* ack) {
+  try {
+    ack->set_accepted(ingest(*req));
+    return ::grpc::Status::OK;
+  } catch (const std::exception& ex) {
+    spdlog::error("PushRtcpBatch error: {}", ex.what());
+    return {::grpc::StatusCode::INTERNAL, ex.what()};
+  }
+}
+
+::grpc::Status ObserveIngestImpl::PushRtcpStream(::grpc::ServerContext*, const RtcpBatch& batch, RtcpBatchAck& ack) {
+  try {
+    // 框架在整个流内复用同一个请求对象：protobuf 解析时沿用已分配的 repeated 元素与字符串容量，
+    // 稳定状态下逐条读取不再分配堆内存
+    ack.set_accepted(ack.accepted() + ingest(batch));
+    return ::grpc::Status::OK;
+  } catch (const std::exception& ex) {
+    spdlog::error("PushRtcpStream error: {}", ex.what());
+    return {::grpc::StatusCode::INTERNAL, ex.what()};
+  }
+}
+
+}
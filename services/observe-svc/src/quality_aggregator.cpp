@@ -0,0 +1,275 @@
+#include "quality_aggregator.hpp"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cstdio>
+#include <utility>
+#include "common/time.hpp"
+
+namespace hs::observe {
+
+QualityAggregator::Entity* QualityAggregator::Registry::get(std::string_view name, size_t slots) {
+  auto& sh = shards_[hs::StringHash{}(name) % shards_.size()];
+  {
+    std::shared_lock lk(sh.mu);
+    auto it = sh.map.find(name);
+    if (it != sh.map.end()) return it->second.get();
+  }
+  std::unique_lock lk(sh.mu);
+  auto [it, inserted] = sh.map.try_emplace(std::string(name));
+  if (inserted) it->second = std::make_unique<Entity>(std::string(name), slots);
+  return it->second.get();
+}
+
+const QualityAggregator::Entity* QualityAggregator::Registry::find(std::string_view name) const {
+  auto& sh = shards_[hs::StringHash{}(name) % shards_.size()];
+  std::shared_lock lk(sh.mu);
+  auto it = sh.map.find(name);
+  return it == sh.map.end() ? nullptr : it->second.get();
+}
+
+std::vector<QualityAggregator::Entity*> QualityAggregator::Registry::all() const {
+  std::vector<Entity*> out;
+  for (auto& sh : shards_) {
+    std::shared_lock lk(sh.mu);
+    for (auto& [_, e] : sh.map) out.push_back(e.get());
+  }
+  return out;
+}
+
+QualityAggregator::QualityAggregator(hs::RedisClient* redis, Options opt) : redis_(redis), opt_(opt) {
+  bucket_ms_ = std::max<int64_t>(1000, std::chrono::duration_cast<std::chrono::milliseconds>(opt_.bucket).count());
+  auto window_ms = std::chrono::duration_cast<std::chrono::milliseconds>(opt_.window).count();
+  window_buckets_ = static_cast<size_t>(std::max<int64_t>(1, (window_ms + bucket_ms_ - 1) / bucket_ms_));
+  slots_ = window_buckets_ + 2;
+  cleared_ep_ = epoch(hs::now_epoch_ms());
+
+  auto& reg = hs::metrics::registry();
+  publish_rtt_ = &hs::RedisClient::rtt("quality_publish");
+  reg.counter_fn(this, "hs_quality_reports_total", "RTCP reports aggregated", hs::metrics::load(stats_.reports));
+  reg.counter_fn(this, "hs_quality_unresolved_total", "RTCP reports without a known trunk or vendor", hs::metrics::load(stats_.unresolved));
+  reg.counter_fn(this, "hs_quality_publish_errors_total", "Failed quality publishes", hs::metrics::load(stats_.publish_errors));
+  reg.gauge_fn(this, "hs_quality_calls", "Call legs tracked", [this] {
+    size_t calls = 0;
+    for (auto& sh : calls_) {
+      std::lock_guard<std::mutex> lk(sh.mu);
+      calls += sh.map.size();
+    }
+    return static_cast<double>(calls);
+  });
+}
+
+QualityAggregator::~QualityAggregator() {
+  hs::metrics::registry().remove(this);
+  stop();
+}
+
+void QualityAggregator::start() {
+  thread_ = std::jthread([this](std::stop_token st) { run(st); });
+}
+
+void QualityAggregator::stop() {
+  if (thread_.joinable()) {
+    thread_.request_stop();
+    run_cv_.notify_all();
+    thread_.join();
+  }
+}
+
+void QualityAggregator::add(const Sample& s) {
+  stats_.reports.fetch_add(1, std::memory_order_relaxed);
+  int64_t now = hs::now_epoch_ms();
+  Entity* trunk;
+  Entity* vendor;
+  {
+    auto& sh = calls_[hs::StringHash{}(s.call_id) % kShards];
+    std::lock_guard<std::mutex> lk(sh.mu);
+    auto it = sh.map.find(s.call_id);
+    if (it == sh.map.end()) it = sh.map.try_emplace(std::string(s.call_id)).first;
+    Call& c = it->second;
+    Leg& leg = c.legs[s.leg ? 1 : 0];
+    if (!s.trunk.empty() && (!leg.trunk || leg.trunk->name != s.trunk)) leg.trunk = trunks_.get(s.trunk, slots_);
+    if (!s.vendor.empty() && (!leg.vendor || leg.vendor->name != s.vendor)) leg.vendor = vendors_.get(s.vendor, slots_);
+    leg.loss = s.loss;
+    leg.jitter_ms = s.jitter_ms;
+    leg.rtt_ms = s.rtt_ms;
+    leg.dirty = true;
+    c.last_ms = now;
+    trunk = leg.trunk;
+    vendor = leg.vendor;
+  }
+  if (!trunk && !vendor) {
+    stats_.unresolved.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  // 按报告时刻入桶，迟到或时钟偏差的报告夹到窗口内，不会写入已过期或尚未清空的桶
+  int64_t now_ep = epoch(now);
+  int64_t ep = s.ts_ms > 0 ? std::clamp(epoch(s.ts_ms), now_ep - static_cast<int64_t>(window_buckets_) + 1, now_ep) : now_ep;
+  size_t i = slot(ep);
+  double loss_pct = std::clamp(s.loss, 0.0, 1.0) * 100.0;
+  for (Entity* e : {trunk, vendor}) {
+    if (!e) continue;
+    Bucket& b = e->buckets[i];
+    b.count.fetch_add(1, std::memory_order_relaxed);
+    b.loss.add(loss_pct);
+    b.jitter.add(s.jitter_ms);
+    b.rtt.add(s.rtt_ms);
+  }
+}
+
+double QualityAggregator::mos(double loss_pct, double jitter_ms, double rtt_ms) {
+  // 单向时延取 RTT/2，抖动缓冲按两倍抖动计，另加 10ms 编解码时延
+  double eff = rtt_ms / 2 + 2 * jitter_ms + 10;
+  double r = eff < 160 ? 93.2 - eff / 40 : 93.2 - (eff - 120) / 10;
+  r -= 2.5 * loss_pct;
+  if (r <= 0) return 1.0;
+  if (r >= 100) return 4.5;
+  return 1 + 0.035 * r + 7e-6 * r * (r - 60) * (100 - r);
+}
+
+double QualityAggregator::penalty(double mos, double min_penalty) {
+  // MOS ≥ 4.0 不惩罚，≤ 2.6（多数用户不满意）降到下限
+  constexpr double kGood = 4.0, kBad = 2.6;
+  return std::clamp((mos - kBad) / (kGood - kBad), min_penalty, 1.0);
+}
+
+QualityAggregator::Quality QualityAggregator::window_quality(const Entity& e, int64_t now_ep) const {
+  Quality q;
+  QuantileSketch::Counts loss{}, jitter{}, rtt{};
+  for (size_t k = 0; k < window_buckets_; ++k) {
+    const Bucket& b = e.buckets[slot(now_ep - static_cast<int64_t>(k))];
+    q.samples += b.count.load(std::memory_order_relaxed);
+    b.loss.merge_into(loss);
+    b.jitter.merge_into(jitter);
+    b.rtt.merge_into(rtt);
+  }
+  if (q.samples == 0) return q;
+  q.loss_pct = QuantileSketch::quantile(loss, opt_.quantile);
+  q.jitter_ms = QuantileSketch::quantile(jitter, opt_.quantile);
+  q.rtt_ms = QuantileSketch::quantile(rtt, opt_.quantile);
+  q.mos = mos(q.loss_pct, q.jitter_ms, q.rtt_ms);
+  q.penalty = q.samples < opt_.min_samples ? 1.0 : penalty(q.mos, opt_.min_penalty);
+  return q;
+}
+
+QualityAggregator::Quality QualityAggregator::trunk_quality(std::string_view trunk) const {
+  const Entity* e = trunks_.find(trunk);
+  return e ? window_quality(*e, epoch(hs::now_epoch_ms())) : Quality{};
+}
+
+void QualityAggregator::clear_ahead(int64_t now_ep) {
+  // 清空即将使用的时间桶。正在写入的当前桶不能清空：后台线程滞后超过一个桶时，
+  // 被跳过的桶里会残留一轮之前的数据，节拍为半个桶时不会发生
+  int64_t target = now_ep + 1;
+  if (target <= cleared_ep_) return;
+  int64_t from = std::max(cleared_ep_ + 1, now_ep + 1);
+  auto trunks = trunks_.all();
+  auto vendors = vendors_.all();
+  for (int64_t ep = from; ep <= target; ++ep) {
+    size_t i = slot(ep);
+    for (Entity* e : trunks) e->buckets[i].clear();
+    for (Entity* e : vendors) e->buckets[i].clear();
+  }
+  cleared_ep_ = target;
+}
+
+void QualityAggregator::publish(int64_t now_ms) {
+  using Fields = std::vector<std::pair<std::string, std::string>>;
+  auto t0 = std::chrono::steady_clock::now();
+  int64_t now_ep = epoch(now_ms);
+  auto ttl = std::max(std::chrono::seconds(30),
+                      std::chrono::duration_cast<std::chrono::seconds>(opt_.publish_interval * 3));
+  auto num = [](double v) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.4g", v);
+    return std::string(buf);
+  };
+
+  // 窗口内无样本的中继不写，键过期后 route-svc 视为无惩罚
+  std::vector<std::pair<std::string, Fields>> rows;
+  for (auto [prefix, reg] : {std::pair{"quality:trunk:", &trunks_}, std::pair{"quality:vendor:", &vendors_}}) {
+    for (const Entity* e : reg->all()) {
+      Quality q = window_quality(*e, now_ep);
+      if (q.samples == 0) continue;
+      rows.emplace_back(prefix + e->name, Fields{{"penalty", num(q.penalty)},
+                                                 {"mos", num(q.mos)},
+                                                 {"loss_pct", num(q.loss_pct)},
+                                                 {"jitter_ms", num(q.jitter_ms)},
+                                                 {"rtt_ms", num(q.rtt_ms)},
+                                                 {"samples", std::to_string(q.samples)},
+                                                 {"ts_ms", std::to_string(now_ms)}});
+    }
+  }
+
+  // 通话腿：丢弃过期通话，收集自上次发布以来有更新的腿
+  int64_t expire_before = now_ms - std::chrono::duration_cast<std::chrono::milliseconds>(opt_.call_ttl).count();
+  size_t n_trunk_rows = rows.size();
+  for (auto& sh : calls_) {
+    std::lock_guard<std::mutex> lk(sh.mu);
+    for (auto it = sh.map.begin(); it != sh.map.end();) {
+      if (it->second.last_ms < expire_before) { it = sh.map.erase(it); continue; }
+      for (int l = 0; l < 2; ++l) {
+        Leg& leg = it->second.legs[l];
+        if (!leg.dirty) continue;
+        leg.dirty = false;
+        if (!opt_.publish_calls) continue;
+        rows.emplace_back("quality:call:" + it->first + (l ? ":b" : ":a"),
+                          Fields{{"loss", num(leg.loss)}, {"jitter_ms", num(leg.jitter_ms)}, {"rtt_ms", num(leg.rtt_ms)}});
+      }
+      ++it;
+    }
+  }
+  if (rows.empty()) return;
+
+  try {
+    auto pipe = redis_->get().pipeline(false);
+    for (size_t i = 0; i < rows.size(); ++i) {
+      const auto& [key, fields] = rows[i];
+      pipe.hset(key, fields.begin(), fields.end());
+      pipe.expire(key, i < n_trunk_rows ? ttl : std::chrono::duration_cast<std::chrono::seconds>(opt_.call_ttl));
+    }
+    hs::metrics::Timer t(*publish_rtt_);
+    pipe.exec();
+    stats_.publishes.fetch_add(1, std::memory_order_relaxed);
+  } catch (const std::exception& ex) {
+    stats_.publish_errors.fetch_add(1, std::memory_order_relaxed);
+    spdlog::warn("Quality publish failed ({} keys): {}", rows.size(), ex.what());
+  }
+  stats_.publish_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count(),
+                              std::memory_order_relaxed);
+}
+
+void QualityAggregator::run(std::stop_token st) {
+  // 清空节拍不超过半个时间桶，保证下一个桶在启用前已清空
+  auto tick = std::min(std::chrono::duration_cast<std::chrono::milliseconds>(opt_.publish_interval),
+                       std::chrono::milliseconds(bucket_ms_ / 2));
+  auto next_publish = std::chrono::steady_clock::now() + opt_.publish_interval;
+  auto next_report = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+  while (!st.stop_requested()) {
+    {
+      std::unique_lock<std::mutex> lk(run_mu_);
+      run_cv_.wait_for(lk, st, tick, [] { return false; });
+    }
+    if (st.stop_requested()) break;
+    int64_t now_ms = hs::now_epoch_ms();
+    clear_ahead(epoch(now_ms));
+    auto now = std::chrono::steady_clock::now();
+    if (now >= next_publish) {
+      next_publish = now + opt_.publish_interval;
+      publish(now_ms);
+    }
+    if (now >= next_report) {
+      next_report = now + std::chrono::seconds(60);
+      size_t calls = 0;
+      for (auto& sh : calls_) {
+        std::lock_guard<std::mutex> lk(sh.mu);
+        calls += sh.map.size();
+      }
+      auto pubs = stats_.publishes.load();
+      spdlog::info("Quality aggregator: reports={} unresolved={} calls={} trunks={} publishes={} errors={} avg_publish_ms={:.2f}",
+                   stats_.reports.load(), stats_.unresolved.load(), calls, trunks_.all().size(), pubs,
+                   stats_.publish_errors.load(), pubs ? stats_.publish_ns.load() / 1e6 / pubs : 0.0);
+    }
+  }
+}
+
+}
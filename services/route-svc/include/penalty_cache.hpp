@@ -0,0 +1,81 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "common/hash.hpp"
+#include "common/redis.hpp"
+#include "common/snapshot.hpp"
+
+namespace hs::routing {
+
+// 中继质量惩罚系数的进程内缓存：后台线程按固定间隔用一次流水线 HGET 拉取全部中继的
+// quality:trunk:<trunk> penalty，整体替换快照；Pick 只读内存。
+// 快照超过 max_stale 未成功刷新时视为失效，全部按 1.0（不惩罚）处理。
+class PenaltyCache {
+public:
+  struct Options {
+    std::chrono::milliseconds refresh_interval{1000};
+    std::chrono::milliseconds max_stale{10000};
+  };
+
+  struct Stats {
+    std::atomic<uint64_t> refreshes{0};
+    std::atomic<uint64_t> refresh_errors{0};
+    std::atomic<uint64_t> refresh_us_total{0};
+    std::atomic<uint64_t> last_refresh_us{0};
+    std::atomic<uint64_t> keys{0};
+    std::atomic<uint64_t> invalid_values{0};
+    std::atomic<uint64_t> stale_reads{0};
+  };
+
+  // 返回当前需要关注的中继名（取自路由快照）
+  using TrunkSource = std::function<std::vector<std::string>()>;
+
+  PenaltyCache(hs::RedisClient* redis, Options opt);
+  ~PenaltyCache();
+
+  // 同步刷新一次后启动后台线程
+  void start(TrunkSource trunks);
+  void stop();
+
+  // 直接替换惩罚系数，不经 Redis；用于未 start 的本地模式（基准测试、压测替身）
+  void apply(hs::StringMap<double> penalty);
+
+  // 无记录、快照失效时返回 1.0
+  double penalty(std::string_view trunk) const;
+  // 距上次成功刷新的毫秒数，从未成功时为 -1
+  int64_t age_ms() const;
+  // 惩罚系数的内容版本：刷新结果与上一版相同时不变，失效状态切换时也会改变；供路由决策缓存判断失效
+  uint64_t version() const;
+
+  const Stats& stats() const { return stats_; }
+
+private:
+  struct Table {
+    hs::StringMap<double> penalty;
+    int64_t loaded_ms = 0;
+    uint64_t generation = 0;  // 内容变化时递增
+  };
+
+  void refresh();
+  void run(std::stop_token st);
+
+  hs::RedisClient* redis_;
+  Options opt_;
+  TrunkSource trunks_;
+  hs::Snapshot<Table> table_;
+  mutable Stats stats_;
+  hs::metrics::Histogram* refresh_rtt_;
+  std::mutex run_mu_;
+  std::condition_variable_any run_cv_;
+  std::jthread thread_;
+};
+
+}
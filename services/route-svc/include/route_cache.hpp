@@ -0,0 +1,85 @@
+#pragma once
+#include <hyperswitch/routing/route.pb.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "common/metrics.hpp"
+
+namespace hs::routing {
+
+// 路由决策缓存：键为 (plan_id, 最长匹配前缀在该计划 trie 中的节点)，同一节点的候选列表只取决于计划本身，
+// 值为已按惩罚系数缩放权重的候选（protobuf 形式，命中时直接复制进响应）。
+// 每项记录生成时的路由表代号（RouteTable::generation）与惩罚系数版本，任一变化即视为失效；按键哈希分片，每片容量固定，CLOCK 淘汰。
+// 在途通话饱和过滤每秒都在变化，不进入缓存，命中后逐条检查。
+class RouteCache {
+public:
+  struct Options {
+    size_t capacity = 65536;  // 0 关闭缓存
+  };
+
+  struct Stats {
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> stale{0};  // 命中键但版本已变
+    std::atomic<uint64_t> evictions{0};
+  };
+
+  struct Key {
+    int64_t plan_id;
+    uint32_t node;
+    bool operator==(const Key&) const = default;
+  };
+
+  struct Decision {
+    uint64_t table_version = 0;
+    uint64_t penalty_version = 0;
+    std::vector<hyperswitch::routing::Candidate> candidates;
+    std::vector<uint32_t> trunk_max_concurrent;  // 与 candidates 一一对应：出中继的在途上限
+  };
+
+  explicit RouteCache(Options opt);
+  ~RouteCache();
+
+  bool enabled() const { return per_shard_ > 0; }
+  // 版本不一致视为未命中；命中时置访问位，不分配内存
+  std::shared_ptr<const Decision> find(const Key& key, uint64_t table_version, uint64_t penalty_version);
+  void insert(const Key& key, std::shared_ptr<const Decision> d);
+
+  size_t size() const;
+  const Stats& stats() const { return stats_; }
+
+private:
+  static constexpr size_t kShards = 16;
+
+  struct KeyHash {
+    size_t operator()(const Key& k) const {
+      uint64_t h = static_cast<uint64_t>(k.plan_id) * 0x9e3779b97f4a7c15ULL ^ k.node;
+      h ^= h >> 29;
+      h *= 0xbf58476d1ce4e5b9ULL;
+      return static_cast<size_t>(h ^ (h >> 32));
+    }
+  };
+  struct Slot {
+    Key key{};
+    std::shared_ptr<const Decision> value;
+    bool referenced = false;
+  };
+  struct Shard {
+    mutable std::mutex mu;
+    std::vector<Slot> slots;  // 未满时只增长，满后由 CLOCK 指针轮转替换
+    std::unordered_map<Key, uint32_t, KeyHash> index;
+    size_t hand = 0;
+  };
+
+  Shard& shard(const Key& k) { return shards_[KeyHash{}(k) % kShards]; }
+
+  size_t per_shard_;
+  std::array<Shard, kShards> shards_;
+  Stats stats_;
+};
+
+}
@@ -1,21 +1,60 @@
 #pragma once
 #include <hyperswitch/routing/route.grpc.pb.h>
 #include <memory>
-#include <unordered_map>
-#include <pqxx/pqxx>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "common/live_calls.hpp"
+#include "common/number_plan.hpp"
 #include "common/pg.hpp"
-#include "common/redis.hpp"
+#include "common/snapshot.hpp"
+#include "penalty_cache.hpp"
+#include "route_cache.hpp"
+#include "route_table.hpp"
+#include "shadow.hpp"
 
 namespace hs::routing {
 
-class RouteServiceImpl final : public hyperswitch::routing::RouteService::Service {
+class RouteServiceImpl {
 public:
-  RouteServiceImpl(hs::Pg* pg, hs::RedisClient* redis);
+  // numbers 为空时不做号码分类；reject_invalid 时号码计划判为无效的目的号码返回 INVALID_ARGUMENT；
+  // shadow 非空时抽样的 Pick 交给影子评估
+  RouteServiceImpl(hs::Pg* pg, PenaltyCache* penalties, const hs::LiveCalls* live, RouteCache* cache,
+                   const hs::NumberPlan* numbers = nullptr, bool reject_invalid = true, ShadowEvaluator* shadow = nullptr);
   ::grpc::Status Pick(::grpc::ServerContext* ctx, const hyperswitch::routing::PickRequest* req,
-                      hyperswitch::routing::PickResponse* resp) override;
+                      hyperswitch::routing::PickResponse* resp);
+  // 同一路由快照上的多次查找，逐条返回状态
+  ::grpc::Status PickBatch(::grpc::ServerContext* ctx, const hyperswitch::routing::PickBatchRequest* req,
+                           hyperswitch::routing::PickBatchResponse* resp);
+  // 从 PostgreSQL 全量重建路由快照并原子替换
+  void reload();
+  // 从快照文件加载并发布；文件缺失、损坏或过旧时记录告警并返回 false，由调用方走 PostgreSQL 全量加载
+  bool load_snapshot(const std::string& path, int64_t max_age_s);
+  // 当前路由快照写入文件，自上次写入后未变化时跳过；只由快照维护线程调用
+  void save_snapshot(const std::string& path);
+  // 处理 hs_routing 通道的变更通知：按计划/账户增量重建，无法定位时全量重建
+  void apply_changes(const std::vector<std::string>& payloads);
+  // 当前路由快照中的全部出中继，供惩罚系数缓存刷新
+  std::vector<std::string> trunks() const;
+  std::shared_ptr<const RouteTable> table() const { return table_.load(); }
 private:
+  ::grpc::Status pick_one(const RouteTable& table, const hyperswitch::routing::PickRequest& req,
+                          hyperswitch::routing::PickResponse* resp);
+  // 计算 (计划, 匹配前缀) 的候选列表并写入缓存
+  std::shared_ptr<const RouteCache::Decision> decide(const RouteTable& table, const PlanIndex& plan, std::string_view to,
+                                                     const RouteCache::Key& key);
+
   hs::Pg* pg_;
-  hs::RedisClient* redis_;
+  PenaltyCache* penalties_;
+  const hs::LiveCalls* live_; // 供应商在途通话数，达到条目 max_concurrent 的候选被跳过
+  RouteCache* cache_;
+  const hs::NumberPlan* numbers_;
+  bool reject_invalid_;
+  ShadowEvaluator* shadow_;
+  hs::Snapshot<RouteTable> table_;
+  std::mutex reload_mu_; // 仅串行化写端，读端不加锁
+  uint64_t saved_version_ = 0;
 };
 
-}
\ No newline at end of file
+}
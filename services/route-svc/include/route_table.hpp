@@ -0,0 +1,111 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <pqxx/pqxx>
+#include "common/hash.hpp"
+#include "common/number.hpp"
+#include "common/prefix_trie.hpp"
+
+namespace hs::routing {
+
+struct VendorInfo {
+  std::string vendor;
+  std::string trunk;
+  std::string ip;
+  uint32_t port = 5060;
+  uint32_t max_concurrent = 0;  // 出中继 core.trunks.max_concurrent，供应商级在途上限，0 不限
+};
+
+struct RouteEntry {
+  uint32_t vendor;        // RouteTable::vendors() 下标
+  int32_t priority;
+  int32_t weight;
+  uint32_t max_cps;
+  uint32_t max_concurrent;
+  int64_t entry_id;       // routing.plan_entries.entry_id，供 auth-svc 按条目限流
+};
+
+// 单个路由计划的前缀索引：trie 节点 value 指向 ranges，ranges 为 entries 的 [begin, end)
+struct PlanIndex {
+  int64_t plan_id = 0;
+  int64_t account_id = 0;
+  std::string name;
+  hs::PrefixTrie trie;
+  std::vector<std::pair<uint32_t, uint32_t>> ranges;
+  std::vector<RouteEntry> entries;
+};
+
+struct TrunkBinding {
+  int64_t account_id;
+  int64_t plan_id;
+  hs::number::DialPlan dial; // 目的号码规范化规则（core.trunks 冠字列与 core.trunk_dial_rules）
+  int64_t shadow_plan_id = 0; // 账户最新的影子计划（route_plans.status='shadow'），0 表示无
+};
+
+// 路由数据的不可变快照：构建完成后只读，可被多个线程无锁共享
+class RouteTable {
+public:
+  static constexpr size_t kMaxCandidates = 16;
+
+  static std::shared_ptr<const RouteTable> load(pqxx::connection& conn);
+  // 快照文件（common/snapshot_file.hpp）：冷启动时先从文件加载，再从 PostgreSQL 追平；
+  // 文件损坏、版本不符或早于 max_age_s 秒（> 0 时）时抛出
+  static std::shared_ptr<const RouteTable> load_file(const std::string& path, int64_t max_age_s = 0);
+  void save(const std::string& path) const;
+
+  // 增量重建：仅重新加载指定计划与指定账户（0 为全局）的黑名单，其余部分与当前快照共享
+  std::shared_ptr<const RouteTable> reload(pqxx::connection& conn, const std::unordered_set<int64_t>& plan_ids,
+                                           const std::unordered_set<int64_t>& blacklist_accounts) const;
+
+  // 入中继 → 该账户最新的生效路由计划
+  const PlanIndex* plan_for_trunk(std::string_view ingress_trunk) const;
+  // 入中继 → 该账户最新的影子计划，只参与影子评估，不用于选路；无则返回空
+  const PlanIndex* shadow_plan_for_trunk(std::string_view ingress_trunk) const;
+  const PlanIndex* plan(int64_t plan_id) const;
+  // 入中继的拨号计划，未知中继返回空（按缺省规则规范化）
+  const hs::number::DialPlan* dial_plan(std::string_view ingress_trunk) const;
+
+  // 账户级或全局黑名单中存在未过期的匹配前缀
+  bool blacklisted(int64_t account_id, std::string_view dest, int64_t now_epoch) const;
+
+  // 按最长前缀优先、同前缀内 priority ASC / weight DESC 输出候选，返回条数
+  size_t candidates(const PlanIndex& plan, std::string_view dest, const RouteEntry** out, size_t limit) const;
+
+  const VendorInfo& vendor(uint32_t idx) const { return vendors_->list[idx]; }
+  const std::vector<VendorInfo>& vendors() const { return vendors_->list; }
+  size_t plan_count() const { return plans_.size(); }
+  // 每次构建（全量、增量或快照文件）分配的进程内唯一代号，随表一起发布；
+  // 决策缓存按代号判定失效，缓存键中的前缀树节点下标只在同一代号内有意义
+  uint64_t generation() const { return generation_; }
+
+private:
+  struct VendorSet {
+    std::vector<VendorInfo> list;
+    std::unordered_map<int64_t, uint32_t> index; // vendor_id → list 下标
+  };
+  struct Blacklist {
+    hs::PrefixTrie trie;
+    std::vector<int64_t> expire_at; // 0 表示永久
+  };
+  using PlanMap = std::unordered_map<int64_t, std::shared_ptr<const PlanIndex>>;
+  using BlacklistMap = std::unordered_map<int64_t, std::shared_ptr<const Blacklist>>;
+
+  static hs::StringMap<TrunkBinding> load_bindings(pqxx::transaction_base& tx);
+  static std::shared_ptr<const VendorSet> load_vendors(pqxx::transaction_base& tx);
+  static size_t load_plans(pqxx::transaction_base& tx, const VendorSet& vendors, const std::unordered_set<int64_t>* only, PlanMap& out);
+  static size_t load_blacklists(pqxx::transaction_base& tx, const std::unordered_set<int64_t>* only, BlacklistMap& out);
+  static uint64_t next_generation();
+
+  hs::StringMap<TrunkBinding> trunks_;
+  PlanMap plans_;
+  std::shared_ptr<const VendorSet> vendors_;
+  BlacklistMap blacklists_; // account_id=0 为全局
+  uint64_t generation_ = next_generation();  // 复制构造沿用原值，reload 另行分配
+};
+
+}
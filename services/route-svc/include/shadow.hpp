@@ -0,0 +1,120 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include "common/mpsc_ring.hpp"
+#include "common/number.hpp"
+#include "route_table.hpp"
+
+namespace hs::routing {
+
+// 生效计划与影子计划在同一目的号码上的差异
+enum class Divergence : uint8_t {
+  None,
+  First,          // 首选供应商不同
+  Set,            // 首选相同，候选供应商集合不同
+  LiveNoRoute,    // 只有影子计划有候选
+  ShadowNoRoute,  // 只有生效计划有候选
+};
+constexpr size_t kDivergenceKinds = 5;
+
+const char* divergence_name(Divergence d);
+
+// 按 ClickHouse TabSeparated 转义追加字段；route_shadow 写入与 route-replay 输出共用
+void append_escaped(std::string& out, std::string_view s);
+
+struct PolicyPick {
+  std::array<const RouteEntry*, RouteTable::kMaxCandidates> entries;
+  size_t size = 0;
+};
+
+struct PolicyDiff {
+  PolicyPick live, shadow;
+  Divergence divergence = Divergence::None;
+};
+
+// 两个计划按 RouteTable::candidates 的顺序各取候选后比较；供 route-svc 影子评估与 route-replay 离线回放共用
+PolicyDiff compare_policies(const RouteTable& table, const PlanIndex& live, const PlanIndex& shadow, std::string_view dest);
+
+// 影子路由评估：Pick 在抽样的请求上只把 (生效计划, 影子计划, 目的号码) 写入无锁环，不做额外查找；
+// 后台线程在最新路由快照上用 compare_policies 比较两个计划，有分歧的记录批量写入 ClickHouse route_shadow。
+// 环满时丢弃并计数，写入失败时丢弃该批并计数，均不影响 Pick
+class ShadowEvaluator {
+public:
+  struct Options {
+    uint32_t sample_ppm = 0;        // 抽样比例（百万分之一），0 关闭
+    size_t ring_capacity = 16384;
+    std::string ch_http;            // ClickHouse HTTP 端点，为空时只计数不写入
+    std::chrono::milliseconds ch_timeout{10000};
+    std::chrono::milliseconds flush_interval{1000};
+    size_t batch_max = 10000;
+    std::string node;               // 写入 route_shadow.node
+  };
+
+  struct Stats {
+    std::atomic<uint64_t> sampled{0};
+    std::atomic<uint64_t> dropped{0};     // 环满丢弃
+    std::atomic<uint64_t> evaluated{0};
+    std::atomic<uint64_t> stale{0};       // 评估时计划已不在路由快照中
+    std::array<std::atomic<uint64_t>, kDivergenceKinds> divergent{};
+    std::atomic<uint64_t> written{0};
+    std::atomic<uint64_t> write_errors{0};
+  };
+
+  using TableSource = std::function<std::shared_ptr<const RouteTable>()>;
+
+  explicit ShadowEvaluator(Options opt);
+  ~ShadowEvaluator();
+
+  void start(TableSource table);
+  void stop();
+
+  // Pick 热路径：线程内随机数决定是否抽中，未启用时恒为 false
+  bool sample() const {
+    if (opt_.sample_ppm == 0) return false;
+    thread_local uint64_t x = seed();
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return ((x >> 32) * 1000000 >> 32) < opt_.sample_ppm;
+  }
+  // 抽中后调用；dest 为规范化的 E.164
+  void offer(const PlanIndex& live, const PlanIndex& shadow, std::string_view dest);
+
+  const Stats& stats() const { return stats_; }
+
+private:
+  struct Sample {
+    int64_t ts;  // epoch 秒
+    int64_t live_plan;
+    int64_t shadow_plan;
+    int64_t account_id;
+    uint8_t size;
+    char dest[hs::number::kMaxDigits];
+  };
+
+  static uint64_t seed();
+  void run(std::stop_token st);
+  void evaluate(const RouteTable& table, const Sample& s);
+  void flush();
+
+  Options opt_;
+  TableSource table_;
+  hs::MpscRing<Sample> ring_;
+  mutable Stats stats_;
+  std::string rows_;  // 待写入的 TabSeparated 行，只由后台线程访问
+  size_t row_count_ = 0;
+  std::mutex run_mu_;
+  std::condition_variable_any run_cv_;
+  std::jthread thread_;
+};
+
+}
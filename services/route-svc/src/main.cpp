@@ -1,10 +1,18 @@
-#include <grpcpp/grpcpp.h>
+#include <unistd.h>
+#include <algorithm>
 #include <spdlog/spdlog.h>
 #include "common/env.hpp"
+#include "common/live_calls.hpp"
 #include "common/log.hpp"
+#include "common/metrics.hpp"
+#include "common/number_plan.hpp"
 #include "common/pg.hpp"
+#include "common/pg_listener.hpp"
 #include "common/redis.hpp"
+#include "common/rpc_server.hpp"
+#include "common/snapshot_file.hpp"
 #include "route_service_impl.hpp"
+#include "shadow.hpp"
 
 int main(int argc, char** argv) {
   hs::init_logging(hs::get_env("LOG_LEVEL", "info"));
@@ -12,17 +20,70 @@ int main(int argc, char** argv) {
   std::string redis_uri = hs::get_env("REDIS_URI", "tcp://localhost:6379");
   std::string bind = hs::get_env("BIND", "0.0.0.0:7001");
 
-  hs::Pg pg(pg_uri);
+  hs::Pg pg(pg_uri, hs::get_env_int("PG_POOL_SIZE", 2), std::chrono::milliseconds(hs::get_env_int("PG_POOL_TIMEOUT_MS", 2000)));
   hs::RedisClient redis(redis_uri);
 
-  hs::routing::RouteServiceImpl service(&pg, &redis);
+  hs::routing::PenaltyCache::Options popt;
+  popt.refresh_interval = std::chrono::milliseconds(hs::get_env_int("ROUTE_PENALTY_REFRESH_MS", 1000));
+  popt.max_stale = std::chrono::milliseconds(hs::get_env_int("ROUTE_PENALTY_MAX_STALE_MS", 10000));
+  hs::routing::PenaltyCache penalties(&redis, popt);
+  hs::LiveCalls::Options vopt;
+  vopt.refresh_interval = std::chrono::milliseconds(hs::get_env_int("LIVE_CALLS_REFRESH_MS", 1000));
+  vopt.max_stale = std::chrono::milliseconds(hs::get_env_int("LIVE_CALLS_MAX_STALE_MS", 10000));
+  hs::LiveCalls live(&redis, vopt);
+  live.start();
+  hs::routing::RouteCache::Options copt;
+  copt.capacity = static_cast<size_t>(hs::get_env_int("ROUTE_CACHE_SIZE", 65536));
+  hs::routing::RouteCache cache(copt);
+  // loader phonemeta --out 生成的号码计划索引，未配置时不做号码校验
+  std::shared_ptr<const hs::NumberPlan> numbers;
+  if (auto path = hs::get_env("NUMBER_PLAN", ""); !path.empty()) numbers = hs::NumberPlan::open(path);
+  // 影子路由：账户有 status='shadow' 的计划时，按 ROUTE_SHADOW_SAMPLE_PPM 抽样与生效计划比较，分歧写入 ClickHouse
+  hs::routing::ShadowEvaluator::Options sopt;
+  sopt.sample_ppm = static_cast<uint32_t>(std::clamp<long long>(hs::get_env_int("ROUTE_SHADOW_SAMPLE_PPM", 0), 0, 1000000));
+  sopt.ring_capacity = static_cast<size_t>(hs::get_env_int("ROUTE_SHADOW_RING", 16384));
+  sopt.ch_http = hs::get_env("CH_HTTP", "http://localhost:8123/?database=hyperswitch");
+  sopt.ch_timeout = std::chrono::milliseconds(hs::get_env_int("CH_TIMEOUT_MS", 10000));
+  sopt.flush_interval = std::chrono::milliseconds(hs::get_env_int("ROUTE_SHADOW_FLUSH_MS", 1000));
+  sopt.node = hs::get_env("NODE_ID", hs::get_env("HOSTNAME", "route-svc") + ":" + std::to_string(::getpid()));
+  hs::routing::ShadowEvaluator shadow(sopt);
+  hs::routing::RouteServiceImpl service(&pg, &penalties, &live, &cache, numbers.get(),
+                                        hs::get_env_int("NUMBER_PLAN_ENFORCE", 1) != 0, &shadow);
 
-  grpc::ServerBuilder builder;
-  builder.AddListeningPort(bind, grpc::InsecureServerCredentials());
-  builder.RegisterService(&service);
+  // 快照文件：可用时先以文件内容提供服务，全量加载转到后台追平；之后定期重写
+  std::string snapshot = hs::get_env("ROUTE_SNAPSHOT", "");
+  bool warm = !snapshot.empty() && service.load_snapshot(snapshot, hs::get_env_int("ROUTE_SNAPSHOT_MAX_AGE_S", 86400));
 
-  std::unique_ptr<grpc::Server> server(builder.BuildAndStart());
+  // 先 LISTEN 再全量加载，保证加载期间的变更不会丢失
+  hs::PgListener listener(pg_uri);
+  listener.subscribe("hs_routing", [&](const std::vector<std::string>& p) { service.apply_changes(p); });
+  listener.on_resync([&] { service.reload(); });
+  listener.start();
+  if (!warm) service.reload();
+  penalties.start([&service] { return service.trunks(); });
+  shadow.start([&service] { return service.table(); });
+  std::jthread snapshot_writer;
+  if (!snapshot.empty())
+    snapshot_writer = hs::snapshot_thread("route-svc", warm ? std::function<void()>([&] { service.reload(); }) : nullptr,
+                                          [&] { service.save_snapshot(snapshot); },
+                                          std::chrono::seconds(hs::get_env_int("ROUTE_SNAPSHOT_INTERVAL_S", 300)));
+
+  // Pick / PickBatch 只读内存快照，直接在完成队列线程上执行
+  using hyperswitch::routing::RouteService;
+  RouteService::AsyncService rpc_svc;
+  hs::rpc::Options ropt;
+  ropt.bind = bind;
+  hs::rpc::Server server(hs::rpc::options_from_env(ropt));
+  server.unary("Pick", &rpc_svc, &RouteService::AsyncService::RequestPick,
+               [&](auto* ctx, auto* req, auto* resp) { return service.Pick(ctx, req, resp); });
+  server.unary("PickBatch", &rpc_svc, &RouteService::AsyncService::RequestPickBatch,
+               [&](auto* ctx, auto* req, auto* resp) { return service.PickBatch(ctx, req, resp); });
+  server.start();
+  hs::metrics::Exporter metrics(hs::get_env("METRICS_BIND", "0.0.0.0:9101"));
   spdlog::info("route-svc listening on {}", bind);
-  server->Wait();
+  server.wait();
+  // 后台线程回调 service，须在其析构之前停止
+  shadow.stop();
+  penalties.stop();
   return 0;
 }
\ No newline at end of file
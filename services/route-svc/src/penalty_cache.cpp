@@ -0,0 +1,127 @@
+#include "penalty_cache.hpp"
+#include <spdlog/spdlog.h>
+#include <cstdlib>
+#include <memory>
+#include "common/time.hpp"
+
+namespace hs::routing {
+
+PenaltyCache::PenaltyCache(hs::RedisClient* redis, Options opt) : redis_(redis), opt_(opt) {
+  auto& reg = hs::metrics::registry();
+  refresh_rtt_ = &hs::RedisClient::rtt("penalty_refresh");
+  reg.counter_fn(this, "hs_route_penalty_refresh_errors_total", "Failed penalty refreshes", hs::metrics::load(stats_.refresh_errors));
+  reg.counter_fn(this, "hs_route_penalty_stale_reads_total", "Penalty lookups served as 1.0 because the cache was stale",
+                 hs::metrics::load(stats_.stale_reads));
+  reg.counter_fn(this, "hs_route_penalty_invalid_values_total", "Penalty values outside [0, 1] ignored",
+                 hs::metrics::load(stats_.invalid_values));
+  reg.gauge_fn(this, "hs_route_penalty_keys", "Trunks with a penalty value", hs::metrics::load(stats_.keys));
+  reg.gauge_fn(this, "hs_route_penalty_age_seconds", "Time since the last successful penalty refresh",
+               [this] { return static_cast<double>(age_ms()) / 1000.0; });
+}
+
+PenaltyCache::~PenaltyCache() {
+  hs::metrics::registry().remove(this);
+  stop();
+}
+
+void PenaltyCache::start(TrunkSource trunks) {
+  trunks_ = std::move(trunks);
+  refresh();
+  thread_ = std::jthread([this](std::stop_token st) { run(st); });
+}
+
+void PenaltyCache::stop() {
+  if (thread_.joinable()) {
+    thread_.request_stop();
+    run_cv_.notify_all();
+    thread_.join();
+  }
+}
+
+double PenaltyCache::penalty(std::string_view trunk) const {
+  const Table* t = table_.read();
+  if (!t) return 1.0;
+  if (hs::now_epoch_ms() - t->loaded_ms > opt_.max_stale.count()) {
+    stats_.stale_reads.fetch_add(1, std::memory_order_relaxed);
+    return 1.0;
+  }
+  auto it = t->penalty.find(trunk);
+  return it == t->penalty.end() ? 1.0 : it->second;
+}
+
+uint64_t PenaltyCache::version() const {
+  const Table* t = table_.read();
+  if (!t) return 0;
+  bool stale = hs::now_epoch_ms() - t->loaded_ms > opt_.max_stale.count();
+  return t->generation << 1 | (stale ? 1 : 0);
+}
+
+int64_t PenaltyCache::age_ms() const {
+  auto t = table_.load();
+  return t ? hs::now_epoch_ms() - t->loaded_ms : -1;
+}
+
+void PenaltyCache::apply(hs::StringMap<double> penalty) {
+  auto next = std::make_shared<Table>();
+  next->penalty = std::move(penalty);
+  next->loaded_ms = hs::now_epoch_ms();
+  auto cur = table_.load();
+  next->generation = !cur ? 1 : cur->penalty == next->penalty ? cur->generation : cur->generation + 1;
+  stats_.keys.store(next->penalty.size(), std::memory_order_relaxed);
+  table_.store(std::move(next));
+  stats_.refreshes.fetch_add(1, std::memory_order_relaxed);
+}
+
+void PenaltyCache::refresh() {
+  auto t0 = std::chrono::steady_clock::now();
+  try {
+    std::vector<std::string> trunks = trunks_ ? trunks_() : std::vector<std::string>{};
+    hs::StringMap<double> penalty;
+    if (!trunks.empty()) {
+      auto pipe = redis_->get().pipeline(false);
+      for (const auto& t : trunks) pipe.hget("quality:trunk:" + t, "penalty");
+      auto t1 = std::chrono::steady_clock::now();
+      auto replies = pipe.exec();
+      refresh_rtt_->record(std::chrono::steady_clock::now() - t1);
+      for (size_t i = 0; i < trunks.size(); ++i) {
+        auto v = replies.get<sw::redis::OptionalString>(i);
+        if (!v) continue;
+        char* end = nullptr;
+        double p = std::strtod(v->c_str(), &end);
+        if (end == v->c_str() || *end != '\0' || !(p >= 0.0 && p <= 1.0)) {
+          stats_.invalid_values.fetch_add(1, std::memory_order_relaxed);
+          continue;
+        }
+        penalty.emplace(trunks[i], p);
+      }
+    }
+    apply(std::move(penalty));
+  } catch (const std::exception& ex) {
+    stats_.refresh_errors.fetch_add(1, std::memory_order_relaxed);
+    spdlog::warn("Penalty refresh failed (cache age {}ms): {}", age_ms(), ex.what());
+  }
+  auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
+  stats_.last_refresh_us.store(us, std::memory_order_relaxed);
+  stats_.refresh_us_total.fetch_add(us, std::memory_order_relaxed);
+}
+
+void PenaltyCache::run(std::stop_token st) {
+  auto next_report = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+  while (!st.stop_requested()) {
+    {
+      std::unique_lock<std::mutex> lk(run_mu_);
+      run_cv_.wait_for(lk, st, opt_.refresh_interval, [] { return false; });
+    }
+    if (st.stop_requested()) break;
+    refresh();
+    if (std::chrono::steady_clock::now() >= next_report) {
+      next_report = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+      auto n = stats_.refreshes.load() + stats_.refresh_errors.load();
+      spdlog::info("Penalty cache: age={}ms keys={} refreshes={} errors={} last_refresh_us={} avg_refresh_us={} stale_reads={}",
+                   age_ms(), stats_.keys.load(), stats_.refreshes.load(), stats_.refresh_errors.load(),
+                   stats_.last_refresh_us.load(), n ? stats_.refresh_us_total.load() / n : 0, stats_.stale_reads.load());
+    }
+  }
+}
+
+}
@@ -0,0 +1,81 @@
+#include "route_cache.hpp"
+#include <utility>
+
+namespace hs::routing {
+
+RouteCache::RouteCache(Options opt) : per_shard_((opt.capacity + kShards - 1) / kShards) {
+  for (auto& s : shards_) {
+    s.slots.reserve(per_shard_);
+    s.index.reserve(per_shard_);
+  }
+  auto& reg = hs::metrics::registry();
+  reg.counter_fn(this, "hs_route_cache_hits_total", "Route decision cache hits", hs::metrics::load(stats_.hits));
+  reg.counter_fn(this, "hs_route_cache_misses_total", "Route decision cache misses", hs::metrics::load(stats_.misses));
+  reg.counter_fn(this, "hs_route_cache_stale_total", "Cached route decisions dropped after a snapshot or penalty change",
+                 hs::metrics::load(stats_.stale));
+  reg.counter_fn(this, "hs_route_cache_evictions_total", "Route decisions evicted by CLOCK", hs::metrics::load(stats_.evictions));
+  reg.gauge_fn(this, "hs_route_cache_entries", "Cached route decisions", [this] { return static_cast<double>(size()); });
+}
+
+RouteCache::~RouteCache() { hs::metrics::registry().remove(this); }
+
+std::shared_ptr<const RouteCache::Decision> RouteCache::find(const Key& key, uint64_t table_version, uint64_t penalty_version) {
+  if (!enabled()) return nullptr;
+  auto& s = shard(key);
+  std::lock_guard<std::mutex> lk(s.mu);
+  auto it = s.index.find(key);
+  if (it == s.index.end()) {
+    stats_.misses.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+  Slot& slot = s.slots[it->second];
+  if (slot.value->table_version != table_version || slot.value->penalty_version != penalty_version) {
+    stats_.stale.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+  slot.referenced = true;
+  stats_.hits.fetch_add(1, std::memory_order_relaxed);
+  return slot.value;
+}
+
+void RouteCache::insert(const Key& key, std::shared_ptr<const Decision> d) {
+  if (!enabled()) return;
+  auto& s = shard(key);
+  std::shared_ptr<const Decision> old;  // 在锁外释放
+  std::lock_guard<std::mutex> lk(s.mu);
+  if (auto it = s.index.find(key); it != s.index.end()) {
+    Slot& slot = s.slots[it->second];
+    old = std::exchange(slot.value, std::move(d));
+    slot.referenced = true;
+    return;
+  }
+  if (s.slots.size() < per_shard_) {
+    s.index.emplace(key, static_cast<uint32_t>(s.slots.size()));
+    s.slots.push_back({key, std::move(d), false});
+    return;
+  }
+  // CLOCK：跳过并清除访问位，替换第一个未被访问的槽位
+  while (s.slots[s.hand].referenced) {
+    s.slots[s.hand].referenced = false;
+    s.hand = (s.hand + 1) % s.slots.size();
+  }
+  Slot& victim = s.slots[s.hand];
+  s.index.erase(victim.key);
+  s.index.emplace(key, static_cast<uint32_t>(s.hand));
+  victim.key = key;
+  old = std::exchange(victim.value, std::move(d));
+  victim.referenced = false;
+  s.hand = (s.hand + 1) % s.slots.size();
+  stats_.evictions.fetch_add(1, std::memory_order_relaxed);
+}
+
+size_t RouteCache::size() const {
+  size_t n = 0;
+  for (const auto& s : shards_) {
+    std::lock_guard<std::mutex> lk(s.mu);
+    n += s.slots.size();
+  }
+  return n;
+}
+
+}
@@ -1,92 +1,204 @@
 #include "route_service_impl.hpp"
 #include <spdlog/spdlog.h>
-#include <sstream>
+#include <array>
+#include <chrono>
+#include <unordered_set>
 
 using hyperswitch::routing::PickRequest;
 using hyperswitch::routing::PickResponse;
 using hyperswitch::routing::Candidate;
+using hyperswitch::routing::PickBatchRequest;
+using hyperswitch::routing::PickBatchResponse;
 
 namespace hs::routing {
 
-RouteServiceImpl::RouteServiceImpl(hs::Pg* pg, hs::RedisClient* redis) : pg_(pg), redis_(redis) {}
+RouteServiceImpl::RouteServiceImpl(hs::Pg* pg, PenaltyCache* penalties, const hs::LiveCalls* live, RouteCache* cache,
+                                   const hs::NumberPlan* numbers, bool reject_invalid, ShadowEvaluator* shadow)
+  : pg_(pg), penalties_(penalties), live_(live), cache_(cache), numbers_(numbers), reject_invalid_(reject_invalid),
+    shadow_(shadow) {}
 
-::grpc::Status RouteServiceImpl::Pick(::grpc::ServerContext* ctx, const PickRequest* req, PickResponse* resp) {
+std::vector<std::string> RouteServiceImpl::trunks() const {
+  std::vector<std::string> out;
+  auto t = table_.load();
+  if (!t) return out;
+  std::unordered_set<std::string_view> seen;
+  for (const auto& v : t->vendors())
+    if (!v.trunk.empty() && seen.insert(v.trunk).second) out.push_back(v.trunk);
+  return out;
+}
+
+void RouteServiceImpl::reload() {
+  std::lock_guard<std::mutex> lk(reload_mu_);
+  auto conn = pg_->acquire();
+  table_.store(RouteTable::load(*conn));
+}
+
+bool RouteServiceImpl::load_snapshot(const std::string& path, int64_t max_age_s) {
   try {
-    pqxx::work txn(pg_->conn());
+    auto t = RouteTable::load_file(path, max_age_s);
+    std::lock_guard<std::mutex> lk(reload_mu_);
+    table_.store(std::move(t));
+    return true;
+  } catch (const std::exception& ex) {
+    spdlog::warn("Route snapshot not used: {}", ex.what());
+    return false;
+  }
+}
 
-    auto r1 = txn.exec_params(
-                "SELECT a.account_id, rp.plan_id, rp.name FROM core.trunks t "
-                "JOIN core.accounts a ON a.account_id=t.account_id "
-                "JOIN routing.route_plans rp ON rp.account_id=a.account_id "
-                "WHERE t.name=$1 ORDER BY rp.plan_id DESC LIMIT 1", req->ingress_trunk());
+void RouteServiceImpl::save_snapshot(const std::string& path) {
+  auto t = table_.load();
+  if (!t || t->generation() == saved_version_) return;
+  t->save(path);
+  saved_version_ = t->generation();
+}
 
-    if (r1.empty()) {
-      spdlog::warn("No route plan for trunk {}", req->ingress_trunk());
-      return ::grpc::Status(::grpc::StatusCode::NOT_FOUND, "route plan not found");
-    }
-    auto account_id = r1[0][0].as<long long>();
-    auto plan_id = r1[0][1].as<long long>();
-    auto plan_name = r1[0][2].as<std::string>();
-
-    auto to = req->e164_to().empty() ? req->to_uri() : req->e164_to();
-
-    // 黑名单检查（最长前缀存在则拒绝）
-    auto bl = txn.exec_params(
-      "SELECT 1 FROM security.blacklist_destinations b \n"
-      "JOIN routing.prefixes p ON p.prefix_id=b.prefix_id \n"
-      "WHERE (b.account_id IS NULL OR b.account_id=$1) AND $2 LIKE p.prefix || '%' AND (b.expire_at IS NULL OR b.expire_at>now()) \n"
-      "ORDER BY length(p.prefix) DESC LIMIT 1", account_id, to);
-    if (!bl.empty()) {
-      return ::grpc::Status(::grpc::StatusCode::PERMISSION_DENIED, "destination blacklisted");
+void RouteServiceImpl::apply_changes(const std::vector<std::string>& payloads) {
+  std::unordered_set<int64_t> plans, blacklists;
+  bool full = false;
+  for (const auto& p : payloads) {
+    auto pos = p.find(':');
+    std::string_view table(p.data(), pos == std::string::npos ? p.size() : pos);
+    std::string_view key = pos == std::string::npos ? std::string_view("*") : std::string_view(p).substr(pos + 1);
+    // account_id 为空的全局黑名单条目通知键为 "*"，只重建 account_id=0 的全局黑名单
+    if (table == "security.blacklist_destinations") {
+      blacklists.insert(key == "*" ? 0 : std::stoll(std::string(key)));
+      continue;
     }
+    if (key == "*") { full = true; break; }
+    if (table == "routing.route_plans" || table == "routing.plan_entries") plans.insert(std::stoll(std::string(key)));
+    else { full = true; break; }
+  }
+  std::lock_guard<std::mutex> lk(reload_mu_);
+  auto conn = pg_->acquire();
+  auto cur = table_.load();
+  if (full || !cur) table_.store(RouteTable::load(*conn));
+  else table_.store(cur->reload(*conn, plans, blacklists));
+}
+
+std::shared_ptr<const RouteCache::Decision> RouteServiceImpl::decide(const RouteTable& table, const PlanIndex& plan, std::string_view to,
+                                                                     const RouteCache::Key& key) {
+  // 路由表代号随表本身读取，两者必然一致；惩罚系数先取版本再读数据，读到的只会比版本新，缓存项至多被多判一次失效
+  auto d = std::make_shared<RouteCache::Decision>();
+  d->table_version = table.generation();
+  d->penalty_version = penalties_->version();
+  std::array<const RouteEntry*, RouteTable::kMaxCandidates> cands;
+  size_t n = table.candidates(plan, to, cands.data(), cands.size());
+  d->candidates.resize(n);
+  d->trunk_max_concurrent.resize(n);
+  // 质量衰减：按出中继的惩罚系数缩放 weight（内存缓存，不访问 Redis）
+  for (size_t i = 0; i < n; ++i) {
+    const RouteEntry& e = *cands[i];
+    const VendorInfo& v = table.vendor(e.vendor);
+    Candidate& c = d->candidates[i];
+    c.set_vendor(v.vendor);
+    c.set_egress_trunk(v.trunk);
+    c.set_ip(v.ip);
+    c.set_port(v.port);
+    c.set_priority(e.priority);
+    c.set_weight(std::max(1, static_cast<int>(e.weight * penalties_->penalty(v.trunk))));
+    c.set_max_cps(e.max_cps);
+    c.set_max_concurrent(e.max_concurrent);
+    c.set_entry_id(e.entry_id);
+    d->trunk_max_concurrent[i] = v.max_concurrent;
+  }
+  cache_->insert(key, d);
+  return d;
+}
+
+::grpc::Status RouteServiceImpl::pick_one(const RouteTable& table, const PickRequest& req, PickResponse* resp) {
+  const PlanIndex* plan = table.plan_for_trunk(req.ingress_trunk());
+  if (!plan) {
+    spdlog::warn("No route plan for trunk {}", req.ingress_trunk());
+    return ::grpc::Status(::grpc::StatusCode::NOT_FOUND, "route plan not found");
+  }
+
+  // 规范化为 E.164 后再做号码计划、黑名单与前缀匹配，与 billing / cdr 使用同一键
+  hs::number::E164 dest;
+  auto st = hs::number::normalize(req.e164_to().empty() ? req.to_uri() : req.e164_to(), dest,
+                                  table.dial_plan(req.ingress_trunk()));
+  if (st != hs::number::Status::Ok) {
+    return ::grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT,
+                          std::string("invalid destination number: ") + hs::number::status_name(st));
+  }
+  std::string_view to = dest.view();
+  resp->set_e164_to(std::string(to));
 
-    auto r2 = txn.exec_params(
-      "WITH cand AS (\n"
-      "  SELECT p.prefix, pe.priority, pe.weight, v.name AS vendor, t.name AS trunk, t.auth_data->>'host' AS ip, \n"
-      "         COALESCE((t.auth_data->>'port')::int,5060) AS port\n"
-      "  FROM routing.prefixes p\n"
-      "  JOIN routing.plan_entries pe ON pe.prefix_id=p.prefix_id AND pe.plan_id=$1\n"
-      "  JOIN routing.vendors v ON v.vendor_id=pe.vendor_id\n"
-      "  JOIN core.trunks t ON t.trunk_id=v.trunk_id\n"
-      "  WHERE $2 LIKE p.prefix || '%'\n"
-      ")\n"
-      "SELECT prefix, priority, weight, vendor, trunk, ip, port FROM cand\n"
-      " ORDER BY length(prefix) DESC, priority ASC, weight DESC LIMIT 16;",
-      plan_id, to);
-
-    if (r2.empty()) {
-      return ::grpc::Status(::grpc::StatusCode::NOT_FOUND, "no route candidates");
+  // 号码计划：目的地分类与长度校验，只读映射的索引，无锁
+  if (numbers_) {
+    auto m = numbers_->classify(to);
+    if (!m.valid() && reject_invalid_) {
+      return ::grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT, "invalid destination number");
     }
+    if (m.valid()) {
+      resp->set_dest_region(std::string(hs::NumberPlan::region_id(*m.region)));
+      resp->set_number_type(hs::number_types_name(m.types));
+    }
+  }
 
-    // 质量衰减：从 Redis 查询 vendor/trunk penalty，乘到 weight
-    auto& red = redis_->get();
-
-    for (const auto& row : r2) {
-      double penalty = 1.0;
-      try {
-        auto key = std::string("quality:trunk:") + row[4].c_str();
-        auto v = red.hget(key, "penalty");
-        if (v) penalty = std::stod(*v);
-      } catch (...) {}
-      int base_weight = row[2].as<int>();
-      int scaled_weight = std::max(1, static_cast<int>(base_weight * penalty));
-
-      Candidate* c = resp->add_candidates();
-      c->set_vendor(row[3].as<std::string>());
-      c->set_egress_trunk(row[4].as<std::string>());
-      c->set_ip(row[5].as<std::string>());
-      c->set_port(row[6].as<int>());
-      c->set_priority(row[1].as<int>());
-      c->set_weight(scaled_weight);
+  // 黑名单检查（存在未过期的匹配前缀则拒绝）
+  auto now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+  if (table.blacklisted(plan->account_id, to, now)) {
+    return ::grpc::Status(::grpc::StatusCode::PERMISSION_DENIED, "destination blacklisted");
+  }
+
+  // 影子评估：抽中的请求只写入无锁环，两个计划的比较在后台线程进行
+  if (shadow_ && shadow_->sample()) {
+    if (const PlanIndex* sp = table.shadow_plan_for_trunk(req.ingress_trunk())) shadow_->offer(*plan, *sp, to);
+  }
+
+  // 候选列表只取决于计划与最长匹配前缀
+  RouteCache::Key key{plan->plan_id, plan->trie.longest(to)};
+  if (key.node == hs::PrefixTrie::kNone) {
+    return ::grpc::Status(::grpc::StatusCode::NOT_FOUND, "no route candidates");
+  }
+  auto d = cache_->find(key, table.generation(), penalties_->version());
+  if (!d) d = decide(table, *plan, to, key);
+
+  // 在途登记只有账户 / 中继 / 供应商粒度，这里按出中继上限过滤；路由条目上限由 RiskEval 的 entry:<id> 计数器执行
+  for (size_t i = 0; i < d->candidates.size(); ++i) {
+    const Candidate& c = d->candidates[i];
+    uint32_t cap = d->trunk_max_concurrent[i];
+    if (cap && live_->live("trunk:", c.egress_trunk()) >= static_cast<int32_t>(cap)) continue;
+    *resp->add_candidates() = c;
+  }
+  if (resp->candidates_size() == 0) {
+    return ::grpc::Status(::grpc::StatusCode::RESOURCE_EXHAUSTED, "all route candidates saturated");
+  }
+  resp->set_route_plan(plan->name);
+  resp->set_policy_version(std::to_string(plan->plan_id));
+  return ::grpc::Status::OK;
+}
+
+::grpc::Status RouteServiceImpl::Pick(::grpc::ServerContext* ctx, const PickRequest* req, PickResponse* resp) {
+  try {
+    const RouteTable* table = table_.read();
+    if (!table) return ::grpc::Status(::grpc::StatusCode::UNAVAILABLE, "route table not loaded");
+    return pick_one(*table, *req, resp);
+  } catch (const std::exception& ex) {
+    spdlog::error("Route Pick error: {}", ex.what());
+    return ::grpc::Status(::grpc::StatusCode::INTERNAL, ex.what());
+  }
+}
+
+::grpc::Status RouteServiceImpl::PickBatch(::grpc::ServerContext* ctx, const PickBatchRequest* req, PickBatchResponse* resp) {
+  try {
+    const RouteTable* table = table_.read();
+    if (!table) return ::grpc::Status(::grpc::StatusCode::UNAVAILABLE, "route table not loaded");
+    for (const auto& item : req->items()) {
+      auto* r = resp->add_results();
+      r->set_seq(item.seq());
+      auto st = pick_one(*table, item.request(), r->mutable_response());
+      if (!st.ok()) {
+        r->clear_response();
+        r->set_code(st.error_code());
+        r->set_error(st.error_message());
+      }
     }
-    resp->set_route_plan(plan_name);
-    resp->set_policy_version("v1");
-    txn.commit();
     return ::grpc::Status::OK;
   } catch (const std::exception& ex) {
-    spdlog::error("Route Pick error: {}", ex.what());
+    spdlog::error("Route PickBatch error: {}", ex.what());
     return ::grpc::Status(::grpc::StatusCode::INTERNAL, ex.what());
   }
 }
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,455 @@
+#include "route_table.hpp"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include "common/snapshot_file.hpp"
+
+namespace hs::routing {
+
+namespace {
+
+// ---- 快照文件布局：段号与记录，记录间以段内下标引用 ----
+
+constexpr std::string_view kSnapshotKind = "ROUT";
+constexpr uint32_t kSnapshotVersion = 3;
+enum : uint32_t { kTrunks = 1, kRules, kVendors, kPlans, kNodes, kRanges, kEntries, kBlacklists, kExpire };
+
+using Str = hs::SnapshotFile::Str;
+
+struct FlatTrunk {
+  Str name;
+  int64_t account_id;
+  int64_t plan_id;
+  int64_t shadow_plan_id;
+  Str intl_prefix, national_prefix, country_code;
+  uint32_t first_rule, rule_count;
+};
+struct FlatRule {
+  Str match, prepend;
+  uint32_t strip, reserved;
+};
+struct FlatVendor {
+  int64_t vendor_id;
+  Str vendor, trunk, ip;
+  uint32_t port, max_concurrent;
+};
+// 节点在 kNodes 段，ranges / entries 为各自段中的区间
+struct FlatPlan {
+  int64_t plan_id;
+  int64_t account_id;
+  Str name;
+  uint32_t first_node, node_count, first_range, range_count, first_entry, entry_count;
+};
+struct FlatRange {
+  uint32_t begin, end;
+};
+struct FlatEntry {
+  uint32_t vendor;
+  int32_t priority, weight;
+  uint32_t max_cps, max_concurrent, reserved;
+  int64_t entry_id;
+};
+struct FlatBlacklist {
+  int64_t account_id;
+  uint32_t first_node, node_count, first_expire, expire_count;
+};
+// 记录不含隐式填充，文件内容由数据唯一决定
+static_assert(sizeof(FlatTrunk) == 64 && sizeof(FlatRule) == 24 && sizeof(FlatVendor) == 40 && sizeof(FlatPlan) == 48 &&
+              sizeof(FlatRange) == 8 && sizeof(FlatEntry) == 32 && sizeof(FlatBlacklist) == 24);
+
+int64_t epoch_now() {
+  return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// 从快照节点重建前缀树，并校验节点 value 都是 [0, slots) 内的下标
+void restore_trie(const hs::SnapshotFile& f, std::span<const hs::PrefixTrie::Node> nodes, uint32_t first, uint32_t count,
+                  size_t slots, hs::PrefixTrie& out) {
+  if (!out.assign(hs::SnapshotFile::slice(nodes, first, count)))
+    throw std::runtime_error("snapshot " + f.path() + ": corrupt prefix index");
+  for (const auto& n : out.nodes())
+    if (n.value != hs::PrefixTrie::kNone && n.value >= slots)
+      throw std::runtime_error("snapshot " + f.path() + ": prefix slot out of range");
+}
+
+}
+
+// only 为空时全量查询；否则 sql 中以 $1 绑定 id 数组
+static pqxx::result exec_filtered(pqxx::transaction_base& tx, const std::string& sql, const std::unordered_set<int64_t>* only) {
+  if (!only) return tx.exec(sql);
+  std::vector<long long> ids(only->begin(), only->end());
+  return tx.exec_params(sql, ids);
+}
+
+hs::StringMap<TrunkBinding> RouteTable::load_bindings(pqxx::transaction_base& tx) {
+  hs::StringMap<TrunkBinding> out;
+  std::unordered_map<int64_t, TrunkBinding*> by_id;
+  // 同名中继取最新的生效计划，与原 ORDER BY rp.plan_id DESC LIMIT 1 一致；影子计划不参与选路
+  for (const auto& row : tx.exec(
+         "SELECT DISTINCT ON (t.name) t.name, a.account_id, rp.plan_id, t.trunk_id, t.intl_prefix, t.national_prefix, t.country_code "
+         "FROM core.trunks t "
+         "JOIN core.accounts a ON a.account_id=t.account_id "
+         "JOIN routing.route_plans rp ON rp.account_id=a.account_id AND rp.status='live' "
+         "ORDER BY t.name, rp.plan_id DESC")) {
+    TrunkBinding b{row[1].as<long long>(), row[2].as<long long>(), {}};
+    b.dial.intl_prefix = row[4].as<std::string>();
+    b.dial.national_prefix = row[5].as<std::string>();
+    b.dial.country_code = row[6].as<std::string>();
+    auto it = out.emplace(row[0].as<std::string>(), std::move(b)).first;
+    by_id.emplace(row[3].as<long long>(), &it->second);
+  }
+  for (const auto& row : tx.exec("SELECT trunk_id, match_prefix, strip_digits, prepend FROM core.trunk_dial_rules")) {
+    auto it = by_id.find(row[0].as<long long>());
+    if (it == by_id.end()) continue;
+    it->second->dial.rewrites.push_back({row[1].as<std::string>(), row[2].as<uint32_t>(), row[3].as<std::string>()});
+  }
+  std::unordered_map<int64_t, int64_t> shadow;
+  for (const auto& row : tx.exec(
+         "SELECT DISTINCT ON (account_id) account_id, plan_id FROM routing.route_plans "
+         "WHERE status='shadow' ORDER BY account_id, plan_id DESC")) {
+    shadow.emplace(row[0].as<long long>(), row[1].as<long long>());
+  }
+  for (auto& [name, b] : out) {
+    b.dial.finalize();
+    if (auto it = shadow.find(b.account_id); it != shadow.end()) b.shadow_plan_id = it->second;
+  }
+  return out;
+}
+
+std::shared_ptr<const RouteTable::VendorSet> RouteTable::load_vendors(pqxx::transaction_base& tx) {
+  auto vs = std::make_shared<VendorSet>();
+  for (const auto& row : tx.exec(
+         "SELECT v.vendor_id, v.name, t.name, COALESCE(t.auth_data->>'host',''), \n"
+         "       COALESCE((t.auth_data->>'port')::int,5060), GREATEST(t.max_concurrent,0) \n"
+         "FROM routing.vendors v JOIN core.trunks t ON t.trunk_id=v.trunk_id")) {
+    vs->index.emplace(row[0].as<long long>(), static_cast<uint32_t>(vs->list.size()));
+    vs->list.push_back({row[1].as<std::string>(), row[2].as<std::string>(), row[3].as<std::string>(), row[4].as<uint32_t>(),
+                        row[5].as<uint32_t>()});
+  }
+  return vs;
+}
+
+size_t RouteTable::load_plans(pqxx::transaction_base& tx, const VendorSet& vendors,
+                              const std::unordered_set<int64_t>* only, PlanMap& out) {
+  const char* filter = only ? " WHERE plan_id = ANY($1)" : "";
+  const char* entry_filter = only ? " WHERE pe.plan_id = ANY($1)" : "";
+
+  std::unordered_map<int64_t, std::shared_ptr<PlanIndex>> plans;
+  for (const auto& row : exec_filtered(tx, std::string("SELECT plan_id, account_id, name FROM routing.route_plans") + filter, only)) {
+    auto p = std::make_shared<PlanIndex>();
+    p->plan_id = row[0].as<long long>();
+    p->account_id = row[1].as<long long>();
+    p->name = row[2].as<std::string>();
+    plans.emplace(p->plan_id, std::move(p));
+  }
+
+  size_t skipped = 0;
+  PlanIndex* cur = nullptr;
+  uint32_t* slot = nullptr;
+  std::string last_prefix;
+  for (const auto& row : exec_filtered(tx,
+         std::string("SELECT pe.plan_id, p.prefix, pe.vendor_id, pe.priority, pe.weight, pe.max_cps, pe.max_concurrent, pe.entry_id \n"
+                     "FROM routing.plan_entries pe JOIN routing.prefixes p ON p.prefix_id=pe.prefix_id") + entry_filter +
+         " ORDER BY pe.plan_id, p.prefix, pe.priority ASC, pe.weight DESC", only)) {
+    auto pit = plans.find(row[0].as<long long>());
+    auto vit = vendors.index.find(row[2].as<long long>());
+    if (pit == plans.end() || vit == vendors.index.end()) { ++skipped; continue; }
+    std::string prefix = row[1].as<std::string>();
+    if (pit->second.get() != cur || prefix != last_prefix) {
+      cur = pit->second.get();
+      last_prefix = prefix;
+      slot = cur->trie.insert(prefix);
+      if (!slot) { ++skipped; continue; }
+      *slot = static_cast<uint32_t>(cur->ranges.size());
+      auto begin = static_cast<uint32_t>(cur->entries.size());
+      cur->ranges.emplace_back(begin, begin);
+    }
+    if (!slot) { ++skipped; continue; }
+    cur->entries.push_back({vit->second, row[3].as<int>(), row[4].as<int>(),
+                            static_cast<uint32_t>(std::max(0, row[5].as<int>())),
+                            static_cast<uint32_t>(std::max(0, row[6].as<int>())), row[7].as<long long>()});
+    cur->ranges.back().second = static_cast<uint32_t>(cur->entries.size());
+  }
+  for (auto& [id, p] : plans) out[id] = std::move(p);
+  return skipped;
+}
+
+size_t RouteTable::load_blacklists(pqxx::transaction_base& tx, const std::unordered_set<int64_t>* only, BlacklistMap& out) {
+  std::unordered_map<int64_t, std::shared_ptr<Blacklist>> lists;
+  if (only) for (auto id : *only) lists[id] = std::make_shared<Blacklist>();
+
+  size_t skipped = 0;
+  for (const auto& row : exec_filtered(tx,
+         std::string("SELECT COALESCE(b.account_id,0), p.prefix, COALESCE(EXTRACT(EPOCH FROM b.expire_at)::bigint,0) \n"
+                     "FROM security.blacklist_destinations b JOIN routing.prefixes p ON p.prefix_id=b.prefix_id \n"
+                     "WHERE (b.expire_at IS NULL OR b.expire_at>now())") +
+         (only ? " AND COALESCE(b.account_id,0) = ANY($1)" : ""), only)) {
+    auto& bl = lists[row[0].as<long long>()];
+    if (!bl) bl = std::make_shared<Blacklist>();
+    uint32_t* v = bl->trie.insert(row[1].as<std::string>());
+    if (!v) { ++skipped; continue; }
+    int64_t exp = row[2].as<long long>();
+    if (*v == hs::PrefixTrie::kNone) {
+      *v = static_cast<uint32_t>(bl->expire_at.size());
+      bl->expire_at.push_back(exp);
+    } else if (bl->expire_at[*v] != 0) {
+      // 同一前缀多条记录：取最晚到期，永久优先
+      bl->expire_at[*v] = exp == 0 ? 0 : std::max(bl->expire_at[*v], exp);
+    }
+  }
+  for (auto& [id, bl] : lists) {
+    if (bl->expire_at.empty()) out.erase(id);
+    else out[id] = std::move(bl);
+  }
+  return skipped;
+}
+
+uint64_t RouteTable::next_generation() {
+  static std::atomic<uint64_t> next{0};
+  return next.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+std::shared_ptr<const RouteTable> RouteTable::load(pqxx::connection& conn) {
+  auto t = std::make_shared<RouteTable>();
+  pqxx::read_transaction tx(conn);
+  t->trunks_ = load_bindings(tx);
+  t->vendors_ = load_vendors(tx);
+  size_t skipped = load_plans(tx, *t->vendors_, nullptr, t->plans_);
+  skipped += load_blacklists(tx, nullptr, t->blacklists_);
+
+  size_t entry_count = 0;
+  for (const auto& [id, p] : t->plans_) entry_count += p->entries.size();
+  spdlog::info("Route table loaded: {} plans, {} entries, {} vendors, {} trunks, {} rows skipped",
+               t->plans_.size(), entry_count, t->vendors_->list.size(), t->trunks_.size(), skipped);
+  return t;
+}
+
+std::shared_ptr<const RouteTable> RouteTable::reload(pqxx::connection& conn, const std::unordered_set<int64_t>& plan_ids,
+                                                     const std::unordered_set<int64_t>& blacklist_accounts) const {
+  auto t = std::make_shared<RouteTable>(*this);
+  t->generation_ = next_generation();
+  pqxx::read_transaction tx(conn);
+  size_t skipped = 0;
+  if (!plan_ids.empty()) {
+    // 计划增删会改变中继绑定，绑定查询较轻，一并刷新
+    t->trunks_ = load_bindings(tx);
+    for (auto id : plan_ids) t->plans_.erase(id);
+    skipped += load_plans(tx, *t->vendors_, &plan_ids, t->plans_);
+  }
+  if (!blacklist_accounts.empty()) skipped += load_blacklists(tx, &blacklist_accounts, t->blacklists_);
+  spdlog::info("Route table reloaded {} plan(s), {} blacklist(s), {} rows skipped",
+               plan_ids.size(), blacklist_accounts.size(), skipped);
+  return t;
+}
+
+void RouteTable::save(const std::string& path) const {
+  auto t0 = std::chrono::steady_clock::now();
+  hs::SnapshotWriter w(kSnapshotKind, kSnapshotVersion);
+
+  std::vector<FlatTrunk> trunks;
+  std::vector<FlatRule> rules;
+  for (const auto& [name, b] : trunks_) {
+    FlatTrunk ft{};
+    ft.name = w.str(name);
+    ft.account_id = b.account_id;
+    ft.plan_id = b.plan_id;
+    ft.shadow_plan_id = b.shadow_plan_id;
+    ft.intl_prefix = w.str(b.dial.intl_prefix);
+    ft.national_prefix = w.str(b.dial.national_prefix);
+    ft.country_code = w.str(b.dial.country_code);
+    ft.first_rule = static_cast<uint32_t>(rules.size());
+    ft.rule_count = static_cast<uint32_t>(b.dial.rewrites.size());
+    for (const auto& r : b.dial.rewrites) {
+      FlatRule fr{};
+      fr.match = w.str(r.match);
+      fr.prepend = w.str(r.prepend);
+      fr.strip = r.strip;
+      rules.push_back(fr);
+    }
+    trunks.push_back(ft);
+  }
+
+  std::vector<int64_t> vendor_ids(vendors_->list.size());
+  for (const auto& [id, idx] : vendors_->index) vendor_ids[idx] = id;
+  std::vector<FlatVendor> vendors;
+  for (size_t i = 0; i < vendors_->list.size(); ++i) {
+    const VendorInfo& v = vendors_->list[i];
+    FlatVendor fv{};
+    fv.vendor_id = vendor_ids[i];
+    fv.vendor = w.str(v.vendor);
+    fv.trunk = w.str(v.trunk);
+    fv.ip = w.str(v.ip);
+    fv.port = v.port;
+    fv.max_concurrent = v.max_concurrent;
+    vendors.push_back(fv);
+  }
+
+  std::vector<hs::PrefixTrie::Node> nodes;
+  std::vector<FlatPlan> plans;
+  std::vector<FlatRange> ranges;
+  std::vector<FlatEntry> entries;
+  for (const auto& [id, p] : plans_) {
+    FlatPlan fp{};
+    fp.plan_id = p->plan_id;
+    fp.account_id = p->account_id;
+    fp.name = w.str(p->name);
+    fp.first_node = static_cast<uint32_t>(nodes.size());
+    fp.node_count = static_cast<uint32_t>(p->trie.node_count());
+    nodes.insert(nodes.end(), p->trie.nodes().begin(), p->trie.nodes().end());
+    fp.first_range = static_cast<uint32_t>(ranges.size());
+    fp.range_count = static_cast<uint32_t>(p->ranges.size());
+    for (const auto& [b, e] : p->ranges) ranges.push_back({b, e});
+    fp.first_entry = static_cast<uint32_t>(entries.size());
+    fp.entry_count = static_cast<uint32_t>(p->entries.size());
+    for (const auto& e : p->entries) entries.push_back({e.vendor, e.priority, e.weight, e.max_cps, e.max_concurrent, 0, e.entry_id});
+    plans.push_back(fp);
+  }
+
+  std::vector<FlatBlacklist> blacklists;
+  std::vector<int64_t> expire;
+  for (const auto& [account, bl] : blacklists_) {
+    FlatBlacklist fb{};
+    fb.account_id = account;
+    fb.first_node = static_cast<uint32_t>(nodes.size());
+    fb.node_count = static_cast<uint32_t>(bl->trie.node_count());
+    nodes.insert(nodes.end(), bl->trie.nodes().begin(), bl->trie.nodes().end());
+    fb.first_expire = static_cast<uint32_t>(expire.size());
+    fb.expire_count = static_cast<uint32_t>(bl->expire_at.size());
+    expire.insert(expire.end(), bl->expire_at.begin(), bl->expire_at.end());
+    blacklists.push_back(fb);
+  }
+
+  w.section(kTrunks, trunks);
+  w.section(kRules, rules);
+  w.section(kVendors, vendors);
+  w.section(kPlans, plans);
+  w.section(kNodes, nodes);
+  w.section(kRanges, ranges);
+  w.section(kEntries, entries);
+  w.section(kBlacklists, blacklists);
+  w.section(kExpire, expire);
+  w.write(path, epoch_now());
+  spdlog::info("Route snapshot written to {} in {:.1f}ms: {} plans, {} entries, {} trie nodes", path,
+               std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count(), plans.size(),
+               entries.size(), nodes.size());
+}
+
+std::shared_ptr<const RouteTable> RouteTable::load_file(const std::string& path, int64_t max_age_s) {
+  auto t0 = std::chrono::steady_clock::now();
+  auto f = hs::SnapshotFile::open(path, kSnapshotKind, kSnapshotVersion, max_age_s);
+  auto t = std::make_shared<RouteTable>();
+  auto nodes = f->section<hs::PrefixTrie::Node>(kNodes);
+
+  auto rules = f->section<FlatRule>(kRules);
+  for (const auto& ft : f->section<FlatTrunk>(kTrunks)) {
+    TrunkBinding b{ft.account_id, ft.plan_id, {}, ft.shadow_plan_id};
+    b.dial.intl_prefix = f->str(ft.intl_prefix);
+    b.dial.national_prefix = f->str(ft.national_prefix);
+    b.dial.country_code = f->str(ft.country_code);
+    for (const auto& r : hs::SnapshotFile::slice(rules, ft.first_rule, ft.rule_count))
+      b.dial.rewrites.push_back({std::string(f->str(r.match)), r.strip, std::string(f->str(r.prepend))});
+    b.dial.finalize();
+    t->trunks_.emplace(f->str(ft.name), std::move(b));
+  }
+
+  auto vs = std::make_shared<VendorSet>();
+  for (const auto& fv : f->section<FlatVendor>(kVendors)) {
+    vs->index.emplace(fv.vendor_id, static_cast<uint32_t>(vs->list.size()));
+    vs->list.push_back({std::string(f->str(fv.vendor)), std::string(f->str(fv.trunk)), std::string(f->str(fv.ip)), fv.port,
+                        fv.max_concurrent});
+  }
+  t->vendors_ = vs;
+
+  auto ranges = f->section<FlatRange>(kRanges);
+  auto entries = f->section<FlatEntry>(kEntries);
+  size_t entry_count = 0;
+  for (const auto& fp : f->section<FlatPlan>(kPlans)) {
+    auto p = std::make_shared<PlanIndex>();
+    p->plan_id = fp.plan_id;
+    p->account_id = fp.account_id;
+    p->name = f->str(fp.name);
+    restore_trie(*f, nodes, fp.first_node, fp.node_count, fp.range_count, p->trie);
+    for (const auto& r : hs::SnapshotFile::slice(ranges, fp.first_range, fp.range_count)) {
+      if (r.begin > r.end || r.end > fp.entry_count) throw std::runtime_error("snapshot " + path + ": entry range out of bounds");
+      p->ranges.emplace_back(r.begin, r.end);
+    }
+    p->entries.reserve(fp.entry_count);
+    for (const auto& e : hs::SnapshotFile::slice(entries, fp.first_entry, fp.entry_count)) {
+      if (e.vendor >= vs->list.size()) throw std::runtime_error("snapshot " + path + ": vendor out of range");
+      p->entries.push_back({e.vendor, e.priority, e.weight, e.max_cps, e.max_concurrent, e.entry_id});
+    }
+    entry_count += p->entries.size();
+    t->plans_.emplace(p->plan_id, std::move(p));
+  }
+
+  auto expire = f->section<int64_t>(kExpire);
+  for (const auto& fb : f->section<FlatBlacklist>(kBlacklists)) {
+    auto bl = std::make_shared<Blacklist>();
+    restore_trie(*f, nodes, fb.first_node, fb.node_count, fb.expire_count, bl->trie);
+    auto exp = hs::SnapshotFile::slice(expire, fb.first_expire, fb.expire_count);
+    bl->expire_at.assign(exp.begin(), exp.end());
+    t->blacklists_.emplace(fb.account_id, std::move(bl));
+  }
+
+  spdlog::info("Route table loaded from snapshot {} ({}s old) in {:.1f}ms: {} plans, {} entries, {} vendors, {} trunks", path,
+               epoch_now() - f->header().created_at,
+               std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count(), t->plans_.size(),
+               entry_count, vs->list.size(), t->trunks_.size());
+  return t;
+}
+
+const PlanIndex* RouteTable::plan_for_trunk(std::string_view ingress_trunk) const {
+  auto it = trunks_.find(ingress_trunk);
+  if (it == trunks_.end()) return nullptr;
+  auto pit = plans_.find(it->second.plan_id);
+  return pit == plans_.end() ? nullptr : pit->second.get();
+}
+
+const PlanIndex* RouteTable::shadow_plan_for_trunk(std::string_view ingress_trunk) const {
+  auto it = trunks_.find(ingress_trunk);
+  if (it == trunks_.end() || it->second.shadow_plan_id == 0) return nullptr;
+  return plan(it->second.shadow_plan_id);
+}
+
+const PlanIndex* RouteTable::plan(int64_t plan_id) const {
+  auto it = plans_.find(plan_id);
+  return it == plans_.end() ? nullptr : it->second.get();
+}
+
+const hs::number::DialPlan* RouteTable::dial_plan(std::string_view ingress_trunk) const {
+  auto it = trunks_.find(ingress_trunk);
+  return it == trunks_.end() ? nullptr : &it->second.dial;
+}
+
+bool RouteTable::blacklisted(int64_t account_id, std::string_view dest, int64_t now_epoch) const {
+  for (int64_t key : {int64_t{0}, account_id}) {
+    auto it = blacklists_.find(key);
+    if (it == blacklists_.end()) continue;
+    const Blacklist& bl = *it->second;
+    bool hit = false;
+    bl.trie.walk(dest, [&](uint32_t v, size_t) {
+      int64_t exp = bl.expire_at[v];
+      if (exp == 0 || exp > now_epoch) hit = true;
+    });
+    if (hit) return true;
+    if (account_id == 0) break;
+  }
+  return false;
+}
+
+size_t RouteTable::candidates(const PlanIndex& plan, std::string_view dest, const RouteEntry** out, size_t limit) const {
+  std::array<uint32_t, 32> matched;
+  size_t depth = 0;
+  plan.trie.walk(dest, [&](uint32_t v, size_t) {
+    if (depth < matched.size()) matched[depth++] = v;
+  });
+  size_t n = 0;
+  while (depth > 0 && n < limit) {
+    auto [begin, end] = plan.ranges[matched[--depth]];
+    for (uint32_t i = begin; i < end && n < limit; ++i) out[n++] = &plan.entries[i];
+  }
+  return n;
+}
+
+}
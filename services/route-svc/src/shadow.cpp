@@ -0,0 +1,240 @@
+#include "shadow.hpp"
+#include <algorithm>
+#include <cstring>
+#include <cpr/cpr.h>
+#include <spdlog/spdlog.h>
+#include "common/metrics.hpp"
+
+namespace hs::routing {
+
+namespace {
+
+// 候选的供应商下标，按出现顺序去重
+size_t vendors_of(const PolicyPick& p, std::array<uint32_t, RouteTable::kMaxCandidates>& out) {
+  size_t n = 0;
+  for (size_t i = 0; i < p.size; ++i) {
+    uint32_t v = p.entries[i]->vendor;
+    if (std::find(out.begin(), out.begin() + n, v) == out.begin() + n) out[n++] = v;
+  }
+  return n;
+}
+
+// ClickHouse TabSeparated 中的 Array(String)：['a','b']
+void append_array(std::string& out, const RouteTable& table, const PolicyPick& p) {
+  std::array<uint32_t, RouteTable::kMaxCandidates> vs;
+  size_t n = vendors_of(p, vs);
+  out += '[';
+  for (size_t i = 0; i < n; ++i) {
+    if (i) out += ',';
+    // 元素在字段转义之外只需再转义单引号
+    std::string_view name = table.vendor(vs[i]).vendor;
+    out += '\'';
+    for (size_t from = 0;;) {
+      size_t q = name.find('\'', from);
+      append_escaped(out, name.substr(from, q - from));
+      if (q == std::string_view::npos) break;
+      out += "\\'";
+      from = q + 1;
+    }
+    out += '\'';
+  }
+  out += ']';
+}
+
+}
+
+void append_escaped(std::string& out, std::string_view s) {
+  for (char c : s) {
+    switch (c) {
+      case '\\': out += "\\\\"; break;
+      case '\t': out += "\\t"; break;
+      case '\n': out += "\\n"; break;
+      default: out += c;
+    }
+  }
+}
+
+const char* divergence_name(Divergence d) {
+  switch (d) {
+    case Divergence::None: return "none";
+    case Divergence::First: return "first";
+    case Divergence::Set: return "set";
+    case Divergence::LiveNoRoute: return "live_no_route";
+    case Divergence::ShadowNoRoute: return "shadow_no_route";
+  }
+  return "";
+}
+
+PolicyDiff compare_policies(const RouteTable& table, const PlanIndex& live, const PlanIndex& shadow, std::string_view dest) {
+  PolicyDiff d;
+  d.live.size = table.candidates(live, dest, d.live.entries.data(), d.live.entries.size());
+  d.shadow.size = table.candidates(shadow, dest, d.shadow.entries.data(), d.shadow.entries.size());
+  if (d.live.size == 0 || d.shadow.size == 0) {
+    d.divergence = d.live.size == d.shadow.size ? Divergence::None
+                 : d.live.size == 0             ? Divergence::LiveNoRoute
+                                                : Divergence::ShadowNoRoute;
+    return d;
+  }
+  if (d.live.entries[0]->vendor != d.shadow.entries[0]->vendor) {
+    d.divergence = Divergence::First;
+    return d;
+  }
+  std::array<uint32_t, RouteTable::kMaxCandidates> a, b;
+  size_t na = vendors_of(d.live, a), nb = vendors_of(d.shadow, b);
+  std::sort(a.begin(), a.begin() + na);
+  std::sort(b.begin(), b.begin() + nb);
+  if (!std::equal(a.begin(), a.begin() + na, b.begin(), b.begin() + nb)) d.divergence = Divergence::Set;
+  return d;
+}
+
+ShadowEvaluator::ShadowEvaluator(Options opt) : opt_(std::move(opt)), ring_(opt_.ring_capacity) {
+  auto& reg = hs::metrics::registry();
+  reg.counter_fn(this, "hs_route_shadow_sampled_total", "Pick calls sampled for shadow evaluation", hs::metrics::load(stats_.sampled));
+  reg.counter_fn(this, "hs_route_shadow_dropped_total", "Shadow samples dropped because the ring was full",
+                 hs::metrics::load(stats_.dropped));
+  reg.counter_fn(this, "hs_route_shadow_evaluated_total", "Shadow samples evaluated against both plans",
+                 hs::metrics::load(stats_.evaluated));
+  reg.counter_fn(this, "hs_route_shadow_stale_total", "Shadow samples whose plans were gone at evaluation",
+                 hs::metrics::load(stats_.stale));
+  for (size_t i = 1; i < kDivergenceKinds; ++i) {
+    reg.counter_fn(this, "hs_route_shadow_divergent_total", "Shadow samples where the shadow plan diverged from the live plan",
+                   hs::metrics::load(stats_.divergent[i]), {{"kind", divergence_name(static_cast<Divergence>(i))}});
+  }
+  reg.counter_fn(this, "hs_route_shadow_written_total", "Divergent samples written to route_shadow",
+                 hs::metrics::load(stats_.written));
+  reg.counter_fn(this, "hs_route_shadow_write_errors_total", "Failed route_shadow inserts", hs::metrics::load(stats_.write_errors));
+  reg.gauge_fn(this, "hs_route_shadow_ring_depth", "Shadow samples waiting for evaluation",
+               [this] { return static_cast<double>(ring_.size_approx()); });
+}
+
+ShadowEvaluator::~ShadowEvaluator() {
+  hs::metrics::registry().remove(this);
+  stop();
+}
+
+void ShadowEvaluator::start(TableSource table) {
+  if (opt_.sample_ppm == 0) return;
+  table_ = std::move(table);
+  thread_ = std::jthread([this](std::stop_token st) { run(st); });
+}
+
+void ShadowEvaluator::stop() {
+  if (thread_.joinable()) {
+    thread_.request_stop();
+    run_cv_.notify_all();
+    thread_.join();
+  }
+}
+
+uint64_t ShadowEvaluator::seed() {
+  uint64_t x = std::hash<std::thread::id>{}(std::this_thread::get_id()) ^
+               static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+  return x ? x : 0x9e3779b97f4a7c15ull;
+}
+
+void ShadowEvaluator::offer(const PlanIndex& live, const PlanIndex& shadow, std::string_view dest) {
+  stats_.sampled.fetch_add(1, std::memory_order_relaxed);
+  Sample s;
+  s.ts = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+  s.live_plan = live.plan_id;
+  s.shadow_plan = shadow.plan_id;
+  s.account_id = live.account_id;
+  s.size = static_cast<uint8_t>(std::min(dest.size(), sizeof(s.dest)));
+  std::memcpy(s.dest, dest.data(), s.size);
+  if (!ring_.try_push(s)) stats_.dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ShadowEvaluator::evaluate(const RouteTable& table, const Sample& s) {
+  const PlanIndex* live = table.plan(s.live_plan);
+  const PlanIndex* shadow = table.plan(s.shadow_plan);
+  if (!live || !shadow) {
+    stats_.stale.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  stats_.evaluated.fetch_add(1, std::memory_order_relaxed);
+  std::string_view dest(s.dest, s.size);
+  PolicyDiff d = compare_policies(table, *live, *shadow, dest);
+  if (d.divergence == Divergence::None) return;
+  stats_.divergent[static_cast<size_t>(d.divergence)].fetch_add(1, std::memory_order_relaxed);
+  if (opt_.ch_http.empty()) return;
+
+  // 列顺序与 flush 中的 INSERT 一致
+  rows_ += std::to_string(s.ts);
+  rows_ += '\t';
+  append_escaped(rows_, opt_.node);
+  rows_ += '\t';
+  rows_ += std::to_string(s.account_id);
+  rows_ += '\t';
+  rows_ += dest;
+  rows_ += '\t';
+  rows_ += std::to_string(s.live_plan);
+  rows_ += '\t';
+  rows_ += std::to_string(s.shadow_plan);
+  rows_ += '\t';
+  rows_ += divergence_name(d.divergence);
+  rows_ += '\t';
+  if (d.live.size) append_escaped(rows_, table.vendor(d.live.entries[0]->vendor).vendor);
+  rows_ += '\t';
+  if (d.shadow.size) append_escaped(rows_, table.vendor(d.shadow.entries[0]->vendor).vendor);
+  rows_ += '\t';
+  append_array(rows_, table, d.live);
+  rows_ += '\t';
+  append_array(rows_, table, d.shadow);
+  rows_ += '\n';
+  ++row_count_;
+}
+
+void ShadowEvaluator::flush() {
+  if (row_count_ == 0) return;
+  std::string body =
+    "INSERT INTO route_shadow (ts, node, account_id, e164_to, live_plan, shadow_plan, divergence, live_first, shadow_first, "
+    "live_vendors, shadow_vendors) FORMAT TabSeparated\n";
+  body += rows_;
+  size_t n = row_count_;
+  rows_.clear();
+  row_count_ = 0;
+  auto r = cpr::Post(cpr::Url{opt_.ch_http}, cpr::Body{std::move(body)}, cpr::Timeout{opt_.ch_timeout});
+  if (r.status_code < 200 || r.status_code >= 300) {
+    stats_.write_errors.fetch_add(1, std::memory_order_relaxed);
+    spdlog::warn("route_shadow insert of {} rows failed ({}): {}", n, r.status_code, r.error.message.empty() ? r.text : r.error.message);
+    return;
+  }
+  stats_.written.fetch_add(n, std::memory_order_relaxed);
+}
+
+void ShadowEvaluator::run(std::stop_token st) {
+  using clock = std::chrono::steady_clock;
+  auto next_flush = clock::now() + opt_.flush_interval;
+  auto next_report = clock::now() + std::chrono::seconds(60);
+  for (;;) {
+    // 每轮取一次路由快照，同一轮的样本在同一快照上评估
+    std::shared_ptr<const RouteTable> table;
+    Sample s;
+    size_t n = 0;
+    for (; n < opt_.batch_max && ring_.try_pop(s); ++n) {
+      if (!table) table = table_();
+      if (table) evaluate(*table, s);
+      else stats_.stale.fetch_add(1, std::memory_order_relaxed);
+    }
+    auto now = clock::now();
+    if (st.stop_requested() || row_count_ >= opt_.batch_max || now >= next_flush) {
+      flush();
+      next_flush = now + opt_.flush_interval;
+    }
+    if (st.stop_requested()) break;
+    if (now >= next_report) {
+      next_report = now + std::chrono::seconds(60);
+      uint64_t divergent = 0;
+      for (size_t i = 1; i < kDivergenceKinds; ++i) divergent += stats_.divergent[i].load();
+      spdlog::info("Shadow routing: sampled={} evaluated={} divergent={} dropped={} stale={} written={} write_errors={}",
+                   stats_.sampled.load(), stats_.evaluated.load(), divergent, stats_.dropped.load(), stats_.stale.load(),
+                   stats_.written.load(), stats_.write_errors.load());
+    }
+    if (n == 0) {
+      std::unique_lock<std::mutex> lk(run_mu_);
+      run_cv_.wait_for(lk, st, std::chrono::milliseconds(20), [] { return false; });
+    }
+  }
+}
+
+}
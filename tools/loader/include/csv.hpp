@@ -0,0 +1,164 @@
+#pragma once
+// loader 的输入层：只读映射文件，按行切块多线程解析，结果按文件顺序交给单线程写出（COPY）
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace hs::loader {
+
+// 只读映射整个文件。页面按需换入，写出后的区间用 release() 交还内核，常驻内存与文件大小无关
+class MappedFile {
+public:
+  explicit MappedFile(const std::string& path);
+  ~MappedFile();
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  std::string_view data() const { return {data_, size_}; }
+  // 不再访问 [0, end) 时调用
+  void release(size_t end);
+
+private:
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+  size_t released_ = 0;
+};
+
+// 一行 CSV 的字段（RFC 4180：双引号包围的字段可含逗号，"" 表示一个引号；不支持字段内换行）。
+// 不含转义的字段直接指向原行，其余指向 scratch
+class CsvRow {
+public:
+  // 引号不闭合时返回 false
+  bool split(std::string_view line);
+  size_t size() const { return fields_.size(); }
+  std::string_view operator[](size_t i) const { return i < fields_.size() ? fields_[i] : std::string_view{}; }
+
+private:
+  std::vector<std::string_view> fields_;
+  std::string scratch_;
+};
+
+std::string_view trim(std::string_view s);
+// 写入 COPY text 格式的一个字段（转义反斜杠、制表符与换行）
+void append_copy(std::string& out, std::string_view v);
+inline void append_null(std::string& out) { out += "\\N"; }
+
+// 一块的解析结果
+struct Chunk {
+  std::string copy;   // COPY text 行，每行以换行结尾
+  size_t rows = 0;    // copy 中的行数
+  size_t lines = 0;   // 块内已解析的行数；解析回调中即当前行在块内的序号
+  size_t end = 0;     // 块在输入中的结束偏移
+  size_t pos = 0;     // 当前行在输入中的字节偏移，解析回调中有效，可作文件内的顺序键
+  std::vector<std::pair<size_t, std::string>> errors;  // 块内行序号与原因
+
+  void reject(std::string why) { errors.emplace_back(lines, std::move(why)); }
+  // 结束一行 COPY 数据
+  void end_row() { copy += '\n'; ++rows; }
+};
+
+// body 在换行处切成约 chunk_bytes 的块，threads 个线程逐行调用 parse(const CsvRow&, Chunk&)；
+// 块结果按输入顺序交给 sink(Chunk&, size_t first_line)，first_line 为块首行在 body 中的序号（从 0 起）。
+// 在途的块不超过 2 * threads，内存占用与输入大小无关。回调抛出的异常在调用方线程重新抛出
+template <class Parse, class Sink>
+void parallel_csv(std::string_view body, unsigned threads, size_t chunk_bytes, Parse&& parse, Sink&& sink) {
+  threads = std::max(1u, threads);
+  std::vector<size_t> cuts{0};
+  while (cuts.back() < body.size()) {
+    size_t p = cuts.back() + chunk_bytes;
+    if (p >= body.size()) p = body.size();
+    else {
+      p = body.find('\n', p);
+      p = p == std::string_view::npos ? body.size() : p + 1;
+    }
+    cuts.push_back(p);
+  }
+  const size_t n = cuts.size() - 1;
+  const size_t window = 2 * static_cast<size_t>(threads);
+
+  std::mutex mu;
+  std::condition_variable cv;
+  std::vector<Chunk> slots(window);
+  std::vector<char> ready(window, 0);
+  size_t next = 0, consumed = 0;
+  bool stop = false;
+  std::exception_ptr error;
+
+  auto work = [&] {
+    CsvRow row;
+    for (;;) {
+      size_t k;
+      {
+        std::unique_lock<std::mutex> lk(mu);
+        cv.wait(lk, [&] { return stop || next >= n || next < consumed + window; });
+        if (stop || next >= n) return;
+        k = next++;
+      }
+      Chunk c;
+      c.end = cuts[k + 1];
+      try {
+        std::string_view rest = body.substr(cuts[k], cuts[k + 1] - cuts[k]);
+        c.copy.reserve(rest.size() + rest.size() / 4);
+        while (!rest.empty()) {
+          size_t nl = rest.find('\n');
+          std::string_view line = rest.substr(0, nl);
+          rest = nl == std::string_view::npos ? std::string_view{} : rest.substr(nl + 1);
+          if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+          c.pos = static_cast<size_t>(line.data() - body.data());
+          if (!trim(line).empty()) {
+            if (!row.split(line)) c.reject("unterminated quote");
+            else parse(static_cast<const CsvRow&>(row), c);
+          }
+          ++c.lines;
+        }
+      } catch (...) {
+        std::lock_guard<std::mutex> lk(mu);
+        if (!error) error = std::current_exception();
+        stop = true;
+        cv.notify_all();
+        return;
+      }
+      std::lock_guard<std::mutex> lk(mu);
+      slots[k % window] = std::move(c);
+      ready[k % window] = 1;
+      cv.notify_all();
+    }
+  };
+
+  std::vector<std::jthread> workers;
+  for (unsigned i = 0; i < threads; ++i) workers.emplace_back(work);
+  try {
+    size_t line = 0;
+    for (size_t k = 0; k < n; ++k) {
+      Chunk c;
+      {
+        std::unique_lock<std::mutex> lk(mu);
+        cv.wait(lk, [&] { return ready[k % window] || error; });
+        if (error) std::rethrow_exception(error);
+        c = std::move(slots[k % window]);
+        ready[k % window] = 0;
+        consumed = k + 1;
+      }
+      cv.notify_all();
+      size_t first = line;
+      line += c.lines;
+      sink(c, first);
+    }
+  } catch (...) {
+    {
+      std::lock_guard<std::mutex> lk(mu);
+      stop = true;
+    }
+    cv.notify_all();
+    throw;
+  }
+}
+
+}
@@ -0,0 +1,29 @@
+#pragma once
+// libphonenumber 元数据（PhoneNumberMetadata.xml）的编译：读取各地区各类型的 nationalNumberPattern，
+// 把正则展开为前缀集合，供号码计划索引与 routing.prefixes 使用
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "common/number_plan.hpp"
+
+namespace hs::loader {
+
+// 一个地区的一类号码
+struct PhonePattern {
+  std::string region;        // CLDR 地区码，非地理号码为 "001"
+  std::string name;          // 地区名（取自元数据中的注释），缺省为地区码
+  std::string calling_code;
+  hs::NumberType type;
+  std::string pattern;       // 去掉空白后的 nationalNumberPattern
+};
+
+// generalDesc（各类型之并）与 noInternationalDialling 不收录；结构不符时抛出 std::runtime_error
+std::vector<PhonePattern> read_phone_metadata(std::string_view xml);
+
+// 把 pattern 展开为 (国内号码前缀, 国内号码总长度)：以前缀开头、长度相符的号码恰好是 pattern 匹配的全部号码。
+// 末尾连续的 \d 不展开。支持元数据用到的正则子集：数字、\d、字符类、(?:…)、|、?、{n}、{n,m}；
+// 其余语法或展开结果过大时抛出 std::invalid_argument
+void expand_pattern(std::string_view pattern, const std::function<void(std::string_view prefix, size_t length)>& emit);
+
+}
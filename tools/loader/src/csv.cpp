@@ -0,0 +1,108 @@
+#include "csv.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+namespace hs::loader {
+
+MappedFile::MappedFile(const std::string& path) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) throw std::runtime_error("cannot open " + path + ": " + std::strerror(errno));
+  struct stat st {};
+  if (::fstat(fd, &st) != 0) {
+    int err = errno;
+    ::close(fd);
+    throw std::runtime_error("cannot stat " + path + ": " + std::strerror(err));
+  }
+  size_ = static_cast<size_t>(st.st_size);
+  if (size_ > 0) {
+    void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+      int err = errno;
+      ::close(fd);
+      throw std::runtime_error("cannot map " + path + ": " + std::strerror(err));
+    }
+    ::madvise(p, size_, MADV_SEQUENTIAL);
+    data_ = static_cast<const char*>(p);
+  }
+  ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (data_) ::munmap(const_cast<char*>(data_), size_);
+}
+
+void MappedFile::release(size_t end) {
+  // 按页对齐，末尾不足一页的部分留给下一次
+  static const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+  end = std::min(end, size_) / page * page;
+  if (!data_ || end <= released_) return;
+  ::madvise(const_cast<char*>(data_) + released_, end - released_, MADV_DONTNEED);
+  released_ = end;
+}
+
+bool CsvRow::split(std::string_view line) {
+  fields_.clear();
+  scratch_.clear();
+  // 反转义后的字段不会比原行长，预留后 scratch_ 不再重新分配，已有视图保持有效
+  scratch_.reserve(line.size());
+  size_t i = 0;
+  for (;;) {
+    if (i < line.size() && line[i] == '"') {
+      size_t start = scratch_.size();
+      bool plain = true;
+      size_t begin = ++i;
+      for (;;) {
+        if (i >= line.size()) return false;
+        if (line[i] != '"') { ++i; continue; }
+        if (i + 1 < line.size() && line[i + 1] == '"') {
+          scratch_.append(line.substr(begin, i - begin));
+          plain = false;
+          scratch_ += '"';
+          i += 2;
+          begin = i;
+          continue;
+        }
+        break;
+      }
+      if (plain) fields_.push_back(line.substr(begin, i - begin));
+      else {
+        scratch_.append(line.substr(begin, i - begin));
+        fields_.emplace_back(scratch_.data() + start, scratch_.size() - start);
+      }
+      ++i;  // 闭合引号；其后到逗号之间的内容忽略
+      size_t comma = line.find(',', i);
+      if (comma == std::string_view::npos) return true;
+      i = comma + 1;
+    } else {
+      size_t comma = line.find(',', i);
+      fields_.push_back(line.substr(i, comma == std::string_view::npos ? std::string_view::npos : comma - i));
+      if (comma == std::string_view::npos) return true;
+      i = comma + 1;
+    }
+  }
+}
+
+std::string_view trim(std::string_view s) {
+  while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+  while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+  return s;
+}
+
+void append_copy(std::string& out, std::string_view v) {
+  for (char c : v) {
+    switch (c) {
+      case '\\': out += "\\\\"; break;
+      case '\t': out += "\\t"; break;
+      case '\n': out += "\\n"; break;
+      case '\r': out += "\\r"; break;
+      default: out += c;
+    }
+  }
+}
+
+}
@@ -0,0 +1,323 @@
+#include "phone_metadata.hpp"
+#include <charconv>
+#include <stdexcept>
+#include <utility>
+#include <fmt/format.h>
+
+namespace hs::loader {
+
+namespace {
+
+// ---- XML ----
+
+struct TypeTag {
+  std::string_view tag;
+  hs::NumberType type;
+};
+
+constexpr TypeTag kTypeTags[] = {
+  {"fixedLine", hs::NumberType::FixedLine},     {"mobile", hs::NumberType::Mobile},
+  {"pager", hs::NumberType::Pager},             {"tollFree", hs::NumberType::TollFree},
+  {"premiumRate", hs::NumberType::PremiumRate}, {"sharedCost", hs::NumberType::SharedCost},
+  {"personalNumber", hs::NumberType::PersonalNumber}, {"voip", hs::NumberType::Voip},
+  {"uan", hs::NumberType::Uan},                 {"voicemail", hs::NumberType::Voicemail},
+};
+
+bool is_space(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+std::string_view trim_ws(std::string_view s) {
+  while (!s.empty() && is_space(s.front())) s.remove_prefix(1);
+  while (!s.empty() && is_space(s.back())) s.remove_suffix(1);
+  return s;
+}
+
+// 标签内 name="value" 的值，不存在时为空
+std::string attr(std::string_view tag, std::string_view name) {
+  for (size_t p = tag.find(name); p != std::string_view::npos; p = tag.find(name, p + 1)) {
+    size_t q = p + name.size();
+    if (p == 0 || !is_space(tag[p - 1]) || tag.substr(q, 2) != "=\"") continue;
+    size_t e = tag.find('"', q + 2);
+    if (e == std::string_view::npos) break;
+    return std::string(tag.substr(q + 2, e - q - 2));
+  }
+  return {};
+}
+
+// 元数据中每个地区前的注释形如 "Ascension Island (AC)"
+std::string name_from_comment(std::string_view comment, std::string_view id) {
+  comment = trim_ws(comment);
+  std::string suffix = fmt::format(" ({})", id);
+  if (comment.size() > suffix.size() && comment.ends_with(suffix)) return std::string(comment.substr(0, comment.size() - suffix.size()));
+  return {};
+}
+
+// ---- 正则 ----
+
+constexpr uint16_t kAny = 0x3ff;
+constexpr size_t kMaxSequences = size_t{1} << 20;
+constexpr size_t kMaxPrefixes = size_t{1} << 21;
+
+struct Re {
+  enum Kind { Set, Seq, Alt, Rep } kind;
+  uint16_t mask = 0;
+  int lo = 1, hi = 1;
+  std::vector<Re> items{};
+};
+
+class ReParser {
+public:
+  explicit ReParser(std::string_view s) : s_(s) {}
+
+  Re parse() {
+    Re r = alt();
+    if (i_ != s_.size()) fail("unbalanced ')'");
+    return r;
+  }
+
+private:
+  bool peek(char c) const { return i_ < s_.size() && s_[i_] == c; }
+
+  [[noreturn]] void fail(std::string_view why) const {
+    throw std::invalid_argument(fmt::format("{} at offset {} in pattern {}", why, i_, s_));
+  }
+
+  Re alt() {
+    Re r{Re::Alt};
+    r.items.push_back(seq());
+    while (peek('|')) {
+      ++i_;
+      r.items.push_back(seq());
+    }
+    return r;
+  }
+
+  Re seq() {
+    Re r{Re::Seq};
+    while (i_ < s_.size() && s_[i_] != '|' && s_[i_] != ')') r.items.push_back(quantified());
+    return r;
+  }
+
+  Re quantified() {
+    Re a = atom();
+    int lo = 1, hi = 1;
+    if (peek('?')) {
+      ++i_;
+      lo = 0;
+    } else if (peek('{')) {
+      size_t e = s_.find('}', i_);
+      if (e == std::string_view::npos) fail("missing '}'");
+      std::string_view q = s_.substr(i_ + 1, e - i_ - 1);
+      size_t comma = q.find(',');
+      auto num = [&](std::string_view v, int& out) {
+        auto [p, ec] = std::from_chars(v.data(), v.data() + v.size(), out);
+        if (ec != std::errc() || p != v.data() + v.size()) fail("invalid repetition");
+      };
+      num(q.substr(0, comma), lo);
+      if (comma == std::string_view::npos) hi = lo;
+      else num(q.substr(comma + 1), hi);  // {n,} 无上界，同样拒绝
+      if (lo < 0 || hi < lo || hi > static_cast<int>(hs::NumberPlan::kMaxDigits)) fail("invalid repetition");
+      i_ = e + 1;
+    } else if (peek('*') || peek('+')) {
+      fail("unbounded repetition");
+    } else {
+      return a;
+    }
+    Re r{Re::Rep};
+    r.lo = lo;
+    r.hi = hi;
+    r.items.push_back(std::move(a));
+    return r;
+  }
+
+  Re atom() {
+    if (i_ >= s_.size()) fail("unexpected end");
+    char c = s_[i_];
+    if (c == '(') {
+      ++i_;
+      if (s_.substr(i_, 2) == "?:") i_ += 2;
+      else if (peek('?')) fail("unsupported group");
+      Re r = alt();
+      if (!peek(')')) fail("missing ')'");
+      ++i_;
+      return r;
+    }
+    if (c == '[') {
+      Re r{Re::Set};
+      ++i_;
+      if (peek('^')) fail("negated class");
+      while (!peek(']')) {
+        if (i_ >= s_.size()) fail("missing ']'");
+        if (s_.substr(i_, 2) == "\\d") {
+          r.mask = kAny;
+          i_ += 2;
+          continue;
+        }
+        unsigned a = static_cast<unsigned char>(s_[i_]) - '0';
+        if (a > 9) fail("unsupported class member");
+        unsigned b = a;
+        if (i_ + 2 < s_.size() && s_[i_ + 1] == '-') {
+          b = static_cast<unsigned char>(s_[i_ + 2]) - '0';
+          if (b > 9 || b < a) fail("invalid class range");
+          i_ += 2;
+        }
+        for (unsigned d = a; d <= b; ++d) r.mask = static_cast<uint16_t>(r.mask | (1u << d));
+        ++i_;
+      }
+      ++i_;
+      return r;
+    }
+    if (c == '\\') {
+      if (s_.substr(i_, 2) != "\\d") fail("unsupported escape");
+      i_ += 2;
+      return {Re::Set, kAny};
+    }
+    if (c >= '0' && c <= '9') {
+      ++i_;
+      return {Re::Set, static_cast<uint16_t>(1u << (c - '0'))};
+    }
+    fail("unsupported syntax");
+  }
+
+  std::string_view s_;
+  size_t i_ = 0;
+};
+
+// 每个序列是逐位的数字集合位图
+using Sequences = std::vector<std::vector<uint16_t>>;
+
+Sequences product(const Sequences& a, const Sequences& b) {
+  if (a.size() * b.size() > kMaxSequences) throw std::invalid_argument("pattern expands to too many alternatives");
+  Sequences out;
+  out.reserve(a.size() * b.size());
+  for (const auto& x : a)
+    for (const auto& y : b) {
+      auto& s = out.emplace_back(x);
+      s.insert(s.end(), y.begin(), y.end());
+    }
+  return out;
+}
+
+Sequences expand(const Re& r) {
+  switch (r.kind) {
+    case Re::Set: return {{r.mask}};
+    case Re::Alt: {
+      Sequences out;
+      for (const auto& it : r.items) {
+        auto e = expand(it);
+        if (out.size() + e.size() > kMaxSequences) throw std::invalid_argument("pattern expands to too many alternatives");
+        out.insert(out.end(), std::make_move_iterator(e.begin()), std::make_move_iterator(e.end()));
+      }
+      return out;
+    }
+    case Re::Seq: {
+      Sequences out{{}};
+      for (const auto& it : r.items) out = product(out, expand(it));
+      return out;
+    }
+    case Re::Rep: {
+      Sequences one = expand(r.items[0]), cur{{}}, out;
+      for (int k = 0; k <= r.hi; ++k) {
+        if (k >= r.lo) out.insert(out.end(), cur.begin(), cur.end());
+        if (k < r.hi) cur = product(cur, one);
+      }
+      return out;
+    }
+  }
+  return {};
+}
+
+}
+
+std::vector<PhonePattern> read_phone_metadata(std::string_view xml) {
+  std::vector<PhonePattern> out;
+  std::string name_hint;  // 最近一条形如 "Name (ID)" 的注释
+  std::vector<std::string_view> comments;
+  bool in_territory = false;
+  std::string id, cc, name;
+  const TypeTag* type = nullptr;
+
+  for (size_t i = xml.find('<'); i != std::string_view::npos; i = xml.find('<', i)) {
+    if (xml.substr(i, 4) == "<!--") {
+      size_t e = xml.find("-->", i + 4);
+      if (e == std::string_view::npos) throw std::runtime_error("unterminated comment");
+      if (!in_territory) comments.push_back(xml.substr(i + 4, e - i - 4));
+      i = e + 3;
+      continue;
+    }
+    if (xml.substr(i, 2) == "<!" || xml.substr(i, 2) == "<?") {
+      // DOCTYPE 的内部子集含 '>'，跳到 "]>"
+      size_t gt = xml.find('>', i), br = xml.find('[', i);
+      i = br < gt ? xml.find("]>", br) : gt;
+      if (i == std::string_view::npos) throw std::runtime_error("unterminated declaration");
+      ++i;
+      continue;
+    }
+    size_t gt = xml.find('>', i);
+    if (gt == std::string_view::npos) throw std::runtime_error("unterminated tag");
+    std::string_view tag = xml.substr(i + 1, gt - i - 1);
+    i = gt + 1;
+    bool closing = tag.starts_with('/');
+    if (closing) tag.remove_prefix(1);
+    std::string_view tname = tag.substr(0, std::min(tag.size(), tag.find_first_of(" \t\r\n/")));
+
+    if (tname == "territory") {
+      if (closing) {
+        in_territory = false;
+        continue;
+      }
+      in_territory = true;
+      id = attr(tag, "id");
+      cc = attr(tag, "countryCode");
+      if (id.empty() || cc.empty()) throw std::runtime_error("territory without id or countryCode");
+      name.clear();
+      for (auto c = comments.rbegin(); c != comments.rend() && name.empty(); ++c) name = name_from_comment(*c, id);
+      if (name.empty()) name = id == "001" ? "+" + cc : id;
+      comments.clear();
+      continue;
+    }
+    if (!in_territory) continue;
+    if (tname == "nationalNumberPattern" && !closing) {
+      size_t e = xml.find("</nationalNumberPattern>", i);
+      if (e == std::string_view::npos) throw std::runtime_error("unterminated nationalNumberPattern in " + id);
+      if (type) {
+        std::string p;
+        for (char c : xml.substr(i, e - i))
+          if (!is_space(c)) p += c;
+        out.push_back({id, name, cc, type->type, std::move(p)});
+      }
+      i = e;
+      continue;
+    }
+    for (const auto& t : kTypeTags)
+      if (t.tag == tname) type = closing || tag.ends_with('/') ? nullptr : &t;
+  }
+  if (out.empty()) throw std::runtime_error("no number patterns found");
+  return out;
+}
+
+void expand_pattern(std::string_view pattern, const std::function<void(std::string_view prefix, size_t length)>& emit) {
+  Sequences seqs = expand(ReParser(pattern).parse());
+  size_t emitted = 0;
+  std::string prefix;
+  for (const auto& s : seqs) {
+    // 末尾的任意数字不展开，由长度约束
+    size_t k = s.size();
+    while (k > 0 && s[k - 1] == kAny) --k;
+    auto walk = [&](auto&& self, size_t pos) -> void {
+      if (pos == k) {
+        if (++emitted > kMaxPrefixes) throw std::invalid_argument("pattern expands to too many prefixes: " + std::string(pattern));
+        emit(prefix, s.size());
+        return;
+      }
+      for (unsigned d = 0; d < 10; ++d) {
+        if (!(s[pos] >> d & 1)) continue;
+        prefix.push_back(static_cast<char>('0' + d));
+        self(self, pos + 1);
+        prefix.pop_back();
+      }
+    };
+    walk(walk, 0);
+  }
+}
+
+}